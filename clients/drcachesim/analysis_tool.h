@@ -531,6 +531,39 @@ public:
     {
         return false;
     }
+    /**
+     * Returns whether this tool implements parallel_shard_memrefs() to operate on
+     * spans of consecutive trace entries, which avoids a virtual call per entry for
+     * lightweight tools.  If so, the analyzer may accumulate a shard's entries and
+     * pass them together.  A span never crosses an interval boundary and is always
+     * delivered before the interval snapshot and parallel_shard_exit() callbacks for
+     * its shard, but the shard stream may have advanced past its last entry by the
+     * time it is delivered.  A tool which queries per-entry stream state, such as
+     * memtrace_stream_t::get_output_instruction_ordinal(), should thus return false.
+     * This may be called prior to initialize().
+     */
+    virtual bool
+    parallel_shard_memrefs_supported()
+    {
+        return false;
+    }
+    /**
+     * Operates on \p count consecutive trace entries of the shard whose
+     * parallel_shard_init_stream() return value is \p shard_data, with the same
+     * effect as calling parallel_shard_memref() on each in turn, which is what the
+     * default implementation does.  This is only called if
+     * parallel_shard_memrefs_supported() returns true.  On failure,
+     * parallel_shard_error() returns a descriptive message.
+     */
+    virtual bool
+    parallel_shard_memrefs(void *shard_data, const RecordType *entries, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parallel_shard_memref(shard_data, entries[i]))
+                return false;
+        }
+        return true;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
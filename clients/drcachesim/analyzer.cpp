@@ -64,6 +64,7 @@
 #ifdef HAS_SNAPPY
 #    include "reader/snappy_file_reader.h"
 #endif
+#include "common/pipelined_stream.h"
 #include "common/utils.h"
 
 namespace dynamorio {
@@ -361,6 +362,7 @@ analyzer_tmpl_t<RecordType, ReaderType>::init_scheduler_common(
         sched_ops.replay_as_traced_istream = options.replay_as_traced_istream;
         sched_ops.read_inputs_in_init = options.read_inputs_in_init;
         sched_ops.kernel_syscall_trace_path = options.kernel_syscall_trace_path;
+        sched_ops.read_ahead_blocks = options.read_ahead_blocks;
     }
     sched_mapping_ = options.mapping;
     if (scheduler_.init(workloads, output_count, std::move(sched_ops)) !=
@@ -560,6 +562,13 @@ template <typename RecordType, typename ReaderType>
 void
 analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &worker)
 {
+    // Intervals are computed from the live stream, and time-based scheduling
+    // should see the tools' progress, so neither can run ahead of the tools.
+    if (serial_pipeline_ && interval_microseconds_ == 0 && interval_instr_count_ == 0 &&
+        !sched_by_time_) {
+        process_serial_pipelined(worker);
+        return;
+    }
     std::vector<void *> user_worker_data(num_tools_);
 
     worker.shard_data[0].tool_data.resize(num_tools_);
@@ -626,6 +635,121 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_serial(analyzer_worker_data_t &
     }
 }
 
+template <typename RecordType, typename ReaderType>
+void
+analyzer_tmpl_t<RecordType, ReaderType>::process_serial_pipelined(
+    analyzer_worker_data_t &worker)
+{
+    // Each record carries the stream state the tools would have observed when
+    // it was returned, along with the final status for the last one.
+    struct pipelined_record_t {
+        RecordType record;
+        stream_snapshot_t snapshot;
+        typename sched_type_t::stream_status_t status;
+    };
+    static constexpr size_t NUM_BATCHES = 8;
+    static constexpr size_t BATCH_SIZE = 4096;
+    spsc_batch_queue_t<pipelined_record_t> queue(NUM_BATCHES, BATCH_SIZE);
+    auto *stream = new pipelined_stream_t(worker.stream);
+    serial_pipeline_stream_.reset(stream);
+
+    for (int i = 0; i < num_tools_; ++i) {
+        worker.error = tools_[i]->initialize_stream(stream);
+        if (!worker.error.empty())
+            return;
+        worker.error = tools_[i]->initialize_shard_type(shard_type_);
+        if (!worker.error.empty())
+            return;
+    }
+
+    // The readers, and their decompression helpers with -read_ahead_blocks, are
+    // driven from this thread as the scheduler interleaves them.
+    std::thread producer([&]() {
+        while (true) {
+            std::vector<pipelined_record_t> *batch = queue.producer_acquire();
+            if (batch == nullptr)
+                return;
+            bool done = false;
+            while (!done && batch->size() < queue.batch_size()) {
+                batch->emplace_back();
+                pipelined_record_t &entry = batch->back();
+                entry.status = worker.stream->next_record(entry.record);
+                if (entry.status == sched_type_t::STATUS_WAIT) {
+                    entry.record = create_wait_marker();
+                    entry.status = sched_type_t::STATUS_OK;
+                } else if (entry.status == sched_type_t::STATUS_IDLE) {
+                    assert(shard_type_ == SHARD_BY_CORE);
+                    entry.record = create_idle_marker();
+                    entry.status = sched_type_t::STATUS_OK;
+                } else if (entry.status != sched_type_t::STATUS_OK)
+                    done = true;
+                entry.snapshot.capture(*worker.stream);
+            }
+            queue.producer_publish();
+            if (done)
+                return;
+        }
+    });
+
+    typename sched_type_t::stream_status_t final_status = sched_type_t::STATUS_OK;
+    while (final_status == sched_type_t::STATUS_OK && worker.error.empty()) {
+        std::vector<pipelined_record_t> *batch = queue.consumer_acquire();
+        for (const pipelined_record_t &entry : *batch) {
+            if (entry.status != sched_type_t::STATUS_OK) {
+                final_status = entry.status;
+                break;
+            }
+            stream->set_snapshot(&entry.snapshot);
+            for (int i = 0; i < num_tools_; ++i) {
+                if (!tools_[i]->process_memref(entry.record)) {
+                    worker.error = tools_[i]->get_error_string();
+                    VPRINT(this, 1, "Worker %d hit memref error %s on trace shard %s\n",
+                           worker.index, worker.error.c_str(),
+                           stream->get_stream_name().c_str());
+                    break;
+                }
+            }
+            if (!worker.error.empty())
+                break;
+        }
+        queue.consumer_release();
+    }
+    queue.stop();
+    producer.join();
+    stream->hold_source_state();
+    if (!worker.error.empty() || final_status == sched_type_t::STATUS_EOF)
+        return;
+    if (final_status == sched_type_t::STATUS_REGION_INVALID) {
+        worker.error = "Too-far -skip_instrs for: " + worker.stream->get_stream_name();
+    } else {
+        worker.error = "Failed to read from trace: " + worker.stream->get_stream_name();
+    }
+}
+
+template <typename RecordType, typename ReaderType>
+bool
+analyzer_tmpl_t<RecordType, ReaderType>::flush_memref_batch(
+    analyzer_worker_data_t *worker)
+{
+    if (worker->batch.empty())
+        return true;
+    analyzer_shard_data_t &shard = worker->shard_data[worker->batch_shard_index];
+    for (int i : batched_tools_) {
+        if (!tools_[i]->parallel_shard_memrefs(shard.tool_data[i].shard_data,
+                                               worker->batch.data(),
+                                               worker->batch.size())) {
+            worker->error =
+                tools_[i]->parallel_shard_error(shard.tool_data[i].shard_data);
+            VPRINT(this, 1,
+                   "Worker %d hit shard memref error %s on trace shard index %d\n",
+                   worker->index, worker->error.c_str(), worker->batch_shard_index);
+            return false;
+        }
+    }
+    worker->batch.clear();
+    return true;
+}
+
 template <typename RecordType, typename ReaderType>
 bool
 analyzer_tmpl_t<RecordType, ReaderType>::process_shard_exit(
@@ -633,6 +757,8 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_shard_exit(
 {
     VPRINT(this, 1, "Worker %d finished trace shard %s\n", worker->index,
            worker->stream->get_stream_name().c_str());
+    if (shard_index == worker->batch_shard_index && !flush_memref_batch(worker))
+        return false;
     worker->shard_data[shard_index].exited = true;
     if (interval_microseconds_ != 0 || interval_instr_count_ != 0) {
         if (!do_process_final_interval) {
@@ -731,15 +857,18 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
         }
         uint64_t prev_interval_index;
         uint64_t prev_interval_init_instr_count;
+        // Batched records must reach the tools before the interval ends.
         if ((record_is_timestamp(record) || record_is_instr(record)) &&
             advance_interval_id(worker->stream, &worker->shard_data[shard_index],
                                 prev_interval_index, prev_interval_init_instr_count,
                                 record_is_instr(record)) &&
-            !process_interval(prev_interval_index, prev_interval_init_instr_count, worker,
-                              /*parallel=*/true, record_is_instr(record), shard_index)) {
+            (!flush_memref_batch(worker) ||
+             !process_interval(prev_interval_index, prev_interval_init_instr_count,
+                               worker, /*parallel=*/true, record_is_instr(record),
+                               shard_index))) {
             return false;
         }
-        for (int i = 0; i < num_tools_; ++i) {
+        for (int i : unbatched_tools_) {
             if (!tools_[i]->parallel_shard_memref(
                     worker->shard_data[shard_index].tool_data[i].shard_data, record)) {
                 worker->error = tools_[i]->parallel_shard_error(
@@ -750,6 +879,16 @@ analyzer_tmpl_t<RecordType, ReaderType>::process_tasks_internal(
                 return false;
             }
         }
+        if (!batched_tools_.empty()) {
+            if (shard_index != worker->batch_shard_index) {
+                if (!flush_memref_batch(worker))
+                    return false;
+                worker->batch_shard_index = shard_index;
+            }
+            worker->batch.push_back(record);
+            if (worker->batch.size() >= MEMREF_BATCH_SIZE && !flush_memref_batch(worker))
+                return false;
+        }
         if (record_is_thread_final(record) && shard_type_ != SHARD_BY_CORE) {
             if (!process_shard_exit(worker, shard_index)) {
                 return false;
@@ -1035,6 +1174,8 @@ analyzer_tmpl_t<RecordType, ReaderType>::run()
             error_string_ = "Invalid worker count: must be > 0";
             return false;
         }
+        batched_tools_.clear();
+        unbatched_tools_.clear();
         for (int i = 0; i < num_tools_; ++i) {
             error_string_ = tools_[i]->initialize_stream(nullptr);
             if (!error_string_.empty())
@@ -1042,6 +1183,10 @@ analyzer_tmpl_t<RecordType, ReaderType>::run()
             error_string_ = tools_[i]->initialize_shard_type(shard_type_);
             if (!error_string_.empty())
                 return false;
+            if (tools_[i]->parallel_shard_memrefs_supported())
+                batched_tools_.push_back(i);
+            else
+                unbatched_tools_.push_back(i);
         }
         std::vector<std::thread> threads;
         VPRINT(this, 1, "Creating %d worker threads\n", worker_count_);
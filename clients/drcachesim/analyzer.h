@@ -203,12 +203,18 @@ protected:
             stream = src.stream;
             shard_data = std::move(src.shard_data);
             error = std::move(src.error);
+            batch = std::move(src.batch);
+            batch_shard_index = src.batch_shard_index;
         }
 
         int index;
         typename scheduler_tmpl_t<RecordType, ReaderType>::stream_t *stream;
         std::string error;
         std::unordered_map<int, analyzer_shard_data_t> shard_data;
+        // Records accumulated for the tools which take spans of records, all from
+        // the shard batch_shard_index.
+        std::vector<RecordType> batch;
+        int batch_shard_index = -1;
 
     private:
         // Delete copy constructor and assignment operator to avoid overhead of
@@ -235,8 +241,8 @@ protected:
     // For core-sharded, worker_count_ must be set prior to calling this; for parallel
     // mode if it is not set it will be set to the underlying core count.
     // For core-sharded, all of "options" is used; otherwise, the
-    // read_inputs_in_init, replay_as_traced_istream, and kernel_syscall_trace_path
-    // fields are preserved.
+    // read_inputs_in_init, replay_as_traced_istream, kernel_syscall_trace_path, and
+    // read_ahead_blocks fields are preserved.
     bool
     init_scheduler_common(std::vector<typename sched_type_t::input_workload_t> &workloads,
                           typename sched_type_t::scheduler_options_t options);
@@ -248,10 +254,20 @@ protected:
     void
     process_serial(analyzer_worker_data_t &worker);
 
+    // Helper for process_serial() which reads and interleaves records on a separate
+    // thread from the one running the tools.
+    void
+    process_serial_pipelined(analyzer_worker_data_t &worker);
+
     // Helper for process_tasks().
     bool
     process_tasks_internal(analyzer_worker_data_t *worker);
 
+    // Helper for process_tasks() which passes the worker's accumulated records to the
+    // tools in batched_tools_.  Returns false if there was an error.
+    bool
+    flush_memref_batch(analyzer_worker_data_t *worker);
+
     // Helper for process_tasks() which calls parallel_shard_exit() in each tool.
     // Returns false if there was an error and the caller should return early.
     bool
@@ -376,6 +392,13 @@ protected:
     std::vector<analyzer_worker_data_t> worker_data_;
     int num_tools_;
     analysis_tool_tmpl_t<RecordType> **tools_;
+    // For parallel mode, the indices into tools_ of the tools which take spans of
+    // records and of those which take one record at a time.
+    std::vector<int> batched_tools_;
+    std::vector<int> unbatched_tools_;
+    // The maximum number of records passed in one parallel_shard_memrefs() call.
+    // This keeps a span in the cache while bounding the delay before delivery.
+    static constexpr size_t MEMREF_BATCH_SIZE = 256;
     // Stores the interval state snapshots, merged across shards. These are
     // produced when timestamp intervals are enabled using interval_microseconds_.
     //
@@ -437,6 +460,12 @@ protected:
     int verbosity_ = 0;
     shard_type_t shard_type_ = SHARD_BY_THREAD;
     bool sched_by_time_ = false;
+    // Whether a serial analysis runs record reading and interleaving on a helper
+    // thread, leaving the worker thread to run only the tools.
+    bool serial_pipeline_ = false;
+    // The stream given to the tools for a pipelined serial analysis.  It outlives
+    // the analysis as tools may query it when printing results.
+    std::unique_ptr<memtrace_stream_t> serial_pipeline_stream_;
     typename sched_type_t::mapping_t sched_mapping_ = sched_type_t::MAP_TO_ANY_OUTPUT;
 
     // Factory to create noise generators that can then be added to the scheduler's
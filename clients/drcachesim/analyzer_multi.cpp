@@ -37,6 +37,7 @@
 #include "common/utils.h"
 #include "common/directory_iterator.h"
 #include "noise_generator.h"
+#include "tlb_multi_simulator.h"
 #include "tlb_simulator.h"
 #include "tracer/raw2trace_directory.h"
 #include "tracer/raw2trace.h"
@@ -54,6 +55,7 @@
 #endif
 #include "reader/ipc_reader.h"
 #include "simulator/cache_simulator_create.h"
+#include "simulator/cache_sweep.h"
 #include "simulator/tlb_simulator_create.h"
 #include "tools/basic_counts_create.h"
 #include "tools/filter/record_filter_create.h"
@@ -199,6 +201,20 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         return cache_miss_analyzer_create(*knobs, op_miss_count_threshold.get_value(),
                                           op_miss_frac_threshold.get_value(),
                                           op_confidence_threshold.get_value());
+    } else if (tool == CACHE_SWEEP) {
+        cache_sweep_knobs_t sweep_knobs;
+        std::string error = parse_cache_sweep_lists(
+            op_sweep_LL_sizes.get_value(), op_sweep_LL_assocs.get_value(), sweep_knobs);
+        if (!error.empty()) {
+            ERRMSG("Usage error: %s\n", error.c_str());
+            return nullptr;
+        }
+        sweep_knobs.sample_rate = op_sweep_sample_rate.get_value();
+        const std::string &config_file = op_config_file.get_value();
+        if (!config_file.empty())
+            return cache_sweep_create(config_file, sweep_knobs);
+        cache_simulator_knobs_t *knobs = get_cache_simulator_knobs();
+        return cache_sweep_create(*knobs, sweep_knobs);
     } else if (tool == TLB || tool == TLB_LEGACY) {
         tlb_simulator_knobs_t knobs;
         knobs.num_cores = op_num_cores.get_value();
@@ -219,6 +235,16 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         knobs.use_physical = op_use_physical.get_value();
         knobs.v2p_file =
             get_aux_file_path(op_v2p_file.get_value(), DRMEMTRACE_V2P_FILENAME);
+        if (!op_TLB_configs.get_value().empty()) {
+            std::vector<tlb_simulator_knobs_t> configs;
+            std::string error =
+                parse_tlb_configs(op_TLB_configs.get_value(), knobs, configs);
+            if (!error.empty()) {
+                ERRMSG("Usage error: -TLB_configs: %s\n", error.c_str());
+                return nullptr;
+            }
+            return tlb_multi_simulator_create(configs, op_TLB_config_threads.get_value());
+        }
         analysis_tool_t *tlb_simulator = tlb_simulator_create(knobs);
         return tlb_simulator;
     } else if (tool == HISTOGRAM) {
@@ -233,6 +259,7 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         knobs.skip_list_distance = op_reuse_skip_dist.get_value();
         knobs.distance_limit = op_reuse_distance_limit.get_value();
         knobs.verify_skip = op_reuse_verify_skip.get_value();
+        knobs.use_tree = op_reuse_use_tree.get_value();
         knobs.histogram_bin_multiplier = op_reuse_histogram_bin_multiplier.get_value();
         if (knobs.histogram_bin_multiplier < 1.0) {
             ERRMSG("Usage error: reuse_histogram_bin_multiplier must be >= 1.0\n");
@@ -281,7 +308,8 @@ analyzer_multi_t::create_analysis_tool_from_options(const std::string &tool)
         auto ext_tool = create_external_tool(tool);
         if (ext_tool == nullptr) {
             ERRMSG("Usage error: unsupported analyzer type \"%s\". "
-                   "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " TLB ", " HISTOGRAM
+                   "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " CACHE_SWEEP ", " TLB
+                   ", " HISTOGRAM
                    ", " REUSE_DIST ", " BASIC_COUNTS ", " OPCODE_MIX ", " SYSCALL_MIX
                    ", " VIEW ", " FUNC_VIEW ", or some external analyzer.\n",
                    tool.c_str());
@@ -342,7 +370,7 @@ record_analyzer_multi_t::create_analysis_tool_from_options(const std::string &to
             op_filter_marker_types.get_value(), op_trim_before_timestamp.get_value(),
             op_trim_after_timestamp.get_value(), op_encodings2regdeps.get_value(),
             op_filter_func_ids.get_value(), op_modify_marker_value.get_value(),
-            op_verbose.get_value());
+            op_filter_columnar.get_value(), op_verbose.get_value());
     }
     ERRMSG("Usage error: unsupported record analyzer type \"%s\".  Only " RECORD_FILTER
            " is supported.\n",
@@ -402,6 +430,7 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::analyzer_multi_tmpl_t()
     }
     this->interval_microseconds_ = op_interval_microseconds.get_value();
     this->interval_instr_count_ = op_interval_instr_count.get_value();
+    this->serial_pipeline_ = op_serial_pipeline.get_value();
     // Initial measurements show it's sometimes faster to keep the parallel model
     // of using single-file readers but use them sequentially, as opposed to
     // the every-file interleaving reader, but the user can specify -jobs 1, so
@@ -573,6 +602,8 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::analyzer_multi_tmpl_t()
     }
 
     sched_ops.kernel_syscall_trace_path = op_sched_syscall_file.get_value();
+    sched_ops.read_ahead_blocks = op_read_ahead_blocks.get_value();
+    sched_ops.mmap_uncompressed_inputs = op_mmap_uncompressed_inputs.get_value();
 
     // Enable the noise generator before init_scheduler(), where we eventually add a
     // noise generator as another input workload.
@@ -866,6 +897,7 @@ analyzer_multi_tmpl_t<RecordType, ReaderType>::get_cache_simulator_knobs()
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
     knobs->use_physical = op_use_physical.get_value();
+    knobs->parallel = op_cache_parallel.get_value();
     return knobs;
 }
 
@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2022-2023 Google, Inc.  All rights reserved.
+ * Copyright (c) 2022-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -54,6 +54,15 @@ public:
     // error description on failure.
     virtual std::string
     open_new_component(const std::string &name) = 0;
+
+    // As above, additionally recording "comment" in the archive's metadata for
+    // the new component where the archive format supports that.  The default
+    // implementation drops the comment.
+    virtual std::string
+    open_new_component_with_comment(const std::string &name, const std::string &comment)
+    {
+        return open_new_component(name);
+    }
 };
 
 } // namespace drmemtrace
@@ -0,0 +1,87 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* chunk_index: per-chunk seek metadata for zipfile traces. */
+
+#ifndef _CHUNK_INDEX_H_
+#define _CHUNK_INDEX_H_ 1
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Writers of zipfile traces attach one of these to each chunk component as
+// its comment in the zip central directory.  A reader can then build a seek
+// index for the whole shard by walking just the central directory, without
+// decompressing any chunk, and jump to any instruction with a binary search
+// and a single unzSetOffset64().  Readers that do not know about the comment
+// ignore it, so the trace format itself is unchanged.
+struct chunk_index_entry_t {
+    // The number of instructions in all prior chunks.
+    uint64_t instr_ordinal = 0;
+    // The last timestamp before the chunk, which is also the timestamp
+    // duplicated into the chunk's header.  This is 0 for the first chunk.
+    uint64_t timestamp = 0;
+};
+
+#define CHUNK_INDEX_COMMENT_PREFIX "drmemtrace_chunk"
+
+static inline std::string
+encode_chunk_index_comment(const chunk_index_entry_t &entry)
+{
+    char buf[96];
+    snprintf(buf, sizeof(buf), CHUNK_INDEX_COMMENT_PREFIX " instr=%" PRIu64
+             " timestamp=%" PRIu64,
+             entry.instr_ordinal, entry.timestamp);
+    return buf;
+}
+
+// Returns false if "comment" is not a chunk index comment, as for traces
+// written before these were added.
+static inline bool
+decode_chunk_index_comment(const char *comment, chunk_index_entry_t &entry)
+{
+    return sscanf(comment, CHUNK_INDEX_COMMENT_PREFIX " instr=%" SCNu64
+                  " timestamp=%" SCNu64,
+                  &entry.instr_ordinal, &entry.timestamp) == 2;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CHUNK_INDEX_H_ */
@@ -0,0 +1,369 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* columnar_chunk: a column-oriented, delta-encoded layout for the trace_entry_t
+ * records inside one zipfile chunk.
+ */
+
+#ifndef _COLUMNAR_CHUNK_H_
+#define _COLUMNAR_CHUNK_H_ 1
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <type_traits>
+
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// A columnar chunk component starts with COLUMNAR_CHUNK_MAGIC followed by a
+// series of blocks.  Each block is a columnar_block_header_t followed by its
+// streams, back to back.  An entries block splits its records into one stream
+// per field class so that the zip compressor sees long runs of similar bytes:
+// - COLUMNAR_STREAM_TYPE: the type of every record, as a varint.
+// - COLUMNAR_STREAM_SIZE: the size of every record, as a varint.
+// - COLUMNAR_STREAM_PC: instruction pcs, as a zigzag varint delta from the
+//   fall-through of the prior instruction.
+// - COLUMNAR_STREAM_DATA: data addresses, as a zigzag varint delta from the
+//   prior address of the same memory operand of the same instruction.
+// - COLUMNAR_STREAM_MARKER: marker values, as a zigzag varint delta from the
+//   prior value of the same marker type.
+// - COLUMNAR_STREAM_RAW: all other fields, such as encodings and headers,
+//   verbatim.
+// A raw block holds bytes which do not form whole records, verbatim in its
+// first stream.  The delta state carries across the blocks of one component
+// but starts over in each component, so chunks can still be read and skipped
+// to independently.
+#define COLUMNAR_CHUNK_MAGIC "DRMTCOL1"
+#define COLUMNAR_CHUNK_MAGIC_SIZE (sizeof(COLUMNAR_CHUNK_MAGIC) - 1)
+
+enum {
+    COLUMNAR_STREAM_TYPE,
+    COLUMNAR_STREAM_SIZE,
+    COLUMNAR_STREAM_PC,
+    COLUMNAR_STREAM_DATA,
+    COLUMNAR_STREAM_MARKER,
+    COLUMNAR_STREAM_RAW,
+    COLUMNAR_STREAM_COUNT,
+};
+
+enum {
+    COLUMNAR_BLOCK_ENTRIES,
+    COLUMNAR_BLOCK_RAW,
+};
+
+// Like trace_entry_t itself, all fields are in host byte order.
+struct columnar_block_header_t {
+    uint32_t kind;
+    // The number of records for COLUMNAR_BLOCK_ENTRIES, or of bytes for
+    // COLUMNAR_BLOCK_RAW.
+    uint32_t count;
+    uint32_t stream_size[COLUMNAR_STREAM_COUNT];
+};
+
+// Writers encode this many records per block.  This bounds the memory needed
+// by both the writer and the reader to a few megabytes.
+#define COLUMNAR_BLOCK_ENTRIES_MAX (32 * 1024)
+// Readers reject larger blocks as corrupt.
+#define COLUMNAR_BLOCK_BYTES_MAX (64 * 1024 * 1024)
+
+// The delta-encoding state shared by columnar_encoder_t and columnar_decoder_t,
+// which must update it identically.
+class columnar_state_t {
+public:
+    columnar_state_t()
+    {
+        reset();
+    }
+    void
+    reset()
+    {
+        last_pc_ = 0;
+        last_instr_size_ = 0;
+        memop_index_ = 0;
+        memset(site_addr_, 0, sizeof(site_addr_));
+        memset(marker_value_, 0, sizeof(marker_value_));
+    }
+    static int
+    stream_for_type(unsigned short type)
+    {
+        trace_type_t trace_type = static_cast<trace_type_t>(type);
+        if (trace_type == TRACE_TYPE_MARKER)
+            return COLUMNAR_STREAM_MARKER;
+        if (type_is_data(trace_type))
+            return COLUMNAR_STREAM_DATA;
+        if (is_any_instr_type(trace_type))
+            return COLUMNAR_STREAM_PC;
+        return COLUMNAR_STREAM_RAW;
+    }
+    // Returns the value "entry.addr" is predicted to be, given all prior
+    // entries in the component.  Only valid for the delta-encoded streams.
+    addr_t
+    predict(int stream, const trace_entry_t &entry)
+    {
+        switch (stream) {
+        case COLUMNAR_STREAM_PC: return last_pc_ + last_instr_size_;
+        case COLUMNAR_STREAM_DATA: return site_addr_[site_slot()];
+        case COLUMNAR_STREAM_MARKER: return marker_value_[marker_slot(entry)];
+        default: return 0;
+        }
+    }
+    // Records "entry", whose fields are now all known, as the latest.
+    void
+    update(int stream, const trace_entry_t &entry)
+    {
+        switch (stream) {
+        case COLUMNAR_STREAM_PC:
+            last_pc_ = entry.addr;
+            last_instr_size_ = entry.size;
+            memop_index_ = 0;
+            break;
+        case COLUMNAR_STREAM_DATA:
+            site_addr_[site_slot()] = entry.addr;
+            ++memop_index_;
+            break;
+        case COLUMNAR_STREAM_MARKER: marker_value_[marker_slot(entry)] = entry.addr; break;
+        default: break;
+        }
+    }
+
+private:
+    // Memory operands are keyed by the pc of their instruction and their
+    // position among its operands.  Collisions in this direct-mapped table only
+    // cost compression, as the encoder and the decoder see the same ones.
+    static const int SITE_TABLE_BITS = 12;
+    static const int MARKER_TABLE_SIZE = 256;
+    size_t
+    site_slot() const
+    {
+        uint64_t key = (static_cast<uint64_t>(last_pc_) << 4) + memop_index_;
+        return static_cast<size_t>((key * 0x9e3779b97f4a7c15ULL) >>
+                                   (64 - SITE_TABLE_BITS));
+    }
+    static size_t
+    marker_slot(const trace_entry_t &entry)
+    {
+        return entry.size % MARKER_TABLE_SIZE;
+    }
+    addr_t last_pc_;
+    addr_t last_instr_size_;
+    uint64_t memop_index_;
+    addr_t site_addr_[1 << SITE_TABLE_BITS];
+    addr_t marker_value_[MARKER_TABLE_SIZE];
+};
+
+class columnar_encoder_t {
+public:
+    // Starts a new component.
+    void
+    reset()
+    {
+        state_.reset();
+    }
+    // Appends to "out" an entries block holding "count" records.
+    void
+    encode_entries(const trace_entry_t *entries, uint32_t count, std::string &out)
+    {
+        for (int i = 0; i < COLUMNAR_STREAM_COUNT; ++i)
+            streams_[i].clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            trace_entry_t entry;
+            memcpy(&entry, &entries[i], sizeof(entry));
+            append_varint(streams_[COLUMNAR_STREAM_TYPE], entry.type);
+            append_varint(streams_[COLUMNAR_STREAM_SIZE], entry.size);
+            int stream = columnar_state_t::stream_for_type(entry.type);
+            if (stream == COLUMNAR_STREAM_RAW) {
+                addr_t raw = entry.addr;
+                streams_[stream].append(reinterpret_cast<const char *>(&raw),
+                                        sizeof(raw));
+            } else {
+                addr_t delta = entry.addr - state_.predict(stream, entry);
+                append_varint(streams_[stream], zigzag_encode(delta));
+                state_.update(stream, entry);
+            }
+        }
+        columnar_block_header_t header = {};
+        header.kind = COLUMNAR_BLOCK_ENTRIES;
+        header.count = count;
+        for (int i = 0; i < COLUMNAR_STREAM_COUNT; ++i)
+            header.stream_size[i] = static_cast<uint32_t>(streams_[i].size());
+        out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (int i = 0; i < COLUMNAR_STREAM_COUNT; ++i)
+            out.append(streams_[i]);
+    }
+    // Appends to "out" a raw block holding "size" bytes.
+    static void
+    encode_raw(const char *data, uint32_t size, std::string &out)
+    {
+        columnar_block_header_t header = {};
+        header.kind = COLUMNAR_BLOCK_RAW;
+        header.count = size;
+        header.stream_size[0] = size;
+        out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.append(data, size);
+    }
+
+private:
+    static uint64_t
+    zigzag_encode(addr_t delta)
+    {
+        int64_t value =
+            static_cast<int64_t>(static_cast<std::make_signed<addr_t>::type>(delta));
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+    static void
+    append_varint(std::string &stream, uint64_t value)
+    {
+        while (value >= 0x80) {
+            stream.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        stream.push_back(static_cast<char>(value));
+    }
+
+    columnar_state_t state_;
+    std::string streams_[COLUMNAR_STREAM_COUNT];
+};
+
+class columnar_decoder_t {
+public:
+    // Starts a new component.
+    void
+    reset()
+    {
+        state_.reset();
+    }
+    // Returns the total size of the streams following "header", or 0 if the
+    // header is invalid.
+    static size_t
+    payload_size(const columnar_block_header_t &header)
+    {
+        size_t size = 0;
+        for (int i = 0; i < COLUMNAR_STREAM_COUNT; ++i)
+            size += header.stream_size[i];
+        if ((header.kind != COLUMNAR_BLOCK_ENTRIES && header.kind != COLUMNAR_BLOCK_RAW) ||
+            size == 0 || size > COLUMNAR_BLOCK_BYTES_MAX ||
+            header.count > COLUMNAR_BLOCK_BYTES_MAX / sizeof(trace_entry_t))
+            return 0;
+        return size;
+    }
+    // Replaces the contents of "out" with the bytes of the block described by
+    // "header", whose streams are in "payload".  Returns false if the block is
+    // corrupt.
+    bool
+    decode(const columnar_block_header_t &header, const char *payload, std::string &out)
+    {
+        if (header.kind == COLUMNAR_BLOCK_RAW) {
+            if (header.count != header.stream_size[0])
+                return false;
+            out.assign(payload, header.count);
+            return true;
+        }
+        stream_reader_t streams[COLUMNAR_STREAM_COUNT];
+        const char *cur = payload;
+        for (int i = 0; i < COLUMNAR_STREAM_COUNT; ++i) {
+            streams[i].cur = cur;
+            cur += header.stream_size[i];
+            streams[i].end = cur;
+        }
+        out.resize(header.count * sizeof(trace_entry_t));
+        char *dest = &out[0];
+        for (uint32_t i = 0; i < header.count; ++i) {
+            trace_entry_t entry;
+            uint64_t value;
+            if (!streams[COLUMNAR_STREAM_TYPE].read_varint(value))
+                return false;
+            entry.type = static_cast<unsigned short>(value);
+            if (!streams[COLUMNAR_STREAM_SIZE].read_varint(value))
+                return false;
+            entry.size = static_cast<unsigned short>(value);
+            int stream = columnar_state_t::stream_for_type(entry.type);
+            if (stream == COLUMNAR_STREAM_RAW) {
+                addr_t raw;
+                if (!streams[stream].read_bytes(&raw, sizeof(raw)))
+                    return false;
+                entry.addr = raw;
+            } else {
+                if (!streams[stream].read_varint(value))
+                    return false;
+                entry.addr = state_.predict(stream, entry) + zigzag_decode(value);
+                state_.update(stream, entry);
+            }
+            memcpy(dest, &entry, sizeof(entry));
+            dest += sizeof(entry);
+        }
+        return true;
+    }
+
+private:
+    struct stream_reader_t {
+        bool
+        read_varint(uint64_t &value)
+        {
+            value = 0;
+            for (int shift = 0; shift < 64 && cur < end; shift += 7) {
+                uint8_t byte = static_cast<uint8_t>(*cur++);
+                value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+            return false;
+        }
+        bool
+        read_bytes(void *dest, size_t size)
+        {
+            if (static_cast<size_t>(end - cur) < size)
+                return false;
+            memcpy(dest, cur, size);
+            cur += size;
+            return true;
+        }
+        const char *cur = nullptr;
+        const char *end = nullptr;
+    };
+    static addr_t
+    zigzag_decode(uint64_t value)
+    {
+        return static_cast<addr_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    columnar_state_t state_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _COLUMNAR_CHUNK_H_ */
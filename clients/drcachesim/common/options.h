@@ -40,6 +40,7 @@
 #define CPU_CACHE "cache_simulator"
 #define CPU_CACHE_ALT "drcachesim"
 #define MISS_ANALYZER "miss_analyzer"
+#define CACHE_SWEEP "cache_sweep"
 #define TLB_LEGACY "TLB"
 #define TLB "TLB_simulator"
 #define HISTOGRAM "histogram"
@@ -122,6 +123,7 @@ extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
 extern dynamorio::droption::droption_t<bool> op_instr_only_trace;
 extern dynamorio::droption::droption_t<bool> op_coherence;
 extern dynamorio::droption::droption_t<bool> op_use_physical;
+extern dynamorio::droption::droption_t<bool> op_cache_parallel;
 extern dynamorio::droption::droption_t<unsigned int> op_virt2phys_freq;
 extern dynamorio::droption::droption_t<std::string> op_v2p_file;
 extern dynamorio::droption::droption_t<bool> op_cpu_scheduling;
@@ -140,6 +142,10 @@ extern dynamorio::droption::droption_t<bool> op_split_windows;
 extern dynamorio::droption::droption_t<dynamorio::droption::bytesize_t>
     op_exit_after_tracing;
 extern dynamorio::droption::droption_t<std::string> op_raw_compress;
+extern dynamorio::droption::droption_t<unsigned int> op_async_writers;
+extern dynamorio::droption::droption_t<unsigned int> op_async_buffers;
+extern dynamorio::droption::droption_t<bool> op_raw_io_uring;
+extern dynamorio::droption::droption_t<unsigned int> op_raw_io_uring_chunks;
 extern dynamorio::droption::droption_t<std::string> op_trace_compress;
 extern dynamorio::droption::droption_t<bool> op_online_instr_types;
 extern dynamorio::droption::droption_t<std::string> op_replace_policy;
@@ -152,10 +158,15 @@ extern dynamorio::droption::droption_t<unsigned int> op_TLB_L1D_assoc;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L2_entries;
 extern dynamorio::droption::droption_t<unsigned int> op_TLB_L2_assoc;
 extern dynamorio::droption::droption_t<std::string> op_TLB_replace_policy;
+extern dynamorio::droption::droption_t<std::string> op_TLB_configs;
+extern dynamorio::droption::droption_t<unsigned int> op_TLB_config_threads;
 extern dynamorio::droption::droption_t<std::string> op_tool;
 extern dynamorio::droption::droption_t<unsigned int> op_verbose;
 extern dynamorio::droption::droption_t<bool> op_show_func_trace;
 extern dynamorio::droption::droption_t<int> op_jobs;
+extern dynamorio::droption::droption_t<int> op_read_ahead_blocks;
+extern dynamorio::droption::droption_t<bool> op_mmap_uncompressed_inputs;
+extern dynamorio::droption::droption_t<bool> op_serial_pipeline;
 extern dynamorio::droption::droption_t<bool> op_test_mode;
 extern dynamorio::droption::droption_t<std::string> op_test_mode_name;
 extern dynamorio::droption::droption_t<bool> op_disable_optimizations;
@@ -186,6 +197,7 @@ extern dynamorio::droption::droption_t<bool> op_reuse_distance_histogram;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_skip_dist;
 extern dynamorio::droption::droption_t<unsigned int> op_reuse_distance_limit;
 extern dynamorio::droption::droption_t<bool> op_reuse_verify_skip;
+extern dynamorio::droption::droption_t<bool> op_reuse_use_tree;
 extern dynamorio::droption::droption_t<double> op_reuse_histogram_bin_multiplier;
 extern dynamorio::droption::droption_t<std::string> op_view_syntax;
 extern dynamorio::droption::droption_t<std::string> op_record_function;
@@ -197,6 +209,9 @@ extern dynamorio::droption::droption_t<std::string> op_record_syscall;
 extern dynamorio::droption::droption_t<unsigned int> op_miss_count_threshold;
 extern dynamorio::droption::droption_t<double> op_miss_frac_threshold;
 extern dynamorio::droption::droption_t<double> op_confidence_threshold;
+extern dynamorio::droption::droption_t<std::string> op_sweep_LL_sizes;
+extern dynamorio::droption::droption_t<std::string> op_sweep_LL_assocs;
+extern dynamorio::droption::droption_t<double> op_sweep_sample_rate;
 extern dynamorio::droption::droption_t<bool> op_enable_drstatecmp;
 #ifdef BUILD_PT_TRACER
 extern dynamorio::droption::droption_t<bool> op_enable_kernel_tracing;
@@ -236,6 +251,7 @@ extern dynamorio::droption::droption_t<std::string> op_filter_marker_types;
 extern dynamorio::droption::droption_t<bool> op_encodings2regdeps;
 extern dynamorio::droption::droption_t<std::string> op_filter_func_ids;
 extern dynamorio::droption::droption_t<std::string> op_modify_marker_value;
+extern dynamorio::droption::droption_t<bool> op_filter_columnar;
 extern dynamorio::droption::droption_t<uint64_t> op_trim_before_timestamp;
 extern dynamorio::droption::droption_t<uint64_t> op_trim_after_timestamp;
 extern dynamorio::droption::droption_t<bool> op_abort_on_invariant_error;
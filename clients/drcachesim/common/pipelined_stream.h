@@ -0,0 +1,418 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* pipelined_stream: support for running a serial analysis as a pipeline. */
+
+#ifndef _PIPELINED_STREAM_H_
+#define _PIPELINED_STREAM_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memtrace_stream.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * A bounded lock-free queue of batches between exactly one producer thread and
+ * one consumer thread.  Each side fills or drains a whole batch at a time so the
+ * shared indices are only touched once per batch.
+ */
+template <typename T> class spsc_batch_queue_t {
+public:
+    spsc_batch_queue_t(size_t num_batches, size_t batch_size)
+        : batches_(num_batches)
+        , batch_size_(batch_size)
+    {
+        for (auto &batch : batches_)
+            batch.reserve(batch_size);
+    }
+    size_t
+    batch_size() const
+    {
+        return batch_size_;
+    }
+    // Returns an empty batch for the producer to fill, waiting for the consumer to
+    // release one if all are in use.  Returns nullptr if the consumer has stopped.
+    std::vector<T> *
+    producer_acquire()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        for (int waits = 0;
+             head - tail_.load(std::memory_order_acquire) >= batches_.size();
+             ++waits) {
+            if (stopped_.load(std::memory_order_acquire))
+                return nullptr;
+            wait(waits);
+        }
+        std::vector<T> *batch = &batches_[head % batches_.size()];
+        batch->clear();
+        return batch;
+    }
+    // Hands the batch from producer_acquire() to the consumer.
+    void
+    producer_publish()
+    {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // Returns the oldest published batch, waiting for the producer if there is none.
+    std::vector<T> *
+    consumer_acquire()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (int waits = 0; head_.load(std::memory_order_acquire) == tail; ++waits)
+            wait(waits);
+        return &batches_[tail % batches_.size()];
+    }
+    // Returns the batch from consumer_acquire() to the producer.
+    void
+    consumer_release()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // Called by the consumer when it will take no more batches.
+    void
+    stop()
+    {
+        stopped_.store(true, std::memory_order_release);
+    }
+
+private:
+    static void
+    wait(int waits)
+    {
+        // A stage is usually blocked on the other for a whole batch, so after a
+        // short spin we sleep rather than burn a core that a reader could use.
+        if (waits < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    std::vector<std::vector<T>> batches_;
+    const size_t batch_size_;
+    // Free-running counts of published and released batches.
+    std::atomic<size_t> head_ { 0 };
+    std::atomic<size_t> tail_ { 0 };
+    std::atomic<bool> stopped_ { false };
+};
+
+/**
+ * The values a memtrace_stream_t reports for one record, captured where the
+ * record is read so that they can be replayed where it is consumed.
+ */
+struct stream_snapshot_t {
+    uint64_t record_ordinal = 0;
+    uint64_t instruction_ordinal = 0;
+    uint64_t last_timestamp = 0;
+    uint64_t first_timestamp = 0;
+    uint64_t version = 0;
+    uint64_t filetype = 0;
+    uint64_t cache_line_size = 0;
+    uint64_t chunk_instr_count = 0;
+    uint64_t page_size = 0;
+    int64_t output_cpuid = 0;
+    int64_t workload_id = 0;
+    int64_t input_id = 0;
+    int64_t tid = 0;
+    int shard_index = 0;
+    bool is_record_synthetic = false;
+    bool is_record_kernel = false;
+    // The corresponding values from get_input_interface(), which is nullptr if
+    // "input" is nullptr.
+    memtrace_stream_t *input = nullptr;
+    uint64_t input_record_ordinal = 0;
+    uint64_t input_instruction_ordinal = 0;
+    uint64_t input_last_timestamp = 0;
+    uint64_t input_first_timestamp = 0;
+
+    void
+    capture(const memtrace_stream_t &stream)
+    {
+        record_ordinal = stream.get_record_ordinal();
+        instruction_ordinal = stream.get_instruction_ordinal();
+        last_timestamp = stream.get_last_timestamp();
+        first_timestamp = stream.get_first_timestamp();
+        version = stream.get_version();
+        filetype = stream.get_filetype();
+        cache_line_size = stream.get_cache_line_size();
+        chunk_instr_count = stream.get_chunk_instr_count();
+        page_size = stream.get_page_size();
+        output_cpuid = stream.get_output_cpuid();
+        workload_id = stream.get_workload_id();
+        input_id = stream.get_input_id();
+        tid = stream.get_tid();
+        shard_index = stream.get_shard_index();
+        is_record_synthetic = stream.is_record_synthetic();
+        is_record_kernel = stream.is_record_kernel();
+        input = stream.get_input_interface();
+        if (input != nullptr) {
+            input_record_ordinal = input->get_record_ordinal();
+            input_instruction_ordinal = input->get_instruction_ordinal();
+            input_last_timestamp = input->get_last_timestamp();
+            input_first_timestamp = input->get_first_timestamp();
+        }
+    }
+};
+
+/**
+ * A memtrace_stream_t presented to tools on the consuming side of a pipeline.  It
+ * answers queries from the snapshot of the record being processed rather than
+ * from the underlying stream, which has usually moved ahead.  The schedule
+ * statistics are the exception: those come from the underlying stream and so may
+ * reflect later records.
+ */
+class pipelined_stream_t : public memtrace_stream_t {
+public:
+    // Starts out reporting the current state of "source".
+    explicit pipelined_stream_t(memtrace_stream_t *source)
+        : source_(source)
+        , input_view_(this)
+    {
+        hold_source_state();
+    }
+    // Reports "snapshot", which must remain valid until the next call.
+    void
+    set_snapshot(const stream_snapshot_t *snapshot)
+    {
+        cur_ = snapshot;
+    }
+    // Reports the current state of the underlying stream until the next
+    // set_snapshot().  The caller must ensure the stream is not concurrently
+    // advancing.
+    void
+    hold_source_state()
+    {
+        held_.capture(*source_);
+        cur_ = &held_;
+    }
+    uint64_t
+    get_record_ordinal() const override
+    {
+        return cur_->record_ordinal;
+    }
+    uint64_t
+    get_instruction_ordinal() const override
+    {
+        return cur_->instruction_ordinal;
+    }
+    std::string
+    get_stream_name() const override
+    {
+        // The input's name is fixed, unlike the underlying stream's.
+        if (cur_->input != nullptr)
+            return cur_->input->get_stream_name();
+        return source_->get_stream_name();
+    }
+    uint64_t
+    get_last_timestamp() const override
+    {
+        return cur_->last_timestamp;
+    }
+    uint64_t
+    get_first_timestamp() const override
+    {
+        return cur_->first_timestamp;
+    }
+    uint64_t
+    get_version() const override
+    {
+        return cur_->version;
+    }
+    uint64_t
+    get_filetype() const override
+    {
+        return cur_->filetype;
+    }
+    uint64_t
+    get_cache_line_size() const override
+    {
+        return cur_->cache_line_size;
+    }
+    uint64_t
+    get_chunk_instr_count() const override
+    {
+        return cur_->chunk_instr_count;
+    }
+    uint64_t
+    get_page_size() const override
+    {
+        return cur_->page_size;
+    }
+    bool
+    is_record_synthetic() const override
+    {
+        return cur_->is_record_synthetic;
+    }
+    int64_t
+    get_output_cpuid() const override
+    {
+        return cur_->output_cpuid;
+    }
+    int64_t
+    get_workload_id() const override
+    {
+        return cur_->workload_id;
+    }
+    int64_t
+    get_input_id() const override
+    {
+        return cur_->input_id;
+    }
+    int64_t
+    get_tid() const override
+    {
+        return cur_->tid;
+    }
+    memtrace_stream_t *
+    get_input_interface() const override
+    {
+        return cur_->input == nullptr ? nullptr : &input_view_;
+    }
+    int
+    get_shard_index() const override
+    {
+        return cur_->shard_index;
+    }
+    bool
+    is_record_kernel() const override
+    {
+        return cur_->is_record_kernel;
+    }
+    double
+    get_schedule_statistic(schedule_statistic_t stat) const override
+    {
+        return source_->get_schedule_statistic(stat);
+    }
+
+private:
+    // The input stream as of the current snapshot.  Its ordinals and timestamps
+    // come from the snapshot; everything else comes from the input stream itself.
+    class input_view_t : public memtrace_stream_t {
+    public:
+        explicit input_view_t(const pipelined_stream_t *parent)
+            : parent_(parent)
+        {
+        }
+        uint64_t
+        get_record_ordinal() const override
+        {
+            return parent_->cur_->input_record_ordinal;
+        }
+        uint64_t
+        get_instruction_ordinal() const override
+        {
+            return parent_->cur_->input_instruction_ordinal;
+        }
+        std::string
+        get_stream_name() const override
+        {
+            return input()->get_stream_name();
+        }
+        uint64_t
+        get_last_timestamp() const override
+        {
+            return parent_->cur_->input_last_timestamp;
+        }
+        uint64_t
+        get_first_timestamp() const override
+        {
+            return parent_->cur_->input_first_timestamp;
+        }
+        uint64_t
+        get_version() const override
+        {
+            return input()->get_version();
+        }
+        uint64_t
+        get_filetype() const override
+        {
+            return input()->get_filetype();
+        }
+        uint64_t
+        get_cache_line_size() const override
+        {
+            return input()->get_cache_line_size();
+        }
+        uint64_t
+        get_chunk_instr_count() const override
+        {
+            return input()->get_chunk_instr_count();
+        }
+        uint64_t
+        get_page_size() const override
+        {
+            return input()->get_page_size();
+        }
+        int64_t
+        get_workload_id() const override
+        {
+            return parent_->cur_->workload_id;
+        }
+        int64_t
+        get_input_id() const override
+        {
+            return parent_->cur_->input_id;
+        }
+        int64_t
+        get_tid() const override
+        {
+            return parent_->cur_->tid;
+        }
+
+    private:
+        memtrace_stream_t *
+        input() const
+        {
+            return parent_->cur_->input;
+        }
+        const pipelined_stream_t *parent_;
+    };
+
+    memtrace_stream_t *source_;
+    stream_snapshot_t held_;
+    const stream_snapshot_t *cur_ = nullptr;
+    mutable input_view_t input_view_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _PIPELINED_STREAM_H_ */
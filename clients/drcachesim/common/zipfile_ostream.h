@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2022-2024 Google, Inc.  All rights reserved.
+ * Copyright (c) 2022-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -38,22 +38,45 @@
 #ifndef _ZIPFILE_OSTREAM_H_
 #define _ZIPFILE_OSTREAM_H_ 1
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include "minizip/zip.h"
+#ifdef HAS_ZSTD
+#    include <zstd.h>
+#endif
+#include "columnar_chunk.h"
 
 namespace dynamorio {
 namespace drmemtrace {
 
+#ifdef HAS_ZSTD
+// A low level, for speed, which still compresses better than deflate.
+#    define ZSTD_ZIP_MEMBER_LEVEL 3
+#endif
+
 // We need to override the stream buffer class which is where the file
 // writes happen.  We go ahead and use a simple buffer.  The stream
 // buffer base class writes to pbase()..epptr() with the next slot at
 // pptr().
 class zipfile_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
 public:
-    explicit zipfile_streambuf_t(const std::string &path)
+    zipfile_streambuf_t(const std::string &path, bool columnar, bool zstd)
+        : columnar_(columnar)
     {
+        if (zstd) {
+#ifdef HAS_ZSTD
+            zstd_ = ZSTD_createCCtx();
+            if (zstd_ == nullptr ||
+                ZSTD_isError(ZSTD_CCtx_setParameter(zstd_, ZSTD_c_compressionLevel,
+                                                    ZSTD_ZIP_MEMBER_LEVEL)))
+                return;
+            zstd_buf_.resize(ZSTD_CStreamOutSize());
+#else
+            return;
+#endif
+        }
         zip_ = zipOpen2_64(path.c_str(), APPEND_STATUS_CREATE, nullptr, nullptr);
         if (zip_ == nullptr)
             return;
@@ -67,17 +90,20 @@ public:
     {
         sync();
         delete[] buf_;
-        if (zip_ == nullptr)
-            return;
-        // We do not bother with the zipfile comment: it doesn't seem to show
-        // up when I do set it anyway ("unzip -z" prints the .zip path instead).
-        if ((!first_component_ && zipCloseFileInZip(zip_) != ZIP_OK) ||
-            zipClose(zip_, nullptr) != ZIP_OK) {
+        if (zip_ != nullptr) {
+            // We do not bother with the zipfile comment: it doesn't seem to show
+            // up when I do set it anyway ("unzip -z" prints the .zip path instead).
+            if ((!first_component_ && !close_component()) ||
+                zipClose(zip_, nullptr) != ZIP_OK) {
 #ifdef DEBUG
-            // Let's at least have something visible in debug build.
-            std::cerr << "zipfile_ostream failed to close zipfile\n";
+                // Let's at least have something visible in debug build.
+                std::cerr << "zipfile_ostream failed to close zipfile\n";
 #endif
+            }
         }
+#ifdef HAS_ZSTD
+        ZSTD_freeCCtx(zstd_);
+#endif
     }
     int
     overflow(int extra_char) override
@@ -91,8 +117,11 @@ public:
         }
         int res = traits_type::not_eof(extra_char);
         if (pptr() > pbase()) {
-            if (zipWriteInFileInZip(
-                    zip_, pbase(), static_cast<unsigned int>(pptr() - pbase())) != ZIP_OK)
+            if (columnar_) {
+                pending_.append(pbase(), pptr() - pbase());
+                if (!flush_columnar(/*at_end=*/false))
+                    res = traits_type::eof();
+            } else if (!write_member(pbase(), pptr() - pbase()))
                 res = traits_type::eof();
         }
         setp(buf_, buf_ + buffer_size_ - 1);
@@ -103,39 +132,155 @@ public:
     {
         return overflow(traits_type::eof());
     }
+    bool
+    is_open() const
+    {
+        return zip_ != nullptr;
+    }
     std::string
-    open_new_component(const std::string &name)
+    open_new_component(const std::string &name, const std::string &comment)
     {
         if (!first_component_) {
             sync();
-            if (zipCloseFileInZip(zip_) != ZIP_OK)
+            if (!close_component())
                 return "Failed to close prior component";
         } else
             first_component_ = false;
         // XXX: We should set the date in a zip_fileinfo struct (3rd param)
         // so it's not 1980 in the file.
+        // The comment is only stored in the central directory.
+        // A zstd frame is stored as is: minizip refuses to open members with
+        // the zstd method id.
+        bool stored = zstd_enabled();
         if (zipOpenNewFileInZip(zip_, name.c_str(), nullptr, nullptr, 0, nullptr, 0,
-                                nullptr, Z_DEFLATED, Z_DEFAULT_COMPRESSION) != ZIP_OK) {
+                                comment.empty() ? nullptr : comment.c_str(),
+                                stored ? 0 : Z_DEFLATED,
+                                stored ? Z_NO_COMPRESSION : Z_DEFAULT_COMPRESSION) !=
+            ZIP_OK) {
             return "Failed to add new component " + name + " to zipfile";
         }
+        if (columnar_) {
+            encoder_.reset();
+            if (!write_member(COLUMNAR_CHUNK_MAGIC, COLUMNAR_CHUNK_MAGIC_SIZE))
+                return "Failed to write to new component " + name;
+        }
         return "";
     }
 
 private:
+    // For columnar output, encodes and writes each full block of records in
+    // pending_.  If "at_end" is set, which must be the case at the end of each
+    // component, whatever remains is written as well.
+    bool
+    flush_columnar(bool at_end)
+    {
+        if (!columnar_)
+            return true;
+        const size_t block_bytes = COLUMNAR_BLOCK_ENTRIES_MAX * sizeof(trace_entry_t);
+        size_t start = 0;
+        bool ok = true;
+        while (ok &&
+               (pending_.size() - start >= block_bytes ||
+                (at_end && pending_.size() - start >= sizeof(trace_entry_t)))) {
+            size_t bytes = std::min(pending_.size() - start, block_bytes);
+            uint32_t count = static_cast<uint32_t>(bytes / sizeof(trace_entry_t));
+            encoded_.clear();
+            encoder_.encode_entries(
+                reinterpret_cast<const trace_entry_t *>(pending_.data() + start), count,
+                encoded_);
+            ok = write_encoded();
+            start += count * sizeof(trace_entry_t);
+        }
+        if (ok && at_end && pending_.size() > start) {
+            // A partial record: there should not be any, but we preserve it.
+            encoded_.clear();
+            columnar_encoder_t::encode_raw(pending_.data() + start,
+                                           static_cast<uint32_t>(pending_.size() - start),
+                                           encoded_);
+            ok = write_encoded();
+            start = pending_.size();
+        }
+        pending_.erase(0, start);
+        return ok;
+    }
+    bool
+    write_encoded()
+    {
+        return write_member(encoded_.data(), encoded_.size());
+    }
+    bool
+    zstd_enabled() const
+    {
+#ifdef HAS_ZSTD
+        return zstd_ != nullptr;
+#else
+        return false;
+#endif
+    }
+    // Writes to the open component, through zstd if enabled.  With "end" set,
+    // also ends the component's zstd frame.
+    bool
+    write_member(const char *data, size_t size, bool end = false)
+    {
+#ifdef HAS_ZSTD
+        if (zstd_ != nullptr) {
+            ZSTD_inBuffer in = { data, size, 0 };
+            size_t remaining;
+            do {
+                ZSTD_outBuffer out = { &zstd_buf_[0], zstd_buf_.size(), 0 };
+                remaining = ZSTD_compressStream2(zstd_, &out, &in,
+                                                 end ? ZSTD_e_end : ZSTD_e_continue);
+                if (ZSTD_isError(remaining) ||
+                    (out.pos > 0 &&
+                     zipWriteInFileInZip(zip_, out.dst,
+                                         static_cast<unsigned int>(out.pos)) != ZIP_OK))
+                    return false;
+            } while (end ? remaining != 0 : in.pos < in.size);
+            return true;
+        }
+#endif
+        return size == 0 ||
+            zipWriteInFileInZip(zip_, data, static_cast<unsigned int>(size)) == ZIP_OK;
+    }
+    bool
+    close_component()
+    {
+        return flush_columnar(/*at_end=*/true) &&
+            (!zstd_enabled() || write_member(nullptr, 0, /*end=*/true)) &&
+            zipCloseFileInZip(zip_) == ZIP_OK;
+    }
+
     static const int buffer_size_ = 4096;
     zipFile zip_ = nullptr;
     char *buf_ = nullptr;
     bool first_component_ = true;
+    // See columnar_chunk.h.
+    bool columnar_ = false;
+    columnar_encoder_t encoder_;
+    std::string pending_;
+    std::string encoded_;
+#ifdef HAS_ZSTD
+    // Each component is one zstd frame, so components remain independent.
+    ZSTD_CCtx *zstd_ = nullptr;
+    std::string zstd_buf_;
+#endif
 };
 
 // open_new_component() should be called to create an initial component before
-// doing any writing.
+// doing any writing.  If "columnar" is set, the trace_entry_t records written
+// to each component are stored in the columnar format from columnar_chunk.h,
+// which is much smaller after compression than the records themselves.  If
+// "zstd" is set, each component is compressed with zstd rather than deflate,
+// which decompresses several times faster; this requires HAS_ZSTD.  The
+// zipfile trace reader detects and decodes both formats automatically.
 class zipfile_ostream_t : public archive_ostream_t {
 public:
-    explicit zipfile_ostream_t(const std::string &path)
-        : archive_ostream_t(new zipfile_streambuf_t(path))
+    explicit zipfile_ostream_t(const std::string &path, bool columnar = false,
+                               bool zstd = false)
+        : archive_ostream_t(new zipfile_streambuf_t(path, columnar, zstd))
     {
-        if (!rdbuf())
+        if (!rdbuf() ||
+            !reinterpret_cast<zipfile_streambuf_t *>(rdbuf())->is_open())
             setstate(std::ios::badbit);
     }
     ~zipfile_ostream_t() override
@@ -144,9 +289,15 @@ public:
     }
     std::string
     open_new_component(const std::string &name) override
+    {
+        return open_new_component_with_comment(name, "");
+    }
+    std::string
+    open_new_component_with_comment(const std::string &name,
+                                    const std::string &comment) override
     {
         zipfile_streambuf_t *zbuf = reinterpret_cast<zipfile_streambuf_t *>(rdbuf());
-        return zbuf->open_new_component(name);
+        return zbuf->open_new_component(name, comment);
     }
 };
 
@@ -0,0 +1,157 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* zstd_istream_t: a wrapper around zstd to match the parts of the
+ * std::istream interface we use for raw2trace and file_reader_t.
+ * Supports only limited seeking within the current internal buffer.
+ */
+
+#ifndef _ZSTD_ISTREAM_H_
+#define _ZSTD_ISTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <stdio.h>
+#include <zstd.h>
+#include <iostream>
+#include <string>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/* We need to override the stream buffer class which is where the file
+ * reads happen.  The stream buffer base class reads from eback()..egptr()
+ * with the next to read at gptr().
+ */
+class zstd_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    explicit zstd_istreambuf_t(const std::string &path)
+    {
+        file_ = fopen(path.c_str(), "rb");
+        if (file_ == nullptr)
+            return;
+        dctx_ = ZSTD_createDCtx();
+        if (dctx_ == nullptr) {
+            fclose(file_);
+            file_ = nullptr;
+            return;
+        }
+        // These are the sizes zstd recommends for streaming.
+        compressed_size_ = ZSTD_DStreamInSize();
+        uncompressed_size_ = ZSTD_DStreamOutSize();
+        buf_compressed_ = new char[compressed_size_];
+        buf_uncompressed_ = new char[uncompressed_size_];
+    }
+    ~zstd_istreambuf_t() override
+    {
+        if (file_ != nullptr)
+            fclose(file_);
+        delete[] buf_compressed_;
+        delete[] buf_uncompressed_;
+        ZSTD_freeDCtx(dctx_);
+    }
+    int
+    underflow() override
+    {
+        if (file_ == nullptr)
+            return traits_type::eof();
+        if (gptr() == egptr()) {
+            ZSTD_outBuffer out = { buf_uncompressed_, uncompressed_size_, 0 };
+            // A frame ending mid-buffer produces no output for that call, and
+            // the file may hold several frames back to back, so we loop.  When
+            // the prior call filled its output, zstd may still hold decoded data
+            // with no further input needed.
+            do {
+                if (src_pos_ == src_left_ && !output_pending_) {
+                    src_left_ = fread(buf_compressed_, 1, compressed_size_, file_);
+                    src_pos_ = 0;
+                    if (ferror(file_) || src_left_ == 0)
+                        return traits_type::eof();
+                }
+                ZSTD_inBuffer in = { buf_compressed_, src_left_, src_pos_ };
+                size_t res = ZSTD_decompressStream(dctx_, &out, &in);
+                if (ZSTD_isError(res))
+                    return traits_type::eof();
+                src_pos_ = in.pos;
+                output_pending_ = out.pos == out.size;
+            } while (out.pos == 0);
+            setg(buf_uncompressed_, buf_uncompressed_, buf_uncompressed_ + out.pos);
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+    std::iostream::pos_type
+    seekoff(std::iostream::off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override
+    {
+        if (dir == std::ios_base::cur &&
+            ((off >= 0 && gptr() + off < egptr()) ||
+             (off < 0 && gptr() + off >= eback())))
+            gbump(static_cast<int>(off));
+        else {
+            // Unsupported!
+            return -1;
+        }
+        return gptr() - eback();
+    }
+
+private:
+    ZSTD_DCtx *dctx_ = nullptr;
+    FILE *file_ = nullptr;
+    size_t compressed_size_ = 0;
+    size_t uncompressed_size_ = 0;
+    char *buf_compressed_ = nullptr;
+    char *buf_uncompressed_ = nullptr;
+    size_t src_left_ = 0;
+    size_t src_pos_ = 0;
+    bool output_pending_ = false;
+};
+
+class zstd_istream_t : public std::istream {
+public:
+    explicit zstd_istream_t(const std::string &path)
+        : std::istream(new zstd_istreambuf_t(path))
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    virtual ~zstd_istream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ZSTD_ISTREAM_H_ */
@@ -0,0 +1,147 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* zstd_ostream_t: a wrapper around zstd to match the parts of the
+ * std::ostream interface we use for raw2trace and record_filter.
+ */
+
+#ifndef _ZSTD_OSTREAM_H_
+#define _ZSTD_OSTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zstd.h>
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Low levels give most of zstd's ratio at several times deflate's speed.
+#define ZSTD_TRACE_LEVEL 3
+
+class zstd_ostreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    zstd_ostreambuf_t(const std::string &path, int level)
+    {
+        cctx_ = ZSTD_createCCtx();
+        if (cctx_ == nullptr ||
+            ZSTD_isError(ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level)))
+            return;
+        src_buf_.resize(buffer_size_);
+        dest_buf_.resize(ZSTD_CStreamOutSize());
+        file_ = new std::ofstream(path, std::ofstream::binary);
+        char *base = &src_buf_.front();
+        setp(base, base + src_buf_.size() - 1);
+    }
+    ~zstd_ostreambuf_t() override
+    {
+        if (file_ != nullptr) {
+            sync();
+            compress(nullptr, 0, ZSTD_e_end);
+            delete file_;
+            file_ = nullptr;
+        }
+        ZSTD_freeCCtx(cctx_);
+    }
+    bool
+    is_open() const
+    {
+        return file_ != nullptr && !file_->fail();
+    }
+
+private:
+    int
+    overflow(int extra_char) override
+    {
+        if (file_ == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int size = static_cast<int>(pptr() - pbase());
+        pbump(-size);
+        if (!compress(pbase(), size, ZSTD_e_continue))
+            return traits_type::eof();
+        return traits_type::not_eof(extra_char);
+    }
+    int
+    sync() override
+    {
+        return overflow(traits_type::eof());
+    }
+    bool
+    compress(const char *src, size_t size, ZSTD_EndDirective mode)
+    {
+        ZSTD_inBuffer in = { src, size, 0 };
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = { &dest_buf_.front(), dest_buf_.size(), 0 };
+            remaining = ZSTD_compressStream2(cctx_, &out, &in, mode);
+            if (ZSTD_isError(remaining))
+                return false;
+            file_->write(&dest_buf_.front(), out.pos);
+        } while (mode == ZSTD_e_end ? remaining != 0 : in.pos < in.size);
+        return true;
+    }
+
+    static const int buffer_size_ = 1024 * 1024;
+    std::ostream *file_ = nullptr;
+    std::vector<char> src_buf_;
+    std::vector<char> dest_buf_;
+    ZSTD_CCtx *cctx_ = nullptr;
+};
+
+class zstd_ostream_t : public std::ostream {
+public:
+    explicit zstd_ostream_t(const std::string &path, int level = ZSTD_TRACE_LEVEL)
+        : std::ostream(new zstd_ostreambuf_t(path, level))
+    {
+        if (!static_cast<zstd_ostreambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    ~zstd_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif // _ZSTD_OSTREAM_H_
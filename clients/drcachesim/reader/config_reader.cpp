@@ -171,6 +171,18 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
             } else {
                 knobs.use_physical = false;
             }
+        } else if (param == "parallel") {
+            // Whether to simulate cores in parallel.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading parallel from the configuration file\n");
+                return false;
+            }
+            if (is_true(bool_val)) {
+                knobs.parallel = true;
+            } else {
+                knobs.parallel = false;
+            }
         } else {
             // A cache unit.
             cache_params_t cache;
@@ -43,12 +43,14 @@
 #include <string.h>
 
 #include <fstream>
+#include <memory>
 #include <queue>
 #include <string>
 #include <vector>
 
 #include "directory_iterator.h"
 #include "memref.h"
+#include "read_ahead.h"
 #include "reader.h"
 #include "trace_entry.h"
 #include "utils.h"
@@ -76,8 +78,13 @@ namespace drmemtrace {
 template <typename T> class file_reader_t : public reader_t {
 public:
     file_reader_t();
-    file_reader_t(const std::string &path, int verbosity = 0)
+    /**
+     * If "read_ahead_blocks" is non-zero and the file type supports it, that many
+     * blocks are decompressed ahead of the consumer on a helper thread.
+     */
+    file_reader_t(const std::string &path, int verbosity = 0, int read_ahead_blocks = 0)
         : reader_t(verbosity, "[file_reader]")
+        , read_ahead_blocks_(read_ahead_blocks)
         , input_path_(path)
     {
         online_ = false;
@@ -175,9 +182,34 @@ protected:
         return reader_t::skip_instructions(instruction_count);
     }
 
+    // For file types that support read-ahead: returns the next record from
+    // read_ahead_, or nullptr at the end of the input or on an error.
+    trace_entry_t *
+    read_next_entry_from_read_ahead()
+    {
+        if (read_ahead_cur_ >= read_ahead_end_) {
+            read_ahead_block_ = read_ahead_->next();
+            int size = read_ahead_block_->size;
+            if (size < static_cast<int>(sizeof(trace_entry_t)) ||
+                size % static_cast<int>(sizeof(trace_entry_t)) != 0) {
+                at_eof_ = (size >= 0);
+                return nullptr;
+            }
+            read_ahead_cur_ = read_ahead_block_->entries.data();
+            read_ahead_end_ = read_ahead_cur_ + size / sizeof(trace_entry_t);
+        }
+        return read_ahead_cur_++;
+    }
+
     // Protected for access by mock_file_reader_t.
     T input_file_;
 
+    int read_ahead_blocks_ = 0;
+    std::unique_ptr<read_ahead_t> read_ahead_;
+    read_ahead_t::block_t *read_ahead_block_ = nullptr;
+    trace_entry_t *read_ahead_cur_ = nullptr;
+    trace_entry_t *read_ahead_end_ = nullptr;
+
 private:
     std::string input_path_;
 };
@@ -72,6 +72,8 @@ template <>
 /* clang-format on */
 file_reader_t<lz4_reader_t>::~file_reader_t()
 {
+    // The read-ahead thread must be done with the file before we delete it.
+    read_ahead_.reset();
     if (input_file_.file != nullptr) {
         delete input_file_.file;
         input_file_.file = nullptr;
@@ -85,6 +87,15 @@ file_reader_t<lz4_reader_t>::open_single_file(const std::string &path)
     auto file = new lz4_istream_t(path);
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
     input_file_ = lz4_reader_t(file);
+    if (read_ahead_blocks_ > 0) {
+        auto fill = [file](read_ahead_t::block_t &block) {
+            block.size = static_cast<int>(
+                file->read(reinterpret_cast<char *>(block.entries.data()),
+                           block.entries.size() * sizeof(trace_entry_t))
+                    .gcount());
+        };
+        read_ahead_.reset(new read_ahead_t(read_ahead_blocks_, fill));
+    }
     return true;
 }
 
@@ -95,7 +106,10 @@ file_reader_t<lz4_reader_t>::read_next_entry()
     trace_entry_t *entry = read_queued_entry();
     if (entry != nullptr)
         return entry;
-    entry = read_next_entry_common(&input_file_, &at_eof_);
+    if (read_ahead_)
+        entry = read_next_entry_from_read_ahead();
+    else
+        entry = read_next_entry_common(&input_file_, &at_eof_);
     if (entry == nullptr)
         return entry;
     VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
@@ -0,0 +1,88 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* mmap_file_reader: reads uncompressed trace files through a private file mapping. */
+
+#ifndef _MMAP_FILE_READER_H_
+#define _MMAP_FILE_READER_H_ 1
+
+#include <stddef.h>
+
+#include <string>
+
+#include "file_reader.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * A read-only view of an uncompressed trace file mapped into memory.  Entries
+ * are handed out directly from the mapping with no copy.  The mapping is
+ * private and writable so that the reader_t's in-place fixups of entries
+ * never reach the file.
+ */
+struct mmap_reader_t {
+    mmap_reader_t() = default;
+    ~mmap_reader_t();
+    mmap_reader_t(const mmap_reader_t &) = delete;
+    mmap_reader_t &
+    operator=(const mmap_reader_t &) = delete;
+
+    // Returns whether "path" is a regular, non-empty, uncompressed file whose
+    // size is a whole number of trace entries.
+    static bool
+    is_mappable(const std::string &path);
+
+    bool
+    map(const std::string &path);
+    void
+    unmap();
+    // Asks the kernel to start paging in the "entries" entries following cur.
+    void
+    advise_ahead(size_t entries);
+
+    void *base = nullptr;
+    size_t size = 0;
+    trace_entry_t *cur = nullptr;
+    trace_entry_t *end = nullptr;
+    // When read-ahead is requested, the point at which to next call advise_ahead().
+    trace_entry_t *next_advice = nullptr;
+};
+
+typedef file_reader_t<mmap_reader_t> mmap_file_reader_t;
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _MMAP_FILE_READER_H_ */
@@ -0,0 +1,173 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* read_ahead: decompresses trace file blocks ahead of the reader on a helper thread. */
+
+#ifndef _READ_AHEAD_H_
+#define _READ_AHEAD_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+/**
+ * Runs a producer thread which repeatedly invokes a fill function to read (and
+ * thus decompress) the next block of an input into a bounded ring of buffers, so
+ * that the thread consuming the records does not stall on decompression.  The
+ * fill function is only ever invoked on the producer thread; the caller must not
+ * touch the underlying file until stop() returns.
+ */
+class read_ahead_t {
+public:
+    // Matches the buffer size used by the readers themselves.
+    static constexpr size_t BLOCK_ENTRIES = 4096;
+
+    struct block_t {
+        std::vector<trace_entry_t> entries;
+        // The number of valid bytes in "entries", 0 at the end of the input, or
+        // negative on an error.  Any value <= 0 ends production.
+        int size = 0;
+        // Opaque location of the start of this block, for readers that need to
+        // reposition the underlying file (e.g., a zipfile component and offset).
+        uint64_t segment = 0;
+        uint64_t offset = 0;
+    };
+
+    typedef std::function<void(block_t &block)> fill_func_t;
+
+    read_ahead_t(int block_count, fill_func_t fill)
+        : fill_(std::move(fill))
+        , blocks_(block_count < 2 ? 2 : block_count)
+    {
+        for (block_t &block : blocks_)
+            block.entries.resize(BLOCK_ENTRIES);
+        thread_ = std::thread(&read_ahead_t::produce, this);
+    }
+
+    ~read_ahead_t()
+    {
+        stop();
+    }
+
+    /**
+     * Returns the next block, blocking until it is available.  The prior block
+     * returned is released back to the producer.  Once a block with a size <= 0
+     * is returned, that same block is returned on every subsequent call.
+     */
+    block_t *
+    next()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (holding_) {
+            if (blocks_[consume_idx_].size <= 0)
+                return &blocks_[consume_idx_];
+            consume_idx_ = (consume_idx_ + 1) % blocks_.size();
+            --filled_;
+            holding_ = false;
+            space_cond_.notify_one();
+        }
+        data_cond_.wait(lock, [this] { return filled_ > 0; });
+        holding_ = true;
+        return &blocks_[consume_idx_];
+    }
+
+    /**
+     * Stops the producer thread and waits for it to exit, after which the caller
+     * may access the underlying file again.  Blocks not yet consumed are dropped.
+     */
+    void
+    stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        space_cond_.notify_one();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+private:
+    void
+    produce()
+    {
+        size_t produce_idx = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                space_cond_.wait(lock,
+                                 [this] { return stop_ || filled_ < blocks_.size(); });
+                if (stop_)
+                    return;
+            }
+            // The consumer never touches a block between its release and its
+            // re-publication, so we can fill it without holding the lock.
+            block_t &block = blocks_[produce_idx];
+            fill_(block);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++filled_;
+            }
+            data_cond_.notify_one();
+            if (block.size <= 0)
+                return;
+            produce_idx = (produce_idx + 1) % blocks_.size();
+        }
+    }
+
+    fill_func_t fill_;
+    std::vector<block_t> blocks_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable data_cond_;
+    std::condition_variable space_cond_;
+    size_t filled_ = 0;
+    size_t consume_idx_ = 0;
+    bool holding_ = false;
+    bool stop_ = false;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _READ_AHEAD_H_ */
@@ -210,7 +210,8 @@ template <>
 /* clang-format on */
 file_reader_t<snappy_reader_t>::~file_reader_t()
 {
-    // Empty.
+    // The read-ahead thread must be done with the file before it is closed.
+    read_ahead_.reset();
 }
 
 template <>
@@ -222,6 +223,16 @@ file_reader_t<snappy_reader_t>::open_single_file(const std::string &path)
         return false;
     VPRINT(this, 1, "Opened snappy input file %s\n", path.c_str());
     input_file_ = snappy_reader_t(file);
+    if (read_ahead_blocks_ > 0) {
+        auto fill = [this](read_ahead_t::block_t &block) {
+            block.size = input_file_.read(block.entries.size() * sizeof(trace_entry_t),
+                                          block.entries.data());
+            // Match the end-of-file versus error distinction made below.
+            if (block.size <= 0)
+                block.size = input_file_.eof() ? 0 : -1;
+        };
+        read_ahead_.reset(new read_ahead_t(read_ahead_blocks_, fill));
+    }
     return true;
 }
 
@@ -232,6 +243,13 @@ file_reader_t<snappy_reader_t>::read_next_entry()
     trace_entry_t *from_queue = read_queued_entry();
     if (from_queue != nullptr)
         return from_queue;
+    if (read_ahead_) {
+        trace_entry_t *entry = read_next_entry_from_read_ahead();
+        if (entry == nullptr)
+            return nullptr;
+        entry_copy_ = *entry;
+        return &entry_copy_;
+    }
     int len = input_file_.read(sizeof(entry_copy_), &entry_copy_);
     // Returns less than asked-for if at end of file, or –1 for error.
     if (len < (int)sizeof(entry_copy_)) {
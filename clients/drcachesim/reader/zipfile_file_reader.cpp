@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2017-2024 Google, Inc.  All rights reserved.
+ * Copyright (c) 2017-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -33,6 +33,13 @@
 #include "zipfile_file_reader.h"
 #include <inttypes.h>
 
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "chunk_index.h"
+
 namespace dynamorio {
 namespace drmemtrace {
 
@@ -60,6 +67,194 @@ namespace {
 #    define ZPRINT(verbosity, level, ...) /* nothing */
 #endif
 
+// Reads up to "size" bytes of the current component's contents, decompressing
+// a zstd frame if it holds one.  Returns the number of bytes read, which is 0
+// only at the end of the component, or -1 on an error.
+int
+read_member(zipfile_reader_t &zipfile, void *dest, unsigned int size)
+{
+    int num_read;
+#ifdef HAS_ZSTD
+    if (zipfile.zstd) {
+        ZSTD_outBuffer out = { dest, size, 0 };
+        while (out.pos < out.size) {
+            if (zipfile.zstd_in_pos == zipfile.zstd_in.size() && !zipfile.zstd_in_eof) {
+                zipfile.zstd_in.resize(ZSTD_DStreamInSize());
+                int res = unzReadCurrentFile(zipfile.file, &zipfile.zstd_in[0],
+                                             static_cast<unsigned int>(
+                                                 zipfile.zstd_in.size()));
+                if (res < 0)
+                    return -1;
+                zipfile.zstd_in.resize(res);
+                zipfile.zstd_in_pos = 0;
+                zipfile.zstd_in_eof = (res == 0);
+            }
+            ZSTD_inBuffer in = { zipfile.zstd_in.data(), zipfile.zstd_in.size(),
+                                 zipfile.zstd_in_pos };
+            size_t prior_pos = out.pos;
+            size_t res = ZSTD_decompressStream(zipfile.zstd_dctx, &out, &in);
+            if (ZSTD_isError(res)) {
+                ZPRINT(zipfile.verbosity, 1, "zstd error %s in %s\n",
+                       ZSTD_getErrorName(res), zipfile.path.c_str());
+                return -1;
+            }
+            zipfile.zstd_in_pos = in.pos;
+            if (out.pos == prior_pos && zipfile.zstd_in_eof &&
+                zipfile.zstd_in_pos == zipfile.zstd_in.size())
+                break;
+        }
+        num_read = static_cast<int>(out.pos);
+    } else
+#endif
+        num_read = unzReadCurrentFile(zipfile.file, dest, size);
+    if (num_read > 0)
+        zipfile.member_offset += num_read;
+    return num_read;
+}
+
+// Reads exactly "size" bytes via read_member() unless the component ends first.
+// Returns the number of bytes read, or -1 on an error.
+int
+read_fully(zipfile_reader_t &zipfile, void *dest, unsigned int size)
+{
+    unsigned int total = 0;
+    while (total < size) {
+        int num_read = read_member(zipfile, static_cast<char *>(dest) + total,
+                                   size - total);
+        if (num_read < 0)
+            return -1;
+        if (num_read == 0)
+            break;
+        total += num_read;
+    }
+    return static_cast<int>(total);
+}
+
+#ifdef HAS_ZSTD
+bool
+is_zstd_frame(const char *data, int size)
+{
+    static const unsigned char magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+    return size >= static_cast<int>(sizeof(magic)) &&
+        memcmp(data, magic, sizeof(magic)) == 0;
+}
+#endif
+
+// Opens the current component, whose format we detect from its first bytes:
+// zstd-compressed contents are checked in turn for the columnar format.
+bool
+open_component(zipfile_reader_t &zipfile)
+{
+    if (unzOpenCurrentFile(zipfile.file) != UNZ_OK)
+        return false;
+    zipfile.member_offset = 0;
+#ifdef HAS_ZSTD
+    zipfile.zstd = false;
+#endif
+    int num_read = read_fully(zipfile, zipfile.peek, sizeof(zipfile.peek));
+    if (num_read < 0)
+        return false;
+#ifdef HAS_ZSTD
+    if (is_zstd_frame(zipfile.peek, num_read)) {
+        if (zipfile.zstd_dctx == nullptr)
+            zipfile.zstd_dctx = ZSTD_createDCtx();
+        if (zipfile.zstd_dctx == nullptr ||
+            ZSTD_isError(ZSTD_DCtx_reset(zipfile.zstd_dctx, ZSTD_reset_session_only)))
+            return false;
+        zipfile.zstd = true;
+        zipfile.zstd_in.assign(zipfile.peek, num_read);
+        zipfile.zstd_in_pos = 0;
+        zipfile.zstd_in_eof = false;
+        zipfile.member_offset = 0;
+        num_read = read_fully(zipfile, zipfile.peek, sizeof(zipfile.peek));
+        if (num_read < 0)
+            return false;
+    }
+#endif
+    zipfile.columnar = num_read == static_cast<int>(sizeof(zipfile.peek)) &&
+        memcmp(zipfile.peek, COLUMNAR_CHUNK_MAGIC, sizeof(zipfile.peek)) == 0;
+    zipfile.peek_size = zipfile.columnar ? 0 : num_read;
+    zipfile.peek_pos = 0;
+    zipfile.decoder.reset();
+    zipfile.decoded.clear();
+    zipfile.decoded_pos = 0;
+    zipfile.decoded_offset = 0;
+    return true;
+}
+
+// Decodes the next block of a columnar component.  Returns 0 at the end of the
+// component and -1 on an error.
+int
+decode_next_block(zipfile_reader_t &zipfile)
+{
+    columnar_block_header_t header;
+    int num_read = read_fully(zipfile, &header, sizeof(header));
+    if (num_read <= 0)
+        return num_read;
+    size_t size = columnar_decoder_t::payload_size(header);
+    if (num_read != static_cast<int>(sizeof(header)) || size == 0) {
+        ZPRINT(zipfile.verbosity, 1, "Invalid columnar block header in %s\n",
+               zipfile.path.c_str());
+        return -1;
+    }
+    zipfile.payload.resize(size);
+    if (read_fully(zipfile, &zipfile.payload[0], static_cast<unsigned int>(size)) !=
+            static_cast<int>(size) ||
+        !zipfile.decoder.decode(header, zipfile.payload.data(), zipfile.decoded)) {
+        ZPRINT(zipfile.verbosity, 1, "Corrupt columnar block in %s\n",
+               zipfile.path.c_str());
+        return -1;
+    }
+    return 1;
+}
+
+// The equivalent of unzReadCurrentFile() which hides the component format.
+int
+read_component(zipfile_reader_t &zipfile, void *dest, unsigned int size)
+{
+    char *out = static_cast<char *>(dest);
+    unsigned int total = 0;
+    if (!zipfile.columnar) {
+        total = std::min(size, zipfile.peek_size - zipfile.peek_pos);
+        memcpy(out, zipfile.peek + zipfile.peek_pos, total);
+        zipfile.peek_pos += total;
+        if (total == size)
+            return total;
+        int num_read = read_member(zipfile, out + total, size - total);
+        if (num_read < 0)
+            return num_read;
+        return total + num_read;
+    }
+    while (total < size) {
+        if (zipfile.decoded_pos >= zipfile.decoded.size()) {
+            zipfile.decoded_offset += zipfile.decoded.size();
+            zipfile.decoded.clear();
+            zipfile.decoded_pos = 0;
+            int res = decode_next_block(zipfile);
+            if (res < 0)
+                return -1;
+            if (res == 0)
+                break;
+        }
+        size_t avail = zipfile.decoded.size() - zipfile.decoded_pos;
+        unsigned int count = static_cast<unsigned int>(
+            std::min(static_cast<size_t>(size - total), avail));
+        memcpy(out + total, zipfile.decoded.data() + zipfile.decoded_pos, count);
+        zipfile.decoded_pos += count;
+        total += count;
+    }
+    return total;
+}
+
+// The equivalent of unztell64() which hides the component format.
+uint64_t
+tell_component(zipfile_reader_t &zipfile)
+{
+    if (zipfile.columnar)
+        return zipfile.decoded_offset + zipfile.decoded_pos;
+    return zipfile.member_offset - (zipfile.peek_size - zipfile.peek_pos);
+}
+
 bool
 open_single_file_common(const std::string &path, zipfile_reader_t &zread)
 {
@@ -67,65 +262,183 @@ open_single_file_common(const std::string &path, zipfile_reader_t &zread)
     if (file == nullptr)
         return false;
     zread = zipfile_reader_t(file, path);
-    if (unzGoToFirstFile(file) != UNZ_OK || unzOpenCurrentFile(file) != UNZ_OK)
+    // Do not point into the temporary's buffer.
+    zread.cur_buf = zread.buf;
+    zread.max_buf = zread.buf;
+    zread.start_buf = zread.buf;
+    if (unzGoToFirstFile(file) != UNZ_OK || !open_component(zread))
         return false;
     return true;
 }
 
+// Reads the next block of up to "size" bytes into "dest", moving on to the next
+// component when the current one is exhausted.  Returns the number of bytes read,
+// or 0 on an error or at the end of the last component (in which case "at_eof"
+// is set).
+int
+read_next_block(zipfile_reader_t &zipfile, void *dest, unsigned int size, bool &at_eof,
+                const trace_entry_t &last_entry)
+{
+    int num_read = read_component(zipfile, dest, size);
+    if (num_read == 0) {
+#ifdef DEBUG
+        if (zipfile.verbosity >= 3) {
+            zipfile.name[0] = '\0'; /* Just in case. */
+            // This call is expensive if we do it every time.
+            unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
+                                    sizeof(zipfile.name), nullptr, 0, nullptr, 0);
+            ZPRINT(zipfile.verbosity, 3,
+                   "Hit end of component %s; opening next component in %s\n",
+                   zipfile.name, zipfile.path.c_str());
+        }
+#endif
+        if ((last_entry.type != TRACE_TYPE_MARKER ||
+             last_entry.size != TRACE_MARKER_TYPE_CHUNK_FOOTER) &&
+            last_entry.type != TRACE_TYPE_FOOTER) {
+            zipfile.name[0] = '\0'; /* Just in case. */
+            unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
+                                    sizeof(zipfile.name), nullptr, 0, nullptr, 0);
+            ZPRINT(zipfile.verbosity, 1,
+                   "Chunk is missing footer: truncation detected in %s %s\n",
+                   zipfile.path.c_str(), zipfile.name);
+            return 0;
+        }
+        if (unzCloseCurrentFile(zipfile.file) != UNZ_OK)
+            return 0;
+        int res = unzGoToNextFile(zipfile.file);
+        if (res != UNZ_OK) {
+            if (res == UNZ_END_OF_LIST_OF_FILE) {
+                ZPRINT(zipfile.verbosity, 2, "Hit EOF in %s\n", zipfile.path.c_str());
+                at_eof = true;
+            }
+            return 0;
+        }
+        if (!open_component(zipfile))
+            return 0;
+        ++zipfile.component;
+        num_read = read_component(zipfile, dest, size);
+    }
+    if (num_read < static_cast<int>(sizeof(trace_entry_t))) {
+        ZPRINT(zipfile.verbosity, 1, "Failed to read: returned %d in %s\n", num_read,
+               zipfile.path.c_str());
+        return 0;
+    }
+    return num_read;
+}
+
 bool
 read_if_at_end_of_buffer(zipfile_reader_t &zipfile, bool &at_eof,
                          trace_entry_t last_entry)
 {
     if (zipfile.cur_buf >= zipfile.max_buf) {
-        int num_read = unzReadCurrentFile(zipfile.file, zipfile.buf, sizeof(zipfile.buf));
+        int num_read = read_next_block(zipfile, zipfile.buf, sizeof(zipfile.buf),
+                                       at_eof, last_entry);
+        if (num_read == 0)
+            return false;
+        zipfile.cur_buf = zipfile.buf;
+        zipfile.max_buf = zipfile.buf + (num_read / sizeof(*zipfile.max_buf));
+        zipfile.start_buf = zipfile.buf;
+        zipfile.start_buf_component = zipfile.component;
+        zipfile.start_buf_offset = tell_component(zipfile) - num_read;
+    }
+    return true;
+}
+
+// Creates a read-ahead thread which takes over reading "zipfile" from its current
+// position.  "last_entry" is the last record read from the file so far, for the
+// truncation check at the end of the current component.
+std::unique_ptr<read_ahead_t>
+start_read_ahead(zipfile_reader_t &zipfile, int block_count, trace_entry_t last_entry)
+{
+    auto fill = [&zipfile, last_entry](read_ahead_t::block_t &block) mutable {
+        bool at_eof = false;
+        int num_read =
+            read_next_block(zipfile, block.entries.data(),
+                            static_cast<unsigned int>(block.entries.size() *
+                                                      sizeof(trace_entry_t)),
+                            at_eof, last_entry);
         if (num_read == 0) {
-#ifdef DEBUG
-            if (zipfile.verbosity >= 3) {
-                zipfile.name[0] = '\0'; /* Just in case. */
-                // This call is expensive if we do it every time.
-                unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
-                                        sizeof(zipfile.name), nullptr, 0, nullptr, 0);
-                ZPRINT(zipfile.verbosity, 3,
-                       "Hit end of component %s; opening next component in %s\n",
-                       zipfile.name, zipfile.path.c_str());
-            }
-#endif
-            if ((last_entry.type != TRACE_TYPE_MARKER ||
-                 last_entry.size != TRACE_MARKER_TYPE_CHUNK_FOOTER) &&
-                last_entry.type != TRACE_TYPE_FOOTER) {
-                zipfile.name[0] = '\0'; /* Just in case. */
-                unzGetCurrentFileInfo64(zipfile.file, nullptr, zipfile.name,
-                                        sizeof(zipfile.name), nullptr, 0, nullptr, 0);
-                ZPRINT(zipfile.verbosity, 1,
-                       "Chunk is missing footer: truncation detected in %s %s\n",
-                       zipfile.path.c_str(), zipfile.name);
-                return false;
-            }
-            if (unzCloseCurrentFile(zipfile.file) != UNZ_OK)
-                return false;
-            int res = unzGoToNextFile(zipfile.file);
-            if (res != UNZ_OK) {
-                if (res == UNZ_END_OF_LIST_OF_FILE) {
-                    ZPRINT(zipfile.verbosity, 2, "Hit EOF in %s\n", zipfile.path.c_str());
-                    at_eof = true;
-                }
-                return false;
-            }
-            if (unzOpenCurrentFile(zipfile.file) != UNZ_OK)
-                return false;
-            num_read = unzReadCurrentFile(zipfile.file, zipfile.buf, sizeof(zipfile.buf));
+            block.size = at_eof ? 0 : -1;
+            return;
         }
-        if (num_read < static_cast<int>(sizeof(trace_entry_t))) {
-            ZPRINT(zipfile.verbosity, 1, "Failed to read: returned %d in %s\n", num_read,
-                   zipfile.path.c_str());
+        block.size = num_read;
+        block.segment = zipfile.component;
+        block.offset = tell_component(zipfile) - num_read;
+        last_entry = block.entries[num_read / sizeof(trace_entry_t) - 1];
+    };
+    return std::unique_ptr<read_ahead_t>(new read_ahead_t(block_count, fill));
+}
+
+// Re-opens "zipfile" at the consumer's position, which the read-ahead thread has
+// typically moved past.  Data in cur_buf that has not yet been consumed is dropped
+// and will be read again.
+bool
+reposition_at_consumer(zipfile_reader_t &zipfile)
+{
+    uint64_t component = zipfile.start_buf_component;
+    uint64_t offset = zipfile.start_buf_offset +
+        (zipfile.cur_buf - zipfile.start_buf) * sizeof(trace_entry_t);
+    // There is no open component if the read-ahead thread hit the end.
+    unzCloseCurrentFile(zipfile.file);
+    if (component < zipfile.chunk_index.size()) {
+        if (unzSetOffset64(zipfile.file, zipfile.chunk_index[component].pos) != UNZ_OK)
             return false;
+    } else {
+        if (unzGoToFirstFile(zipfile.file) != UNZ_OK)
+            return false;
+        for (uint64_t i = 0; i < component; ++i) {
+            if (unzGoToNextFile(zipfile.file) != UNZ_OK)
+                return false;
         }
-        zipfile.cur_buf = zipfile.buf;
-        zipfile.max_buf = zipfile.buf + (num_read / sizeof(*zipfile.max_buf));
     }
+    if (!open_component(zipfile))
+        return false;
+    zipfile.component = component;
+    while (offset > 0) {
+        unsigned int size = static_cast<unsigned int>(
+            std::min(offset, static_cast<uint64_t>(sizeof(zipfile.buf))));
+        if (read_component(zipfile, zipfile.buf, size) !=
+            static_cast<int>(size))
+            return false;
+        offset -= size;
+    }
+    zipfile.cur_buf = zipfile.buf;
+    zipfile.max_buf = zipfile.buf;
+    zipfile.start_buf = zipfile.buf;
     return true;
 }
 
+// Fills in zipfile.chunk_index by walking the central directory, which leaves
+// no component open.  Chunks without an index comment, from traces written
+// before we added them, are assumed to hold "chunk_instr_count" instructions.
+bool
+build_chunk_index(zipfile_reader_t &zipfile, uint64_t chunk_instr_count)
+{
+    zipfile.chunk_index.clear();
+    int res;
+    for (res = unzGoToFirstFile(zipfile.file); res == UNZ_OK;
+         res = unzGoToNextFile(zipfile.file)) {
+        unz_file_info64 info;
+        char comment[128];
+        if (unzGetCurrentFileInfo64(zipfile.file, &info, nullptr, 0, nullptr, 0, comment,
+                                    sizeof(comment)) != UNZ_OK)
+            return false;
+        comment[std::min(static_cast<size_t>(info.size_file_comment),
+                         sizeof(comment) - 1)] = '\0';
+        zipfile_reader_t::chunk_pos_t chunk;
+        chunk.pos = unzGetOffset64(zipfile.file);
+        chunk_index_entry_t entry;
+        if (decode_chunk_index_comment(comment, entry))
+            chunk.instr_ordinal = entry.instr_ordinal;
+        else
+            chunk.instr_ordinal = zipfile.chunk_index.size() * chunk_instr_count;
+        zipfile.chunk_index.push_back(chunk);
+    }
+    ZPRINT(zipfile.verbosity, 2, "Indexed %zu chunks in %s\n", zipfile.chunk_index.size(),
+           zipfile.path.c_str());
+    return res == UNZ_END_OF_LIST_OF_FILE;
+}
+
 } // namespace
 
 /**************************************************
@@ -145,10 +458,15 @@ template <>
 /* clang-format on */
 file_reader_t<zipfile_reader_t>::~file_reader_t()
 {
+    // The read-ahead thread must be done with the file before we close it.
+    read_ahead_.reset();
     if (input_file_.file != nullptr) {
         unzClose(input_file_.file);
         input_file_.file = nullptr;
     }
+#ifdef HAS_ZSTD
+    ZSTD_freeDCtx(input_file_.zstd_dctx);
+#endif
 }
 
 template <>
@@ -159,6 +477,8 @@ file_reader_t<zipfile_reader_t>::open_single_file(const std::string &path)
         return false;
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
     input_file_.verbosity = verbosity_;
+    if (read_ahead_blocks_ > 0)
+        read_ahead_ = start_read_ahead(input_file_, read_ahead_blocks_, {});
     return true;
 }
 
@@ -169,7 +489,21 @@ file_reader_t<zipfile_reader_t>::read_next_entry()
     trace_entry_t *from_queue = read_queued_entry();
     if (from_queue != nullptr)
         return from_queue;
-    if (!read_if_at_end_of_buffer(input_file_, at_eof_, entry_copy_))
+    if (read_ahead_) {
+        if (input_file_.cur_buf >= input_file_.max_buf) {
+            read_ahead_t::block_t *block = read_ahead_->next();
+            if (block->size <= 0) {
+                at_eof_ = (block->size == 0);
+                return nullptr;
+            }
+            input_file_.cur_buf = block->entries.data();
+            input_file_.max_buf =
+                input_file_.cur_buf + block->size / sizeof(*input_file_.max_buf);
+            input_file_.start_buf = input_file_.cur_buf;
+            input_file_.start_buf_component = block->segment;
+            input_file_.start_buf_offset = block->offset;
+        }
+    } else if (!read_if_at_end_of_buffer(input_file_, at_eof_, entry_copy_))
         return nullptr;
     entry_copy_ = *input_file_.cur_buf;
     ++input_file_.cur_buf;
@@ -195,46 +529,66 @@ file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count)
         return *this;
     }
     zipfile_reader_t *zipfile = &input_file_;
-    // We assume our unzGoToNextFile loop is plenty performant and we don't need to
-    // know the chunk names to use with a single unzLocateFile.
+    // Take the file back from any read-ahead thread for the jumps below, and hand
+    // it back once we are done.
+    bool resume_read_ahead = false;
+    if (read_ahead_) {
+        read_ahead_->stop();
+        bool ok = reposition_at_consumer(*zipfile);
+        read_ahead_.reset();
+        if (!ok) {
+            VPRINT(this, 1, "Failed to reposition after read-ahead\n");
+            at_eof_ = true;
+            return *this;
+        }
+        resume_read_ahead = true;
+    }
     uint64_t stop_count = cur_instr_count_ + instruction_count + 1;
     VPRINT(this, 2,
            "stop=%" PRIu64 " cur=%" PRIu64 " chunk=%" PRIu64 " est=%" PRIu64 "\n",
            stop_count, cur_instr_count_, chunk_instr_count_,
            cur_instr_count_ +
                (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)));
-    // First, quickly skip over chunks to reach the chunk containing the target.
-    while (cur_instr_count_ +
-               (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)) <
-           stop_count) {
+    // First, if the target is past the current chunk, jump straight to the chunk
+    // containing it using the index, rather than stepping through every chunk in
+    // between.
+    if (cur_instr_count_ +
+            (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)) <
+        stop_count) {
         if (unzCloseCurrentFile(zipfile->file) != UNZ_OK) {
             VPRINT(this, 1, "Failed to close zip subfile\n");
             at_eof_ = true;
             return *this;
         }
-        int res = unzGoToNextFile(zipfile->file);
-        if (res != UNZ_OK) {
-            if (res == UNZ_END_OF_LIST_OF_FILE)
-                VPRINT(this, 2, "Hit EOF\n");
-            else
-                VPRINT(this, 2, "Failed to go to next zip subfile\n");
+        if (zipfile->chunk_index.empty() &&
+            !build_chunk_index(*zipfile, chunk_instr_count_)) {
+            VPRINT(this, 1, "Failed to index zip subfiles\n");
+            at_eof_ = true;
+            return *this;
+        }
+        // Find the last chunk starting before the target.
+        auto it = std::lower_bound(
+            zipfile->chunk_index.begin(), zipfile->chunk_index.end(), stop_count,
+            [](const zipfile_reader_t::chunk_pos_t &chunk, uint64_t count) {
+                return chunk.instr_ordinal < count;
+            });
+        uint64_t target = static_cast<uint64_t>(it - zipfile->chunk_index.begin());
+        target = std::max(target == 0 ? 0 : target - 1, zipfile->component + 1);
+        if (target >= zipfile->chunk_index.size()) {
+            VPRINT(this, 2, "Hit EOF\n");
             at_eof_ = true;
             return *this;
         }
-        if (unzOpenCurrentFile(zipfile->file) != UNZ_OK) {
+        if (unzSetOffset64(zipfile->file, zipfile->chunk_index[target].pos) != UNZ_OK ||
+            !open_component(*zipfile)) {
             VPRINT(this, 1, "Failed to open zip subfile\n");
             at_eof_ = true;
             return *this;
         }
-        cur_instr_count_ += chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_);
-        VPRINT(this, 2, "At %" PRIu64 " instrs at start of new chunk\n",
-               cur_instr_count_);
-        VPRINT(this, 2,
-               "zip chunk stop=%" PRIu64 " cur=%" PRIu64 " chunk=%" PRIu64
-               " end-of-chunk=%" PRIu64 "\n",
-               stop_count, cur_instr_count_, chunk_instr_count_,
-               cur_instr_count_ +
-                   (chunk_instr_count_ - (cur_instr_count_ % chunk_instr_count_)));
+        zipfile->component = target;
+        cur_instr_count_ = zipfile->chunk_index[target].instr_ordinal;
+        VPRINT(this, 2, "At %" PRIu64 " instrs at start of chunk %" PRIu64 "\n",
+               cur_instr_count_, target);
         // Clear cached data from the prior chunk.
         zipfile->cur_buf = zipfile->max_buf;
     }
@@ -242,7 +596,13 @@ file_reader_t<zipfile_reader_t>::skip_instructions(uint64_t instruction_count)
     // duplicated timestamps at the start of the chunk to cover any skipped in
     // the fast chunk jumps we just did).
     // Subtract 1 to pass the target instr itself.
-    return skip_instructions_with_timestamp(stop_count - 1);
+    skip_instructions_with_timestamp(stop_count - 1);
+    if (resume_read_ahead && !at_eof_) {
+        trace_entry_t last_entry =
+            zipfile->cur_buf < zipfile->max_buf ? *(zipfile->max_buf - 1) : entry_copy_;
+        read_ahead_ = start_read_ahead(*zipfile, read_ahead_blocks_, last_entry);
+    }
+    return *this;
 }
 
 /*********************************************************
@@ -263,6 +623,9 @@ template <> record_file_reader_t<zipfile_reader_t>::~record_file_reader_t()
         unzClose(input_file_->file);
         input_file_->file = nullptr;
     }
+#ifdef HAS_ZSTD
+    ZSTD_freeDCtx(input_file_->zstd_dctx);
+#endif
 }
 
 template <>
@@ -273,6 +636,10 @@ record_file_reader_t<zipfile_reader_t>::open_single_file(const std::string &path
     if (!open_single_file_common(path, zread))
         return false;
     input_file_ = std::unique_ptr<zipfile_reader_t>(new zipfile_reader_t(zread));
+    // Do not point into the local's buffer.
+    input_file_->cur_buf = input_file_->buf;
+    input_file_->max_buf = input_file_->buf;
+    input_file_->start_buf = input_file_->buf;
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
     input_file_->verbosity = verbosity_;
     return true;
@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2017-2023 Google, Inc.  All rights reserved.
+ * Copyright (c) 2017-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -36,7 +36,15 @@
 #define _ZIPFILE_FILE_READER_H_ 1
 
 #include <zlib.h>
+
+#include <string>
+#include <vector>
+
 #include "minizip/unzip.h"
+#ifdef HAS_ZSTD
+#    include <zstd.h>
+#endif
+#include "columnar_chunk.h"
 #include "file_reader.h"
 #include "record_file_reader.h"
 
@@ -64,6 +72,49 @@ struct zipfile_reader_t {
     trace_entry_t buf[4096];
     trace_entry_t *cur_buf = buf;
     trace_entry_t *max_buf = buf;
+    // The index of the component currently open in "file".
+    uint64_t component = 0;
+    // The start of the data pointed at by cur_buf, which may be "buf" or a
+    // read-ahead block, along with its component and uncompressed offset within
+    // that component.  These let us reposition the file at the consumer's
+    // location after the read-ahead thread has moved on.
+    trace_entry_t *start_buf = buf;
+    uint64_t start_buf_component = 0;
+    uint64_t start_buf_offset = 0;
+    // The seek index, built from the central directory by the first skip that
+    // leaves the current chunk: the minizip position of each chunk along with
+    // the instruction ordinal at its start.
+    struct chunk_pos_t {
+        uint64_t instr_ordinal;
+        ZPOS64_T pos;
+    };
+    std::vector<chunk_pos_t> chunk_index;
+    // Components in the columnar format from columnar_chunk.h are decoded a
+    // block at a time into "decoded", whose start is at uncompressed offset
+    // "decoded_offset" within the component.  For other components, "peek"
+    // holds the bytes read while checking for the columnar magic, which are
+    // handed out before any more are read from the component.
+    bool columnar = false;
+    columnar_decoder_t decoder;
+    std::string decoded;
+    size_t decoded_pos = 0;
+    uint64_t decoded_offset = 0;
+    std::string payload;
+    char peek[COLUMNAR_CHUNK_MAGIC_SIZE];
+    unsigned int peek_size = 0;
+    unsigned int peek_pos = 0;
+#ifdef HAS_ZSTD
+    // For components holding a zstd frame (see zipfile_ostream.h): the
+    // decompression context, which the owning reader frees, and the compressed
+    // input not yet consumed.
+    bool zstd = false;
+    ZSTD_DCtx *zstd_dctx = nullptr;
+    std::string zstd_in;
+    size_t zstd_in_pos = 0;
+    bool zstd_in_eof = false;
+#endif
+    // The uncompressed bytes read so far from the current component.
+    uint64_t member_offset = 0;
     // Store the path and component names for debug messages.
     std::string path;
     char name[128];
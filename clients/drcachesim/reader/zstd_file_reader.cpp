@@ -0,0 +1,165 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "zstd_file_reader.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+trace_entry_t *
+read_next_entry_common(zstd_reader_t *reader, bool *eof)
+{
+    if (reader->cur_buf >= reader->max_buf) {
+        int len = reader->file
+                      ->read(reinterpret_cast<char *>(&reader->buf), sizeof(reader->buf))
+                      .gcount();
+        if (len < static_cast<int>(sizeof(trace_entry_t)) ||
+            len % static_cast<int>(sizeof(trace_entry_t)) != 0) {
+            *eof = (len >= 0);
+            return nullptr;
+        }
+        reader->cur_buf = reader->buf;
+        reader->max_buf = reader->buf + (len / sizeof(trace_entry_t));
+    }
+    trace_entry_t *res = reader->cur_buf;
+    ++reader->cur_buf;
+    return res;
+}
+
+/**************************************************
+ * zstd_reader_t specializations for file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::file_reader_t()
+{
+    input_file_.file = nullptr;
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<zstd_reader_t>::~file_reader_t()
+{
+    // The read-ahead thread must be done with the file before we delete it.
+    read_ahead_.reset();
+    if (input_file_.file != nullptr) {
+        delete input_file_.file;
+        input_file_.file = nullptr;
+    }
+}
+
+template <>
+bool
+file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    auto file = new zstd_istream_t(path);
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_ = zstd_reader_t(file);
+    if (read_ahead_blocks_ > 0) {
+        auto fill = [file](read_ahead_t::block_t &block) {
+            block.size = static_cast<int>(
+                file->read(reinterpret_cast<char *>(block.entries.data()),
+                           block.entries.size() * sizeof(trace_entry_t))
+                    .gcount());
+        };
+        read_ahead_.reset(new read_ahead_t(read_ahead_blocks_, fill));
+    }
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_queued_entry();
+    if (entry != nullptr)
+        return entry;
+    if (read_ahead_)
+        entry = read_next_entry_from_read_ahead();
+    else
+        entry = read_next_entry_common(&input_file_, &at_eof_);
+    if (entry == nullptr)
+        return entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[entry->type], entry->type, entry->size, entry->addr);
+    entry_copy_ = *entry;
+    return &entry_copy_;
+}
+
+/*********************************************************
+ * zstd_reader_t specializations for record_file_reader_t.
+ */
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+record_file_reader_t<zstd_reader_t>::~record_file_reader_t()
+{
+    if (input_file_ != nullptr) {
+        delete input_file_->file;
+        input_file_->file = nullptr;
+    }
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::open_single_file(const std::string &path)
+{
+    auto file = new zstd_istream_t(path);
+    if (!*file) {
+        delete file;
+        return false;
+    }
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_file_ = std::unique_ptr<zstd_reader_t>(new zstd_reader_t(file));
+    return true;
+}
+
+template <>
+bool
+record_file_reader_t<zstd_reader_t>::read_next_entry()
+{
+    trace_entry_t *entry = read_next_entry_common(input_file_.get(), &eof_);
+    if (entry == nullptr)
+        return false;
+    cur_entry_ = *entry;
+    VPRINT(this, 4, "Read from file: type=%s (%d), size=%d, addr=%zu\n",
+           trace_type_names[cur_entry_.type], cur_entry_.type, cur_entry_.size,
+           cur_entry_.addr);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
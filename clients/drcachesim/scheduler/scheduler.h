@@ -908,6 +908,25 @@ public:
         std::unique_ptr<ReaderType> kernel_syscall_reader;
         /** The end reader for #kernel_syscall_reader. */
         std::unique_ptr<ReaderType> kernel_syscall_reader_end;
+        /**
+         * If non-zero, each input reader that the scheduler opens from a path
+         * decompresses this many blocks ahead of the records being consumed, on a
+         * helper thread per input.  This moves decompression off the thread
+         * processing the records, at the cost of one extra thread and this many
+         * 64KB-ish buffers per open input.  Supported for gzip, zipfile, lz4, and
+         * snappy-compressed inputs; ignored for others and for readers passed in
+         * by the caller.
+         */
+        int read_ahead_blocks = 0;
+        /**
+         * If true, each uncompressed input file that the scheduler opens from a
+         * path is read through a private memory mapping, which hands out records
+         * without copying them, rather than through the default stream reader.
+         * For such inputs #read_ahead_blocks asks the kernel to page in that many
+         * blocks ahead of the records being consumed instead of using a helper
+         * thread.  Only supported on UNIX; ignored elsewhere.
+         */
+        bool mmap_uncompressed_inputs = false;
         // When adding new options, also add to print_configuration().
     };
 
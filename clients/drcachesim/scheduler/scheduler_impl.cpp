@@ -66,6 +66,9 @@
 #ifdef HAS_LZ4
 #    include "lz4_file_reader.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "zstd_file_reader.h"
+#endif
 #ifdef HAS_ZLIB
 #    include "compressed_file_reader.h"
 #endif
@@ -77,6 +80,9 @@
 #ifdef HAS_SNAPPY
 #    include "snappy_file_reader.h"
 #endif
+#ifdef HAS_MMAP
+#    include "mmap_file_reader.h"
+#endif
 #include "directory_iterator.h"
 #include "utils.h"
 
@@ -129,19 +135,29 @@ std::unique_ptr<reader_t>
 scheduler_impl_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path,
                                                       int verbosity)
 {
-#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4)
+    int read_ahead = options_.read_ahead_blocks;
+#if defined(HAS_SNAPPY) || defined(HAS_ZIP) || defined(HAS_LZ4) || defined(HAS_ZSTD)
 #    ifdef HAS_LZ4
     if (ends_with(path, ".lz4")) {
-        return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
+        return std::unique_ptr<reader_t>(
+            new lz4_file_reader_t(path, verbosity, read_ahead));
+    }
+#    endif
+#    ifdef HAS_ZSTD
+    if (ends_with(path, ".zst")) {
+        return std::unique_ptr<reader_t>(
+            new zstd_file_reader_t(path, verbosity, read_ahead));
     }
 #    endif
 #    ifdef HAS_SNAPPY
     if (ends_with(path, ".sz"))
-        return std::unique_ptr<reader_t>(new snappy_file_reader_t(path, verbosity));
+        return std::unique_ptr<reader_t>(
+            new snappy_file_reader_t(path, verbosity, read_ahead));
 #    endif
 #    ifdef HAS_ZIP
     if (ends_with(path, ".zip"))
-        return std::unique_ptr<reader_t>(new zipfile_file_reader_t(path, verbosity));
+        return std::unique_ptr<reader_t>(
+            new zipfile_file_reader_t(path, verbosity, read_ahead));
 #    endif
     // If path is a directory, and any file in it ends in .sz, return a snappy reader.
     if (directory_iterator_t::is_directory(path)) {
@@ -166,25 +182,41 @@ scheduler_impl_tmpl_t<memref_t, reader_t>::get_reader(const std::string &path,
 #    ifdef HAS_SNAPPY
             if (ends_with(*iter, ".sz")) {
                 return std::unique_ptr<reader_t>(
-                    new snappy_file_reader_t(path, verbosity));
+                    new snappy_file_reader_t(path, verbosity, read_ahead));
             }
 #    endif
 #    ifdef HAS_ZIP
             if (ends_with(*iter, ".zip")) {
                 return std::unique_ptr<reader_t>(
-                    new zipfile_file_reader_t(path, verbosity));
+                    new zipfile_file_reader_t(path, verbosity, read_ahead));
             }
 #    endif
 #    ifdef HAS_LZ4
             if (ends_with(path, ".lz4")) {
-                return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
+                return std::unique_ptr<reader_t>(
+                    new lz4_file_reader_t(path, verbosity, read_ahead));
+            }
+#    endif
+#    ifdef HAS_ZSTD
+            if (ends_with(*iter, ".zst")) {
+                return std::unique_ptr<reader_t>(
+                    new zstd_file_reader_t(path, verbosity, read_ahead));
             }
 #    endif
         }
     }
+#endif
+#ifdef HAS_MMAP
+    // If requested, an uncompressed regular file is mapped rather than streamed:
+    // this avoids both the per-entry copy and the gzip layer's buffering.
+    if (options_.mmap_uncompressed_inputs && mmap_reader_t::is_mappable(path)) {
+        return std::unique_ptr<reader_t>(
+            new mmap_file_reader_t(path, verbosity, read_ahead));
+    }
 #endif
     // No snappy/zlib support, or didn't find a .sz/.zip file.
-    return std::unique_ptr<reader_t>(new default_file_reader_t(path, verbosity));
+    return std::unique_ptr<reader_t>(
+        new default_file_reader_t(path, verbosity, read_ahead));
 }
 
 template <>
@@ -435,6 +467,12 @@ scheduler_impl_tmpl_t<trace_entry_t, record_reader_t>::get_reader(const std::str
         return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
             new zipfile_record_file_reader_t(path, verbosity));
     }
+#endif
+#ifdef HAS_ZSTD
+    if (ends_with(path, ".zst")) {
+        return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
+            new zstd_record_file_reader_t(path, verbosity));
+    }
 #endif
     return std::unique_ptr<dynamorio::drmemtrace::record_reader_t>(
         new default_record_file_reader_t(path, verbosity));
@@ -752,6 +790,9 @@ scheduler_impl_tmpl_t<RecordType, ReaderType>::print_configuration()
            options_.kernel_syscall_reader.get());
     VPRINT(this, 1, "  %-25s : %p\n", "kernel_syscall_reader_end",
            options_.kernel_syscall_reader_end.get());
+    VPRINT(this, 1, "  %-25s : %d\n", "read_ahead_blocks", options_.read_ahead_blocks);
+    VPRINT(this, 1, "  %-25s : %d\n", "mmap_uncompressed_inputs",
+           options_.mmap_uncompressed_inputs);
 }
 
 template <typename RecordType, typename ReaderType>
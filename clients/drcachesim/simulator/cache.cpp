@@ -93,21 +93,25 @@ cache_t::flush(const memref_t &memref)
     addr_t tag = compute_tag(memref.flush.addr);
     addr_t final_tag =
         compute_tag(memref.flush.addr + memref.flush.size - 1 /*no overflow*/);
-    last_tag_ = TAG_INVALID;
+    if (!is_shared())
+        last_tag_ = TAG_INVALID;
     for (; tag <= final_tag; ++tag) {
+        auto set_lock = lock_set(compute_block_idx(tag));
         auto block_way = find_caching_device_block(tag);
         if (block_way.first == nullptr)
             continue;
         replacement_policy_->invalidation_update(compute_block_idx(tag),
                                                  block_way.second);
-        invalidate_caching_device_block(block_way.first);
+        invalidate_caching_device_block(compute_block_idx(tag), block_way.second);
     }
     // We flush parent_'s code cache here.
     // XXX: should L1 data cache be flushed when L1 instr cache is flushed?
     if (parent_ != NULL)
         ((cache_t *)parent_)->flush(memref);
-    if (stats_ != NULL)
+    if (stats_ != NULL) {
+        auto stats_lock = lock_stats();
         ((cache_stats_t *)stats_)->flush(memref);
+    }
 }
 
 } // namespace drmemtrace
@@ -87,6 +87,13 @@ public:
     /// Returns the name of the replacement policy.
     virtual std::string
     get_name() const = 0;
+    /// Returns whether the policy keeps state that is shared among sets, such that
+    /// updates to different sets must not run concurrently.
+    virtual bool
+    has_cross_set_state() const
+    {
+        return false;
+    }
 
     virtual ~cache_replacement_policy_t() = default;
 
@@ -38,6 +38,7 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -498,55 +499,13 @@ cache_simulator_t::process_memref(const memref_t &memref)
         simref = &phys_memref;
     }
 
-    if (type_is_instr(simref->instr.type) ||
-        simref->instr.type == TRACE_TYPE_PREFETCH_INSTR) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->instr.addr << " instr x"
-                      << simref->instr.size << "\n";
-        }
-        l1_icaches_[core_index]->request(*simref);
-    } else if (simref->data.type == TRACE_TYPE_READ ||
-               simref->data.type == TRACE_TYPE_WRITE ||
-               // We may potentially handle prefetches differently.
-               // TRACE_TYPE_PREFETCH_INSTR is handled above.
-               type_is_prefetch(simref->data.type)) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " "
-                      << trace_type_names[simref->data.type] << " "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core_index]->request(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_INSTR_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " iflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_icaches_[core_index]->flush(*simref);
-    } else if (simref->flush.type == TRACE_TYPE_DATA_FLUSH) {
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->data.pc << " dflush "
-                      << (void *)simref->data.addr << " x" << simref->data.size << "\n";
-        }
-        l1_dcaches_[core_index]->flush(*simref);
-    } else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
+    if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(simref->exit.tid);
         last_thread_ = 0;
     } else if (memref.marker.type == TRACE_TYPE_MARKER &&
                memref.marker.marker_type == TRACE_MARKER_TYPE_CPU_ID) {
         last_thread_ = 0;
-    } else if (simref->marker.type == TRACE_TYPE_INSTR_NO_FETCH) {
-        // Just ignore.
-        if (knobs_.verbose >= 3) {
-            std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
-                      << " @" << (void *)simref->instr.addr << " non-fetched instr x"
-                      << simref->instr.size << "\n";
-        }
-    } else {
-        error_string_ = "Unhandled memref type " + std::to_string(simref->data.type);
+    } else if (!simulate_core_access(core_index, *simref, error_string_)) {
         return false;
     }
 
@@ -566,6 +525,170 @@ cache_simulator_t::process_memref(const memref_t &memref)
     return true;
 }
 
+std::string
+cache_simulator_t::initialize_shard_type(shard_type_t shard_type)
+{
+    std::string error = simulator_t::initialize_shard_type(shard_type);
+    if (!error.empty() || !knobs_.parallel)
+        return error;
+    if (shard_type != SHARD_BY_CORE)
+        return "Usage error: -cache_parallel requires -core_sharded";
+    return init_parallel_caches();
+}
+
+std::string
+cache_simulator_t::init_parallel_caches()
+{
+    // The per-record counters and the physical address state are global to
+    // the simulation and are not yet synchronized across shards.
+    // XXX: We could support these with atomic counters, though the precise
+    // record at which warmup completes would still depend on thread timing.
+    if (knobs_.skip_refs > 0 || knobs_.warmup_refs > 0 || knobs_.warmup_fraction > 0.0 ||
+        knobs_.sim_refs != cache_simulator_knobs_t().sim_refs) {
+        return "Usage error: -cache_parallel does not support -skip_refs, "
+               "-warmup_refs, -warmup_fraction, or -sim_refs";
+    }
+    if (knobs_.use_physical)
+        return "Usage error: -cache_parallel does not support -use_physical";
+    // Coherence and inclusive or exclusive shared caches have the shared levels
+    // reach back down into other cores' private caches, which we do not lock.
+    if (knobs_.model_coherence)
+        return "Usage error: -cache_parallel does not support -coherence";
+    // Find the caches reachable from more than one core.  Any ancestor of such a
+    // cache is reachable from the same cores and so is found as well.
+    std::unordered_map<caching_device_t *, int> cache2core;
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        for (caching_device_t *l1 : { static_cast<caching_device_t *>(l1_icaches_[i]),
+                                      static_cast<caching_device_t *>(l1_dcaches_[i]) }) {
+            for (caching_device_t *cache = l1; cache != nullptr;
+                 cache = cache->get_parent()) {
+                auto it = cache2core.find(cache);
+                if (it == cache2core.end()) {
+                    cache2core[cache] = i;
+                } else if (it->second != static_cast<int>(i) && !cache->is_shared()) {
+                    if (cache->is_inclusive() || cache->is_exclusive()) {
+                        return "Usage error: -cache_parallel does not support "
+                               "inclusive or exclusive shared caches";
+                    }
+                    cache->set_shared(MAX_SHARED_CACHE_SET_LOCKS);
+                }
+            }
+        }
+    }
+    return "";
+}
+
+bool
+cache_simulator_t::parallel_shard_supported()
+{
+    return knobs_.parallel;
+}
+
+void *
+cache_simulator_t::parallel_shard_init_stream(int shard_index, void *worker_data,
+                                              memtrace_stream_t *shard_stream)
+{
+    return new shard_data_t(shard_index, shard_stream);
+}
+
+bool
+cache_simulator_t::parallel_shard_exit(void *shard_data)
+{
+    delete reinterpret_cast<shard_data_t *>(shard_data);
+    return true;
+}
+
+bool
+cache_simulator_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (memref.marker.type == TRACE_TYPE_MARKER) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << memref.data.pid << "." << memref.data.tid << ":: "
+                      << "marker type " << memref.marker.marker_type << " value "
+                      << memref.marker.marker_value << "\n";
+        }
+        return true;
+    }
+    if (shard->core >= static_cast<int>(knobs_.num_cores)) {
+        shard->error = "Too-small core count " + std::to_string(knobs_.num_cores) +
+            " for trace core #" + std::to_string(shard->core);
+        return false;
+    }
+    if (!shard->saw_record) {
+        // Track the cpuid<->ordinal relationship for our results printout,
+        // matching what core_for_thread() records in serial mode.
+        shard->saw_record = true;
+        std::lock_guard<std::mutex> guard(shard_lock_);
+        int64_t cpu = shard->stream->get_output_cpuid();
+        if (cpu2core_.find(cpu) == cpu2core_.end())
+            cpu2core_[cpu] = shard->core;
+    }
+    // Thread exits need no action for SHARD_BY_CORE.
+    if (memref.exit.type == TRACE_TYPE_THREAD_EXIT)
+        return true;
+    return simulate_core_access(shard->core, memref, shard->error);
+}
+
+std::string
+cache_simulator_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+bool
+cache_simulator_t::simulate_core_access(int core_index, const memref_t &simref,
+                                        std::string &error)
+{
+    if (type_is_instr(simref.instr.type) ||
+        simref.instr.type == TRACE_TYPE_PREFETCH_INSTR) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.instr.addr << " instr x"
+                      << simref.instr.size << "\n";
+        }
+        l1_icaches_[core_index]->request(simref);
+    } else if (simref.data.type == TRACE_TYPE_READ ||
+               simref.data.type == TRACE_TYPE_WRITE ||
+               // We may potentially handle prefetches differently.
+               // TRACE_TYPE_PREFETCH_INSTR is handled above.
+               type_is_prefetch(simref.data.type)) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " "
+                      << trace_type_names[simref.data.type] << " "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_dcaches_[core_index]->request(simref);
+    } else if (simref.flush.type == TRACE_TYPE_INSTR_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " iflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_icaches_[core_index]->flush(simref);
+    } else if (simref.flush.type == TRACE_TYPE_DATA_FLUSH) {
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.data.pc << " dflush "
+                      << (void *)simref.data.addr << " x" << simref.data.size << "\n";
+        }
+        l1_dcaches_[core_index]->flush(simref);
+    } else if (simref.marker.type == TRACE_TYPE_INSTR_NO_FETCH) {
+        // Just ignore.
+        if (knobs_.verbose >= 3) {
+            std::cerr << "::" << simref.data.pid << "." << simref.data.tid << ":: "
+                      << " @" << (void *)simref.instr.addr << " non-fetched instr x"
+                      << simref.instr.size << "\n";
+        }
+    } else {
+        error = "Unhandled memref type " + std::to_string(simref.data.type);
+        return false;
+    }
+    return true;
+}
+
 prefetcher_t *
 cache_simulator_t::get_prefetcher(std::string prefetcher_name)
 {
@@ -40,6 +40,7 @@
 #include <stdint.h>
 
 #include <istream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -79,11 +80,27 @@ public:
                       prefetcher_factory_t *custom_prefetcher_factory = nullptr);
 
     virtual ~cache_simulator_t();
+    std::string
+    initialize_shard_type(shard_type_t shard_type) override;
     bool
     process_memref(const memref_t &memref) override;
     bool
     print_results() override;
 
+    // With knobs.parallel, each core-sharded shard is simulated on its own
+    // analyzer worker: see the -cache_parallel option.
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init_stream(int shard_index, void *worker_data,
+                               memtrace_stream_t *shard_stream) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
     int64_t
     get_cache_metric(metric_name_t metric, unsigned level, unsigned core = 0,
                      cache_split_t split = cache_split_t::DATA) const;
@@ -110,9 +127,31 @@ public:
     get_knobs() const;
 
 protected:
+    struct shard_data_t {
+        shard_data_t(int core, memtrace_stream_t *stream)
+            : core(core)
+            , stream(stream)
+        {
+        }
+        int core;
+        memtrace_stream_t *stream;
+        bool saw_record = false;
+        std::string error;
+    };
+
     prefetcher_t *
     get_prefetcher(std::string prefetcher_name);
 
+    // Sends a non-marker record to the private caches of the given core.
+    // Returns false and sets "error" on an unhandled record type.
+    bool
+    simulate_core_access(int core_index, const memref_t &simref, std::string &error);
+
+    // Checks that the configuration can be simulated in parallel and gives
+    // every cache shared among cores the shared lock.
+    std::string
+    init_parallel_caches();
+
     cache_simulator_knobs_t knobs_;
 
     // Implement a set of ICaches and DCaches with pointer arrays.
@@ -136,6 +175,12 @@ protected:
     // Used to get prefetcher instances if the dataprefetcher knob is "custom".
     prefetcher_factory_t *custom_prefetcher_factory_ = nullptr;
 
+    // The number of locks striped across the sets of each cache shared among
+    // cores in parallel mode.
+    static constexpr int MAX_SHARED_CACHE_SET_LOCKS = 256;
+    // Protects simulator_t state updated from parallel shards.
+    std::mutex shard_lock_;
+
 private:
     bool is_warmed_up_;
 };
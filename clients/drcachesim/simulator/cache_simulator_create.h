@@ -35,7 +35,11 @@
 #ifndef _CACHE_SIMULATOR_CREATE_H_
 #define _CACHE_SIMULATOR_CREATE_H_ 1
 
+#include <stdint.h>
+
 #include <string>
+#include <vector>
+
 #include "analysis_tool.h"
 
 namespace dynamorio {
@@ -71,6 +75,7 @@ struct cache_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , use_physical(false)
+        , parallel(false)
         , verbose(0)
     {
     }
@@ -92,6 +97,7 @@ struct cache_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     bool use_physical;
+    bool parallel;
     unsigned int verbose;
 };
 
@@ -106,6 +112,42 @@ cache_simulator_create(const cache_simulator_knobs_t &knobs);
 analysis_tool_t *
 cache_simulator_create(const std::string &config_file);
 
+/**
+ * The options for cache_sweep_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// The options are currently documented in ../common/options.cpp.
+struct cache_sweep_knobs_t {
+    cache_sweep_knobs_t()
+        : LL_sizes({ 1 << 20, 2 << 20, 4 << 20, 8 << 20, 16 << 20, 32 << 20, 64 << 20 })
+        , LL_assocs({ 4, 8, 16 })
+        , sample_rate(1.0)
+    {
+    }
+    std::vector<uint64_t> LL_sizes;
+    std::vector<unsigned int> LL_assocs;
+    double sample_rate;
+};
+
+/**
+ * Creates an instance of a cache sweep: a cache simulator with a 2-level
+ * hierarchy which also reports the miss ratio of the last-level cache for every
+ * combination of the sizes and associativities in \p sweep_knobs, in a single
+ * pass.
+ */
+analysis_tool_t *
+cache_sweep_create(const cache_simulator_knobs_t &knobs,
+                   const cache_sweep_knobs_t &sweep_knobs);
+
+/**
+ * Creates an instance of a cache sweep using a cache hierarchy defined in a
+ * configuration file, reporting the miss ratios of each last-level cache for
+ * every combination of the sizes and associativities in \p sweep_knobs.
+ */
+analysis_tool_t *
+cache_sweep_create(const std::string &config_file,
+                   const cache_sweep_knobs_t &sweep_knobs);
+
 /** Creates an instance of a cache miss analyzer. */
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
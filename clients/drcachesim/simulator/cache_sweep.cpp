@@ -0,0 +1,317 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "cache_sweep.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "cache_simulator.h"
+#include "cache_simulator_create.h"
+#include "cache_stats.h"
+#include "caching_device_block.h"
+#include "memref.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+analysis_tool_t *
+cache_sweep_create(const cache_simulator_knobs_t &knobs,
+                   const cache_sweep_knobs_t &sweep_knobs)
+{
+    return new cache_sweep_t(knobs, sweep_knobs);
+}
+
+analysis_tool_t *
+cache_sweep_create(const std::string &config_file, const cache_sweep_knobs_t &sweep_knobs)
+{
+    std::ifstream fin;
+    fin.open(config_file);
+    if (!fin.is_open()) {
+        ERRMSG("Failed to open the config file '%s'\n", config_file.c_str());
+        return nullptr;
+    }
+    analysis_tool_t *sim = new cache_sweep_t(&fin, sweep_knobs);
+    fin.close();
+    return sim;
+}
+
+std::string
+parse_cache_sweep_lists(const std::string &sizes, const std::string &assocs,
+                        cache_sweep_knobs_t &knobs)
+{
+    knobs.LL_sizes.clear();
+    for (const std::string &size : split_by(sizes, ",")) {
+        char *end;
+        uint64_t value = strtoull(size.c_str(), &end, 0);
+        int shift = 0;
+        if (*end == 'K' || *end == 'k')
+            shift = 10;
+        else if (*end == 'M' || *end == 'm')
+            shift = 20;
+        else if (*end == 'G' || *end == 'g')
+            shift = 30;
+        if (shift > 0) {
+            value <<= shift;
+            ++end;
+        }
+        if (end == size.c_str() || *end != '\0' || value == 0)
+            return "Invalid cache size '" + size + "'";
+        knobs.LL_sizes.push_back(value);
+    }
+    knobs.LL_assocs.clear();
+    for (const std::string &assoc : split_by(assocs, ",")) {
+        char *end;
+        unsigned long value = strtoul(assoc.c_str(), &end, 0);
+        if (end == assoc.c_str() || *end != '\0' || value == 0 || value > UINT_MAX)
+            return "Invalid associativity '" + assoc + "'";
+        knobs.LL_assocs.push_back(static_cast<unsigned int>(value));
+    }
+    return "";
+}
+
+// The finalizer of splitmix64, which spreads consecutive set indices evenly.
+static inline uint64_t
+hash_set_index(uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+std::string
+stack_distance_sweep_t::init(int line_size, const cache_sweep_knobs_t &knobs)
+{
+    if (!IS_POWER_OF_2(line_size))
+        return "Line size must be a power of 2";
+    if (knobs.LL_sizes.empty() || knobs.LL_assocs.empty())
+        return "At least one size and one associativity must be specified";
+    if (!(knobs.sample_rate > 0.0 && knobs.sample_rate <= 1.0))
+        return "The sample rate must be in (0, 1]";
+    line_bits_ = compute_log2(line_size);
+    groups_.clear();
+    points_.clear();
+    for (uint64_t size : knobs.LL_sizes) {
+        for (unsigned int assoc : knobs.LL_assocs) {
+            uint64_t lines = size >> line_bits_;
+            if (assoc == 0 || lines % assoc != 0 || !IS_POWER_OF_2(lines / assoc)) {
+                return "Size " + std::to_string(size) + " with associativity " +
+                    std::to_string(assoc) + " does not yield a power of 2 sets";
+            }
+            uint64_t num_sets = lines / assoc;
+            size_t group = 0;
+            while (group < groups_.size() && groups_[group].num_sets != num_sets)
+                ++group;
+            if (group == groups_.size()) {
+                groups_.emplace_back();
+                groups_.back().num_sets = num_sets;
+                groups_.back().max_assoc = 0;
+            }
+            groups_[group].max_assoc = std::max(groups_[group].max_assoc, assoc);
+            points_.push_back({ size, assoc, group });
+        }
+    }
+    min_sets_ = groups_[0].num_sets;
+    for (set_group_t &group : groups_) {
+        group.stacks.assign(group.num_sets * group.max_assoc, TAG_INVALID);
+        group.depth_hits.assign(group.max_assoc, 0);
+        min_sets_ = std::min(min_sets_, group.num_sets);
+    }
+    sampling_ = knobs.sample_rate < 1.0;
+    if (sampling_) {
+        sample_threshold_ =
+            static_cast<uint64_t>(knobs.sample_rate * static_cast<double>(UINT64_MAX));
+    }
+    accesses_ = 0;
+    return "";
+}
+
+void
+stack_distance_sweep_t::access_group(set_group_t &group, addr_t tag, bool counted)
+{
+    addr_t *stack = &group.stacks[(tag & (group.num_sets - 1)) * group.max_assoc];
+    unsigned int depth = 0;
+    while (depth < group.max_assoc - 1 && stack[depth] != tag)
+        ++depth;
+    if (counted && stack[depth] == tag)
+        ++group.depth_hits[depth];
+    // Move to the front, dropping the least recently used tag on a miss.
+    std::move_backward(stack, stack + depth, stack + depth + 1);
+    stack[0] = tag;
+}
+
+void
+stack_distance_sweep_t::access(addr_t addr, bool counted)
+{
+    addr_t tag = addr >> line_bits_;
+    if (sampling_ && hash_set_index(tag & (min_sets_ - 1)) > sample_threshold_)
+        return;
+    if (counted)
+        ++accesses_;
+    for (set_group_t &group : groups_)
+        access_group(group, tag, counted);
+}
+
+void
+stack_distance_sweep_t::reset_counts()
+{
+    accesses_ = 0;
+    for (set_group_t &group : groups_)
+        std::fill(group.depth_hits.begin(), group.depth_hits.end(), 0);
+}
+
+std::vector<cache_sweep_result_t>
+stack_distance_sweep_t::get_results() const
+{
+    std::vector<cache_sweep_result_t> results;
+    for (const point_t &point : points_) {
+        const set_group_t &group = groups_[point.group];
+        int64_t hits = 0;
+        for (unsigned int depth = 0; depth < point.assoc; ++depth)
+            hits += group.depth_hits[depth];
+        results.push_back({ point.size, point.assoc, accesses_, accesses_ - hits });
+    }
+    return results;
+}
+
+void
+cache_sweep_stats_t::access(const memref_t &memref, bool hit,
+                            caching_device_block_t *cache_block)
+{
+    cache_stats_t::access(memref, hit, cache_block);
+    // Prefetches update the stacks like any fill but only demand accesses count.
+    sweep_.access(memref.data.addr, !type_is_prefetch(memref.data.type));
+}
+
+void
+cache_sweep_stats_t::reset()
+{
+    cache_stats_t::reset();
+    sweep_.reset_counts();
+}
+
+cache_sweep_t::cache_sweep_t(const cache_simulator_knobs_t &knobs,
+                             const cache_sweep_knobs_t &sweep_knobs)
+    : cache_simulator_t(knobs)
+{
+    init_sweep(sweep_knobs);
+}
+
+cache_sweep_t::cache_sweep_t(std::istream *config_file,
+                             const cache_sweep_knobs_t &sweep_knobs)
+    : cache_simulator_t(config_file)
+{
+    init_sweep(sweep_knobs);
+}
+
+void
+cache_sweep_t::init_sweep(const cache_sweep_knobs_t &sweep_knobs)
+{
+    if (!success_)
+        return;
+    sample_rate_ = sweep_knobs.sample_rate;
+    bool warmup_enabled = (knobs_.warmup_refs > 0 || knobs_.warmup_fraction > 0.0);
+    for (auto &llc : llcaches_) {
+        // As in cache_miss_analyzer_t, we replace the stats of each LLC, which
+        // sees every request that reaches it.  This drops any miss file.
+        cache_sweep_stats_t *stats = new cache_sweep_stats_t(
+            static_cast<int>(llc.second->get_block_size()), warmup_enabled,
+            llc.second->is_coherent());
+        std::string error = stats->get_sweep().init(
+            static_cast<int>(llc.second->get_block_size()), sweep_knobs);
+        delete llc.second->get_stats();
+        llc.second->set_stats(stats);
+        if (!error.empty()) {
+            error_string_ = "Usage error: invalid cache sweep: " + error;
+            success_ = false;
+            return;
+        }
+    }
+}
+
+std::vector<cache_sweep_result_t>
+cache_sweep_t::get_sweep_results(const std::string &llc_name) const
+{
+    auto it = llcaches_.find(llc_name);
+    if (it == llcaches_.end())
+        return {};
+    return static_cast<cache_sweep_stats_t *>(it->second->get_stats())
+        ->get_sweep()
+        .get_results();
+}
+
+bool
+cache_sweep_t::print_results()
+{
+    if (!cache_simulator_t::print_results())
+        return false;
+    std::cerr << "Cache sweep results";
+    if (sample_rate_ < 1.0)
+        std::cerr << " (sampling " << sample_rate_ << " of the sets)";
+    std::cerr << ":\n";
+    for (const auto &llc : llcaches_) {
+        stack_distance_sweep_t &sweep =
+            static_cast<cache_sweep_stats_t *>(llc.second->get_stats())->get_sweep();
+        std::cerr << "  " << llc.first << " (" << sweep.get_sampled_accesses()
+                  << " demand accesses simulated):\n";
+        std::cerr << std::setw(14) << "size" << std::setw(8) << "assoc"
+                  << std::setw(16) << "misses" << std::setw(12) << "miss rate"
+                  << "\n";
+        for (const cache_sweep_result_t &result : sweep.get_results()) {
+            double rate = result.accesses == 0
+                ? 0.0
+                : 100.0 * static_cast<double>(result.misses) /
+                    static_cast<double>(result.accesses);
+            std::cerr << std::setw(14) << result.size << std::setw(8) << result.assoc
+                      << std::setw(16) << result.misses << std::setw(11)
+                      << std::fixed << std::setprecision(2) << rate << "%\n";
+        }
+    }
+    // Reset the i/o format for subsequent tool invocations.
+    std::cerr << std::defaultfloat << std::setprecision(6);
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
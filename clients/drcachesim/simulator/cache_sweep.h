@@ -0,0 +1,172 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* cache_sweep: computes last-level cache miss ratios for a grid of sizes and
+ * associativities in a single pass.
+ */
+
+#ifndef _CACHE_SWEEP_H_
+#define _CACHE_SWEEP_H_ 1
+
+#include <stdint.h>
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "cache_simulator.h"
+#include "cache_simulator_create.h"
+#include "cache_stats.h"
+#include "caching_device_block.h"
+#include "memref.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Parses comma-separated lists of sizes, which take an optional K, M, or G
+// suffix, and of associativities into "knobs".  Returns an error message on
+// failure.
+std::string
+parse_cache_sweep_lists(const std::string &sizes, const std::string &assocs,
+                        cache_sweep_knobs_t &knobs);
+
+// The simulated counts for one point of the sweep grid.
+struct cache_sweep_result_t {
+    uint64_t size;
+    unsigned int assoc;
+    int64_t accesses;
+    int64_t misses;
+};
+
+// Computes per-set LRU stack distances (Mattson et al.) for every distinct set
+// count in the grid.  A single stack per set serves all associativities with
+// that set count: an access hits in an A-way cache exactly when its stack
+// depth is below A.
+//
+// With a sample rate below 1, only the sets of the smallest set count whose
+// index hashes below the rate threshold are simulated (SHARDS-style spatial
+// hashing).  Since every larger set count's index extends that smallest one,
+// each sampled set is simulated exactly for every grid point, and the miss
+// ratios are estimated from the sampled sets alone.
+class stack_distance_sweep_t {
+public:
+    std::string
+    init(int line_size, const cache_sweep_knobs_t &knobs);
+    void
+    access(addr_t addr, bool counted);
+    // Clears the counts while keeping the stacks, for the end of warmup.
+    void
+    reset_counts();
+    std::vector<cache_sweep_result_t>
+    get_results() const;
+    int64_t
+    get_sampled_accesses() const
+    {
+        return accesses_;
+    }
+
+private:
+    // The stacks for all grid points sharing one set count.
+    struct set_group_t {
+        uint64_t num_sets;
+        unsigned int max_assoc;
+        // Each set's tags, most recently used first, padded with TAG_INVALID.
+        std::vector<addr_t> stacks;
+        // Counted accesses found at each stack depth.
+        std::vector<int64_t> depth_hits;
+    };
+    struct point_t {
+        uint64_t size;
+        unsigned int assoc;
+        size_t group;
+    };
+
+    void
+    access_group(set_group_t &group, addr_t tag, bool counted);
+
+    int line_bits_ = 0;
+    std::vector<set_group_t> groups_;
+    std::vector<point_t> points_;
+    bool sampling_ = false;
+    uint64_t min_sets_ = 0;
+    uint64_t sample_threshold_ = 0;
+    int64_t accesses_ = 0;
+};
+
+// Stats for a last-level cache which also feed its accesses to a sweep.
+class cache_sweep_stats_t : public cache_stats_t {
+public:
+    cache_sweep_stats_t(int block_size, bool warmup_enabled, bool is_coherent)
+        : cache_stats_t(block_size, "", warmup_enabled, is_coherent)
+    {
+    }
+    void
+    access(const memref_t &memref, bool hit,
+           caching_device_block_t *cache_block) override;
+    void
+    reset() override;
+    stack_distance_sweep_t &
+    get_sweep()
+    {
+        return sweep_;
+    }
+
+private:
+    stack_distance_sweep_t sweep_;
+};
+
+// Simulates the hierarchy as cache_simulator_t does, from knobs or a
+// configuration file, while sweeping the configurations of each last-level
+// cache over the stream of requests it receives.
+class cache_sweep_t : public cache_simulator_t {
+public:
+    cache_sweep_t(const cache_simulator_knobs_t &knobs,
+                  const cache_sweep_knobs_t &sweep_knobs);
+    cache_sweep_t(std::istream *config_file, const cache_sweep_knobs_t &sweep_knobs);
+    bool
+    print_results() override;
+    // Returns the results for the named last-level cache, or an empty vector.
+    std::vector<cache_sweep_result_t>
+    get_sweep_results(const std::string &llc_name) const;
+
+private:
+    void
+    init_sweep(const cache_sweep_knobs_t &sweep_knobs);
+
+    double sample_rate_ = 1.0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _CACHE_SWEEP_H_ */
@@ -35,10 +35,19 @@
 #include <assert.h>
 #include <stddef.h>
 
+#if defined(__AVX2__) && defined(__x86_64__)
+#    include <immintrin.h>
+#elif defined(__SSE2__) && defined(__x86_64__)
+#    include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#    include <arm_neon.h>
+#endif
+
 #include <cstdint>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -127,6 +136,7 @@ caching_device_t::init(int associativity, int64_t block_size, int64_t num_blocks
     coherent_cache_ = coherent_cache;
     blocks_ = new caching_device_block_t *[static_cast<size_t>(num_blocks_)];
     init_blocks();
+    tags_.assign(static_cast<size_t>(num_blocks_), TAG_INVALID);
 
     last_tag_ = TAG_INVALID; // sentinel
 
@@ -138,6 +148,20 @@ caching_device_t::init(int associativity, int64_t block_size, int64_t num_blocks
     return true;
 }
 
+void
+caching_device_t::set_shared(int max_set_locks)
+{
+    int num_locks = 1;
+    // The hashtable and some replacement policies are shared among all sets.
+    if (!use_tag2block_table_ && !replacement_policy_->has_cross_set_state()) {
+        while (num_locks * 2 <= max_set_locks && num_locks * 2 <= blocks_per_way_)
+            num_locks *= 2;
+    }
+    set_locks_ = std::vector<std::mutex>(num_locks);
+    set_lock_mask_ = num_locks - 1;
+    last_tag_ = TAG_INVALID;
+}
+
 std::string
 caching_device_t::get_description() const
 {
@@ -162,6 +186,13 @@ caching_device_t::find_caching_device_block(addr_t tag)
         return it->second;
     }
     int block_idx = compute_block_idx(tag);
+    if (use_tag_array_) {
+        int way = find_way_in_set(block_idx, tag);
+        if (way < 0)
+            return std::make_pair(nullptr, 0);
+        assert(get_caching_device_block(block_idx, way).tag_ == tag);
+        return std::make_pair(&get_caching_device_block(block_idx, way), way);
+    }
     for (int way = 0; way < associativity_; ++way) {
         caching_device_block_t &block = get_caching_device_block(block_idx, way);
         if (block.tag_ == tag)
@@ -170,6 +201,55 @@ caching_device_t::find_caching_device_block(addr_t tag)
     return std::make_pair(nullptr, 0);
 }
 
+int
+caching_device_t::find_way_in_set(int block_idx, addr_t tag) const
+{
+    const addr_t *set_tags = tags_.data() + block_idx;
+    int way = 0;
+    // We compare as many ways at once as the vector width allows and finish any
+    // remainder one at a time.
+#if defined(__AVX2__) && defined(__x86_64__)
+    const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 4 <= associativity_; way += 4) {
+        __m256i ways =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(set_tags + way));
+        int mask =
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(ways, needle)));
+        if (mask != 0)
+            return way + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__) && defined(__x86_64__)
+    // SSE2 has no 64-bit compare, so we compare 32-bit halves and require both
+    // halves of a lane to match.
+    const __m128i needle = _mm_set1_epi64x(static_cast<long long>(tag));
+    for (; way + 2 <= associativity_; way += 2) {
+        __m128i ways = _mm_loadu_si128(reinterpret_cast<const __m128i *>(set_tags + way));
+        __m128i eq32 = _mm_cmpeq_epi32(ways, needle);
+        __m128i eq64 =
+            _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(eq64));
+        if (mask != 0)
+            return way + ((mask & 1) != 0 ? 0 : 1);
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint64x2_t needle = vdupq_n_u64(static_cast<uint64_t>(tag));
+    for (; way + 2 <= associativity_; way += 2) {
+        uint64x2_t eq =
+            vceqq_u64(vld1q_u64(reinterpret_cast<const uint64_t *>(set_tags + way)),
+                      needle);
+        if (vgetq_lane_u64(eq, 0) != 0)
+            return way;
+        if (vgetq_lane_u64(eq, 1) != 0)
+            return way + 1;
+    }
+#endif
+    for (; way < associativity_; ++way) {
+        if (set_tags[way] == tag)
+            return way;
+    }
+    return -1;
+}
+
 void
 caching_device_t::request(const memref_t &memref_in)
 {
@@ -184,7 +264,8 @@ caching_device_t::request(const memref_t &memref_in)
     addr_t tag = compute_tag(memref_in.data.addr);
 
     // Optimization: check last tag if single-block
-    if (tag == final_tag && tag == last_tag_ && memref_in.data.type != TRACE_TYPE_WRITE) {
+    if (tag == final_tag && tag == last_tag_ && memref_in.data.type != TRACE_TYPE_WRITE &&
+        !is_shared()) {
         // Make sure last_tag_ is properly in sync.
         caching_device_block_t *cache_block =
             &get_caching_device_block(last_block_idx_, last_way_);
@@ -203,6 +284,7 @@ caching_device_t::request(const memref_t &memref_in)
         if (tag + 1 <= final_tag)
             memref.data.size = ((tag + 1) << block_size_bits_) - memref.data.addr;
 
+        auto set_lock = lock_set(block_idx);
         auto block_way = find_caching_device_block(tag);
         if (block_way.first != nullptr) {
             // Access is a hit.
@@ -249,9 +331,8 @@ caching_device_t::request(const memref_t &memref_in)
                 record_access_stats(memref, false /*miss*/, cache_block);
             }
             // If no parent we assume we get the data from main memory.
-            if (parent_ != nullptr) {
+            if (parent_ != nullptr)
                 parent_->request(memref);
-            }
             if (is_exclusive()) {
                 continue;
             }
@@ -262,8 +343,15 @@ caching_device_t::request(const memref_t &memref_in)
 
         // Issue a hardware prefetch, if any, before we remember the last tag,
         // so we remember this line and not the prefetched line.
-        if (prefetcher_ != nullptr && !type_is_prefetch(memref_in.data.type))
-            prefetcher_->prefetch(this, memref, missed);
+        if (prefetcher_ != nullptr && !type_is_prefetch(memref_in.data.type)) {
+            if (is_shared()) {
+                // The prefetch requests other sets of ours.
+                set_lock.unlock();
+                std::lock_guard<std::mutex> prefetch_lock(prefetch_lock_);
+                prefetcher_->prefetch(this, memref, missed);
+            } else
+                prefetcher_->prefetch(this, memref, missed);
+        }
 
         if (tag + 1 <= final_tag) {
             addr_t next_addr = (tag + 1) << block_size_bits_;
@@ -272,9 +360,11 @@ caching_device_t::request(const memref_t &memref_in)
         }
 
         // Optimization: remember last tag
-        last_tag_ = tag;
-        last_way_ = way;
-        last_block_idx_ = block_idx;
+        if (!is_shared()) {
+            last_tag_ = tag;
+            last_way_ = way;
+            last_block_idx_ = block_idx;
+        }
     }
 }
 
@@ -295,9 +385,15 @@ caching_device_t::replace_which_way(int block_idx)
 int
 caching_device_t::get_next_way_to_replace(const int block_idx) const
 {
-    for (int way = 0; way < associativity_; ++way) {
-        if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID)
+    if (use_tag_array_) {
+        int way = find_way_in_set(block_idx, TAG_INVALID);
+        if (way >= 0)
             return way;
+    } else {
+        for (int way = 0; way < associativity_; ++way) {
+            if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID)
+                return way;
+        }
     }
     return replacement_policy_->get_next_way_to_replace(compute_set_index(block_idx));
 }
@@ -307,9 +403,12 @@ caching_device_t::invalidate(addr_t tag, invalidation_type_t invalidation_type)
 {
     auto block_way = find_caching_device_block(tag);
     if (block_way.first != nullptr) {
-        invalidate_caching_device_block(block_way.first);
-        loaded_blocks_--;
-        stats_->invalidate(invalidation_type);
+        invalidate_caching_device_block(compute_block_idx(tag), block_way.second);
+        {
+            auto stats_lock = lock_stats();
+            loaded_blocks_--;
+            stats_->invalidate(invalidation_type);
+        }
         // Invalidate last_tag_ if it was this tag.
         replacement_policy_->invalidation_update(
             compute_set_index(compute_block_idx(tag)), block_way.second);
@@ -447,14 +546,21 @@ void
 caching_device_t::record_access_stats(const memref_t &memref, bool hit,
                                       caching_device_block_t *cache_block)
 {
-    stats_->access(memref, hit, cache_block);
+    {
+        auto stats_lock = lock_stats();
+        stats_->access(memref, hit, cache_block);
+    }
     // We propagate hits all the way up the hierarchy.
     // But to avoid over-counting we only propagate misses one level up.
     if (hit) {
-        for (caching_device_t *up = parent_; up != nullptr; up = up->parent_)
+        for (caching_device_t *up = parent_; up != nullptr; up = up->parent_) {
+            auto stats_lock = up->lock_stats();
             up->stats_->child_access(memref, hit, cache_block);
-    } else if (parent_ != nullptr)
+        }
+    } else if (parent_ != nullptr) {
+        auto stats_lock = parent_->lock_stats();
         parent_->stats_->child_access(memref, hit, cache_block);
+    }
 }
 
 // Inserts a tag into the cache, updating the snoop filter and dealing with
@@ -470,6 +576,7 @@ caching_device_t::insert_tag(addr_t tag, bool is_write, int way, int block_idx)
     addr_t victim_tag = cache_block->tag_;
     if (victim_tag == TAG_INVALID) {
         // Lucky for us, nothing needs to be evicted.
+        auto stats_lock = lock_stats();
         loaded_blocks_++;
     } else {
         // Evict the victim tag.
@@ -524,13 +631,12 @@ caching_device_t::insert_tag(addr_t tag, bool is_write, int way, int block_idx)
                         notify_parent_for_snoop = parent_ != nullptr;
                     }
                 }
-                if (notify_parent_for_snoop || push_victim_to_parent) {
+                if (notify_parent_for_snoop || push_victim_to_parent)
                     parent_->propagate_eviction(victim_tag, this);
-                }
             }
         }
     }
-    update_tag(cache_block, way, tag);
+    update_tag(block_idx, way, tag);
 }
 
 } // namespace drmemtrace
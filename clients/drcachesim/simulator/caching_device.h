@@ -41,6 +41,7 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -60,8 +61,12 @@ namespace drmemtrace {
 // Different replacement policies are expected to be implemented by
 // subclassing caching_device_t.
 
-// We assume we're only invoked from a single thread of control and do
-// not need to synchronize data access.
+// We assume each device is only invoked from a single thread of control and
+// does not need to synchronize its own data access.  For parallel simulation,
+// devices shared among cores simulated on different threads are marked via
+// set_shared(), after which they lock each set (through a stripe of set locks)
+// and their statistics internally.  Locks are only ever acquired from a child
+// toward its parents, and a set lock is released before prefetching.
 
 class snoop_filter_t;
 class prefetcher_t;
@@ -154,6 +159,14 @@ public:
         }
         use_tag2block_table_ = use_hashtable;
     }
+    // Selects whether lookups scan the contiguous per-set tag array (the default)
+    // or walk each way's block.  Ignored when the hashtable is in use.
+    // Must be called prior to any call to request().
+    virtual inline void
+    set_tag_array_use(bool use_tag_array)
+    {
+        use_tag_array_ = use_tag_array;
+    }
     int
     get_block_index(const addr_t addr) const
     {
@@ -161,6 +174,19 @@ public:
         return compute_block_idx(tag);
     }
 
+    // Marks this device as shared among cores simulated by separate threads,
+    // guarding its sets with up to "max_set_locks" locks.  Shared devices must be
+    // non-inclusive non-exclusive and non-coherent, and any device with a shared
+    // child must itself be shared.
+    // Must be called after init() and prior to any call to request().
+    void
+    set_shared(int max_set_locks);
+    bool
+    is_shared() const
+    {
+        return !set_locks_.empty();
+    }
+
     // Accessors for cache parameters.
     virtual int
     get_associativity() const
@@ -253,23 +279,54 @@ protected:
         return *(blocks_[block_idx + way]);
     }
 
+    // All changes to a block's tag must go through these two routines to keep
+    // tags_ and tag2block in sync with the blocks.
     inline void
-    invalidate_caching_device_block(caching_device_block_t *block)
+    invalidate_caching_device_block(int block_idx, int way)
     {
+        caching_device_block_t *block = blocks_[block_idx + way];
         if (use_tag2block_table_)
             tag2block.erase(block->tag_);
         block->tag_ = TAG_INVALID;
+        tags_[block_idx + way] = TAG_INVALID;
     }
 
     inline void
-    update_tag(caching_device_block_t *block, int way, addr_t new_tag)
+    update_tag(int block_idx, int way, addr_t new_tag)
     {
+        caching_device_block_t *block = blocks_[block_idx + way];
         if (use_tag2block_table_) {
             if (block->tag_ != TAG_INVALID)
                 tag2block.erase(block->tag_);
             tag2block[new_tag] = std::make_pair(block, way);
         }
         block->tag_ = new_tag;
+        tags_[block_idx + way] = new_tag;
+    }
+
+    // Returns the first way of the set starting at block_idx whose tag equals
+    // `tag`, or -1 if there is none.
+    int
+    find_way_in_set(int block_idx, addr_t tag) const;
+
+    // Returns a lock holding the set starting at block_idx if this device is
+    // shared, or an empty lock otherwise.
+    inline std::unique_lock<std::mutex>
+    lock_set(int block_idx)
+    {
+        if (set_locks_.empty())
+            return std::unique_lock<std::mutex>();
+        return std::unique_lock<std::mutex>(
+            set_locks_[compute_set_index(block_idx) & set_lock_mask_]);
+    }
+    // Returns a lock holding stats_ if this device is shared, or an empty lock
+    // otherwise.
+    inline std::unique_lock<std::mutex>
+    lock_stats()
+    {
+        if (set_locks_.empty())
+            return std::unique_lock<std::mutex>();
+        return std::unique_lock<std::mutex>(stats_lock_);
     }
 
     // Returns the block (and its way) whose tag equals `tag`.
@@ -304,6 +361,12 @@ protected:
     // an extended block class which has its own member variables cannot be indexed
     // correctly by base class pointers.
     caching_device_block_t **blocks_;
+    // A copy of each block's tag, indexed like blocks_ so that the ways of a set
+    // are adjacent.  Scanning this avoids dereferencing a separately allocated
+    // block per way and lets a whole set be compared with a few vector
+    // instructions.
+    std::vector<addr_t> tags_;
+    bool use_tag_array_ = true;
     int64_t blocks_per_way_;
     // Optimization fields for fast bit operations
     int blocks_per_way_mask_;
@@ -328,6 +391,17 @@ protected:
         tag2block;
     bool use_tag2block_table_ = false;
 
+    // Non-empty if this device is shared among concurrently-simulated cores.
+    // The set with index i is guarded by set_locks_[i & set_lock_mask_].  The
+    // last_tag_ fast path is not used for shared devices.
+    std::vector<std::mutex> set_locks_;
+    int set_lock_mask_ = 0;
+    // Guards stats_ and loaded_blocks_ of a shared device.
+    std::mutex stats_lock_;
+    // Serializes calls into the prefetcher of a shared device, which may keep
+    // state across sets.
+    std::mutex prefetch_lock_;
+
     mutable std::unique_ptr<cache_replacement_policy_t> replacement_policy_;
 
     // Name for this cache.
@@ -62,6 +62,12 @@ public:
     invalidation_update(int set_idx, int way) override;
     std::string
     get_name() const override;
+    // The random generator is shared among all sets.
+    bool
+    has_cross_set_state() const override
+    {
+        return true;
+    }
 
     ~policy_bit_plru_t() override = default;
 
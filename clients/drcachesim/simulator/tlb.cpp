@@ -119,7 +119,7 @@ tlb_t::request(const memref_t &memref_in)
 
             // XXX: do we need to handle TLB coherency?
 
-            tlb_entry->tag_ = tag;
+            update_tag(block_idx, way, tag);
             ((tlb_entry_t *)tlb_entry)->pid_ = pid;
         }
 
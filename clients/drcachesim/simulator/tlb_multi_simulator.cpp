@@ -0,0 +1,407 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "tlb_multi_simulator.h"
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+#include "simulator.h"
+#include "tlb.h"
+#include "tlb_simulator.h"
+#include "tlb_simulator_create.h"
+#include "tlb_stats.h"
+#include "trace_entry.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+analysis_tool_t *
+tlb_multi_simulator_create(const std::vector<tlb_simulator_knobs_t> &configs,
+                           unsigned int num_threads)
+{
+    tlb_multi_simulator_t *sim = new tlb_multi_simulator_t(configs, num_threads);
+    if (configs.empty() || configs[0].v2p_file.empty())
+        return sim;
+
+    std::ifstream fin;
+    fin.open(configs[0].v2p_file);
+    if (!fin.is_open()) {
+        delete sim;
+        ERRMSG("Failed to open the v2p file '%s'\n", configs[0].v2p_file.c_str());
+        return nullptr;
+    }
+    std::string error_str = sim->create_v2p_from_file(fin);
+    fin.close();
+    if (!error_str.empty()) {
+        delete sim;
+        ERRMSG("ERROR: v2p_reader failed with: %s\n", error_str.c_str());
+        return nullptr;
+    }
+    return sim;
+}
+
+std::string
+parse_tlb_configs(const std::string &spec, const tlb_simulator_knobs_t &base,
+                  std::vector<tlb_simulator_knobs_t> &configs)
+{
+    configs.clear();
+    for (const std::string &config_spec : split_by(spec, ";")) {
+        if (config_spec.empty())
+            continue;
+        tlb_simulator_knobs_t knobs = base;
+        for (const std::string &knob : split_by(config_spec, ",")) {
+            size_t eq = knob.find('=');
+            if (eq == std::string::npos)
+                return "Invalid TLB configuration entry '" + knob + "': expected name=value";
+            std::string name = knob.substr(0, eq);
+            std::string value = knob.substr(eq + 1);
+            if (name == "TLB_replace_policy") {
+                knobs.TLB_replace_policy = value;
+                continue;
+            }
+            char *end;
+            uint64_t num = strtoull(value.c_str(), &end, 0);
+            if (end == value.c_str())
+                return "Invalid value for TLB configuration knob '" + name + "'";
+            if (name == "page_size" && *end != '\0') {
+                if (*end == 'K' || *end == 'k')
+                    num <<= 10;
+                else if (*end == 'M' || *end == 'm')
+                    num <<= 20;
+                else if (*end == 'G' || *end == 'g')
+                    num <<= 30;
+                else
+                    return "Invalid value for TLB configuration knob '" + name + "'";
+                ++end;
+            }
+            if (*end != '\0' || (name != "page_size" && num > UINT_MAX))
+                return "Invalid value for TLB configuration knob '" + name + "'";
+            unsigned int count = static_cast<unsigned int>(num);
+            if (name == "page_size")
+                knobs.page_size = num;
+            else if (name == "TLB_L1I_entries")
+                knobs.TLB_L1I_entries = count;
+            else if (name == "TLB_L1I_assoc")
+                knobs.TLB_L1I_assoc = count;
+            else if (name == "TLB_L1D_entries")
+                knobs.TLB_L1D_entries = count;
+            else if (name == "TLB_L1D_assoc")
+                knobs.TLB_L1D_assoc = count;
+            else if (name == "TLB_L2_entries")
+                knobs.TLB_L2_entries = count;
+            else if (name == "TLB_L2_assoc")
+                knobs.TLB_L2_assoc = count;
+            else
+                return "Unknown TLB configuration knob '" + name + "'";
+        }
+        configs.push_back(knobs);
+    }
+    if (configs.empty())
+        return "No TLB configurations found in '" + spec + "'";
+    return "";
+}
+
+tlb_multi_simulator_t::tlb_multi_simulator_t(
+    const std::vector<tlb_simulator_knobs_t> &configs, unsigned int num_threads)
+{
+    if (configs.empty()) {
+        error_string_ = "Usage error: no TLB configurations were specified";
+        success_ = false;
+        return;
+    }
+    knobs_ = configs[0];
+    init_knobs(knobs_.num_cores, knobs_.skip_refs, knobs_.warmup_refs,
+               knobs_.warmup_fraction, knobs_.sim_refs, knobs_.cpu_scheduling,
+               knobs_.use_physical, knobs_.verbose);
+    if (!success_)
+        return;
+    configs_.resize(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i) {
+        config_t &config = configs_[i];
+        config.knobs = configs[i];
+        // Only the TLB geometry may differ between configurations.
+        config.knobs.num_cores = knobs_.num_cores;
+        config.itlbs.resize(knobs_.num_cores, nullptr);
+        config.dtlbs.resize(knobs_.num_cores, nullptr);
+        config.lltlbs.resize(knobs_.num_cores, nullptr);
+        std::string error =
+            tlb_simulator_t::create_tlbs(config.knobs, config.itlbs.data(),
+                                         config.dtlbs.data(), config.lltlbs.data());
+        if (!error.empty()) {
+            error_string_ = "TLB configuration #" + std::to_string(i) + ": " + error;
+            success_ = false;
+            return;
+        }
+    }
+    batches_[0].reserve(BATCH_SIZE);
+    batches_[1].reserve(BATCH_SIZE);
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_workers_ = std::min(num_threads, static_cast<unsigned int>(configs_.size()));
+    for (unsigned int i = 0; i < num_workers_; ++i)
+        workers_.emplace_back(&tlb_multi_simulator_t::worker_loop, this, i);
+}
+
+tlb_multi_simulator_t::~tlb_multi_simulator_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exiting_ = true;
+    }
+    batch_ready_.notify_all();
+    for (std::thread &worker : workers_)
+        worker.join();
+    for (config_t &config : configs_) {
+        tlb_simulator_t::delete_tlbs(static_cast<unsigned int>(config.itlbs.size()),
+                                     config.itlbs.data(), config.dtlbs.data(),
+                                     config.lltlbs.data());
+    }
+}
+
+std::string
+tlb_multi_simulator_t::create_v2p_from_file(std::istream &v2p_file)
+{
+    // Unlike tlb_simulator_t, we keep each configuration's own page size for its
+    // TLBs: comparing page sizes is a primary use of this simulator.
+    if (!knobs_.use_physical)
+        return "";
+    return simulator_t::create_v2p_from_file(v2p_file);
+}
+
+void
+tlb_multi_simulator_t::worker_loop(unsigned int index)
+{
+    uint64_t seen = 0;
+    while (true) {
+        int batch_index;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            batch_ready_.wait(lock, [this, seen] { return exiting_ || generation_ != seen; });
+            if (exiting_)
+                return;
+            seen = generation_;
+            batch_index = ready_index_;
+        }
+        for (size_t i = index; i < configs_.size(); i += num_workers_)
+            simulate(configs_[i], batches_[batch_index]);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_workers_ == 0)
+                batch_done_.notify_one();
+        }
+    }
+}
+
+void
+tlb_multi_simulator_t::simulate(config_t &config, const std::vector<request_t> &batch)
+{
+    for (const request_t &request : batch) {
+        if (request.core < 0) {
+            for (size_t i = 0; i < config.itlbs.size(); i++) {
+                config.itlbs[i]->get_stats()->reset();
+                config.dtlbs[i]->get_stats()->reset();
+                config.lltlbs[i]->get_stats()->reset();
+            }
+        } else if (type_is_instr(request.memref.instr.type))
+            config.itlbs[request.core]->request(request.memref);
+        else
+            config.dtlbs[request.core]->request(request.memref);
+    }
+}
+
+void
+tlb_multi_simulator_t::dispatch_batch()
+{
+    if (batches_[fill_index_].empty())
+        return;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // The workers must be done with the other batch before we refill it.
+        batch_done_.wait(lock, [this] { return busy_workers_ == 0; });
+        ready_index_ = fill_index_;
+        busy_workers_ = num_workers_;
+        ++generation_;
+    }
+    batch_ready_.notify_all();
+    fill_index_ ^= 1;
+    batches_[fill_index_].clear();
+}
+
+void
+tlb_multi_simulator_t::drain()
+{
+    dispatch_batch();
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_done_.wait(lock, [this] { return busy_workers_ == 0; });
+}
+
+void
+tlb_multi_simulator_t::add_request(const memref_t &memref, int core)
+{
+    batches_[fill_index_].push_back({ memref, core });
+    if (batches_[fill_index_].size() >= BATCH_SIZE)
+        dispatch_batch();
+}
+
+bool
+tlb_multi_simulator_t::process_memref(const memref_t &memref)
+{
+    // This mirrors tlb_simulator_t::process_memref(), queueing the TLB requests
+    // rather than simulating them.
+    if (knobs_.skip_refs > 0) {
+        knobs_.skip_refs--;
+        return true;
+    }
+
+    // The references after warmup and simulated ones are dropped.
+    if (knobs_.warmup_refs == 0 && knobs_.sim_refs == 0)
+        return true;
+
+    if (!simulator_t::process_memref(memref))
+        return false;
+
+    if (memref.marker.type == TRACE_TYPE_MARKER)
+        return true;
+
+    int core_index;
+    if (memref.data.tid == last_thread_)
+        core_index = last_core_index_;
+    else {
+        core_index = core_for_thread(memref.data.tid);
+        last_thread_ = memref.data.tid;
+        last_core_index_ = core_index;
+    }
+
+    const memref_t *simref = &memref;
+    memref_t phys_memref;
+    if (knobs_.use_physical) {
+        phys_memref = memref2phys(memref);
+        simref = &phys_memref;
+    }
+
+    if (type_is_instr(simref->instr.type) || simref->data.type == TRACE_TYPE_READ ||
+        simref->data.type == TRACE_TYPE_WRITE)
+        add_request(*simref, core_index);
+    else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
+        handle_thread_exit(simref->exit.tid);
+        last_thread_ = 0;
+    } else if (type_is_prefetch(simref->data.type) ||
+               simref->flush.type == TRACE_TYPE_INSTR_FLUSH ||
+               simref->flush.type == TRACE_TYPE_DATA_FLUSH ||
+               simref->marker.type == TRACE_TYPE_MARKER ||
+               simref->marker.type == TRACE_TYPE_INSTR_NO_FETCH) {
+        // TLB simulator ignores prefetching, cache flushing, and markers
+    } else {
+        error_string_ = "Unhandled memref type " + std::to_string(simref->data.type);
+        return false;
+    }
+
+    if (knobs_.verbose >= 3) {
+        std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
+                  << " @" << (void *)simref->data.pc << " "
+                  << trace_type_names[simref->data.type] << " "
+                  << (void *)simref->data.addr << " x" << simref->data.size << std::endl;
+    }
+
+    if (knobs_.warmup_refs > 0) {
+        knobs_.warmup_refs--;
+        // Reset the stats of every configuration when warming up is completed.
+        if (knobs_.warmup_refs == 0)
+            add_request(memref_t(), -1);
+    } else {
+        knobs_.sim_refs--;
+    }
+    return true;
+}
+
+tlb_stats_t *
+tlb_multi_simulator_t::get_tlb_stats(size_t config, unsigned int core,
+                                     tlb_level_t level)
+{
+    if (config >= configs_.size() || core >= knobs_.num_cores)
+        return nullptr;
+    drain();
+    switch (level) {
+    case TLB_LEVEL_L1I:
+        return static_cast<tlb_stats_t *>(configs_[config].itlbs[core]->get_stats());
+    case TLB_LEVEL_L1D:
+        return static_cast<tlb_stats_t *>(configs_[config].dtlbs[core]->get_stats());
+    case TLB_LEVEL_LL:
+        return static_cast<tlb_stats_t *>(configs_[config].lltlbs[core]->get_stats());
+    }
+    return nullptr;
+}
+
+bool
+tlb_multi_simulator_t::print_results()
+{
+    drain();
+    std::cerr << "TLB simulation results for " << configs_.size()
+              << " configurations:\n";
+    for (size_t c = 0; c < configs_.size(); c++) {
+        const tlb_simulator_knobs_t &knobs = configs_[c].knobs;
+        std::cerr << "Configuration #" << c << ": page_size=" << knobs.page_size
+                  << " L1I=" << knobs.TLB_L1I_entries << "/" << knobs.TLB_L1I_assoc
+                  << " L1D=" << knobs.TLB_L1D_entries << "/" << knobs.TLB_L1D_assoc
+                  << " LL=" << knobs.TLB_L2_entries << "/" << knobs.TLB_L2_assoc
+                  << " " << knobs.TLB_replace_policy << "\n";
+        for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+            if (print_core(i)) {
+                std::cerr << "  L1I stats:" << std::endl;
+                configs_[c].itlbs[i]->get_stats()->print_stats("    ");
+                std::cerr << "  L1D stats:" << std::endl;
+                configs_[c].dtlbs[i]->get_stats()->print_stats("    ");
+                std::cerr << "  LL stats:" << std::endl;
+                configs_[c].lltlbs[i]->get_stats()->print_stats("    ");
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
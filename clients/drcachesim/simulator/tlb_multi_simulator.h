@@ -0,0 +1,150 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* tlb_multi_simulator: simulates several TLB configurations in one pass.
+ */
+
+#ifndef _TLB_MULTI_SIMULATOR_H_
+#define _TLB_MULTI_SIMULATOR_H_ 1
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memref.h"
+#include "simulator.h"
+#include "tlb.h"
+#include "tlb_simulator_create.h"
+#include "tlb_stats.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Parses a -TLB_configs value into "configs": configurations separated by ';',
+// each a ','-separated list of name=value overrides of the TLB knobs in "base"
+// (page_size, TLB_L1I_entries, TLB_L1I_assoc, TLB_L1D_entries, TLB_L1D_assoc,
+// TLB_L2_entries, TLB_L2_assoc, and TLB_replace_policy).  page_size takes an
+// optional K, M, or G suffix.  Returns an error message on failure.
+std::string
+parse_tlb_configs(const std::string &spec, const tlb_simulator_knobs_t &base,
+                  std::vector<tlb_simulator_knobs_t> &configs);
+
+// The record-level work shared by all configurations (skipping, warmup and
+// sim_refs accounting, thread-to-core scheduling, and physical translation)
+// is done once on the analysis thread, which appends the resulting TLB
+// requests to a batch.  Full batches are handed to worker threads that each
+// own a subset of the configurations and replay the batch into them, while
+// the analysis thread fills a second batch.
+class tlb_multi_simulator_t : public simulator_t {
+public:
+    enum tlb_level_t {
+        TLB_LEVEL_L1I,
+        TLB_LEVEL_L1D,
+        TLB_LEVEL_LL,
+    };
+
+    tlb_multi_simulator_t(const std::vector<tlb_simulator_knobs_t> &configs,
+                          unsigned int num_threads);
+    virtual ~tlb_multi_simulator_t();
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    std::string
+    create_v2p_from_file(std::istream &v2p_file) override;
+
+    size_t
+    get_config_count() const
+    {
+        return configs_.size();
+    }
+    // Returns the stats of one TLB of one configuration, first waiting for the
+    // workers to simulate every request passed so far.
+    tlb_stats_t *
+    get_tlb_stats(size_t config, unsigned int core, tlb_level_t level);
+
+protected:
+    // A TLB request, or a stats reset at the end of warmup if core is negative.
+    struct request_t {
+        memref_t memref;
+        int core;
+    };
+    // The private TLBs of every core for one configuration.
+    struct config_t {
+        tlb_simulator_knobs_t knobs;
+        std::vector<tlb_t *> itlbs;
+        std::vector<tlb_t *> dtlbs;
+        std::vector<tlb_t *> lltlbs;
+    };
+
+    void
+    add_request(const memref_t &memref, int core);
+    void
+    simulate(config_t &config, const std::vector<request_t> &batch);
+    // Hands the batch being filled to the workers.
+    void
+    dispatch_batch();
+    // Dispatches any partial batch and waits until the workers are idle.
+    void
+    drain();
+    void
+    worker_loop(unsigned int index);
+
+    static const size_t BATCH_SIZE = 64 * 1024;
+
+    // The shared knobs, from the first configuration.
+    tlb_simulator_knobs_t knobs_;
+    std::vector<config_t> configs_;
+
+    std::vector<request_t> batches_[2];
+    int fill_index_ = 0;
+    unsigned int num_workers_ = 0;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable batch_ready_;
+    std::condition_variable batch_done_;
+    // Protected by mutex_.
+    uint64_t generation_ = 0;
+    int ready_index_ = 0;
+    unsigned int busy_workers_ = 0;
+    bool exiting_ = false;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _TLB_MULTI_SIMULATOR_H_ */
@@ -94,72 +94,81 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
         dtlbs_[i] = NULL;
         lltlbs_[i] = NULL;
     }
-    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+    error_string_ = create_tlbs(knobs_, itlbs_, dtlbs_, lltlbs_);
+    if (!error_string_.empty())
+        success_ = false;
+}
+
+tlb_simulator_t::~tlb_simulator_t()
+{
+    delete_tlbs(knobs_.num_cores, itlbs_, dtlbs_, lltlbs_);
+    delete[] itlbs_;
+    delete[] dtlbs_;
+    delete[] lltlbs_;
+}
+
+std::string
+tlb_simulator_t::create_tlbs(const tlb_simulator_knobs_t &knobs, tlb_t **itlbs,
+                             tlb_t **dtlbs, tlb_t **lltlbs)
+{
+    for (unsigned int i = 0; i < knobs.num_cores; i++) {
         std::string core_str = std::to_string(i);
-        itlbs_[i] = new tlb_t("itlb " + core_str);
-        dtlbs_[i] = new tlb_t("dtlb " + core_str);
-        lltlbs_[i] = new tlb_t("lltlb " + core_str);
+        itlbs[i] = new tlb_t("itlb " + core_str);
+        dtlbs[i] = new tlb_t("dtlb " + core_str);
+        lltlbs[i] = new tlb_t("lltlb " + core_str);
         auto replace_policy = create_cache_replacement_policy(
-            knobs_.TLB_replace_policy, knobs_.TLB_L1I_entries / knobs_.TLB_L1I_assoc,
-            knobs_.TLB_L1I_assoc);
-        if (!itlbs_[i]->init(knobs_.TLB_L1I_assoc, (int)knobs_.page_size,
-                             knobs_.TLB_L1I_entries, lltlbs_[i],
-                             new tlb_stats_t((int)knobs_.page_size),
-                             std::move(replace_policy))) {
-            error_string_ =
-                "Usage error: failed to initialize itlbs_. Ensure (entry number / "
-                "associativity) is a power of 2.";
-            success_ = false;
-            return;
+            knobs.TLB_replace_policy, knobs.TLB_L1I_entries / knobs.TLB_L1I_assoc,
+            knobs.TLB_L1I_assoc);
+        if (!itlbs[i]->init(knobs.TLB_L1I_assoc, (int)knobs.page_size,
+                            knobs.TLB_L1I_entries, lltlbs[i],
+                            new tlb_stats_t((int)knobs.page_size),
+                            std::move(replace_policy))) {
+            return "Usage error: failed to initialize itlbs_. Ensure (entry number / "
+                   "associativity) is a power of 2.";
         }
         replace_policy = create_cache_replacement_policy(
-            knobs_.TLB_replace_policy, knobs_.TLB_L1D_entries / knobs_.TLB_L1D_assoc,
-            knobs_.TLB_L1D_assoc);
-        if (!dtlbs_[i]->init(knobs_.TLB_L1D_assoc, (int)knobs_.page_size,
-                             knobs_.TLB_L1D_entries, lltlbs_[i],
-                             new tlb_stats_t((int)knobs_.page_size),
-                             std::move(replace_policy))) {
-            error_string_ =
-                "Usage error: failed to initialize dtlbs_. Ensure (entry number / "
-                "associativity) is a power of 2.";
-            success_ = false;
-            return;
+            knobs.TLB_replace_policy, knobs.TLB_L1D_entries / knobs.TLB_L1D_assoc,
+            knobs.TLB_L1D_assoc);
+        if (!dtlbs[i]->init(knobs.TLB_L1D_assoc, (int)knobs.page_size,
+                            knobs.TLB_L1D_entries, lltlbs[i],
+                            new tlb_stats_t((int)knobs.page_size),
+                            std::move(replace_policy))) {
+            return "Usage error: failed to initialize dtlbs_. Ensure (entry number / "
+                   "associativity) is a power of 2.";
         }
         replace_policy = create_cache_replacement_policy(
-            knobs_.TLB_replace_policy, knobs_.TLB_L2_entries / knobs_.TLB_L2_assoc,
-            knobs_.TLB_L2_assoc);
-        if (!lltlbs_[i]->init(
-                knobs_.TLB_L2_assoc, (int)knobs_.page_size, knobs_.TLB_L2_entries, NULL,
-                new tlb_stats_t((int)knobs_.page_size), std::move(replace_policy))) {
-            error_string_ =
-                "Usage error: failed to initialize lltlbs_. Ensure (entry number / "
-                "associativity) is a power of 2.";
-            success_ = false;
-            return;
+            knobs.TLB_replace_policy, knobs.TLB_L2_entries / knobs.TLB_L2_assoc,
+            knobs.TLB_L2_assoc);
+        if (!lltlbs[i]->init(knobs.TLB_L2_assoc, (int)knobs.page_size,
+                             knobs.TLB_L2_entries, NULL,
+                             new tlb_stats_t((int)knobs.page_size),
+                             std::move(replace_policy))) {
+            return "Usage error: failed to initialize lltlbs_. Ensure (entry number / "
+                   "associativity) is a power of 2.";
         }
     }
+    return "";
 }
 
-tlb_simulator_t::~tlb_simulator_t()
+void
+tlb_simulator_t::delete_tlbs(unsigned int num_cores, tlb_t **itlbs, tlb_t **dtlbs,
+                             tlb_t **lltlbs)
 {
-    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+    for (unsigned int i = 0; i < num_cores; i++) {
         // Try to handle failure during construction.
-        if (itlbs_[i] != NULL) {
-            delete itlbs_[i]->get_stats();
-            delete itlbs_[i];
+        if (itlbs[i] != NULL) {
+            delete itlbs[i]->get_stats();
+            delete itlbs[i];
         }
-        if (dtlbs_[i] != NULL) {
-            delete dtlbs_[i]->get_stats();
-            delete dtlbs_[i];
+        if (dtlbs[i] != NULL) {
+            delete dtlbs[i]->get_stats();
+            delete dtlbs[i];
         }
-        if (lltlbs_[i] != NULL) {
-            delete lltlbs_[i]->get_stats();
-            delete lltlbs_[i];
+        if (lltlbs[i] != NULL) {
+            delete lltlbs[i]->get_stats();
+            delete lltlbs[i];
         }
     }
-    delete[] itlbs_;
-    delete[] dtlbs_;
-    delete[] lltlbs_;
 }
 
 std::string
@@ -60,6 +60,16 @@ public:
     std::string
     create_v2p_from_file(std::istream &v2p_file) override;
 
+    // Creates the private TLBs of each of knobs.num_cores cores into the
+    // caller-allocated arrays, which must start out null.  Returns an error
+    // message on failure, when some entries may already be filled in.
+    static std::string
+    create_tlbs(const tlb_simulator_knobs_t &knobs, tlb_t **itlbs, tlb_t **dtlbs,
+                tlb_t **lltlbs);
+    // Frees the non-null TLBs created by create_tlbs(), along with their stats.
+    static void
+    delete_tlbs(unsigned int num_cores, tlb_t **itlbs, tlb_t **dtlbs, tlb_t **lltlbs);
+
 protected:
     tlb_simulator_knobs_t knobs_;
 
@@ -36,6 +36,7 @@
 #define _TLB_SIMULATOR_CREATE_H_ 1
 
 #include <string>
+#include <vector>
 #include "analysis_tool.h"
 
 namespace dynamorio {
@@ -95,6 +96,19 @@ struct tlb_simulator_knobs_t {
 analysis_tool_t *
 tlb_simulator_create(const tlb_simulator_knobs_t &knobs);
 
+/**
+ * Creates an instance of a TLB simulator which simulates each of the TLB
+ * hierarchies described by \p configs in a single pass over the trace and
+ * reports the statistics of each.  The configurations are spread across
+ * \p num_threads worker threads, or one per configuration up to the number of
+ * hardware threads if \p num_threads is 0.  Only the page size, TLB entry
+ * counts and associativities, and replacement policy are taken from each
+ * configuration; all other knobs are taken from the first one.
+ */
+analysis_tool_t *
+tlb_multi_simulator_create(const std::vector<tlb_simulator_knobs_t> &configs,
+                           unsigned int num_threads = 0);
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
@@ -35,9 +35,13 @@
 #include "test_helpers.h"
 #include <assert.h>
 
+#include <algorithm>
 #include <atomic>
 #include <iostream>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "analyzer.h"
@@ -57,12 +61,14 @@ class mock_analyzer_t : public analyzer_t {
 public:
     mock_analyzer_t(std::vector<scheduler_t::input_workload_t> &sched_inputs,
                     analysis_tool_t **tools, int num_tools, bool parallel,
-                    int worker_count, scheduler_t::scheduler_options_t *sched_ops_in)
+                    int worker_count, scheduler_t::scheduler_options_t *sched_ops_in,
+                    bool serial_pipeline = false)
         : analyzer_t()
     {
         num_tools_ = num_tools;
         tools_ = tools;
         parallel_ = parallel;
+        serial_pipeline_ = serial_pipeline;
         verbosity_ = 1;
         worker_count_ = worker_count;
         scheduler_t::scheduler_options_t sched_ops;
@@ -490,10 +496,269 @@ test_tool_errors()
     return true;
 }
 
+bool
+test_serial_pipeline()
+{
+    std::cerr << "\n----------------\nTesting serial pipeline\n";
+    static constexpr int NUM_INPUTS = 3;
+    // Enough records to span several of the pipeline's batches.
+    static constexpr int NUM_INSTRS = 5000;
+    static constexpr int INSTRS_PER_TIMESTAMP = 700;
+    static constexpr memref_tid_t TID_BASE = 100;
+    static constexpr int ERROR_INSTR_ORDINAL = 9000;
+
+    // Records the stream state seen with each record, and optionally fails
+    // partway through.
+    class query_tool_t : public analysis_tool_t {
+    public:
+        explicit query_tool_t(bool fail)
+            : fail_(fail)
+        {
+        }
+        std::string
+        initialize_stream(memtrace_stream_t *serial_stream) override
+        {
+            stream_ = serial_stream;
+            return "";
+        }
+        bool
+        process_memref(const memref_t &memref) override
+        {
+            memtrace_stream_t *input = stream_->get_input_interface();
+            assert(input != nullptr);
+            seen.push_back({ memref.instr.tid, stream_->get_tid(),
+                             static_cast<int64_t>(stream_->get_record_ordinal()),
+                             static_cast<int64_t>(stream_->get_instruction_ordinal()),
+                             static_cast<int64_t>(stream_->get_last_timestamp()),
+                             static_cast<int64_t>(input->get_instruction_ordinal()),
+                             stream_->get_shard_index() });
+            if (fail_ && stream_->get_instruction_ordinal() == ERROR_INSTR_ORDINAL) {
+                error_string_ = "expected failure";
+                return false;
+            }
+            return true;
+        }
+        bool
+        print_results() override
+        {
+            return true;
+        }
+        std::vector<std::vector<int64_t>> seen;
+
+    private:
+        memtrace_stream_t *stream_ = nullptr;
+        bool fail_;
+    };
+
+    auto run = [&](bool pipeline, bool fail, std::vector<std::vector<int64_t>> &seen,
+                   std::string &error) {
+        std::vector<scheduler_t::input_workload_t> sched_inputs;
+        for (int i = 0; i < NUM_INPUTS; i++) {
+            memref_tid_t tid = TID_BASE + i;
+            std::vector<trace_entry_t> input;
+            input.push_back(test_util::make_thread(tid));
+            input.push_back(test_util::make_pid(1));
+            for (int j = 0; j < NUM_INSTRS; j++) {
+                // Staggered timestamps make the serial schedule interleave the inputs.
+                if (j % INSTRS_PER_TIMESTAMP == 0) {
+                    input.push_back(
+                        test_util::make_timestamp(1 + j * NUM_INPUTS * 10 + i * 10));
+                }
+                input.push_back(test_util::make_instr(42 + j * 4));
+            }
+            input.push_back(test_util::make_exit(tid));
+            std::vector<scheduler_t::input_reader_t> readers;
+            readers.emplace_back(
+                std::unique_ptr<test_util::mock_reader_t>(
+                    new test_util::mock_reader_t(input)),
+                std::unique_ptr<test_util::mock_reader_t>(new test_util::mock_reader_t()),
+                tid);
+            sched_inputs.emplace_back(std::move(readers));
+        }
+        query_tool_t tool(fail);
+        std::vector<analysis_tool_t *> tools = { &tool };
+        mock_analyzer_t analyzer(sched_inputs, &tools[0], (int)tools.size(),
+                                 /*parallel=*/false, /*worker_count=*/1,
+                                 /*sched_ops_in=*/nullptr, pipeline);
+        assert(!!analyzer);
+        bool res = analyzer.run();
+        error = analyzer.get_error_string();
+        seen = std::move(tool.seen);
+        return res;
+    };
+
+    std::vector<std::vector<int64_t>> expect, actual;
+    std::string error;
+    if (!run(/*pipeline=*/false, /*fail=*/false, expect, error))
+        return false;
+    if (!run(/*pipeline=*/true, /*fail=*/false, actual, error))
+        return false;
+    assert(expect.size() > NUM_INPUTS * NUM_INSTRS);
+    if (actual != expect) {
+        std::cerr << "Pipelined records or stream state differ\n";
+        return false;
+    }
+    // A tool error must stop the reading thread rather than hang.
+    if (run(/*pipeline=*/true, /*fail=*/true, actual, error) ||
+        error != "expected failure")
+        return false;
+    assert(actual.size() < expect.size() &&
+           std::equal(actual.begin(), actual.end(), expect.begin()));
+    return true;
+}
+
+bool
+test_memref_batches()
+{
+    std::cerr << "\n----------------\nTesting memref batches\n";
+    static constexpr int NUM_INPUTS = 5;
+    static constexpr int NUM_WORKERS = 2;
+    static constexpr int NUM_INSTRS = 1000;
+    static constexpr int INTERVAL_INSTRS = 300;
+    static constexpr memref_tid_t TID_BASE = 100;
+
+    // Records the sequence of records of each shard and how many had been seen at
+    // each interval end, either one at a time or in spans.
+    class sequence_tool_t : public analysis_tool_t {
+    public:
+        explicit sequence_tool_t(bool batched)
+            : batched_(batched)
+        {
+        }
+        bool
+        process_memref(const memref_t &memref) override
+        {
+            assert(false); // Only expect parallel mode.
+            return false;
+        }
+        bool
+        print_results() override
+        {
+            return true;
+        }
+        bool
+        parallel_shard_supported() override
+        {
+            return true;
+        }
+        void *
+        parallel_shard_init_stream(int shard_index, void *worker_data,
+                                   memtrace_stream_t *stream) override
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            return &shards[shard_index];
+        }
+        bool
+        parallel_shard_memref(void *shard_data, const memref_t &memref) override
+        {
+            per_shard_t *shard = reinterpret_cast<per_shard_t *>(shard_data);
+            assert(!shard->exited);
+            shard->records.push_back(memref.instr.type);
+            shard->records.push_back(memref.instr.addr);
+            return true;
+        }
+        bool
+        parallel_shard_memrefs_supported() override
+        {
+            return batched_;
+        }
+        bool
+        parallel_shard_memrefs(void *shard_data, const memref_t *memrefs,
+                               size_t count) override
+        {
+            assert(batched_ && count > 0);
+            per_shard_t *shard = reinterpret_cast<per_shard_t *>(shard_data);
+            shard->max_span = std::max(shard->max_span, count);
+            return analysis_tool_t::parallel_shard_memrefs(shard_data, memrefs, count);
+        }
+        interval_state_snapshot_t *
+        generate_shard_interval_snapshot(void *shard_data, uint64_t interval_id) override
+        {
+            per_shard_t *shard = reinterpret_cast<per_shard_t *>(shard_data);
+            shard->interval_ends.push_back(shard->records.size());
+            return nullptr;
+        }
+        bool
+        parallel_shard_exit(void *shard_data) override
+        {
+            reinterpret_cast<per_shard_t *>(shard_data)->exited = true;
+            return true;
+        }
+        struct per_shard_t {
+            std::vector<addr_t> records;
+            std::vector<size_t> interval_ends;
+            size_t max_span = 0;
+            bool exited = false;
+        };
+        std::unordered_map<int, per_shard_t> shards;
+
+    private:
+        bool batched_;
+        std::mutex mutex_;
+    };
+
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        memref_tid_t tid = TID_BASE + i;
+        std::vector<trace_entry_t> input;
+        input.push_back(test_util::make_thread(tid));
+        input.push_back(test_util::make_pid(1));
+        for (int j = 0; j < NUM_INSTRS; j++) {
+            if (j % 100 == 0)
+                input.push_back(test_util::make_timestamp(1 + j));
+            input.push_back(test_util::make_instr(42 + j * 4));
+            if (j % 3 == 0)
+                input.push_back(test_util::make_memref(1024 + j, TRACE_TYPE_READ));
+        }
+        input.push_back(test_util::make_exit(tid));
+        std::vector<scheduler_t::input_reader_t> readers;
+        readers.emplace_back(
+            std::unique_ptr<test_util::mock_reader_t>(
+                new test_util::mock_reader_t(input)),
+            std::unique_ptr<test_util::mock_reader_t>(new test_util::mock_reader_t()),
+            tid);
+        sched_inputs.emplace_back(std::move(readers));
+    }
+    class interval_analyzer_t : public mock_analyzer_t {
+    public:
+        interval_analyzer_t(std::vector<scheduler_t::input_workload_t> &sched_inputs,
+                            analysis_tool_t **tools, int num_tools)
+            : mock_analyzer_t(sched_inputs, tools, num_tools, /*parallel=*/true,
+                              NUM_WORKERS, /*sched_ops_in=*/nullptr)
+        {
+            interval_instr_count_ = INTERVAL_INSTRS;
+        }
+    };
+    // Both delivery paths run side by side and must observe the same records and
+    // interval boundaries.
+    sequence_tool_t single(/*batched=*/false), batched(/*batched=*/true);
+    std::vector<analysis_tool_t *> tools = { &single, &batched };
+    interval_analyzer_t analyzer(sched_inputs, &tools[0], (int)tools.size());
+    assert(!!analyzer);
+    if (!analyzer.run())
+        return false;
+    assert(single.shards.size() == NUM_INPUTS);
+    for (auto &keyval : single.shards) {
+        const auto &expect = keyval.second;
+        const auto &actual = batched.shards[keyval.first];
+        assert(expect.exited && actual.exited);
+        assert(expect.interval_ends.size() == NUM_INSTRS / INTERVAL_INSTRS + 1);
+        assert(actual.max_span > 1);
+        if (actual.records != expect.records ||
+            actual.interval_ends != expect.interval_ends) {
+            std::cerr << "Batched records or intervals differ for shard "
+                      << keyval.first << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
-    if (!test_queries() || !test_wait_records() || !test_tool_errors())
+    if (!test_queries() || !test_wait_records() || !test_tool_errors() ||
+        !test_serial_pipeline() || !test_memref_batches())
         return 1;
     std::cerr << "All done!\n";
     return 0;
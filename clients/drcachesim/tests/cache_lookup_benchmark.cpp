@@ -0,0 +1,159 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+// Microbenchmark comparing caching_device_t set lookups through the contiguous
+// per-set tag array against walking each way's separately allocated block.
+// Both modes must produce identical results.  The default iteration count
+// is small enough to serve as a regression test; pass a larger count as the
+// first argument for meaningful timings, ideally from a release build with
+// the target's vector extensions enabled (e.g., -mavx2).
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "memref.h"
+#include "trace_entry.h"
+#include "simulator/cache.h"
+#include "simulator/cache_stats.h"
+#include "simulator/caching_device_stats.h"
+#include "simulator/policy_lru.h"
+#include "test_helpers.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+constexpr int LINE_SIZE = 64;
+// Large enough for the blocks to not fit in the host's caches, as with a
+// simulated LLC of tens of megabytes.
+constexpr int NUM_SETS = 32768;
+
+// Exposes the protected lookup.
+class lookup_cache_t : public cache_t {
+public:
+    bool
+    lookup(addr_t addr)
+    {
+        return find_caching_device_block(compute_tag(addr)).first != nullptr;
+    }
+};
+
+std::vector<memref_t>
+make_refs(int associativity, int count)
+{
+    // A working set of twice the cache capacity, with a hot quarter that is
+    // accessed as often as the rest so we see a mix of hits and misses that
+    // require a full set scan.
+    const addr_t lines = static_cast<addr_t>(2) * associativity * NUM_SETS;
+    std::mt19937_64 rng(associativity);
+    std::uniform_int_distribution<addr_t> all_lines(0, lines - 1);
+    std::uniform_int_distribution<addr_t> hot_lines(0, lines / 4 - 1);
+    std::vector<memref_t> refs(count);
+    for (int i = 0; i < count; ++i) {
+        memref_t &ref = refs[i];
+        ref = {};
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.size = 8;
+        ref.data.addr = ((i % 2 == 0) ? hot_lines(rng) : all_lines(rng)) * LINE_SIZE;
+    }
+    return refs;
+}
+
+// Fills the cache by simulating "refs" and then times looking up each of "refs"
+// again.  Returns the elapsed seconds for the lookups and fills in the
+// request statistics and the number of lookups that found their tag.
+double
+run_lookups(int associativity, bool use_tag_array, const std::vector<memref_t> &refs,
+            int64_t &hits, int64_t &misses, int64_t &found)
+{
+    lookup_cache_t cache;
+    cache_stats_t *stats = new cache_stats_t(LINE_SIZE, "", false);
+    bool ok = cache.init(associativity, LINE_SIZE,
+                         static_cast<int64_t>(associativity) * NUM_SETS * LINE_SIZE,
+                         nullptr, stats,
+                         std::unique_ptr<policy_lru_t>(
+                             new policy_lru_t(NUM_SETS, associativity)));
+    assert(ok);
+    cache.set_tag_array_use(use_tag_array);
+    for (const memref_t &ref : refs)
+        cache.request(ref);
+    hits = stats->get_metric(metric_name_t::HITS);
+    misses = stats->get_metric(metric_name_t::MISSES);
+    found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const memref_t &ref : refs) {
+        if (cache.lookup(ref.data.addr))
+            ++found;
+    }
+    auto end = std::chrono::steady_clock::now();
+    delete stats;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    int count = 200000;
+    if (argc > 1)
+        count = atoi(argv[1]);
+    for (int associativity : { 8, 16, 20 }) {
+        std::vector<memref_t> refs = make_refs(associativity, count);
+        int64_t block_hits, block_misses, block_found;
+        int64_t array_hits, array_misses, array_found;
+        double block_secs = run_lookups(associativity, false, refs, block_hits,
+                                        block_misses, block_found);
+        double array_secs = run_lookups(associativity, true, refs, array_hits,
+                                        array_misses, array_found);
+        assert(block_hits == array_hits && block_misses == array_misses &&
+               block_found == array_found);
+        assert(block_hits > 0 && block_misses > 0 && block_found > 0);
+        std::cerr << associativity << "-way: " << count << " lookups ("
+                  << array_found << " found); per-block walk " << block_secs
+                  << "s, tag array " << array_secs << "s, speedup "
+                  << (array_secs > 0 ? block_secs / array_secs : 0) << "x\n";
+    }
+    std::cerr << "all done\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
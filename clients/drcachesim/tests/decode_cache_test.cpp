@@ -336,6 +336,130 @@ check_decode_caching(void *drcontext, bool use_module_mapper, bool include_decod
     return "";
 }
 
+std::string
+check_shared_decode_caching(void *drcontext)
+{
+    static constexpr addr_t BASE_ADDR = 0x123450;
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *ret = XINST_CREATE_return(drcontext);
+    instr_t *interrupt = XINST_CREATE_interrupt(drcontext, OPND_CREATE_INT8(10));
+    instr_t *jump = XINST_CREATE_jump(drcontext, opnd_create_instr(nop));
+    instrlist_t *ilist = instrlist_create(drcontext);
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, ret);
+    instrlist_append(ilist, interrupt);
+    instrlist_append(ilist, jump);
+    std::vector<memref_with_IR_t> memref_setup = {
+        { gen_instr(TID_A), nop },
+        { gen_instr(TID_A), ret },
+        { gen_instr(TID_A), interrupt },
+        { gen_instr(TID_A), jump },
+    };
+    std::vector<memref_t> memrefs =
+        add_encodings_to_memrefs(ilist, memref_setup, BASE_ADDR);
+    test_decode_info_t::expect_decoded_instr_ = true;
+
+    auto shared_cache = std::make_shared<shared_decode_cache_t<test_decode_info_t>>();
+    decode_cache_t<test_decode_info_t> cache_a(drcontext,
+                                               /*include_decoded_instr=*/true,
+                                               /*persist_decoded_instr=*/false);
+    decode_cache_t<test_decode_info_t> cache_b(drcontext,
+                                               /*include_decoded_instr=*/true,
+                                               /*persist_decoded_instr=*/false);
+    std::string err = cache_a.set_shared_cache(shared_cache);
+    if (!err.empty())
+        return err;
+    err = cache_b.set_shared_cache(shared_cache);
+    if (!err.empty())
+        return err;
+    err = cache_a.init(ENCODING_FILE_TYPE);
+    if (!err.empty())
+        return err;
+    err = cache_b.init(ENCODING_FILE_TYPE);
+    if (!err.empty())
+        return err;
+    if (cache_a.set_shared_cache(shared_cache).empty())
+        return "Expected error for set_shared_cache() after init()";
+
+    // Test: The second cache finds the decode info added by the first one.
+    test_decode_info_t *info_a;
+    test_decode_info_t *info_b;
+    err = cache_a.add_decode_info(memrefs[0].instr, info_a);
+    if (!err.empty())
+        return err;
+    err = cache_b.add_decode_info(memrefs[0].instr, info_b);
+    if (!err.empty())
+        return err;
+    if (info_a == nullptr || info_a != info_b || !info_b->is_nop_ ||
+        cache_b.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) !=
+            info_a) {
+        return "Expected both caches to return the same shared nop decode info";
+    }
+    shared_decode_cache_stats_t stats = shared_cache->get_stats();
+    if (stats.lookups != 2 || stats.hits != 1 || stats.decodes != 1 ||
+        stats.entries != 1)
+        return "Unexpected shared cache stats after shared nop lookup";
+
+    // Test: A repeated instruction is served by the per-cache map.
+    memrefs[0].instr.encoding_is_new = false;
+    err = cache_a.add_decode_info(memrefs[0].instr, info_a);
+    if (!err.empty())
+        return err;
+    if (info_a != info_b || shared_cache->get_stats().lookups != 2)
+        return "Expected repeated nop to be found without a shared lookup";
+
+    // Test: A new encoding at the same pc gets its own shared decode info, while
+    // the other cache keeps the old one.
+    err = cache_b.add_decode_info(memrefs[1].instr, info_b);
+    if (!err.empty())
+        return err;
+    test_decode_info_t *ret_info = info_b;
+    memrefs[2].instr.addr = memrefs[1].instr.addr;
+    err = cache_a.add_decode_info(memrefs[2].instr, info_a);
+    if (!err.empty())
+        return err;
+    if (info_a == ret_info || !info_a->is_interrupt_ || !ret_info->is_ret_ ||
+        cache_b.get_decode_info(reinterpret_cast<app_pc>(memrefs[1].instr.addr)) !=
+            ret_info) {
+        return "Expected distinct shared decode info for a new encoding at a pc";
+    }
+    err = cache_b.add_decode_info(memrefs[2].instr, info_b);
+    if (!err.empty())
+        return err;
+    if (info_b != info_a)
+        return "Expected the new encoding to be shared too";
+
+    // Test: Errors are shared without decoding again.
+    err = cache_a.add_decode_info(memrefs[3].instr, info_a);
+    if (err != FAKE_ERROR)
+        return "Expected error for jump";
+    err = cache_b.add_decode_info(memrefs[3].instr, info_b);
+    if (err != FAKE_ERROR || info_b != info_a || info_b->is_valid())
+        return "Expected shared decode info with error for jump";
+    stats = shared_cache->get_stats();
+    if (stats.lookups != 7 || stats.hits != 3 || stats.decodes != 4 ||
+        stats.duplicate_decodes != 0 || stats.entries != 4)
+        return "Unexpected shared cache stats";
+
+    // Test: Clearing one cache does not affect the other or the shared entries.
+    cache_a.clear_cache();
+    if (cache_a.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) !=
+            nullptr ||
+        cache_b.get_decode_info(reinterpret_cast<app_pc>(memrefs[0].instr.addr)) ==
+            nullptr) {
+        return "Unexpected decode info after clear_cache() on one shared user";
+    }
+    err = cache_a.add_decode_info(memrefs[0].instr, info_a);
+    if (!err.empty())
+        return err;
+    if (!info_a->is_nop_ || shared_cache->get_stats().hits != 4)
+        return "Expected nop decode info from the shared cache after clear_cache()";
+
+    instrlist_clear_and_destroy(drcontext, ilist);
+    std::cerr << "check_shared_decode_caching passed\n";
+    return "";
+}
+
 std::string
 check_init_error_cases(void *drcontext)
 {
@@ -491,6 +615,11 @@ test_main(int argc, const char *argv[])
         exit(1);
     }
 #endif
+    err = check_shared_decode_caching(drcontext);
+    if (!err.empty()) {
+        std::cerr << err << "\n";
+        exit(1);
+    }
     err = check_init_error_cases(drcontext);
     if (!err.empty()) {
         std::cerr << err << "\n";
@@ -34,8 +34,11 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <functional>
 #include <random>
 #include <regex>
+#include <thread>
+#include <vector>
 
 #include <assert.h>
 #include "config_reader_unit_test.h"
@@ -44,6 +47,7 @@
 #include "cache_replacement_policy_unit_test.h"
 #include "simulator/cache.h"
 #include "simulator/cache_simulator.h"
+#include "simulator/cache_sweep.h"
 #include "simulator/policy_lfu.h"
 #include "simulator/policy_lru.h"
 #include "simulator/prefetcher.h"
@@ -183,7 +187,7 @@ unit_test_metrics_API()
     cache_simulator_knobs_t knobs = make_test_knobs();
     cache_simulator_t cache_sim(knobs);
 
-    memref_t ref;
+    memref_t ref = {};
     ref.data.type = TRACE_TYPE_WRITE;
     ref.data.addr = 0;
     ref.data.size = 8;
@@ -1264,6 +1268,199 @@ Core #1 \(traced CPU\(s\): #567800\)
     }
 }
 
+// Runs "make_core_ref" for each of "num_refs" iterations on every core, both
+// serially in lockstep and with one thread per core under -cache_parallel, and
+// checks that the L1D and LLC stats match.
+static void
+check_parallel_matches_serial(cache_simulator_knobs_t knobs, int num_refs,
+                              const std::function<memref_t(int, int)> &make_core_ref)
+{
+    const int num_cores = static_cast<int>(knobs.num_cores);
+    // Serial lockstep run.
+    knobs.parallel = false;
+    cache_simulator_t serial_sim(knobs);
+    default_memtrace_stream_t serial_stream;
+    serial_sim.initialize_stream(&serial_stream);
+    std::string error = serial_sim.initialize_shard_type(SHARD_BY_CORE);
+    assert(error.empty());
+    for (int i = 0; i < num_refs; i++) {
+        for (int core = 0; core < num_cores; core++) {
+            serial_stream.set_shard_index(core);
+            serial_stream.set_output_cpuid(core);
+            bool res = serial_sim.process_memref(make_core_ref(core, i));
+            assert(res);
+        }
+    }
+    // Parallel run with one thread per core.
+    knobs.parallel = true;
+    cache_simulator_t parallel_sim(knobs);
+    assert(parallel_sim.parallel_shard_supported());
+    parallel_sim.initialize_stream(nullptr);
+    error = parallel_sim.initialize_shard_type(SHARD_BY_CORE);
+    assert(error.empty());
+    std::vector<std::thread> threads;
+    for (int core = 0; core < num_cores; core++) {
+        threads.emplace_back([&parallel_sim, &make_core_ref, num_refs, core]() {
+            default_memtrace_stream_t stream;
+            stream.set_shard_index(core);
+            stream.set_output_cpuid(core);
+            void *shard_data = parallel_sim.parallel_shard_init_stream(
+                core, parallel_sim.parallel_worker_init(core), &stream);
+            for (int i = 0; i < num_refs; i++) {
+                memref_t ref = make_core_ref(core, i);
+                bool res = parallel_sim.parallel_shard_memref(shard_data, ref);
+                assert(res);
+            }
+            bool res = parallel_sim.parallel_shard_exit(shard_data);
+            assert(res);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    for (int core = 0; core < num_cores; core++) {
+        for (metric_name_t metric : { metric_name_t::HITS, metric_name_t::MISSES,
+                                      metric_name_t::COMPULSORY_MISSES }) {
+            TEST_EQ(parallel_sim.get_cache_metric(metric, 1, core, cache_split_t::DATA),
+                    serial_sim.get_cache_metric(metric, 1, core, cache_split_t::DATA));
+        }
+    }
+    for (metric_name_t metric : { metric_name_t::HITS, metric_name_t::MISSES,
+                                  metric_name_t::COMPULSORY_MISSES,
+                                  metric_name_t::CHILD_HITS }) {
+        TEST_EQ(parallel_sim.get_cache_metric(metric, 2),
+                serial_sim.get_cache_metric(metric, 2));
+    }
+}
+
+void
+unit_test_parallel_core_sharded()
+{
+    constexpr int NUM_CORES = 4;
+    constexpr int NUM_REFS = 20000;
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = NUM_CORES;
+    knobs.L1D_size = 8 * 64;
+    knobs.L1D_assoc = 2;
+    // A large LLC so that the cross-core access order does not affect its stats.
+    knobs.LL_size = 1024 * 1024;
+    knobs.LL_assoc = 16;
+    {
+        // Test invalid combinations.
+        cache_simulator_knobs_t bad_knobs = knobs;
+        bad_knobs.parallel = true;
+        cache_simulator_t sim_thread(bad_knobs);
+        assert(!sim_thread.initialize_shard_type(SHARD_BY_THREAD).empty());
+        bad_knobs.model_coherence = true;
+        cache_simulator_t sim_coherent(bad_knobs);
+        assert(!sim_coherent.initialize_shard_type(SHARD_BY_CORE).empty());
+        bad_knobs.model_coherence = false;
+        bad_knobs.warmup_refs = 10;
+        cache_simulator_t sim_warmup(bad_knobs);
+        assert(!sim_warmup.initialize_shard_type(SHARD_BY_CORE).empty());
+    }
+    // Each core has a private region plus a region shared with all other cores.
+    check_parallel_matches_serial(knobs, NUM_REFS, [](int core, int i) {
+        addr_t base = (i % 3 == 0) ? 0x100000 : 0x200000 * (core + 1);
+        return make_memref(base + ((i * 7) % 512) * 64,
+                           (i % 5 == 0) ? TRACE_TYPE_WRITE : TRACE_TYPE_READ);
+    });
+    // A small LLC with 64 sets which each core thrashes, but only in the sets
+    // congruent to its core index, so that the LLC sees evictions but per-set
+    // access order is still deterministic.
+    knobs.LL_size = 64 * 4 * 64;
+    knobs.LL_assoc = 4;
+    check_parallel_matches_serial(knobs, NUM_REFS, [](int core, int i) {
+        addr_t line = ((i * 7) % 256) * NUM_CORES + core;
+        return make_memref(line * 64, (i % 5 == 0) ? TRACE_TYPE_WRITE : TRACE_TYPE_READ);
+    });
+}
+
+// Tests that a single-pass sweep matches separate LRU caches of each size.
+void
+unit_test_cache_sweep()
+{
+    static constexpr int LINE_SIZE = 64;
+    cache_sweep_knobs_t sweep_knobs;
+    std::string error = parse_cache_sweep_lists("16K,32K,64k", "1,2,4,8", sweep_knobs);
+    TEST_EQ(error, "");
+    TEST_EQ(sweep_knobs.LL_sizes[1], 32 * 1024U);
+    assert(!parse_cache_sweep_lists("16X", "1", sweep_knobs).empty());
+    assert(!parse_cache_sweep_lists("16K", "0", sweep_knobs).empty());
+    error = parse_cache_sweep_lists("16K,32K,64k", "1,2,4,8", sweep_knobs);
+
+    // A mix of hot lines and a wider, skewed footprint.
+    std::vector<addr_t> addresses;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<addr_t> hot(0, 127);
+    std::geometric_distribution<addr_t> cold(1.0 / 2048);
+    for (int i = 0; i < 200000; ++i) {
+        addresses.push_back((i % 3 == 0 ? hot(rng) : 4096 + cold(rng)) * LINE_SIZE +
+                            i % LINE_SIZE);
+    }
+
+    stack_distance_sweep_t sweep;
+    TEST_EQ(sweep.init(LINE_SIZE, sweep_knobs), "");
+    for (addr_t addr : addresses)
+        sweep.access(addr, /*counted=*/true);
+    std::vector<cache_sweep_result_t> results = sweep.get_results();
+    TEST_EQ(results.size(), sweep_knobs.LL_sizes.size() * sweep_knobs.LL_assocs.size());
+    for (const cache_sweep_result_t &result : results) {
+        cache_t cache;
+        caching_device_stats_t stats(/*miss_file=*/"", LINE_SIZE);
+        bool initialized = cache.init(
+            result.assoc, LINE_SIZE, static_cast<int>(result.size), /*parent=*/nullptr,
+            &stats,
+            std::unique_ptr<policy_lru_t>(new policy_lru_t(
+                static_cast<int>(result.size / LINE_SIZE / result.assoc), result.assoc)));
+        assert(initialized);
+        for (addr_t addr : addresses)
+            cache.request(make_memref(addr, TRACE_TYPE_READ, 1));
+        TEST_EQ(result.accesses, static_cast<int64_t>(addresses.size()));
+        TEST_EQ(result.misses, stats.get_metric(metric_name_t::MISSES));
+    }
+
+    // Sampling half of the sets should closely estimate the miss ratios.
+    sweep_knobs.sample_rate = 0.5;
+    stack_distance_sweep_t sampled;
+    TEST_EQ(sampled.init(LINE_SIZE, sweep_knobs), "");
+    for (addr_t addr : addresses)
+        sampled.access(addr, /*counted=*/true);
+    std::vector<cache_sweep_result_t> sampled_results = sampled.get_results();
+    assert(sampled.get_sampled_accesses() < static_cast<int64_t>(addresses.size()));
+    for (size_t i = 0; i < results.size(); ++i) {
+        double expect = static_cast<double>(results[i].misses) / results[i].accesses;
+        double got =
+            static_cast<double>(sampled_results[i].misses) / sampled_results[i].accesses;
+        assert(got > expect - 0.05 && got < expect + 0.05);
+    }
+
+    // Within the simulator, the sweep point matching the LLC must match its stats.
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.LL_size = 32 * 1024;
+    knobs.LL_assoc = 4;
+    sweep_knobs.sample_rate = 1.0;
+    cache_sweep_t sim(knobs, sweep_knobs);
+    assert(!!sim);
+    for (addr_t addr : addresses)
+        sim.process_memref(make_memref(addr));
+    bool found = false;
+    for (const cache_sweep_result_t &result : sim.get_sweep_results("LL")) {
+        if (result.size == knobs.LL_size && result.assoc == knobs.LL_assoc) {
+            TEST_EQ(result.misses, sim.get_cache_metric(metric_name_t::MISSES, 2));
+            TEST_EQ(result.accesses,
+                    sim.get_cache_metric(metric_name_t::HITS, 2) +
+                        sim.get_cache_metric(metric_name_t::MISSES, 2));
+            found = true;
+        }
+    }
+    assert(found);
+
+    // A grid point without a power of 2 sets is rejected.
+    sweep_knobs.LL_assocs = { 3 };
+    cache_sweep_t bad_sim(knobs, sweep_knobs);
+    assert(!bad_sim);
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -1289,9 +1486,11 @@ test_main(int argc, const char *argv[])
     unit_test_child_hits();
     unit_test_cache_replacement_policy();
     unit_test_core_sharded();
+    unit_test_parallel_core_sharded();
     unit_test_nextline_prefetcher();
     unit_test_custom_prefetcher();
     unit_test_set_parent();
+    unit_test_cache_sweep();
     return 0;
 }
 
@@ -0,0 +1,160 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Unit tests for flat_hash_map_t. */
+
+#include "test_helpers.h"
+#include "tools/common/flat_hash_map.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace dynamorio {
+namespace drmemtrace {
+namespace {
+
+bool
+test_basics()
+{
+    flat_hash_map_t<uint64_t, int64_t> map;
+    assert(map.empty());
+    assert(map.find(42) == map.end());
+    assert(map.begin() == map.end());
+    assert(map.erase(42) == 0);
+    ++map[42];
+    ++map[42];
+    assert(map.size() == 1);
+    assert(map[42] == 2);
+    auto res = map.insert(std::make_pair(42, 7));
+    assert(!res.second);
+    assert(res.first->second == 2);
+    res = map.insert(std::make_pair(43, 7));
+    assert(res.second);
+    assert(map.count(43) == 1);
+    assert(map.erase(42) == 1);
+    assert(map.count(42) == 0);
+    assert(map.size() == 1);
+    map.clear();
+    assert(map.empty());
+    assert(map.find(43) == map.end());
+    return true;
+}
+
+bool
+test_matches_unordered_map()
+{
+    // Mirror a random mix of inserts, updates, and erases in a std::unordered_map.
+    // Cache-line-like keys with a small range force collisions, tombstones, and
+    // in-place rehashes as well as growth.
+    flat_hash_map_t<uint64_t, int64_t> map;
+    std::unordered_map<uint64_t, int64_t> expect;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint64_t> key_dist(0, 4096);
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t key = key_dist(rng) << 6;
+        switch (rng() % 4) {
+        case 0:
+            if (map.erase(key) != expect.erase(key)) {
+                std::cerr << "Erase mismatch for " << key << "\n";
+                return false;
+            }
+            break;
+        case 1: {
+            auto it = map.find(key);
+            auto expect_it = expect.find(key);
+            if ((it == map.end()) != (expect_it == expect.end()) ||
+                (it != map.end() && it->second != expect_it->second)) {
+                std::cerr << "Find mismatch for " << key << "\n";
+                return false;
+            }
+            break;
+        }
+        default: map[key] += i; expect[key] += i;
+        }
+    }
+    if (map.size() != expect.size()) {
+        std::cerr << "Size mismatch: " << map.size() << " vs " << expect.size() << "\n";
+        return false;
+    }
+    size_t visited = 0;
+    for (const auto &keyval : map) {
+        auto it = expect.find(keyval.first);
+        if (it == expect.end() || it->second != keyval.second) {
+            std::cerr << "Iteration mismatch for " << keyval.first << "\n";
+            return false;
+        }
+        ++visited;
+    }
+    assert(visited == expect.size());
+    return true;
+}
+
+bool
+test_copy_and_move()
+{
+    flat_hash_map_t<int, std::string> map;
+    for (int i = 0; i < 100; ++i)
+        map[i] = std::to_string(i);
+    flat_hash_map_t<int, std::string> copy(map);
+    copy[0] = "changed";
+    assert(map[0] == "0");
+    assert(copy.size() == 100 && copy[99] == "99");
+    flat_hash_map_t<int, std::string> moved(std::move(copy));
+    assert(moved.size() == 100 && moved[0] == "changed");
+    map = moved;
+    assert(map[0] == "changed");
+    // The const iterator is obtainable from the non-const one.
+    const flat_hash_map_t<int, std::string> &const_map = map;
+    flat_hash_map_t<int, std::string>::const_iterator it = map.find(5);
+    assert(it != const_map.end() && it->second == "5");
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (!test_basics() || !test_matches_unordered_map() || !test_copy_and_move())
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,251 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+// Benchmark of the analysis tools which take spans of records through
+// parallel_shard_memrefs(), run over a checked-in trace.  Each worker thread
+// replays the whole trace as its own shard, once with one virtual call per record
+// and once in spans, and the per-worker throughput of each is reported.  The
+// basic_counts totals of the two must agree.  The default iteration count is small
+// enough to serve as a regression test; pass a larger count as the second argument
+// (and a worker count as the third) for meaningful timings from a release build.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+#include "memtrace_stream.h"
+#include "scheduler.h"
+#include "test_helpers.h"
+#include "tools/basic_counts.h"
+#include "tools/basic_counts_create.h"
+#include "tools/opcode_mix_create.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+// The analyzer's maximum span length.
+constexpr size_t SPAN_SIZE = 256;
+
+// Supplies the file type and thread id, which the tools query from their shard
+// streams.
+class shard_stream_t : public default_memtrace_stream_t {
+public:
+    shard_stream_t(uint64_t filetype, memref_tid_t tid)
+        : filetype_(filetype)
+        , tid_(tid)
+    {
+    }
+    uint64_t
+    get_filetype() const override
+    {
+        return filetype_;
+    }
+    int64_t
+    get_tid() const override
+    {
+        return tid_;
+    }
+
+private:
+    uint64_t filetype_;
+    memref_tid_t tid_;
+};
+
+// Loads the records of the thread with the most records, as tools expect each
+// thread-sharded shard to hold a single thread.
+bool
+load_trace(const std::string &path, std::vector<memref_t> &memrefs, uint64_t &filetype)
+{
+    scheduler_t scheduler;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    sched_inputs.emplace_back(path);
+    if (scheduler.init(sched_inputs, 1, scheduler_t::make_scheduler_serial_options()) !=
+        scheduler_t::STATUS_SUCCESS) {
+        std::cerr << "Failed to initialize scheduler: " << scheduler.get_error_string()
+                  << "\n";
+        return false;
+    }
+    auto *stream = scheduler.get_stream(0);
+    std::unordered_map<memref_tid_t, std::vector<memref_t>> per_thread;
+    memref_t memref;
+    for (scheduler_t::stream_status_t status = stream->next_record(memref);
+         status != scheduler_t::STATUS_EOF; status = stream->next_record(memref)) {
+        if (status != scheduler_t::STATUS_OK) {
+            std::cerr << "Failed to read " << path << "\n";
+            return false;
+        }
+        per_thread[memref.data.tid].push_back(memref);
+    }
+    filetype = stream->get_filetype();
+    for (auto &entry : per_thread) {
+        if (entry.second.size() > memrefs.size())
+            memrefs.swap(entry.second);
+    }
+    return true;
+}
+
+// Feeds all records to the tool as one shard, either one at a time or in spans.
+bool
+run_shard(analysis_tool_t *tool, const std::vector<memref_t> &memrefs, int index,
+          uint64_t filetype, bool spans)
+{
+    shard_stream_t stream(filetype, memrefs.empty() ? 0 : memrefs[0].data.tid);
+    void *worker = tool->parallel_worker_init(index);
+    void *shard = tool->parallel_shard_init_stream(index, worker, &stream);
+    bool res = true;
+    if (spans) {
+        for (size_t start = 0; res && start < memrefs.size(); start += SPAN_SIZE) {
+            res = tool->parallel_shard_memrefs(
+                shard, memrefs.data() + start,
+                std::min(SPAN_SIZE, memrefs.size() - start));
+        }
+    } else {
+        for (size_t i = 0; res && i < memrefs.size(); ++i)
+            res = tool->parallel_shard_memref(shard, memrefs[i]);
+    }
+    if (!res)
+        std::cerr << "Tool failed: " << tool->parallel_shard_error(shard) << "\n";
+    res = tool->parallel_shard_exit(shard) && res;
+    tool->parallel_worker_exit(worker);
+    return res;
+}
+
+// Runs one shard per worker thread and returns the per-worker records per second,
+// or a negative value on failure.
+double
+run_workers(analysis_tool_t *tool, const std::vector<memref_t> &memrefs,
+            uint64_t filetype, int iters, int workers, bool spans)
+{
+    std::vector<char> ok(workers, 1);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int iter = 0; iter < iters; ++iter) {
+                if (!run_shard(tool, memrefs, i + iter * workers, filetype, spans))
+                    ok[i] = 0;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+        return -1.;
+    return static_cast<double>(memrefs.size()) * iters / seconds;
+}
+
+bool
+bench_tools(const std::vector<memref_t> &memrefs, uint64_t filetype, int iters,
+            int workers)
+{
+    struct named_tool_t {
+        std::string name;
+        std::function<analysis_tool_t *()> create;
+    };
+    std::vector<named_tool_t> tools = {
+        { "basic_counts", []() { return basic_counts_tool_create(); } },
+        { "opcode_mix",
+          []() { return opcode_mix_tool_create(/*module_file_path=*/""); } },
+    };
+    for (const auto &named : tools) {
+        std::unique_ptr<analysis_tool_t> single(named.create());
+        std::unique_ptr<analysis_tool_t> spans(named.create());
+        if (!spans->parallel_shard_memrefs_supported()) {
+            std::cerr << named.name << " does not support spans\n";
+            return false;
+        }
+        double single_rate = run_workers(single.get(), memrefs, filetype, iters,
+                                         workers, /*spans=*/false);
+        double spans_rate =
+            run_workers(spans.get(), memrefs, filetype, iters, workers, /*spans=*/true);
+        if (single_rate < 0 || spans_rate < 0)
+            return false;
+        std::cerr << named.name << " one record per call: " << single_rate / 1e6
+                  << " M records/s per worker\n";
+        std::cerr << named.name << " spans of " << SPAN_SIZE
+                  << " records: " << spans_rate / 1e6 << " M records/s per worker\n";
+        if (named.name == "basic_counts" &&
+            !(static_cast<basic_counts_t *>(single.get())->get_total_counts() ==
+              static_cast<basic_counts_t *>(spans.get())->get_total_counts())) {
+            std::cerr << "basic_counts totals differ between single records and spans\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace_dir> [iterations] [workers]\n";
+        return 1;
+    }
+    int iters = argc > 2 ? atoi(argv[2]) : 1;
+    int workers = argc > 3 ? atoi(argv[3]) : 2;
+    if (iters <= 0 || workers <= 0) {
+        std::cerr << "Iterations and workers must be positive\n";
+        return 1;
+    }
+    std::vector<memref_t> memrefs;
+    uint64_t filetype;
+    if (!load_trace(argv[1], memrefs, filetype))
+        return 1;
+    std::cerr << "Loaded " << memrefs.size() << " records\n";
+    if (!bench_tools(memrefs, filetype, iters, workers))
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -57,7 +57,8 @@ public:
     get_opcode_mix(void *shard)
     {
         shard_data_t *shard_data = reinterpret_cast<shard_data_t *>(shard);
-        return shard_data->opcode_counts;
+        return std::unordered_map<int, int64_t>(shard_data->opcode_counts.begin(),
+                                                shard_data->opcode_counts.end());
     }
 
 protected:
@@ -103,12 +103,12 @@ class raw2trace_test_t : public raw2trace_t {
 public:
     raw2trace_test_t(const std::vector<std::istream *> &input,
                      const std::vector<std::ostream *> &output, instrlist_t &instrs,
-                     void *drcontext)
+                     void *drcontext, int worker_count = -1)
         : raw2trace_t(nullptr, input, output, {}, INVALID_FILE, nullptr, nullptr,
                       drcontext,
                       // The sequences are small so we print everything for easier
                       // debugging and viewing of what's going on.
-                      /*verbosity=*/4)
+                      /*verbosity=*/4, worker_count)
     {
         module_mapper_ = std::unique_ptr<module_mapper_t>(
             new test_module_mapper_t(&instrs, drcontext));
@@ -162,6 +162,12 @@ public:
             std::unique_ptr<module_mapper_t>(new test_multi_module_mapper_t(modules));
         set_modmap_(module_mapper_.get());
     }
+    // Returns the worker the thread_index-th input was assigned to.
+    int
+    get_thread_worker(size_t thread_index)
+    {
+        return thread_data_[thread_index]->worker;
+    }
     // The public function to access the raw2trace_t protected function
     // is_maybe_blocking_syscall.
     bool
@@ -3790,6 +3796,77 @@ test_syscall_injection(void *drcontext)
         check_entry(entries, idx, TRACE_TYPE_FOOTER, -1));
 }
 
+bool
+test_worker_assignment(void *drcontext)
+{
+    std::cerr << "\n===============\nTesting worker assignment\n";
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *move1 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instr_t *move2 =
+        XINST_CREATE_move(drcontext, opnd_create_reg(REG1), opnd_create_reg(REG2));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, move1);
+    instrlist_append(ilist, move2);
+    size_t offs_move1 = instr_length(drcontext, nop);
+
+    // One large thread and several smaller ones, each with a new buffer (and so
+    // a new timestamp) every 10 blocks.
+    const std::vector<int> thread_blocks = { 200, 10, 20, 30, 40 };
+    std::vector<std::string> raw_files;
+    for (size_t i = 0; i < thread_blocks.size(); ++i) {
+        std::vector<offline_entry_t> raw;
+        raw.push_back(make_header());
+        raw.push_back(make_tid(static_cast<memref_tid_t>(i + 1)));
+        raw.push_back(make_pid());
+        raw.push_back(make_line_size());
+        for (int block = 0; block < thread_blocks[i]; ++block) {
+            if (block % 10 == 0) {
+                raw.push_back(make_timestamp());
+                raw.push_back(make_core());
+            }
+            raw.push_back(make_block(offs_move1, 2));
+        }
+        raw.push_back(make_exit());
+        raw_files.emplace_back(reinterpret_cast<const char *>(raw.data()),
+                               reinterpret_cast<const char *>(raw.data() + raw.size()));
+    }
+    // Ensure the size-based assignment gives the same output as a single worker.
+    std::vector<std::string> expect;
+    for (int worker_count : { 1, 3 }) {
+        std::vector<std::unique_ptr<std::istringstream>> raw_in;
+        std::vector<std::unique_ptr<std::ostringstream>> result;
+        std::vector<std::istream *> input;
+        std::vector<std::ostream *> output;
+        for (const std::string &raw : raw_files) {
+            raw_in.emplace_back(new std::istringstream(raw));
+            input.push_back(raw_in.back().get());
+            result.emplace_back(new std::ostringstream());
+            output.push_back(result.back().get());
+        }
+        raw2trace_test_t raw2trace(input, output, *ilist, drcontext, worker_count);
+        std::string error = raw2trace.do_conversion();
+        CHECK(error.empty(), error);
+        if (worker_count > 1) {
+            // The largest thread should have its worker to itself.
+            for (size_t i = 1; i < thread_blocks.size(); ++i) {
+                CHECK(raw2trace.get_thread_worker(i) != raw2trace.get_thread_worker(0),
+                      "largest thread shares its worker");
+            }
+        }
+        for (size_t i = 0; i < result.size(); ++i) {
+            if (worker_count == 1)
+                expect.push_back(result[i]->str());
+            else
+                CHECK(result[i]->str() == expect[i], "output differs from one worker");
+        }
+    }
+    instrlist_clear_and_destroy(drcontext, ilist);
+    return true;
+}
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -3812,7 +3889,8 @@ test_main(int argc, const char *argv[])
         !test_branch_decoration(drcontext) ||
         !test_stats_timestamp_instr_count(drcontext) ||
         !test_is_maybe_blocking_syscall(drcontext) || !test_ifiltered(drcontext) ||
-        !test_asynchronous_signal(drcontext) || !test_syscall_injection(drcontext))
+        !test_asynchronous_signal(drcontext) || !test_syscall_injection(drcontext) ||
+        !test_worker_assignment(drcontext))
         return 1;
     return 0;
 }
@@ -169,9 +169,9 @@ find_strings_in_stream(const std::vector<std::string> &expected_strings, std::is
 
 // Test basic reuse-distance.
 void
-simple_reuse_distance_test()
+simple_reuse_distance_test(bool use_tree)
 {
-    std::cerr << "simple_reuse_distance_test()\n";
+    std::cerr << "simple_reuse_distance_test(use_tree=" << use_tree << ")\n";
 
     constexpr uint32_t LINE_SIZE = 64;
 
@@ -185,6 +185,7 @@ simple_reuse_distance_test()
     knobs.line_size = LINE_SIZE;
     knobs.report_histogram = true;
     knobs.verbose = 0;
+    knobs.use_tree = use_tree;
     reuse_distance_test_t reuse_distance(knobs);
 
     // Create address generator with a predictable access pattern.
@@ -230,9 +231,9 @@ simple_reuse_distance_test()
 
 // Test distance_limit on reuse-distance.
 void
-reuse_distance_limit_test()
+reuse_distance_limit_test(bool use_tree)
 {
-    std::cerr << "reuse_distance_limit_test()\n";
+    std::cerr << "reuse_distance_limit_test(use_tree=" << use_tree << ")\n";
     constexpr uint32_t LINE_SIZE = 32;
     constexpr uint32_t SKIP_LIST_DISTANCE = 75;
     constexpr uint32_t DISTANCE_LIMIT = 500;
@@ -248,6 +249,7 @@ reuse_distance_limit_test()
     knobs.report_histogram = true;
     knobs.skip_list_distance = SKIP_LIST_DISTANCE;
     knobs.distance_limit = DISTANCE_LIMIT;
+    knobs.use_tree = use_tree;
     reuse_distance_test_t reuse_distance(knobs);
 
     // Generate a simple stream of references with a predictable reuse pattern.
@@ -507,14 +509,64 @@ data_histogram_test()
     }
 }
 
+// Test that the tree engine produces exactly the skip list's results on a
+// pseudo-random stream large enough to force several tree compactions.
+void
+tree_matches_list_test()
+{
+    std::cerr << "tree_matches_list_test()\n";
+    constexpr uint32_t LINE_SIZE = 64;
+    constexpr int NUM_REFS = 200000;
+    constexpr int NUM_LINES = 5000;
+
+    reuse_distance_knobs_t knobs;
+    knobs.line_size = LINE_SIZE;
+    knobs.skip_list_distance = 50;
+    reuse_distance_test_t list_tool(knobs);
+    knobs.use_tree = true;
+    reuse_distance_test_t tree_tool(knobs);
+
+    // Mix a small hot set with uniform accesses over the full set so that we
+    // see both short and long distances.
+    uint64_t seed = 42;
+    for (int i = 0; i < NUM_REFS; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t line = (seed >> 33) % NUM_LINES;
+        if ((seed >> 20) % 4 != 0)
+            line %= 64;
+        trace_type_t type = (i % 3 == 0) ? TRACE_TYPE_INSTR : TRACE_TYPE_READ;
+        memref_t memref = generate_memref(line * LINE_SIZE, type);
+        bool success = list_tool.process_memref(memref);
+        assert(success);
+        success = tree_tool.process_memref(memref);
+        assert(success);
+    }
+
+    auto *list_shard = list_tool.get_aggregated_results();
+    auto *tree_shard = tree_tool.get_aggregated_results();
+    assert(list_shard->ref_list->cur_time_ == tree_shard->ref_list->cur_time_);
+    assert(list_shard->dist_map == tree_shard->dist_map);
+    assert(list_shard->dist_map_data == tree_shard->dist_map_data);
+    assert(list_shard->cache_map.size() == tree_shard->cache_map.size());
+    for (const auto &entry : list_shard->cache_map) {
+        const auto &it = tree_shard->cache_map.find(entry.first);
+        assert(it != tree_shard->cache_map.end());
+        assert(it->second->total_refs == entry.second->total_refs);
+        assert(it->second->distant_refs == entry.second->distant_refs);
+    }
+}
+
 int
 test_main(int argc, const char *argv[])
 {
     print_histogram_empty_test();
     print_histogram_mult_1p0_test();
     print_histogram_mult_1p2_test();
-    simple_reuse_distance_test();
-    reuse_distance_limit_test();
+    simple_reuse_distance_test(/*use_tree=*/false);
+    simple_reuse_distance_test(/*use_tree=*/true);
+    reuse_distance_limit_test(/*use_tree=*/false);
+    reuse_distance_limit_test(/*use_tree=*/true);
+    tree_matches_list_test();
     data_histogram_test();
     return 0;
 }
@@ -1399,6 +1399,52 @@ test_real_file_queries_and_filters(const char *testdir)
 #endif
 }
 
+static void
+test_mmap_reader(const char *testdir)
+{
+    std::cerr << "\n----------------\nTesting mmap reader\n";
+    // Ensure the mapped reader produces the same records as the default stream
+    // reader, with and without read-ahead.
+#if (defined(X86_64) || defined(ARM_64)) && defined(HAS_MMAP)
+    std::string path = std::string(testdir) + "/drmemtrace.small.x64.trace";
+    auto read_all = [&path](bool use_mmap, int read_ahead_blocks) {
+        scheduler_t scheduler;
+        std::vector<scheduler_t::input_workload_t> sched_inputs;
+        sched_inputs.emplace_back(path);
+        scheduler_t::scheduler_options_t sched_ops =
+            scheduler_t::make_scheduler_serial_options(/*verbosity=*/1);
+        sched_ops.mmap_uncompressed_inputs = use_mmap;
+        sched_ops.read_ahead_blocks = read_ahead_blocks;
+        if (scheduler.init(sched_inputs, 1, std::move(sched_ops)) !=
+            scheduler_t::STATUS_SUCCESS)
+            assert(false);
+        auto *stream = scheduler.get_stream(0);
+        std::vector<std::string> records;
+        memref_t memref;
+        for (scheduler_t::stream_status_t status = stream->next_record(memref);
+             status != scheduler_t::STATUS_EOF; status = stream->next_record(memref)) {
+            assert(status == scheduler_t::STATUS_OK);
+            std::ostringstream record;
+            record << memref.data.type << " " << memref.data.pid << " "
+                   << memref.data.tid << " " << memref.data.addr << " "
+                   << memref.data.size << " " << stream->get_record_ordinal() << " "
+                   << stream->get_instruction_ordinal();
+            if (memref.marker.type == TRACE_TYPE_MARKER) {
+                record << " " << memref.marker.marker_type << " "
+                       << memref.marker.marker_value;
+            }
+            records.push_back(record.str());
+        }
+        return records;
+    };
+    std::vector<std::string> expect = read_all(/*use_mmap=*/false, 0);
+    assert(!expect.empty());
+    assert(read_all(/*use_mmap=*/true, 0) == expect);
+    assert(read_all(/*use_mmap=*/true, 2) == expect);
+    assert(read_all(/*use_mmap=*/false, 2) == expect);
+#endif
+}
+
 static void
 test_synthetic()
 {
@@ -8029,6 +8075,7 @@ test_main(int argc, const char *argv[])
     test_regions();
     test_only_threads();
     test_real_file_queries_and_filters(argv[1]);
+    test_mmap_reader(argv[1]);
     test_synthetic();
     test_synthetic_with_syscall_seq();
     test_synthetic_time_quanta();
@@ -32,12 +32,27 @@
 
 /* Unit tests for the skip feature. */
 
+#include "archive_ostream.h"
+#include "chunk_index.h"
+#include "columnar_chunk.h"
 #include "droption.h"
 #include "zipfile_file_reader.h"
+#include "zipfile_ostream.h"
 #include "tools/view_create.h"
+#ifdef HAS_ZSTD
+#    include "zstd_istream.h"
+#    include "zstd_ostream.h"
+#endif
+
+#include <string.h>
 
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -75,7 +90,7 @@ static droption_t<bool> op_verbose(DROPTION_SCOPE_FRONTEND, "verbose", false,
                                    "Whether to print diagnostics");
 
 bool
-test_skip_initial()
+test_skip_initial(int read_ahead_blocks)
 {
     int view_count = 10;
     // Our checked-in trace has a chunk size of 20, letting us test cross-chunk
@@ -91,7 +106,8 @@ test_skip_initial()
         std::streambuf *prior = std::cerr.rdbuf(capture.rdbuf());
         // Open the trace.
         std::unique_ptr<reader_t> iter = std::unique_ptr<reader_t>(
-            new zipfile_file_reader_t(op_trace_file.get_value()));
+            new zipfile_file_reader_t(op_trace_file.get_value(), /*verbosity=*/0,
+                                      read_ahead_blocks));
         CHECK(!!iter, "failed to open zipfile");
         CHECK(iter->init(), "failed to initialize reader");
         std::unique_ptr<reader_t> iter_end =
@@ -160,6 +176,262 @@ test_skip_initial()
     return true;
 }
 
+// Reads the whole trace, skipping "skip_instrs" after "skip_after" records, and
+// returns a summary of every record seen.
+static std::vector<std::string>
+read_with_skip(int read_ahead_blocks, int skip_after, int skip_instrs,
+               const std::string &path = op_trace_file.get_value())
+{
+    std::vector<std::string> records;
+    std::unique_ptr<reader_t> iter = std::unique_ptr<reader_t>(
+        new zipfile_file_reader_t(path, /*verbosity=*/0, read_ahead_blocks));
+    std::unique_ptr<reader_t> iter_end =
+        std::unique_ptr<reader_t>(new zipfile_file_reader_t());
+    if (!iter->init())
+        return records;
+    for (int count = 0; *iter != *iter_end; ++(*iter), ++count) {
+        if (count == skip_after && skip_instrs > 0) {
+            iter->skip_instructions(skip_instrs);
+            if (*iter == *iter_end)
+                break;
+        }
+        const memref_t &memref = **iter;
+        std::ostringstream summary;
+        summary << memref.data.type << ":" << memref.data.tid << ":" << memref.data.addr
+                << ":" << memref.data.size;
+        records.push_back(summary.str());
+    }
+    return records;
+}
+
+bool
+test_read_ahead()
+{
+    // Compare reading with and without a read-ahead thread, including skips that
+    // must take the file back from the read-ahead thread mid-stream.
+    for (int skip_after : { 0, 7, 150 }) {
+        for (int skip_instrs : { 0, 3, 45 }) {
+            std::vector<std::string> expect = read_with_skip(0, skip_after, skip_instrs);
+            CHECK(!expect.empty(), "failed to read trace");
+            for (int read_ahead_blocks : { 2, 4 }) {
+                std::vector<std::string> got =
+                    read_with_skip(read_ahead_blocks, skip_after, skip_instrs);
+                CHECK(got == expect, "read-ahead records differ");
+            }
+        }
+    }
+    return true;
+}
+
+// Copies the checked-in trace, which predates chunk index comments, to
+// "copy_path", adding the comments.
+bool
+copy_trace(const std::string &copy_path, int chunk_instrs, bool columnar,
+           bool zstd = false)
+{
+    unzFile in = unzOpen(op_trace_file.get_value().c_str());
+    CHECK(in != nullptr, "failed to open trace");
+    zipfile_ostream_t out(copy_path, columnar, zstd);
+    CHECK(!!out, "failed to create copy");
+    uint64_t chunk = 0;
+    for (int res = unzGoToFirstFile(in); res == UNZ_OK;
+         res = unzGoToNextFile(in), ++chunk) {
+        char name[128];
+        CHECK(unzGetCurrentFileInfo64(in, nullptr, name, sizeof(name), nullptr, 0,
+                                      nullptr, 0) == UNZ_OK,
+              "failed to get component name");
+        chunk_index_entry_t entry;
+        entry.instr_ordinal = chunk * chunk_instrs;
+        CHECK(out.open_new_component_with_comment(name,
+                                                  encode_chunk_index_comment(entry))
+                  .empty(),
+              "failed to open component");
+        CHECK(unzOpenCurrentFile(in) == UNZ_OK, "failed to open component");
+        char buf[4096];
+        int len;
+        while ((len = unzReadCurrentFile(in, buf, sizeof(buf))) > 0)
+            out.write(buf, len);
+        unzCloseCurrentFile(in);
+    }
+    unzClose(in);
+    return true;
+}
+
+bool
+test_chunk_index()
+{
+    // Ensure skipping with chunk index comments matches skipping without.
+    const int chunk_instrs = 20;
+    std::string copy_path = op_trace_file.get_value() + ".indexed.zip";
+    if (!copy_trace(copy_path, chunk_instrs, /*columnar=*/false))
+        return false;
+    // The comments should survive in the central directory, with each chunk
+    // starting a fixed number of instructions after the prior one.
+    unzFile copy = unzOpen(copy_path.c_str());
+    CHECK(copy != nullptr && unzGoToFirstFile(copy) == UNZ_OK, "failed to open copy");
+    uint64_t chunk_ordinal = 0;
+    int res;
+    do {
+        char comment[128];
+        CHECK(unzGetCurrentFileInfo64(copy, nullptr, nullptr, 0, nullptr, 0, comment,
+                                      sizeof(comment)) == UNZ_OK,
+              "failed to read comment");
+        chunk_index_entry_t entry;
+        CHECK(decode_chunk_index_comment(comment, entry) &&
+                  entry.instr_ordinal == chunk_ordinal * chunk_instrs,
+              "chunk index comment mismatch");
+        ++chunk_ordinal;
+    } while ((res = unzGoToNextFile(copy)) == UNZ_OK);
+    CHECK(res == UNZ_END_OF_LIST_OF_FILE && chunk_ordinal > 1, "too few chunks");
+    unzClose(copy);
+    for (int skip_after : { 0, 7, 150 }) {
+        for (int skip_instrs : { 3, 19, 20, 45, 100000 }) {
+            for (int read_ahead_blocks : { 0, 2 }) {
+                std::vector<std::string> expect =
+                    read_with_skip(read_ahead_blocks, skip_after, skip_instrs);
+                std::vector<std::string> got = read_with_skip(
+                    read_ahead_blocks, skip_after, skip_instrs, copy_path);
+                CHECK(got == expect, "indexed skip records differ");
+            }
+        }
+    }
+    std::remove(copy_path.c_str());
+    return true;
+}
+
+bool
+test_columnar()
+{
+    // Ensure a columnar copy reads back identically, including across skips
+    // and with read-ahead, and that it starts with the columnar magic.
+    const int chunk_instrs = 20;
+    std::string copy_path = op_trace_file.get_value() + ".columnar.zip";
+    if (!copy_trace(copy_path, chunk_instrs, /*columnar=*/true))
+        return false;
+    unzFile copy = unzOpen(copy_path.c_str());
+    CHECK(copy != nullptr && unzGoToFirstFile(copy) == UNZ_OK &&
+              unzOpenCurrentFile(copy) == UNZ_OK,
+          "failed to open copy");
+    char magic[COLUMNAR_CHUNK_MAGIC_SIZE];
+    CHECK(unzReadCurrentFile(copy, magic, sizeof(magic)) ==
+                  static_cast<int>(sizeof(magic)) &&
+              memcmp(magic, COLUMNAR_CHUNK_MAGIC, sizeof(magic)) == 0,
+          "columnar magic missing");
+    unzCloseCurrentFile(copy);
+    unzClose(copy);
+    for (int skip_after : { 0, 7, 150 }) {
+        for (int skip_instrs : { 0, 3, 19, 45, 100000 }) {
+            for (int read_ahead_blocks : { 0, 2 }) {
+                std::vector<std::string> expect =
+                    read_with_skip(read_ahead_blocks, skip_after, skip_instrs);
+                std::vector<std::string> got = read_with_skip(
+                    read_ahead_blocks, skip_after, skip_instrs, copy_path);
+                CHECK(got == expect, "columnar records differ");
+            }
+        }
+    }
+    std::remove(copy_path.c_str());
+    return true;
+}
+
+bool
+test_record_reader()
+{
+    // Read the raw records straight out of the components.
+    std::vector<trace_entry_t> expect;
+    unzFile in = unzOpen(op_trace_file.get_value().c_str());
+    CHECK(in != nullptr, "failed to open trace");
+    for (int res = unzGoToFirstFile(in); res == UNZ_OK; res = unzGoToNextFile(in)) {
+        CHECK(unzOpenCurrentFile(in) == UNZ_OK, "failed to open component");
+        trace_entry_t entry;
+        while (unzReadCurrentFile(in, &entry, sizeof(entry)) ==
+               static_cast<int>(sizeof(entry)))
+            expect.push_back(entry);
+        unzCloseCurrentFile(in);
+    }
+    unzClose(in);
+    CHECK(!expect.empty(), "failed to read components");
+    // Ensure the record reader, which opens the file into a heap copy of its
+    // reader state, hands back the same records from the original and from a
+    // columnar copy.
+    std::string copy_path = op_trace_file.get_value() + ".record.zip";
+    if (!copy_trace(copy_path, /*chunk_instrs=*/20, /*columnar=*/true))
+        return false;
+    for (const std::string &path : { op_trace_file.get_value(), copy_path }) {
+        zipfile_record_file_reader_t reader(path);
+        CHECK(reader.init(), "failed to open record reader");
+        record_file_reader_t<std::ifstream> end;
+        size_t count = 0;
+        for (; reader != end; ++reader, ++count) {
+            CHECK(count < expect.size(), "too many records");
+            const trace_entry_t &entry = *reader;
+            CHECK(entry.type == expect[count].type &&
+                      entry.size == expect[count].size &&
+                      entry.addr == expect[count].addr,
+                  "record mismatch");
+        }
+        CHECK(count == expect.size(), "too few records");
+    }
+    std::remove(copy_path.c_str());
+    return true;
+}
+
+#ifdef HAS_ZSTD
+bool
+test_zstd()
+{
+    // Ensure zstd-compressed components read back identically, alone and
+    // combined with the columnar format.
+    const int chunk_instrs = 20;
+    for (bool columnar : { false, true }) {
+        std::string copy_path = op_trace_file.get_value() + ".zstd.zip";
+        if (!copy_trace(copy_path, chunk_instrs, columnar, /*zstd=*/true))
+            return false;
+        unzFile copy = unzOpen(copy_path.c_str());
+        CHECK(copy != nullptr && unzGoToFirstFile(copy) == UNZ_OK &&
+                  unzOpenCurrentFile(copy) == UNZ_OK,
+              "failed to open copy");
+        static const unsigned char zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+        unsigned char magic[sizeof(zstd_magic)];
+        CHECK(unzReadCurrentFile(copy, magic, sizeof(magic)) ==
+                      static_cast<int>(sizeof(magic)) &&
+                  memcmp(magic, zstd_magic, sizeof(magic)) == 0,
+              "zstd frame missing");
+        unzCloseCurrentFile(copy);
+        unzClose(copy);
+        for (int skip_after : { 0, 7, 150 }) {
+            for (int skip_instrs : { 0, 3, 19, 45, 100000 }) {
+                for (int read_ahead_blocks : { 0, 2 }) {
+                    std::vector<std::string> expect =
+                        read_with_skip(read_ahead_blocks, skip_after, skip_instrs);
+                    std::vector<std::string> got = read_with_skip(
+                        read_ahead_blocks, skip_after, skip_instrs, copy_path);
+                    CHECK(got == expect, "zstd records differ");
+                }
+            }
+        }
+        std::remove(copy_path.c_str());
+    }
+    // Round-trip a standalone .zst stream, spanning several internal buffers.
+    std::string zst_path = op_trace_file.get_value() + ".zst";
+    std::string data;
+    for (int i = 0; i < 1 << 20; ++i)
+        data += std::to_string(i % 977);
+    {
+        zstd_ostream_t out(zst_path);
+        CHECK(!!out, "failed to create .zst file");
+        out.write(data.data(), data.size());
+    }
+    zstd_istream_t in(zst_path);
+    CHECK(!!in, "failed to open .zst file");
+    std::string got((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+    CHECK(got == data, ".zst contents differ");
+    std::remove(zst_path.c_str());
+    return true;
+}
+#endif
+
 int
 test_main(int argc, const char *argv[])
 {
@@ -170,8 +442,14 @@ test_main(int argc, const char *argv[])
         FATAL_ERROR("Usage error: %s\nUsage:\n%s", parse_err.c_str(),
                     droption_parser_t::usage_short(DROPTION_SCOPE_ALL).c_str());
     }
-    if (!test_skip_initial())
+    if (!test_skip_initial(/*read_ahead_blocks=*/0) ||
+        !test_skip_initial(/*read_ahead_blocks=*/2) || !test_read_ahead() ||
+        !test_chunk_index() || !test_columnar() || !test_record_reader())
+        return 1;
+#ifdef HAS_ZSTD
+    if (!test_zstd())
         return 1;
+#endif
     // TODO i#5538: Add tests that skip from the middle once we have full support
     // for duplicating the timestamp,cpu in that scenario.
     fprintf(stderr, "Success\n");
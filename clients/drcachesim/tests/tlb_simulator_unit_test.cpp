@@ -38,6 +38,7 @@
 #include <vector>
 
 #include "tlb_simulator_unit_test.h"
+#include "../simulator/tlb_multi_simulator.h"
 #include "../simulator/tlb_simulator.h"
 #include "../common/memref.h"
 #include "trace_entry.h"
@@ -81,6 +82,16 @@ public:
         knob_use_physical_ = set;
     };
 
+    caching_device_stats_t *
+    get_tlb_stats(tlb_multi_simulator_t::tlb_level_t level, unsigned int core)
+    {
+        if (level == tlb_multi_simulator_t::TLB_LEVEL_L1I)
+            return itlbs_[core]->get_stats();
+        if (level == tlb_multi_simulator_t::TLB_LEVEL_L1D)
+            return dtlbs_[core]->get_stats();
+        return lltlbs_[core]->get_stats();
+    }
+
     std::unordered_set<addr_t> addresses;
 };
 
@@ -180,10 +191,85 @@ tlb_simulator_check_addresses(const std::string &testdir)
 #endif
 }
 
+// Checks that simulating several configurations in one pass produces the same
+// stats as simulating each one separately.
+static void
+tlb_simulator_check_multi_config()
+{
+    tlb_simulator_knobs_t base;
+    base.warmup_refs = 1000;
+    std::vector<tlb_simulator_knobs_t> configs;
+    std::string error_str = parse_tlb_configs(
+        "page_size=4K;page_size=2M,TLB_L2_entries=512;"
+        "page_size=1G,TLB_L1D_entries=4,TLB_L1D_assoc=4,TLB_L2_entries=16,"
+        "TLB_replace_policy=LRU",
+        base, configs);
+    if (!error_str.empty() || configs.size() != 3 || configs[1].page_size != 2 << 20 ||
+        configs[2].TLB_replace_policy != "LRU") {
+        std::cerr << "ERROR: parse_tlb_configs failed: " << error_str << "\n";
+        exit(1);
+    }
+    std::vector<tlb_simulator_knobs_t> bad_configs;
+    if (parse_tlb_configs("page_size=4X", base, bad_configs).empty() ||
+        parse_tlb_configs("TLB_L3_entries=4", base, bad_configs).empty()) {
+        std::cerr << "ERROR: parse_tlb_configs accepted an invalid configuration\n";
+        exit(1);
+    }
+
+    // Enough records to span several batches, touching pages across 4GB from
+    // two threads.
+    std::vector<memref_t> memrefs;
+    uint64_t rand_state = 42;
+    for (int i = 0; i < 300000; ++i) {
+        rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        addr_t addr = static_cast<addr_t>((rand_state >> 16) & 0xffffffffULL);
+        memref_t memref = generate_mem_ref(addr, 0x400000 + (i % 4096) * 4);
+        memref.data.tid = 22222 + (i / 1000) % 2;
+        if (i % 3 == 0) {
+            memref.instr.type = TRACE_TYPE_INSTR;
+            memref.instr.addr = memref.data.pc;
+            memref.instr.size = 4;
+        }
+        memrefs.push_back(memref);
+    }
+
+    tlb_multi_simulator_t multi(configs, /*num_threads=*/2);
+    if (!multi) {
+        std::cerr << "ERROR: failed to create the multi-config TLB simulator: "
+                  << multi.get_error_string() << "\n";
+        exit(1);
+    }
+    for (const memref_t &memref : memrefs)
+        multi.process_memref(memref);
+    for (size_t c = 0; c < configs.size(); ++c) {
+        tlb_simulator_mock_t single(configs[c]);
+        for (const memref_t &memref : memrefs)
+            single.process_memref(memref);
+        for (unsigned int core = 0; core < base.num_cores; ++core) {
+            for (auto level : { tlb_multi_simulator_t::TLB_LEVEL_L1I,
+                                tlb_multi_simulator_t::TLB_LEVEL_L1D,
+                                tlb_multi_simulator_t::TLB_LEVEL_LL }) {
+                caching_device_stats_t *expect = single.get_tlb_stats(level, core);
+                caching_device_stats_t *got = multi.get_tlb_stats(c, core, level);
+                if (got == nullptr ||
+                    got->get_metric(metric_name_t::HITS) !=
+                        expect->get_metric(metric_name_t::HITS) ||
+                    got->get_metric(metric_name_t::MISSES) !=
+                        expect->get_metric(metric_name_t::MISSES)) {
+                    std::cerr << "ERROR: multi-config TLB stats mismatch for config "
+                              << c << " core " << core << " level " << level << "\n";
+                    exit(1);
+                }
+            }
+        }
+    }
+}
+
 void
 unit_test_tlb_simulator(const std::string &testdir)
 {
     tlb_simulator_check_addresses(testdir);
+    tlb_simulator_check_multi_config();
 }
 
 } // namespace drmemtrace
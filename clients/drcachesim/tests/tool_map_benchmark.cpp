@@ -0,0 +1,274 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+// Benchmark of the analysis tools whose per-access state is hash-map bound,
+// run over a checked-in trace.  It reports each tool's throughput and then
+// replays the tools' map update patterns through both std::unordered_map and
+// flat_hash_map_t, checking that the two agree.  The default iteration count is
+// small enough to serve as a regression test; pass a larger count as the second
+// argument for meaningful timings from a release build.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "flat_hash_map.h"
+#include "memref.h"
+#include "memtrace_stream.h"
+#include "scheduler.h"
+#include "test_helpers.h"
+#include "tools/histogram_create.h"
+#include "tools/reuse_distance_create.h"
+#include "tools/reuse_time_create.h"
+#include "trace_entry.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+namespace {
+
+constexpr int LINE_SIZE_BITS = 6;
+
+bool
+load_trace(const std::string &path, std::vector<memref_t> &memrefs)
+{
+    scheduler_t scheduler;
+    std::vector<scheduler_t::input_workload_t> sched_inputs;
+    sched_inputs.emplace_back(path);
+    if (scheduler.init(sched_inputs, 1, scheduler_t::make_scheduler_serial_options()) !=
+        scheduler_t::STATUS_SUCCESS) {
+        std::cerr << "Failed to initialize scheduler: " << scheduler.get_error_string()
+                  << "\n";
+        return false;
+    }
+    auto *stream = scheduler.get_stream(0);
+    memref_t memref;
+    for (scheduler_t::stream_status_t status = stream->next_record(memref);
+         status != scheduler_t::STATUS_EOF; status = stream->next_record(memref)) {
+        if (status != scheduler_t::STATUS_OK) {
+            std::cerr << "Failed to read " << path << "\n";
+            return false;
+        }
+        memrefs.push_back(memref);
+    }
+    return true;
+}
+
+double
+time_seconds(int iters, const std::function<void()> &func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i)
+        func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void
+report(const std::string &name, size_t count, int iters, double seconds)
+{
+    std::cerr << name << ": " << static_cast<double>(count) * iters / seconds / 1e6
+              << " M records/s\n";
+}
+
+// Feeds all records to the tool as a single shard.  The interleaving of threads
+// does not matter for throughput purposes.
+bool
+run_tool(analysis_tool_t *tool, const std::vector<memref_t> &memrefs)
+{
+    default_memtrace_stream_t stream;
+    void *worker = tool->parallel_worker_init(0);
+    void *shard = tool->parallel_shard_init_stream(0, worker, &stream);
+    bool res = true;
+    for (const memref_t &memref : memrefs) {
+        if (!tool->parallel_shard_memref(shard, memref)) {
+            std::cerr << "Tool failed: " << tool->parallel_shard_error(shard) << "\n";
+            res = false;
+            break;
+        }
+    }
+    tool->parallel_shard_exit(shard);
+    tool->parallel_worker_exit(worker);
+    return res;
+}
+
+bool
+bench_tools(const std::vector<memref_t> &memrefs, int iters)
+{
+    struct named_tool_t {
+        std::string name;
+        std::function<analysis_tool_t *()> create;
+    };
+    std::vector<named_tool_t> tools = {
+        { "histogram", []() { return histogram_tool_create(); } },
+        { "reuse_time", []() { return reuse_time_tool_create(); } },
+        { "reuse_distance",
+          []() { return reuse_distance_tool_create(reuse_distance_knobs_t()); } },
+    };
+    for (const auto &named : tools) {
+        bool ok = true;
+        double seconds = time_seconds(iters, [&]() {
+            std::unique_ptr<analysis_tool_t> tool(named.create());
+            ok = ok && run_tool(tool.get(), memrefs);
+        });
+        if (!ok)
+            return false;
+        report(named.name, memrefs.size(), iters, seconds);
+    }
+    return true;
+}
+
+// The histogram tool's pattern: a count per line touched.
+template <typename map_t>
+void
+count_lines(const std::vector<addr_t> &lines, map_t &map)
+{
+    for (addr_t line : lines)
+        ++map[line];
+}
+
+// The reuse_time tool's pattern prior to flat_hash_map_t.
+void
+reuse_time_unordered(const std::vector<addr_t> &lines,
+                     std::unordered_map<addr_t, int64_t> &map, int64_t &sum)
+{
+    int64_t time_stamp = 0;
+    for (addr_t line : lines) {
+        ++time_stamp;
+        if (map.count(line) > 0)
+            sum += time_stamp - map[line];
+        map[line] = time_stamp;
+    }
+}
+
+// The reuse_time tool's pattern with flat_hash_map_t.
+void
+reuse_time_flat(const std::vector<addr_t> &lines, flat_hash_map_t<addr_t, int64_t> &map,
+                int64_t &sum)
+{
+    int64_t time_stamp = 0;
+    for (addr_t line : lines) {
+        ++time_stamp;
+        auto res = map.emplace(line, time_stamp);
+        if (!res.second) {
+            sum += time_stamp - res.first->second;
+            res.first->second = time_stamp;
+        }
+    }
+}
+
+bool
+bench_maps(const std::vector<memref_t> &memrefs, int iters)
+{
+    std::vector<addr_t> all_lines, data_lines;
+    for (const memref_t &memref : memrefs) {
+        if (type_is_instr(memref.instr.type)) {
+            all_lines.push_back(memref.instr.addr >> LINE_SIZE_BITS);
+        } else if (memref.data.type == TRACE_TYPE_READ ||
+                   memref.data.type == TRACE_TYPE_WRITE) {
+            all_lines.push_back(memref.data.addr >> LINE_SIZE_BITS);
+            data_lines.push_back(memref.data.addr >> LINE_SIZE_BITS);
+        }
+    }
+
+    size_t unordered_size = 0, flat_size = 0;
+    double unordered_secs = time_seconds(iters, [&]() {
+        std::unordered_map<addr_t, uint64_t> map;
+        count_lines(all_lines, map);
+        unordered_size = map.size();
+    });
+    double flat_secs = time_seconds(iters, [&]() {
+        flat_hash_map_t<addr_t, uint64_t> map;
+        count_lines(all_lines, map);
+        flat_size = map.size();
+    });
+    if (unordered_size != flat_size) {
+        std::cerr << "Line count mismatch: " << unordered_size << " vs " << flat_size
+                  << "\n";
+        return false;
+    }
+    report("line counts with std::unordered_map", all_lines.size(), iters,
+           unordered_secs);
+    report("line counts with flat_hash_map_t", all_lines.size(), iters, flat_secs);
+
+    int64_t unordered_sum = 0, flat_sum = 0;
+    unordered_secs = time_seconds(iters, [&]() {
+        std::unordered_map<addr_t, int64_t> map;
+        reuse_time_unordered(data_lines, map, unordered_sum);
+    });
+    flat_secs = time_seconds(iters, [&]() {
+        flat_hash_map_t<addr_t, int64_t> map;
+        reuse_time_flat(data_lines, map, flat_sum);
+    });
+    if (unordered_sum != flat_sum) {
+        std::cerr << "Reuse time mismatch: " << unordered_sum << " vs " << flat_sum
+                  << "\n";
+        return false;
+    }
+    report("reuse times with std::unordered_map", data_lines.size(), iters,
+           unordered_secs);
+    report("reuse times with flat_hash_map_t", data_lines.size(), iters, flat_secs);
+    return true;
+}
+
+} // namespace
+
+int
+test_main(int argc, const char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <trace_dir> [iterations]\n";
+        return 1;
+    }
+    int iters = argc > 2 ? atoi(argv[2]) : 1;
+    std::vector<memref_t> memrefs;
+    if (!load_trace(argv[1], memrefs))
+        return 1;
+    std::cerr << "Loaded " << memrefs.size() << " records\n";
+    if (!bench_tools(memrefs, iters) || !bench_maps(memrefs, iters))
+        return 1;
+    std::cerr << "All done!\n";
+    return 0;
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
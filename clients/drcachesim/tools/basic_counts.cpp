@@ -244,6 +244,24 @@ basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     return true;
 }
 
+bool
+basic_counts_t::parallel_shard_memrefs_supported()
+{
+    return true;
+}
+
+bool
+basic_counts_t::parallel_shard_memrefs(void *shard_data, const memref_t *memrefs,
+                                       size_t count)
+{
+    // A direct call per record rather than the analyzer's virtual call.
+    for (size_t i = 0; i < count; ++i) {
+        if (!basic_counts_t::parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
 bool
 basic_counts_t::process_memref(const memref_t &memref)
 {
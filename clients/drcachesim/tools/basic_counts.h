@@ -71,6 +71,13 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    // A subclass overriding parallel_shard_memref() must override these as well,
+    // as parallel_shard_memrefs() calls our version directly.
+    bool
+    parallel_shard_memrefs_supported() override;
+    bool
+    parallel_shard_memrefs(void *shard_data, const memref_t *memrefs,
+                           size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
     interval_state_snapshot_t *
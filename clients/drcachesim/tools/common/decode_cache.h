@@ -38,7 +38,9 @@
  *   from the mapped app binaries otherwise;
  * - decoding the instr raw bytes to create the #instr_t;
  * - caching of data derived from the decoded #instr_t, and updating the cache
- *   appropriately based on the encoding_is_new field for embedded encodings.
+ *   appropriately based on the encoding_is_new field for embedded encodings;
+ * - optionally sharing that cached data among the shards, workers, and tools
+ *   that use the same decode info type.
  */
 
 #ifndef _DECODE_CACHE_H_
@@ -47,11 +49,16 @@
 #include "memref.h"
 #include "raw2trace_shared.h"
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -268,6 +275,223 @@ private:
     size_t last_mapped_module_size_ = 0;
 };
 
+/**
+ * Statistics for a #dynamorio::drmemtrace::shared_decode_cache_t.  Lookups
+ * served from the pc map of an attached #dynamorio::drmemtrace::decode_cache_t
+ * do not reach the shared cache and are not counted; every counted lookup is
+ * a hit, a decode, or a duplicate decode.
+ */
+struct shared_decode_cache_stats_t {
+    /** Lookups of an instruction which the attached cache had not yet seen. */
+    uint64_t lookups = 0;
+    /** Lookups which found decode info added earlier by any attached cache. */
+    uint64_t hits = 0;
+    /** Lookups which decoded the instruction and added its decode info. */
+    uint64_t decodes = 0;
+    /**
+     * Lookups which decoded the instruction concurrently with another attached
+     * cache and discarded the result in favor of the one added first.
+     */
+    uint64_t duplicate_decodes = 0;
+    /** Distinct pc and encoding pairs with decode info. */
+    uint64_t entries = 0;
+};
+
+/**
+ * A concurrent cache of decode info keyed by instruction pc and encoding which
+ * may be shared by any number of #dynamorio::drmemtrace::decode_cache_t
+ * objects with the same DecodeInfo type, typically one per shard, in any
+ * worker thread and in any analysis tool.  This avoids decoding the same
+ * instruction and holding its decode info once per shard.
+ *
+ * Lookups do not take locks.  The entries are split among independently
+ * locked shards by hash for inserts.  An entry is never changed or removed once
+ * added, since a changed encoding at the same pc, as in JIT code, is a
+ * different key; entries are freed when the shared cache is destroyed.  The
+ * DecodeInfo objects are thus read concurrently by all threads and must not be
+ * modified by users.
+ *
+ * Attach a shared cache to a #dynamorio::drmemtrace::decode_cache_t with
+ * #dynamorio::drmemtrace::decode_cache_t::set_shared_cache().
+ */
+template <class DecodeInfo> class shared_decode_cache_t {
+public:
+    shared_decode_cache_t()
+    {
+        for (shard_t &shard : shards_) {
+            shard.tables.emplace_back(new table_t(INITIAL_CAPACITY));
+            shard.table.store(shard.tables.back().get(), std::memory_order_relaxed);
+        }
+    }
+    ~shared_decode_cache_t()
+    {
+        for (shard_t &shard : shards_) {
+            table_t *table = shard.table.load(std::memory_order_relaxed);
+            for (size_t i = 0; i <= table->mask; ++i)
+                delete table->slots[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Returns the statistics accumulated so far.
+     */
+    shared_decode_cache_stats_t
+    get_stats()
+    {
+        shared_decode_cache_stats_t stats;
+        for (shard_t &shard : shards_) {
+            std::lock_guard<std::mutex> guard(shard.mutex);
+            stats.hits += shard.hits.load(std::memory_order_relaxed);
+            stats.decodes += shard.decodes.load(std::memory_order_relaxed);
+            stats.duplicate_decodes +=
+                shard.duplicate_decodes.load(std::memory_order_relaxed);
+            stats.entries += shard.count;
+        }
+        stats.lookups = stats.hits + stats.decodes + stats.duplicate_decodes;
+        return stats;
+    }
+
+private:
+    template <class T> friend class decode_cache_t;
+
+    // Encodings are compared in full, so the hash only spreads the keys.
+    struct entry_t {
+        app_pc pc = nullptr;
+        uint64_t hash = 0;
+        // Zero when the encoding comes from the module mapper, where it cannot
+        // change for a pc.
+        size_t encoding_size = 0;
+        unsigned char encoding[MAX_ENCODING_LENGTH];
+        DecodeInfo info;
+
+        bool
+        matches(const entry_t &key) const
+        {
+            return pc == key.pc && encoding_size == key.encoding_size &&
+                memcmp(encoding, key.encoding, encoding_size) == 0;
+        }
+    };
+    // An open-addressed table of entries, replaced by a larger copy as it fills.
+    // Replaced tables are kept alive as lookups may still be reading them.
+    struct table_t {
+        explicit table_t(size_t capacity)
+            : mask(capacity - 1)
+            , slots(new std::atomic<entry_t *>[capacity])
+        {
+            for (size_t i = 0; i < capacity; ++i)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+        size_t mask;
+        std::unique_ptr<std::atomic<entry_t *>[]> slots;
+    };
+    struct shard_t {
+        std::atomic<table_t *> table;
+        // Guards inserts, count, and tables.
+        std::mutex mutex;
+        size_t count = 0;
+        std::vector<std::unique_ptr<table_t>> tables;
+        std::atomic<uint64_t> hits { 0 };
+        std::atomic<uint64_t> decodes { 0 };
+        std::atomic<uint64_t> duplicate_decodes { 0 };
+    };
+    static constexpr int SHARD_BITS = 6;
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    static void
+    set_key(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+            bool use_module_mapper, entry_t &key)
+    {
+        key.pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        key.encoding_size = use_module_mapper
+            ? 0
+            : std::min(static_cast<size_t>(memref_instr.size),
+                       static_cast<size_t>(MAX_ENCODING_LENGTH));
+        memcpy(key.encoding, memref_instr.encoding, key.encoding_size);
+        // FNV-1a over the encoding, then the splitmix64 finalizer with the pc.
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < key.encoding_size; ++i)
+            hash = (hash ^ key.encoding[i]) * 0x100000001b3ULL;
+        hash ^= reinterpret_cast<uint64_t>(key.pc);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        key.hash = hash ^ (hash >> 31);
+    }
+
+    shard_t &
+    get_shard(uint64_t hash)
+    {
+        return shards_[hash >> (64 - SHARD_BITS)];
+    }
+
+    // Returns the matching entry or nullptr.  Safe without the shard lock.
+    static entry_t *
+    find_in_table(const table_t *table, const entry_t &key, size_t *empty_slot = nullptr)
+    {
+        for (size_t i = key.hash & table->mask;; i = (i + 1) & table->mask) {
+            entry_t *entry = table->slots[i].load(std::memory_order_acquire);
+            if (entry == nullptr) {
+                if (empty_slot != nullptr)
+                    *empty_slot = i;
+                return nullptr;
+            }
+            if (entry->hash == key.hash && entry->matches(key))
+                return entry;
+        }
+    }
+
+    // Returns the decode info for the instruction in memref_instr, calling
+    // decode(DecodeInfo &) to fill in a new one if there is none yet.
+    template <typename DecodeFunc>
+    DecodeInfo *
+    find_or_add(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+                bool use_module_mapper, DecodeFunc decode)
+    {
+        std::unique_ptr<entry_t> entry(new entry_t());
+        set_key(memref_instr, use_module_mapper, *entry);
+        shard_t &shard = get_shard(entry->hash);
+        entry_t *found =
+            find_in_table(shard.table.load(std::memory_order_acquire), *entry);
+        if (found != nullptr) {
+            shard.hits.fetch_add(1, std::memory_order_relaxed);
+            return &found->info;
+        }
+        // Decode outside the lock; another thread may be decoding the same
+        // instruction, in which case the first one added wins.
+        decode(entry->info);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        table_t *table = shard.table.load(std::memory_order_relaxed);
+        size_t slot;
+        found = find_in_table(table, *entry, &slot);
+        if (found != nullptr) {
+            shard.duplicate_decodes.fetch_add(1, std::memory_order_relaxed);
+            return &found->info;
+        }
+        // Keep the load factor at most 1/2 so probe sequences stay short.
+        if ((shard.count + 1) * 2 > table->mask + 1) {
+            table_t *larger = new table_t((table->mask + 1) * 2);
+            for (size_t i = 0; i <= table->mask; ++i) {
+                entry_t *old = table->slots[i].load(std::memory_order_relaxed);
+                if (old == nullptr)
+                    continue;
+                size_t j = old->hash & larger->mask;
+                while (larger->slots[j].load(std::memory_order_relaxed) != nullptr)
+                    j = (j + 1) & larger->mask;
+                larger->slots[j].store(old, std::memory_order_relaxed);
+            }
+            shard.tables.emplace_back(larger);
+            shard.table.store(larger, std::memory_order_release);
+            table = larger;
+            find_in_table(table, *entry, &slot);
+        }
+        ++shard.count;
+        shard.decodes.fetch_add(1, std::memory_order_relaxed);
+        table->slots[slot].store(entry.get(), std::memory_order_release);
+        return &entry.release()->info;
+    }
+
+    shard_t shards_[1 << SHARD_BITS];
+};
+
 /**
  * A cache to store decode info for instructions per observed app pc. The template arg
  * DecodeInfo is a class derived from #dynamorio::drmemtrace::decode_info_base_t which
@@ -330,6 +554,12 @@ public:
     DecodeInfo *
     get_decode_info(app_pc pc)
     {
+        if (shared_cache_) {
+            auto shared_it = shared_entries_.find(pc);
+            if (shared_it == shared_entries_.end())
+                return nullptr;
+            return shared_it->second;
+        }
         auto it = decode_cache_.find(pc);
         if (it == decode_cache_.end()) {
             return nullptr;
@@ -365,6 +595,8 @@ public:
         if (!init_done_) {
             return "init() must be called first";
         }
+        if (shared_cache_)
+            return add_shared_decode_info(memref_instr, cached_decode_info);
         const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
 
         // XXX: Simplify using try_emplace when we upgrade to C++17.
@@ -398,42 +630,33 @@ public:
             info->second = DecodeInfo();
         }
         cached_decode_info = &info->second;
+        return decode_into(memref_instr, info->second);
+    }
 
-        // Get address for the instr encoding raw bytes.
-        app_pc decode_pc;
-        if (!use_module_mapper_) {
-            decode_pc = const_cast<app_pc>(memref_instr.encoding);
-        } else {
-            // Legacy trace support where we need the binaries.
-            std::string err = find_mapped_trace_address(trace_pc, decode_pc);
-            if (!err.empty()) {
-                cached_decode_info->error_string_ = err;
-                return err;
-            }
-        }
-
-        // Optionally decode the instruction.
-        instr_t *instr = nullptr;
-        instr_noalloc_t noalloc;
-        if (include_decoded_instr_) {
-            if (persist_decoded_instr_) {
-                instr = instr_create(dcontext_);
-            } else {
-                instr_noalloc_init(dcontext_, &noalloc);
-                instr = instr_from_noalloc(&noalloc);
-            }
-
-            app_pc next_pc = decode_from_copy(dcontext_, decode_pc, trace_pc, instr);
-            if (next_pc == nullptr || !instr_valid(instr)) {
-                if (persist_decoded_instr_) {
-                    instr_destroy(dcontext_, instr);
-                }
-                cached_decode_info->error_string_ = "decode_from_copy failed";
-                return cached_decode_info->get_error_string();
-            }
+    /**
+     * Makes this cache look up and add decode info in \p shared_cache, which
+     * may also be used by other #dynamorio::drmemtrace::decode_cache_t objects
+     * concurrently, instead of decoding each instruction itself. This cache
+     * then only keeps a map from each pc to the shared decode info for its
+     * latest instruction. The DecodeInfo objects returned by
+     * add_decode_info() and get_decode_info() are then shared and must not be
+     * modified.
+     *
+     * All caches using the same \p shared_cache must be constructed with the
+     * same \p include_decoded_instr and \p persist_decoded_instr parameters,
+     * and must be initialized to use the embedded encodings or the module
+     * mapper alike.
+     *
+     * Must be called before init(). Returns an error string on failure.
+     */
+    std::string
+    set_shared_cache(std::shared_ptr<shared_decode_cache_t<DecodeInfo>> shared_cache)
+    {
+        if (init_done_) {
+            return "set_shared_cache() must be called before init()";
         }
-        info->second.set_decode_info(dcontext_, memref_instr, instr, decode_pc);
-        return info->second.get_error_string();
+        shared_cache_ = std::move(shared_cache);
+        return "";
     }
 
     /**
@@ -552,10 +775,79 @@ public:
         // Just a clear() does not release all memory held by the unordered_map. So we
         // need to fully replace it with a new one.
         decode_cache_ = std::unordered_map<app_pc, DecodeInfo>();
+        // The shared entries themselves remain in the shared cache.
+        shared_entries_ = std::unordered_map<app_pc, DecodeInfo *>();
     }
 
 private:
+    std::string
+    add_shared_decode_info(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+                           DecodeInfo *&cached_decode_info)
+    {
+        const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        DecodeInfo *&shared_info = shared_entries_[trace_pc];
+        // The same conditions as for reusing a private entry in add_decode_info().
+        // A new encoding is looked up again as it may have been seen before by
+        // any user of the shared cache.
+        if (shared_info == nullptr ||
+            (!use_module_mapper_ && memref_instr.encoding_is_new)) {
+            shared_info = shared_cache_->find_or_add(
+                memref_instr, use_module_mapper_,
+                [this, &memref_instr](DecodeInfo &info) {
+                    decode_into(memref_instr, info);
+                });
+        }
+        cached_decode_info = shared_info;
+        return shared_info->get_error_string();
+    }
+
+    // Fills in the default-constructed \p info for \p memref_instr.
+    std::string
+    decode_into(const dynamorio::drmemtrace::_memref_instr_t &memref_instr,
+                DecodeInfo &info)
+    {
+        const app_pc trace_pc = reinterpret_cast<app_pc>(memref_instr.addr);
+        // Get address for the instr encoding raw bytes.
+        app_pc decode_pc;
+        if (!use_module_mapper_) {
+            decode_pc = const_cast<app_pc>(memref_instr.encoding);
+        } else {
+            // Legacy trace support where we need the binaries.
+            std::string err = find_mapped_trace_address(trace_pc, decode_pc);
+            if (!err.empty()) {
+                info.error_string_ = err;
+                return err;
+            }
+        }
+
+        // Optionally decode the instruction.
+        instr_t *instr = nullptr;
+        instr_noalloc_t noalloc;
+        if (include_decoded_instr_) {
+            if (persist_decoded_instr_) {
+                instr = instr_create(dcontext_);
+            } else {
+                instr_noalloc_init(dcontext_, &noalloc);
+                instr = instr_from_noalloc(&noalloc);
+            }
+
+            app_pc next_pc = decode_from_copy(dcontext_, decode_pc, trace_pc, instr);
+            if (next_pc == nullptr || !instr_valid(instr)) {
+                if (persist_decoded_instr_) {
+                    instr_destroy(dcontext_, instr);
+                }
+                info.error_string_ = "decode_from_copy failed";
+                return info.get_error_string();
+            }
+        }
+        info.set_decode_info(dcontext_, memref_instr, instr, decode_pc);
+        return info.get_error_string();
+    }
+
     std::unordered_map<app_pc, DecodeInfo> decode_cache_;
+    std::shared_ptr<shared_decode_cache_t<DecodeInfo>> shared_cache_;
+    // Used instead of decode_cache_ with a shared cache.
+    std::unordered_map<app_pc, DecodeInfo *> shared_entries_;
     void *dcontext_ = nullptr;
     std::mutex dcontext_mutex_;
     bool include_decoded_instr_ = false;
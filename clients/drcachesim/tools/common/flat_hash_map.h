@@ -0,0 +1,543 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/**
+ * flat_hash_map.h: an open-addressing hash table for the per-access state kept
+ * by analysis tools.
+ *
+ * Entries live in a single flat allocation alongside one control byte per slot,
+ * so a lookup costs one probe of a 16-byte control group (compared with SSE2 where
+ * available) and usually a single cache line of entry storage, with no per-entry
+ * heap allocation.  It implements the subset of the std::unordered_map interface
+ * the tools use.  Iteration order is unspecified, as with std::unordered_map, and
+ * any insertion may invalidate iterators and references.
+ */
+
+#ifndef _FLAT_HASH_MAP_H_
+#define _FLAT_HASH_MAP_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define FLAT_HASH_MAP_SSE2 1
+#endif
+
+namespace dynamorio {
+namespace drmemtrace {
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class flat_hash_map_t {
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    // Unlike std::unordered_map the key is not const, which lets entries be
+    // relocated on growth.  Callers must not modify keys.
+    using value_type = std::pair<Key, Value>;
+    using size_type = size_t;
+
+private:
+    template <bool IsConst> class iterator_base_t {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = flat_hash_map_t::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = typename std::conditional<IsConst, const value_type *,
+                                                  value_type *>::type;
+        using reference = typename std::conditional<IsConst, const value_type &,
+                                                    value_type &>::type;
+        using map_pointer = typename std::conditional<IsConst, const flat_hash_map_t *,
+                                                      flat_hash_map_t *>::type;
+
+        iterator_base_t() = default;
+        iterator_base_t(map_pointer map, size_t index)
+            : map_(map)
+            , index_(index)
+        {
+            skip_unused();
+        }
+        // Allow iterator to const_iterator conversion.
+        template <bool OtherConst,
+                  typename = typename std::enable_if<IsConst && !OtherConst>::type>
+        iterator_base_t(const iterator_base_t<OtherConst> &other)
+            : map_(other.map_)
+            , index_(other.index_)
+        {
+        }
+        reference
+        operator*() const
+        {
+            return map_->slots_[index_];
+        }
+        pointer
+        operator->() const
+        {
+            return &map_->slots_[index_];
+        }
+        iterator_base_t &
+        operator++()
+        {
+            ++index_;
+            skip_unused();
+            return *this;
+        }
+        iterator_base_t
+        operator++(int)
+        {
+            iterator_base_t orig = *this;
+            ++*this;
+            return orig;
+        }
+        template <bool OtherConst>
+        bool
+        operator==(const iterator_base_t<OtherConst> &rhs) const
+        {
+            return index_ == rhs.index_;
+        }
+        template <bool OtherConst>
+        bool
+        operator!=(const iterator_base_t<OtherConst> &rhs) const
+        {
+            return index_ != rhs.index_;
+        }
+
+    private:
+        friend class flat_hash_map_t;
+        template <bool> friend class iterator_base_t;
+        void
+        skip_unused()
+        {
+            while (index_ < map_->capacity_ && !is_full(map_->ctrl_[index_]))
+                ++index_;
+        }
+        map_pointer map_ = nullptr;
+        size_t index_ = 0;
+    };
+
+public:
+    using iterator = iterator_base_t<false>;
+    using const_iterator = iterator_base_t<true>;
+
+    flat_hash_map_t() = default;
+    flat_hash_map_t(const flat_hash_map_t &other)
+    {
+        *this = other;
+    }
+    flat_hash_map_t(flat_hash_map_t &&other) noexcept
+    {
+        swap(other);
+    }
+    ~flat_hash_map_t()
+    {
+        release();
+    }
+    flat_hash_map_t &
+    operator=(const flat_hash_map_t &other)
+    {
+        if (this != &other) {
+            clear();
+            reserve(other.size_);
+            for (const value_type &entry : other)
+                insert(entry);
+        }
+        return *this;
+    }
+    flat_hash_map_t &
+    operator=(flat_hash_map_t &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+    void
+    swap(flat_hash_map_t &other) noexcept
+    {
+        std::swap(slots_, other.slots_);
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(deleted_, other.deleted_);
+        std::swap(hash_, other.hash_);
+        std::swap(equal_, other.equal_);
+    }
+
+    iterator
+    begin()
+    {
+        return iterator(this, 0);
+    }
+    iterator
+    end()
+    {
+        return iterator(this, capacity_);
+    }
+    const_iterator
+    begin() const
+    {
+        return const_iterator(this, 0);
+    }
+    const_iterator
+    end() const
+    {
+        return const_iterator(this, capacity_);
+    }
+
+    size_t
+    size() const
+    {
+        return size_;
+    }
+    bool
+    empty() const
+    {
+        return size_ == 0;
+    }
+
+    iterator
+    find(const Key &key)
+    {
+        return iterator(this, find_index(key));
+    }
+    const_iterator
+    find(const Key &key) const
+    {
+        return const_iterator(this, find_index(key));
+    }
+    size_t
+    count(const Key &key) const
+    {
+        return find_index(key) == capacity_ ? 0 : 1;
+    }
+
+    // As with std::unordered_map, returns the existing entry with a false second
+    // value if the key is already present.
+    std::pair<iterator, bool>
+    insert(const value_type &entry)
+    {
+        return emplace(entry.first, entry.second);
+    }
+    template <typename... Args>
+    std::pair<iterator, bool>
+    emplace(const Key &key, Args &&...args)
+    {
+        size_t hash = hash_key(key);
+        size_t index = find_index(key, hash);
+        if (index != capacity_)
+            return std::make_pair(iterator(this, index), false);
+        index = prepare_insert(hash);
+        new (&slots_[index]) value_type(std::piecewise_construct,
+                                        std::forward_as_tuple(key),
+                                        std::forward_as_tuple(std::forward<Args>(args)...));
+        return std::make_pair(iterator(this, index), true);
+    }
+    Value &
+    operator[](const Key &key)
+    {
+        return emplace(key).first->second;
+    }
+
+    size_t
+    erase(const Key &key)
+    {
+        size_t index = find_index(key);
+        if (index == capacity_)
+            return 0;
+        slots_[index].~value_type();
+        --size_;
+        // A probe only continues past a group with no empty slots, so if this
+        // group has one no probe can pass through it and the slot can become
+        // empty again rather than a tombstone.
+        const int8_t *group = ctrl_ + (index & ~(GROUP_WIDTH - 1));
+        if (match_byte(group, CTRL_EMPTY) != 0) {
+            ctrl_[index] = CTRL_EMPTY;
+        } else {
+            ctrl_[index] = CTRL_DELETED;
+            ++deleted_;
+        }
+        return 1;
+    }
+
+    void
+    clear()
+    {
+        if (capacity_ == 0)
+            return;
+        destroy_entries();
+        memset(ctrl_, CTRL_EMPTY, capacity_);
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    // Grows the table so that "count" entries fit without further growth.
+    void
+    reserve(size_t count)
+    {
+        size_t want = GROUP_WIDTH;
+        while (max_load(want) < count)
+            want *= 2;
+        if (want > capacity_)
+            rehash(want);
+    }
+
+private:
+    static constexpr size_t GROUP_WIDTH = 16;
+    // Full slots store the low 7 bits of the hash, so these have the top bit set.
+    static constexpr int8_t CTRL_EMPTY = -128;
+    static constexpr int8_t CTRL_DELETED = -2;
+
+    static bool
+    is_full(int8_t ctrl)
+    {
+        return ctrl >= 0;
+    }
+
+    // Returns a bitmask of the positions in the group whose control byte is "value".
+    static uint32_t
+    match_byte(const int8_t *group, int8_t value)
+    {
+#ifdef FLAT_HASH_MAP_SSE2
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (group[i] == value)
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Returns a bitmask of the empty or deleted positions in the group.
+    static uint32_t
+    match_available(const int8_t *group)
+    {
+#ifdef FLAT_HASH_MAP_SSE2
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            if (!is_full(group[i]))
+                mask |= 1u << i;
+        }
+        return mask;
+#endif
+    }
+
+    static int
+    lowest_bit(uint32_t mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    static size_t
+    max_load(size_t capacity)
+    {
+        return capacity - capacity / 8;
+    }
+
+    size_t
+    hash_key(const Key &key) const
+    {
+        // std::hash is the identity for integers in common implementations, and
+        // cache line addresses differ mostly in their low bits, so we mix the
+        // hash to spread it over both the group index and the control byte.
+        uint64_t hash = static_cast<uint64_t>(hash_(key)) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+
+    static int8_t
+    hash_ctrl(size_t hash)
+    {
+        return static_cast<int8_t>(hash & 0x7f);
+    }
+
+    static size_t
+    hash_group(size_t hash)
+    {
+        return hash >> 7;
+    }
+
+    size_t
+    find_index(const Key &key) const
+    {
+        if (capacity_ == 0)
+            return 0;
+        return find_index(key, hash_key(key));
+    }
+
+    // Returns capacity_ if "key" is not present.
+    size_t
+    find_index(const Key &key, size_t hash) const
+    {
+        if (capacity_ == 0)
+            return 0;
+        const size_t group_mask = capacity_ / GROUP_WIDTH - 1;
+        size_t group = hash_group(hash) & group_mask;
+        const int8_t ctrl = hash_ctrl(hash);
+        // Triangular probing visits every group once when the group count is a
+        // power of two.
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * GROUP_WIDTH;
+            for (uint32_t mask = match_byte(ctrl_ + base, ctrl); mask != 0;
+                 mask &= mask - 1) {
+                size_t index = base + lowest_bit(mask);
+                if (equal_(slots_[index].first, key))
+                    return index;
+            }
+            if (match_byte(ctrl_ + base, CTRL_EMPTY) != 0 || step > group_mask)
+                return capacity_;
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Returns the slot to use for a new entry with "hash", whose key is known to
+    // be absent, and marks it full.
+    size_t
+    prepare_insert(size_t hash)
+    {
+        if (capacity_ == 0)
+            rehash(GROUP_WIDTH);
+        else if (size_ + deleted_ >= max_load(capacity_)) {
+            // Reclaim tombstones in place if they are what filled the table.
+            rehash(size_ >= max_load(capacity_) / 2 ? capacity_ * 2 : capacity_);
+        }
+        size_t index = find_available(ctrl_, capacity_, hash);
+        if (ctrl_[index] == CTRL_DELETED)
+            --deleted_;
+        ctrl_[index] = hash_ctrl(hash);
+        ++size_;
+        return index;
+    }
+
+    static size_t
+    find_available(const int8_t *ctrl, size_t capacity, size_t hash)
+    {
+        const size_t group_mask = capacity / GROUP_WIDTH - 1;
+        size_t group = hash_group(hash) & group_mask;
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * GROUP_WIDTH;
+            uint32_t mask = match_available(ctrl + base);
+            if (mask != 0)
+                return base + lowest_bit(mask);
+            group = (group + step) & group_mask;
+        }
+    }
+
+    // Moves all entries into a new allocation of "new_capacity" slots.  The slots
+    // and control bytes share one allocation so that growth is a single
+    // allocation and lookups touch one block.
+    void
+    rehash(size_t new_capacity)
+    {
+        value_type *new_slots = static_cast<value_type *>(
+            ::operator new(new_capacity * (sizeof(value_type) + 1)));
+        int8_t *new_ctrl = reinterpret_cast<int8_t *>(new_slots + new_capacity);
+        memset(new_ctrl, CTRL_EMPTY, new_capacity);
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (!is_full(ctrl_[i]))
+                continue;
+            size_t hash = hash_key(slots_[i].first);
+            size_t index = find_available(new_ctrl, new_capacity, hash);
+            new_ctrl[index] = hash_ctrl(hash);
+            new (&new_slots[index]) value_type(std::move(slots_[i]));
+            slots_[i].~value_type();
+        }
+        ::operator delete(slots_);
+        slots_ = new_slots;
+        ctrl_ = new_ctrl;
+        capacity_ = new_capacity;
+        deleted_ = 0;
+    }
+
+    void
+    destroy_entries()
+    {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (is_full(ctrl_[i]))
+                slots_[i].~value_type();
+        }
+    }
+
+    void
+    release()
+    {
+        if (capacity_ == 0)
+            return;
+        destroy_entries();
+        ::operator delete(slots_);
+        slots_ = nullptr;
+        ctrl_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    value_type *slots_ = nullptr;
+    int8_t *ctrl_ = nullptr;
+    // Always zero or a power of two no smaller than GROUP_WIDTH.
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t deleted_ = 0;
+    Hash hash_;
+    KeyEqual equal_;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _FLAT_HASH_MAP_H_ */
@@ -51,6 +51,10 @@
 #ifdef HAS_ZIP
 #    include "common/zipfile_ostream.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "common/zstd_ostream.h"
+#endif
+#include "chunk_index.h"
 #include "memref.h"
 #include "memtrace_stream.h"
 #include "raw2trace_shared.h"
@@ -122,7 +126,8 @@ record_filter_tool_create(const std::string &output_dir, uint64_t stop_timestamp
                           const std::string &remove_marker_types,
                           uint64_t trim_before_timestamp, uint64_t trim_after_timestamp,
                           bool encodings2regdeps, const std::string &keep_func_ids,
-                          const std::string &modify_marker_value, unsigned int verbose)
+                          const std::string &modify_marker_value, bool columnar_output,
+                          unsigned int verbose)
 {
     std::vector<
         std::unique_ptr<dynamorio::drmemtrace::record_filter_t::record_filter_func_t>>
@@ -174,18 +179,19 @@ record_filter_tool_create(const std::string &output_dir, uint64_t stop_timestamp
 
     // TODO i#5675: Add other filters.
 
-    return new dynamorio::drmemtrace::record_filter_t(output_dir, std::move(filter_funcs),
-                                                      stop_timestamp, verbose);
+    return new dynamorio::drmemtrace::record_filter_t(
+        output_dir, std::move(filter_funcs), stop_timestamp, verbose, columnar_output);
 }
 
 record_filter_t::record_filter_t(
     const std::string &output_dir,
     std::vector<std::unique_ptr<record_filter_func_t>> filters, uint64_t stop_timestamp,
-    unsigned int verbose)
+    unsigned int verbose, bool columnar_output)
     : output_dir_(output_dir)
     , filters_(std::move(filters))
     , stop_timestamp_(stop_timestamp)
     , verbosity_(verbose)
+    , columnar_output_(columnar_output)
 {
     UNUSED(verbosity_);
     UNUSED(output_prefix_);
@@ -291,6 +297,8 @@ record_filter_t::get_writer(per_shard_t *per_shard, memtrace_stream_t *shard_str
 {
     if (per_shard->output_path.empty())
         return "Error: output_path is empty";
+    if (columnar_output_ && !ends_with(per_shard->output_path, ".zip"))
+        return "Columnar output requires a zipfile input trace";
 #ifdef HAS_ZLIB
     if (ends_with(per_shard->output_path, ".gz")) {
         VPRINT(this, 3, "Using the gzip writer for %s\n", per_shard->output_path.c_str());
@@ -300,11 +308,20 @@ record_filter_t::get_writer(per_shard_t *per_shard, memtrace_stream_t *shard_str
         return "";
     }
 #endif
+#ifdef HAS_ZSTD
+    if (ends_with(per_shard->output_path, ".zst")) {
+        VPRINT(this, 3, "Using the zstd writer for %s\n", per_shard->output_path.c_str());
+        per_shard->file_writer =
+            std::unique_ptr<std::ostream>(new zstd_ostream_t(per_shard->output_path));
+        per_shard->writer = per_shard->file_writer.get();
+        return "";
+    }
+#endif
 #ifdef HAS_ZIP
     if (ends_with(per_shard->output_path, ".zip")) {
         VPRINT(this, 3, "Using the zip writer for %s\n", per_shard->output_path.c_str());
         per_shard->archive_writer = std::unique_ptr<archive_ostream_t>(
-            new zipfile_ostream_t(per_shard->output_path));
+            new zipfile_ostream_t(per_shard->output_path, columnar_output_));
         per_shard->writer = per_shard->archive_writer.get();
         return open_new_chunk(per_shard);
     }
@@ -354,7 +371,11 @@ record_filter_t::open_new_chunk(per_shard_t *shard)
     std::ostringstream stream;
     stream << TRACE_CHUNK_PREFIX << std::setfill('0')
            << std::setw(TRACE_CHUNK_SUFFIX_WIDTH) << shard->chunk_ordinal;
-    err = shard->archive_writer->open_new_component(stream.str());
+    chunk_index_entry_t index_entry;
+    index_entry.instr_ordinal = shard->chunk_ordinal * shard->chunk_size;
+    index_entry.timestamp = shard->last_timestamp;
+    err = shard->archive_writer->open_new_component_with_comment(
+        stream.str(), encode_chunk_index_comment(index_entry));
     if (!err.empty())
         return err;
 
@@ -156,9 +156,12 @@ public:
     };
 
     // stop_timestamp sets a point beyond which no filtering will occur.
+    // columnar_output selects the columnar format from columnar_chunk.h for
+    // zipfile output.
     record_filter_t(const std::string &output_dir,
                     std::vector<std::unique_ptr<record_filter_func_t>> filters,
-                    uint64_t stop_timestamp, unsigned int verbose);
+                    uint64_t stop_timestamp, unsigned int verbose,
+                    bool columnar_output = false);
     ~record_filter_t() override;
     std::string
     initialize_stream(memtrace_stream_t *serial_stream) override;
@@ -335,6 +338,7 @@ private:
     std::vector<std::unique_ptr<record_filter_func_t>> filters_;
     uint64_t stop_timestamp_;
     unsigned int verbosity_;
+    bool columnar_output_;
     const char *output_prefix_ = "[record_filter]";
     // For core-sharded, but used for thread-sharded to simplify the code.
     std::mutex input2info_mutex_;
@@ -70,6 +70,8 @@ namespace drmemtrace {
  * @param[in] modify_marker_value A list of comma-separated pairs of integers representing
  *   <TRACE_MARKER_TYPE_, new_value> to modify the value of all listed TRACE_MARKER_TYPE_
  *   in the trace with their corresponding new_value.
+ * @param[in] columnar_output  If true, zipfile output chunks are written in the
+ *   columnar, delta-encoded format.  This requires a zipfile input trace.
  * @param[in] verbose  Verbosity level for notifications.
  */
 record_analysis_tool_t *
@@ -78,7 +80,8 @@ record_filter_tool_create(const std::string &output_dir, uint64_t stop_timestamp
                           const std::string &remove_marker_types,
                           uint64_t trim_before_timestamp, uint64_t trim_after_timestamp,
                           bool encodings2regdeps, const std::string &keep_func_ids,
-                          const std::string &modify_marker_value, unsigned int verbose);
+                          const std::string &modify_marker_value, bool columnar_output,
+                          unsigned int verbose);
 
 } // namespace drmemtrace
 } // namespace dynamorio
@@ -120,7 +120,7 @@ bool
 histogram_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 {
     shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
-    std::unordered_map<addr_t, uint64_t> *cache_map = nullptr;
+    flat_hash_map_t<addr_t, uint64_t> *cache_map = nullptr;
     addr_t start_addr;
     size_t size;
     if (type_is_instr(memref.instr.type) ||
@@ -1541,6 +1541,12 @@ invariant_checker_t::print_results()
                          "have been disabled.\n";
         }
     }
+    if (knob_verbose_ >= 1) {
+        shared_decode_cache_stats_t stats = shared_decode_cache_->get_stats();
+        std::cerr << "Shared decode cache: " << stats.entries << " entries, "
+                  << stats.hits << " hits, " << stats.decodes << " decodes, "
+                  << stats.duplicate_decodes << " duplicate decodes\n";
+    }
     return true;
 }
 
@@ -1903,6 +1909,7 @@ invariant_checker_t::init_decode_cache(per_shard_t *shard, void *dcontext)
             dcontext,
             /*include_decoded_instr=*/true,
             /*persist_decoded_instrs=*/false));
+    shard->decode_cache_->set_shared_cache(shared_decode_cache_);
     shard->error_ = shard->decode_cache_->init(shard->file_type_);
     return shard->error_.empty();
 }
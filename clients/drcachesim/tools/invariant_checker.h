@@ -299,6 +299,10 @@ protected:
 #endif
 
     void *drcontext_ = dr_standalone_init();
+    // Shared by the decode caches of all shards.
+    std::shared_ptr<shared_decode_cache_t<per_shard_t::decoding_info_t>>
+        shared_decode_cache_ =
+            std::make_shared<shared_decode_cache_t<per_shard_t::decoding_info_t>>();
     std::unordered_map<int, std::unique_ptr<per_shard_t>> shard_map_;
     // This mutex is only needed in parallel_shard_init to initialize shard_map_ with
     // per_shard_t data and set dcontext_t.isa_mode, which is a global resource.
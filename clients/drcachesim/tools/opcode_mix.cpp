@@ -79,6 +79,7 @@ opcode_mix_t::opcode_mix_t(const std::string &module_file_path, unsigned int ver
     , knob_verbose_(verbose)
     , knob_alt_module_dir_(alt_module_dir)
 {
+    shared_decode_cache_ = std::make_shared<shared_decode_cache_t<opcode_data_t>>();
 }
 
 bool
@@ -90,6 +91,7 @@ opcode_mix_t::init_decode_cache(shard_data_t *shard, void *dcontext,
             dcontext,
             /*include_decoded_instr=*/true,
             /*persist_decoded_instrs=*/false, knob_verbose_));
+    shard->decode_cache->set_shared_cache(shared_decode_cache_);
     if (!TESTANY(OFFLINE_FILE_TYPE_ENCODINGS, filetype)) {
         shard->error =
             shard->decode_cache->init(filetype, module_file_path_, knob_alt_module_dir_);
@@ -201,6 +203,24 @@ opcode_mix_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     return true;
 }
 
+bool
+opcode_mix_t::parallel_shard_memrefs_supported()
+{
+    return true;
+}
+
+bool
+opcode_mix_t::parallel_shard_memrefs(void *shard_data, const memref_t *memrefs,
+                                     size_t count)
+{
+    // A direct call per record rather than the analyzer's virtual call.
+    for (size_t i = 0; i < count; ++i) {
+        if (!opcode_mix_t::parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
 std::string
 opcode_mix_t::parallel_shard_error(void *shard_data)
 {
@@ -294,6 +314,12 @@ opcode_mix_t::print_results()
         std::cerr << std::setw(15) << keyvals.second << " : " << std::setw(9)
                   << get_category_names(keyvals.first) << "\n";
     }
+    if (knob_verbose_ > 0) {
+        shared_decode_cache_stats_t stats = shared_decode_cache_->get_stats();
+        std::cerr << "\nShared decode cache: " << stats.entries << " entries, "
+                  << stats.hits << " hits, " << stats.decodes << " decodes, "
+                  << stats.duplicate_decodes << " duplicate decodes\n";
+    }
 
     return true;
 }
@@ -348,10 +374,10 @@ opcode_mix_t::combine_interval_snapshots(
             snap->get_interval_end_timestamp() != interval_end_timestamp) {
             continue;
         }
-        for (const auto opc_count : snap->opcode_counts_) {
+        for (const auto &opc_count : snap->opcode_counts_) {
             super_snap->opcode_counts_[opc_count.first] += opc_count.second;
         }
-        for (const auto cat_count : snap->category_counts_) {
+        for (const auto &cat_count : snap->category_counts_) {
             super_snap->category_counts_[cat_count.first] += cat_count.second;
         }
     }
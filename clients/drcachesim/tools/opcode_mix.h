@@ -45,6 +45,7 @@
 #include "dr_api.h" // Must be before trace_entry.h from analysis_tool.h.
 #include "analysis_tool.h"
 #include "decode_cache.h"
+#include "flat_hash_map.h"
 #include "memref.h"
 #include "raw2trace.h"
 #include "trace_entry.h"
@@ -77,6 +78,13 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    // A subclass overriding parallel_shard_memref() must override these as well,
+    // as parallel_shard_memrefs() calls our version directly.
+    bool
+    parallel_shard_memrefs_supported() override;
+    bool
+    parallel_shard_memrefs(void *shard_data, const memref_t *memrefs,
+                           size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
 
@@ -136,8 +144,8 @@ protected:
     public:
         // Snapshot the counts as cumulative stats, and then converted them to deltas in
         // finalize_interval_snapshots().  Printed interval results are all deltas.
-        std::unordered_map<int, int64_t> opcode_counts_;
-        std::unordered_map<uint, int64_t> category_counts_;
+        flat_hash_map_t<int, int64_t> opcode_counts_;
+        flat_hash_map_t<uint, int64_t> category_counts_;
     };
 
     struct shard_data_t {
@@ -146,8 +154,8 @@ protected:
         }
 
         int64_t instr_count = 0;
-        std::unordered_map<int, int64_t> opcode_counts;
-        std::unordered_map<uint, int64_t> category_counts;
+        flat_hash_map_t<int, int64_t> opcode_counts;
+        flat_hash_map_t<uint, int64_t> category_counts;
         std::string error;
         dynamorio::drmemtrace::memtrace_stream_t *stream = nullptr;
         std::unique_ptr<decode_cache_t<opcode_data_t>> decode_cache;
@@ -174,6 +182,10 @@ protected:
      */
     dcontext_cleanup_last_t dcontext_;
 
+    // Shared by the decode caches of all shards, so each instruction is decoded
+    // once regardless of how many threads or workers execute it.
+    std::shared_ptr<shared_decode_cache_t<opcode_data_t>> shared_decode_cache_;
+
     // These are all optional and unused for OFFLINE_FILE_TYPE_ENCODINGS.
     // XXX: Once we update our toolchains to guarantee C++17 support we could use
     // std::optional here.
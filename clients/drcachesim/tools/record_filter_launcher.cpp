@@ -148,6 +148,14 @@ droption_t<std::string> op_modify_marker_value(
     "sets all TRACE_MARKER_TYPE_CPU_ID == 3 in the trace to core 24 and "
     "TRACE_MARKER_TYPE_PAGE_SIZE == 18 to 2k.");
 
+droption_t<bool> op_filter_columnar(
+    DROPTION_SCOPE_FRONTEND, "filter_columnar", false,
+    "Write the filtered zipfile trace in the columnar format.",
+    "When present, each output chunk is written in the columnar, delta-encoded layout "
+    "used by the post-processor's -compress zip_columnar, which is usually "
+    "smaller than a regular zipfile trace.  It requires a zipfile input trace, "
+    "as the output format otherwise matches the input.");
+
 } // namespace
 
 int
@@ -179,7 +187,7 @@ _tmain(int argc, const TCHAR *targv[])
             op_remove_marker_types.get_value(), op_trim_before_timestamp.get_value(),
             op_trim_after_timestamp.get_value(), op_encodings2regdeps.get_value(),
             op_filter_func_ids.get_value(), op_modify_marker_value.get_value(),
-            op_verbose.get_value()));
+            op_filter_columnar.get_value(), op_verbose.get_value()));
     std::vector<record_analysis_tool_t *> tools;
     tools.push_back(record_filter.get());
 
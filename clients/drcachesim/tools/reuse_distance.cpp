@@ -100,11 +100,17 @@ reuse_distance_t::initialize_shard_type(shard_type_t shard_type)
 }
 
 reuse_distance_t::shard_data_t::shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                                             uint32_t distance_limit, bool verify)
+                                             uint32_t distance_limit, bool verify,
+                                             bool use_tree)
     : distance_limit(distance_limit)
 {
-    ref_list = std::unique_ptr<line_ref_list_t>(
-        new line_ref_list_t(reuse_threshold, skip_dist, verify));
+    if (use_tree) {
+        ref_list = std::unique_ptr<line_ref_list_t>(
+            new line_ref_tree_t(reuse_threshold, verify));
+    } else {
+        ref_list = std::unique_ptr<line_ref_list_t>(
+            new line_ref_list_t(reuse_threshold, skip_dist, verify));
+    }
 }
 
 bool
@@ -118,7 +124,8 @@ reuse_distance_t::parallel_shard_init_stream(int shard_index, void *worker_data,
                                              memtrace_stream_t *stream)
 {
     auto shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                  knobs_.distance_limit, knobs_.verify_skip);
+                                  knobs_.distance_limit, knobs_.verify_skip,
+                                  knobs_.use_tree);
     std::lock_guard<std::mutex> guard(shard_map_mutex_);
     shard->core = stream->get_output_cpuid();
     shard->tid = stream->get_tid();
@@ -166,8 +173,7 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             ++shard->data_refs;
         }
         addr_t tag = memref.data.addr >> line_size_bits_;
-        std::unordered_map<addr_t, line_ref_t *>::iterator it =
-            shard->cache_map.find(tag);
+        auto it = shard->cache_map.find(tag);
         if (it == shard->cache_map.end()) {
             line_ref_t *ref = new line_ref_t(tag);
             // insert into the map
@@ -216,7 +222,8 @@ reuse_distance_t::process_memref(const memref_t &memref)
     const auto &lookup = shard_map_.find(shard_index);
     if (lookup == shard_map_.end()) {
         shard = new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                                 knobs_.distance_limit, knobs_.verify_skip);
+                                 knobs_.distance_limit, knobs_.verify_skip,
+                                 knobs_.use_tree);
         shard->core = serial_stream_->get_output_cpuid();
         shard->tid = serial_stream_->get_tid();
         shard_map_[shard_index] = shard;
@@ -453,7 +460,7 @@ reuse_distance_t::get_aggregated_results()
     // Otherwise, aggregate the per-shard data to get whole-trace data.
     aggregated_results_ = std::unique_ptr<shard_data_t>(
         new shard_data_t(knobs_.distance_threshold, knobs_.skip_list_distance,
-                         knobs_.distance_limit, knobs_.verify_skip));
+                         knobs_.distance_limit, knobs_.verify_skip, knobs_.use_tree));
     for (auto &shard : shard_map_) {
         aggregated_results_->total_refs += shard.second->total_refs;
         aggregated_results_->data_refs += shard.second->data_refs;
@@ -40,6 +40,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -50,6 +51,7 @@
 #include <vector>
 
 #include "analysis_tool.h"
+#include "flat_hash_map.h"
 #include "memref.h"
 #include "reuse_distance_create.h"
 #include "trace_entry.h"
@@ -115,8 +117,8 @@ protected:
     // for computing over different units if for some reason that was desired.
     struct shard_data_t {
         shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                     unsigned int distance_limit, bool verify);
-        std::unordered_map<addr_t, line_ref_t *> cache_map;
+                     unsigned int distance_limit, bool verify, bool use_tree);
+        flat_hash_map_t<addr_t, line_ref_t *> cache_map;
         std::unordered_set<addr_t> pruned_addresses;
         // These are our reuse distance histograms: one for all accesses and one
         // only for data references.  An instruction histogram can be computed by
@@ -291,7 +293,7 @@ struct line_ref_list_t {
     // We may need to move gate_ forward if there are more cache lines
     // than the threshold so that the gate points to the earliest
     // referenced cache line within the threshold.
-    void
+    virtual void
     add_to_front(line_ref_t *ref)
     {
         IF_DEBUG_VERBOSE(3, std::cerr << "Add tag 0x" << std::hex << ref->tag << "\n");
@@ -339,7 +341,7 @@ struct line_ref_list_t {
     }
 
     // Remove the last entry from the distance list.
-    void
+    virtual void
     prune_tail()
     {
         // Make sure the tail pointers are legal.
@@ -372,7 +374,7 @@ struct line_ref_list_t {
     // We need to move the gate_ pointer forward if the referenced cache
     // line is the gate_ cache line or any cache line after.
     // Returns the reuse distance of ref.
-    int64_t
+    virtual int64_t
     move_to_front(line_ref_t *ref)
     {
         IF_DEBUG_VERBOSE(
@@ -452,6 +454,186 @@ struct line_ref_list_t {
     }
 };
 
+// An alternative to the linked list which computes exact distances in O(log N)
+// time for N tracked lines, for working sets too large for the skip list.
+// Each tracked line occupies one slot in a Fenwick (binary indexed) tree indexed
+// by access order: a line's slot is marked while it is the line's most recent
+// access.  The reuse distance of a line is then the number of marked slots after
+// its own.  Slots are handed out in increasing order; once they run out, the
+// live slots are compacted to the front, in order, and the tree is rebuilt, which
+// keeps the tree at most a constant factor larger than the number of lines and
+// costs amortized O(1) per access.
+//
+// The list fields are reused as follows: head_ and tail_ are the most and least
+// recently accessed lines, and line_ref_t.time_stamp holds the line's slot.  The
+// line_ref_t list and skip pointers are unused, and gate_ is not maintained:
+// a reference is distant when its distance exceeds threshold_.
+struct line_ref_tree_t : public line_ref_list_t {
+    std::vector<uint32_t> tree_;       // 1-based Fenwick tree of marked slots
+    std::vector<line_ref_t *> owner_;  // the line occupying each slot, or NULL
+    uint64_t next_slot_ = 0;           // the next unused slot
+    uint64_t tail_slot_ = 0;           // the slot of tail_
+    uint64_t live_ = 0;                // the number of marked slots
+    static constexpr uint64_t MIN_SLOTS = 1024;
+
+    line_ref_tree_t(uint64_t reuse_threshold_, bool verify)
+        : line_ref_list_t(reuse_threshold_, 0, verify)
+        , tree_(MIN_SLOTS + 1, 0)
+        , owner_(MIN_SLOTS, NULL)
+    {
+    }
+
+    ~line_ref_tree_t() override
+    {
+        for (uint64_t slot = tail_slot_; slot < next_slot_; ++slot)
+            delete owner_[slot];
+        // Our nodes are not linked, so keep the base class from walking them.
+        head_ = NULL;
+    }
+
+    void
+    tree_add(uint64_t slot, int delta)
+    {
+        for (uint64_t i = slot + 1; i < tree_.size(); i += i & (~i + 1))
+            tree_[i] += delta;
+    }
+
+    // Returns the number of marked slots in [0, slot].
+    uint64_t
+    tree_prefix(uint64_t slot)
+    {
+        uint64_t sum = 0;
+        for (uint64_t i = slot + 1; i > 0; i -= i & (~i + 1))
+            sum += tree_[i];
+        return sum;
+    }
+
+    // Moves the live slots to the front and sizes the tree to leave room for
+    // at least as many new slots as there are live ones.
+    void
+    compact()
+    {
+        // Avoid std::max, which would odr-use MIN_SLOTS.
+        uint64_t size = 2 * live_;
+        if (size < MIN_SLOTS)
+            size = MIN_SLOTS;
+        std::vector<line_ref_t *> owner(size, NULL);
+        uint64_t count = 0;
+        for (uint64_t slot = tail_slot_; slot < next_slot_; ++slot) {
+            if (owner_[slot] == NULL)
+                continue;
+            owner_[slot]->time_stamp = count;
+            owner[count++] = owner_[slot];
+        }
+        assert(count == live_);
+        owner_.swap(owner);
+        // Build the tree in linear time: each node pushes its sum to its parent.
+        tree_.assign(size + 1, 0);
+        for (uint64_t i = 1; i <= size; ++i) {
+            if (i <= count)
+                ++tree_[i];
+            uint64_t parent = i + (i & (~i + 1));
+            if (parent <= size)
+                tree_[parent] += tree_[i];
+        }
+        next_slot_ = count;
+        tail_slot_ = 0;
+        IF_DEBUG_VERBOSE(2,
+                         std::cerr << "Compacted " << std::dec << count << " lines into "
+                                   << size << " slots\n");
+    }
+
+    void
+    place_at_front(line_ref_t *ref)
+    {
+        if (next_slot_ == owner_.size())
+            compact();
+        ref->time_stamp = next_slot_;
+        owner_[next_slot_] = ref;
+        tree_add(next_slot_, 1);
+        ++next_slot_;
+        ++live_;
+        head_ = ref;
+    }
+
+    void
+    remove_slot(line_ref_t *ref)
+    {
+        uint64_t slot = ref->time_stamp;
+        owner_[slot] = NULL;
+        tree_add(slot, -1);
+        --live_;
+        if (ref == tail_) {
+            if (live_ == 0) {
+                tail_ = NULL;
+                tail_slot_ = next_slot_;
+                return;
+            }
+            // The least recent slot only moves forward, so this scan is
+            // amortized O(1).
+            do
+                ++tail_slot_;
+            while (owner_[tail_slot_] == NULL);
+            tail_ = owner_[tail_slot_];
+        }
+    }
+
+    void
+    add_to_front(line_ref_t *ref) override
+    {
+        IF_DEBUG_VERBOSE(3, std::cerr << "Add tag 0x" << std::hex << ref->tag << "\n");
+        place_at_front(ref);
+        if (tail_ == NULL) {
+            tail_ = ref;
+            tail_slot_ = ref->time_stamp;
+        }
+        unique_lines_++;
+        cur_time_++;
+    }
+
+    void
+    prune_tail() override
+    {
+        assert(tail_ != NULL);
+        assert(tail_ != head_);
+        IF_DEBUG_VERBOSE(3,
+                         std::cerr << "Prune tag 0x" << std::hex << tail_->tag << "\n");
+        remove_slot(tail_);
+    }
+
+    int64_t
+    move_to_front(line_ref_t *ref) override
+    {
+        IF_DEBUG_VERBOSE(
+            3, std::cerr << "Move tag 0x" << std::hex << ref->tag << " to front\n");
+        ref->total_refs++;
+        if (ref == head_)
+            return 0;
+        int64_t dist = static_cast<int64_t>(live_ - tree_prefix(ref->time_stamp));
+        IF_DEBUG_VERBOSE(
+            0, if (verify_skip_) {
+                // Count the later slots directly as a sanity check.
+                int64_t brute_dist = 0;
+                for (uint64_t slot = ref->time_stamp + 1; slot < next_slot_; ++slot) {
+                    if (owner_[slot] != NULL)
+                        ++brute_dist;
+                }
+                if (brute_dist != dist) {
+                    std::cerr << "Mismatch!  Brute=" << std::dec << brute_dist
+                              << " vs tree=" << dist << "\n";
+                    assert(false);
+                }
+            });
+        if (static_cast<uint64_t>(dist) > threshold_)
+            ref->distant_refs++;
+        // There is at least one other line, so tail_ remains non-NULL.
+        remove_slot(ref);
+        place_at_front(ref);
+        cur_time_++;
+        return dist;
+    }
+};
+
 } // namespace drmemtrace
 } // namespace dynamorio
 
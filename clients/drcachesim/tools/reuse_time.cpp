@@ -157,14 +157,16 @@ reuse_time_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 
     shard->time_stamp++;
     addr_t line = memref.data.addr >> line_size_bits_;
-    if (shard->time_map.count(line) > 0) {
-        int64_t reuse_time = shard->time_stamp - shard->time_map[line];
+    // A single probe both finds the previous access and records this one.
+    auto res = shard->time_map.emplace(line, shard->time_stamp);
+    if (!res.second) {
+        int64_t reuse_time = shard->time_stamp - res.first->second;
         if (DEBUG_VERBOSE(3)) {
             std::cerr << "Reuse " << reuse_time << std::endl;
         }
         shard->reuse_time_histogram[reuse_time]++;
+        res.first->second = shard->time_stamp;
     }
-    shard->time_map[line] = shard->time_stamp;
     return true;
 }
 
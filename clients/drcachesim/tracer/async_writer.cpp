@@ -0,0 +1,369 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "async_writer.h"
+
+#include <string.h>
+
+#include "dr_api.h"
+#include "options.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+bool
+async_writer_t::init(uint num_writers, uint num_buffers, size_t buf_size,
+                     size_t trace_size, write_func_t write_func)
+{
+    if (num_writers == 0 || num_buffers == 0 || trace_size > buf_size)
+        return false;
+    num_writers_ = num_writers;
+    num_buffers_ = num_buffers;
+    buf_size_ = buf_size;
+    trace_size_ = trace_size;
+    write_func_ = write_func;
+    lock_ = dr_mutex_create();
+    free_bufs_ = static_cast<byte **>(dr_global_alloc(num_buffers * sizeof(byte *)));
+    items_ = static_cast<item_t *>(dr_global_alloc(num_buffers * sizeof(item_t)));
+    free_items_ = nullptr;
+    for (uint i = 0; i < num_buffers; ++i) {
+        items_[i].next = free_items_;
+        free_items_ = &items_[i];
+    }
+    // The same allocator as create_buffer() so the tracer can free whichever
+    // buffer a thread ends up holding at exit.
+    for (num_free_bufs_ = 0; num_free_bufs_ < num_buffers; ++num_free_bufs_) {
+        byte *buf = static_cast<byte *>(
+            dr_raw_mem_alloc(buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+        if (buf == nullptr)
+            break;
+        // dr_raw_mem_alloc gives us zeroed memory, so only the redzone needs setting.
+        memset(buf + trace_size, -1, buf_size - trace_size);
+        free_bufs_[num_free_bufs_] = buf;
+    }
+    writers_ = static_cast<writer_t *>(dr_global_alloc(num_writers * sizeof(writer_t)));
+    for (uint i = 0; i < num_writers; ++i) {
+        writers_[i].event = dr_event_create();
+        writers_[i].head = nullptr;
+        writers_[i].tail = nullptr;
+        writers_[i].busy = nullptr;
+        writers_[i].parent = this;
+    }
+    // We create the writer threads on the first submit() rather than here:
+    // client threads created during initialization all wait for the
+    // application to start and then race through DR's thread setup, which
+    // fails when there is more than one of them.
+    started_ = false;
+    return true;
+}
+
+void
+async_writer_t::start_threads()
+{
+    // We count the writers as live up front so exit() waits for any that have
+    // not been scheduled yet.
+    dr_atomic_store32(&live_writers_, num_writers_);
+    for (uint i = 0; i < num_writers_; ++i) {
+        if (!dr_create_client_thread(writer_thread, &writers_[i]))
+            FATAL("Fatal error: failed to create trace writer thread\n");
+    }
+}
+
+void
+async_writer_t::exit()
+{
+    if (writers_ == nullptr)
+        return;
+    dr_atomic_store32(&exiting_, 1);
+    for (uint i = 0; i < num_writers_; ++i)
+        dr_event_signal(writers_[i].event);
+    // Client threads are only synchronized after the exit event, so they are
+    // still running here.  We bound the wait anyway in case they never got
+    // scheduled.
+    static const int MAX_WAIT_MS = 5000;
+    for (int waited = 0; dr_atomic_load32(&live_writers_) > 0 && waited < MAX_WAIT_MS;
+         ++waited)
+        dr_sleep(1);
+    if (dr_atomic_load32(&live_writers_) > 0) {
+        // Leak rather than free state a writer might still touch.
+        NOTIFY(0, "drmemtrace trace writer threads failed to exit\n");
+        return;
+    }
+    for (uint i = 0; i < num_writers_; ++i) {
+        DR_ASSERT(writers_[i].head == nullptr);
+        dr_event_destroy(writers_[i].event);
+    }
+    for (uint i = 0; i < num_free_bufs_; ++i)
+        dr_raw_mem_free(free_bufs_[i], buf_size_);
+    dr_global_free(writers_, num_writers_ * sizeof(writer_t));
+    dr_global_free(items_, num_buffers_ * sizeof(item_t));
+    dr_global_free(free_bufs_, num_buffers_ * sizeof(byte *));
+    dr_mutex_destroy(lock_);
+    writers_ = nullptr;
+}
+
+void
+async_writer_t::fork_init()
+{
+    if (writers_ == nullptr)
+        return;
+    // A parent writer may have held the lock across the fork, in which case we
+    // replace it, leaking the old one as its owner is gone.
+    if (dr_mutex_trylock(lock_))
+        dr_mutex_unlock(lock_);
+    else
+        lock_ = dr_mutex_create();
+    // Queued and in-progress parent buffers belong to parent threads and files,
+    // so we discard their data and reclaim the buffers.
+    for (uint i = 0; i < num_writers_; ++i) {
+        if (writers_[i].busy != nullptr)
+            discard_item(writers_[i].busy);
+        for (item_t *item = writers_[i].head, *next; item != nullptr; item = next) {
+            next = item->next;
+            discard_item(item);
+        }
+        writers_[i].head = nullptr;
+        writers_[i].tail = nullptr;
+        writers_[i].busy = nullptr;
+        dr_event_reset(writers_[i].event);
+    }
+    exiting_ = 0;
+    live_writers_ = 0;
+    started_ = false;
+    num_handoffs_ = 0;
+    num_exhausted_ = 0;
+    num_drained_inline_ = 0;
+    num_written_async_ = 0;
+    total_queue_us_ = 0;
+    max_queue_us_ = 0;
+}
+
+async_writer_t::writer_t *
+async_writer_t::writer_for(per_thread_t *data)
+{
+    // Pin each thread to one writer to keep its buffers in order.  The per-thread
+    // data pointers are heap-aligned so we mix them before picking a writer.
+    uint64 hash = static_cast<uint64>(reinterpret_cast<ptr_uint_t>(data)) *
+        0x9e3779b97f4a7c15ULL;
+    return &writers_[(hash >> 32) % num_writers_];
+}
+
+byte *
+async_writer_t::submit(per_thread_t *data, thread_id_t tid, byte *buf, byte *start,
+                       byte *end, ptr_int_t window)
+{
+    writer_t *writer = writer_for(data);
+    uint64 now = dr_get_microseconds();
+    dr_mutex_lock(lock_);
+    if (num_free_bufs_ == 0) {
+        ++num_exhausted_;
+        dr_mutex_unlock(lock_);
+        return nullptr;
+    }
+    byte *fresh = free_bufs_[--num_free_bufs_];
+    item_t *item = free_items_;
+    DR_ASSERT(item != nullptr);
+    free_items_ = item->next;
+    item->data = data;
+    item->tid = tid;
+    item->buf = buf;
+    item->start = start;
+    item->end = end;
+    item->window = window;
+    item->submit_time = now;
+    item->next = nullptr;
+    if (writer->tail == nullptr)
+        writer->head = item;
+    else
+        writer->tail->next = item;
+    writer->tail = item;
+    ++num_handoffs_;
+    dr_atomic_add32_return_sum(&data->async_pending, 1);
+    bool need_start = !started_;
+    started_ = true;
+    dr_mutex_unlock(lock_);
+    if (need_start)
+        start_threads();
+    dr_event_signal(writer->event);
+    return fresh;
+}
+
+void
+async_writer_t::write_item(item_t *item)
+{
+    write_func_(item->data, item->tid, item->start, item->end, item->window);
+    reset_buffer(item);
+    dr_atomic_add32_return_sum(&item->data->async_pending, -1);
+}
+
+void
+async_writer_t::reset_buffer(item_t *item)
+{
+    // Our instrumentation skips the buffer-full clean call while the buffer
+    // content is zero, so we reset the buffer just like
+    // process_and_output_buffer() does, but off of the application thread.
+    memset(item->buf, 0, trace_size_);
+    if (item->end > item->buf + trace_size_)
+        memset(item->buf + trace_size_, -1, item->end - (item->buf + trace_size_));
+}
+
+void
+async_writer_t::discard_item(item_t *item)
+{
+    // Called with lock_ held.
+    reset_buffer(item);
+    dr_atomic_add32_return_sum(&item->data->async_pending, -1);
+    recycle(item);
+}
+
+void
+async_writer_t::recycle(item_t *item)
+{
+    // Called with lock_ held.
+    DR_ASSERT(num_free_bufs_ < num_buffers_);
+    free_bufs_[num_free_bufs_++] = item->buf;
+    item->next = free_items_;
+    free_items_ = item;
+}
+
+void
+async_writer_t::writer_thread(void *arg)
+{
+    writer_t *writer = static_cast<writer_t *>(arg);
+    async_writer_t *self = writer->parent;
+    while (true) {
+        dr_mutex_lock(self->lock_);
+        item_t *item = writer->head;
+        if (item == nullptr) {
+            dr_mutex_unlock(self->lock_);
+            if (dr_atomic_load32(&self->exiting_) != 0)
+                break;
+            // The event is auto-reset and stays set if signaled while we
+            // were busy, so we cannot miss a submit.
+            dr_event_wait(writer->event);
+            continue;
+        }
+        writer->head = item->next;
+        if (writer->head == nullptr)
+            writer->tail = nullptr;
+        writer->busy = item;
+        uint64 queued = dr_get_microseconds() - item->submit_time;
+        ++self->num_written_async_;
+        self->total_queue_us_ += queued;
+        if (queued > self->max_queue_us_)
+            self->max_queue_us_ = queued;
+        dr_mutex_unlock(self->lock_);
+
+        self->write_item(item);
+
+        dr_mutex_lock(self->lock_);
+        writer->busy = nullptr;
+        self->recycle(item);
+        dr_mutex_unlock(self->lock_);
+    }
+    dr_atomic_add32_return_sum(&self->live_writers_, -1);
+    // We park here rather than returning and leave it to DR to terminate us
+    // after the exit event, as it does for every client thread.  A client
+    // thread exiting on its own during process exit has been seen to die
+    // partway through DR's cleanup once it was suspended for a fork,
+    // leaving DR waiting on it forever.  We touch none of our state from
+    // here on, so exit() is free to delete it.
+    while (true)
+        dr_sleep(1000);
+}
+
+void
+async_writer_t::drain(per_thread_t *data)
+{
+    if (writers_ == nullptr || dr_atomic_load32(&data->async_pending) == 0)
+        return;
+    writer_t *writer = writer_for(data);
+    // Take back our buffers the writer has not started on, preserving order.
+    item_t *mine = nullptr, *mine_tail = nullptr;
+    dr_mutex_lock(lock_);
+    item_t *prev = nullptr;
+    for (item_t *item = writer->head, *next; item != nullptr; item = next) {
+        next = item->next;
+        if (item->data != data) {
+            prev = item;
+            continue;
+        }
+        if (prev == nullptr)
+            writer->head = next;
+        else
+            prev->next = next;
+        if (writer->tail == item)
+            writer->tail = prev;
+        item->next = nullptr;
+        if (mine_tail == nullptr)
+            mine = item;
+        else
+            mine_tail->next = item;
+        mine_tail = item;
+        ++num_drained_inline_;
+    }
+    // Our oldest buffer may be in progress: it must land in the file first.
+    while (writer->busy != nullptr && writer->busy->data == data) {
+        dr_mutex_unlock(lock_);
+        dr_thread_yield();
+        dr_mutex_lock(lock_);
+    }
+    dr_mutex_unlock(lock_);
+    for (item_t *item = mine, *next; item != nullptr; item = next) {
+        next = item->next;
+        write_item(item);
+        dr_mutex_lock(lock_);
+        recycle(item);
+        dr_mutex_unlock(lock_);
+    }
+    DR_ASSERT(dr_atomic_load32(&data->async_pending) == 0);
+}
+
+void
+async_writer_t::print_stats()
+{
+    if (writers_ == nullptr)
+        return;
+    NOTIFY(1,
+           "drmemtrace async writers: " UINT64_FORMAT_STRING " buffer handoffs, "
+           UINT64_FORMAT_STRING " written inline with the pool exhausted, "
+           UINT64_FORMAT_STRING " drained inline; queue latency avg " UINT64_FORMAT_STRING
+           "us max " UINT64_FORMAT_STRING "us.\n",
+           num_handoffs_, num_exhausted_, num_drained_inline_,
+           num_written_async_ == 0 ? 0 : total_queue_us_ / num_written_async_,
+           max_queue_us_);
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
@@ -0,0 +1,160 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* async_writer: moves compression and file writes of full offline trace
+ * buffers off of application threads.
+ */
+
+#ifndef _ASYNC_WRITER_H_
+#define _ASYNC_WRITER_H_ 1
+
+#include "dr_api.h"
+#include "tracer.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Hands full trace buffers to a small pool of DR client threads which
+// compress and write them, while the application thread continues in a
+// fresh buffer taken from a preallocated pool.  Each application thread is
+// pinned to one writer so its buffers reach its file in order and its
+// compression state is only ever used by one thread at a time.
+//
+// We use DR locks and events and raw arrays rather than C++ containers so
+// this works when drmemtrace is statically linked into the application.
+class async_writer_t {
+public:
+    // Writes [start, end) to the file of the thread owning data.  This is
+    // called on writer threads and on application threads draining their
+    // own queued buffers, but never concurrently for the same data.
+    typedef void (*write_func_t)(per_thread_t *data, thread_id_t tid, byte *start,
+                                 byte *end, ptr_int_t window);
+
+    // Allocates num_buffers spare trace buffers of buf_size bytes, of which
+    // the first trace_size bytes are zeroed and the rest are the redzone.
+    // The num_writers client threads are started by the first submit().
+    bool
+    init(uint num_writers, uint num_buffers, size_t buf_size, size_t trace_size,
+         write_func_t write_func);
+    // Stops the writer threads and frees the spare buffers.  All threads must
+    // have drained their buffers beforehand.
+    void
+    exit();
+    // Called in a fork child, which inherits our state but none of our threads.
+    void
+    fork_init();
+
+    // Queues [start, end) of buf, a whole trace buffer owned by the calling
+    // thread, for writing and returns a fresh buffer to continue tracing
+    // into; the writer takes ownership of buf and recycles it once written.
+    // Returns nullptr when no spare buffer is available, in which case the
+    // caller keeps buf and must write the data itself after calling drain().
+    byte *
+    submit(per_thread_t *data, thread_id_t tid, byte *buf, byte *start, byte *end,
+           ptr_int_t window);
+
+    // Returns once every buffer submitted for data has been written.  Buffers
+    // the writer has not yet picked up are written on the calling thread.
+    // This must be called before any other access to data's output file.
+    void
+    drain(per_thread_t *data);
+
+    // Prints handoff and latency statistics under -verbose 1.
+    void
+    print_stats();
+
+private:
+    struct item_t {
+        per_thread_t *data;
+        thread_id_t tid;
+        byte *buf;
+        byte *start;
+        byte *end;
+        ptr_int_t window;
+        uint64 submit_time;
+        item_t *next;
+    };
+    struct writer_t {
+        void *event;
+        item_t *head;
+        item_t *tail;
+        // The item being written right now, if any.
+        item_t *busy;
+        async_writer_t *parent;
+    };
+
+    static void
+    writer_thread(void *arg);
+    void
+    write_item(item_t *item);
+    void
+    reset_buffer(item_t *item);
+    void
+    discard_item(item_t *item);
+    void
+    recycle(item_t *item);
+    void
+    start_threads();
+    writer_t *
+    writer_for(per_thread_t *data);
+
+    void *lock_ = nullptr;
+    writer_t *writers_ = nullptr;
+    uint num_writers_ = 0;
+    // Spare buffers and unused item_t records: each submit consumes one of
+    // each, so there are never more items in flight than buffers.
+    byte **free_bufs_ = nullptr;
+    uint num_free_bufs_ = 0;
+    uint num_buffers_ = 0;
+    item_t *items_ = nullptr;
+    item_t *free_items_ = nullptr;
+    size_t buf_size_ = 0;
+    size_t trace_size_ = 0;
+    write_func_t write_func_ = nullptr;
+    // Whether start_threads() has been called, protected by lock_.
+    bool started_ = false;
+    volatile int exiting_ = 0;
+    volatile int live_writers_ = 0;
+
+    // Statistics, protected by lock_.
+    uint64 num_handoffs_ = 0;
+    uint64 num_exhausted_ = 0;
+    uint64 num_drained_inline_ = 0;
+    uint64 num_written_async_ = 0;
+    uint64 total_queue_us_ = 0;
+    uint64 max_queue_us_ = 0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _ASYNC_WRITER_H_ */
@@ -44,6 +44,7 @@
 #include <cstring>
 #include <string>
 
+#include "async_writer.h"
 #include "dr_api.h"
 #include "drmemtrace.h"
 #include "drmgr.h"
@@ -58,6 +59,9 @@
 #include "trace_entry.h"
 #include "tracer.h"
 #include "utils.h"
+#ifdef HAS_IO_URING
+#    include "uring_writer.h"
+#endif
 #ifdef HAS_SNAPPY
 #    include <snappy.h>
 
@@ -69,6 +73,9 @@
 #ifdef HAS_LZ4
 #    include <lz4frame.h>
 #endif
+#ifdef HAS_ZSTD
+#    include <zstd.h>
+#endif
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -267,6 +274,84 @@ snappy_enabled()
 }
 #endif
 
+/* For -async_writers. */
+static async_writer_t async_writer;
+static bool async_writer_enabled;
+
+/* For -raw_io_uring, which only applies to thread files. */
+#ifdef HAS_IO_URING
+static uring_writer_t uring_writer;
+// Staging chunk size: large enough to amortize each submission while keeping
+// the chunk held by each thread's partially filled file small.
+static const size_t URING_CHUNK_SIZE = 256 * 1024;
+#endif
+static bool uring_enabled;
+
+static file_t
+open_thread_file(const char *fname, uint mode_flags, thread_id_t tid, int64 window)
+{
+#ifdef HAS_IO_URING
+    if (uring_enabled)
+        return uring_writer.open_file(fname, mode_flags);
+#endif
+    return file_ops_func.call_open_file(fname, mode_flags, tid, window);
+}
+
+static ssize_t
+write_thread_file(file_t f, const void *data, size_t count)
+{
+#ifdef HAS_IO_URING
+    if (uring_enabled)
+        return uring_writer.write_file(f, data, count);
+#endif
+    return file_ops_func.write_file(f, data, count);
+}
+
+static void
+close_thread_file_handle(file_t f)
+{
+#ifdef HAS_IO_URING
+    if (uring_enabled) {
+        uring_writer.close_file(f);
+        return;
+    }
+#endif
+    file_ops_func.close_file(f);
+}
+
+#ifdef HAS_ZSTD
+// Raw files favor speed: level 1 keeps up with fast storage while still
+// compressing far better than lz4.
+#    define ZSTD_RAW_LEVEL 1
+
+static inline bool
+zstd_enabled()
+{
+    return op_offline.get_value() && op_raw_compress.get_value() == "zstd";
+}
+
+// Compresses "size" bytes at "src" and writes out the result, ending the frame
+// if "end" is set.  Returns false on a compression or write error.
+static bool
+zstd_compress_and_write(per_thread_t *data, const void *src, size_t size, bool end)
+{
+    ZSTD_inBuffer in = { src, size, 0 };
+    size_t remaining;
+    do {
+        ZSTD_outBuffer out = { data->buf_zstd, data->buf_zstd_size, 0 };
+        remaining = ZSTD_compressStream2(data->zstd_cctx, &out, &in,
+                                         end ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining))
+            return false;
+        if (out.pos > 0 &&
+            write_thread_file(data->file, data->buf_zstd, out.pos) <
+                static_cast<ssize_t>(out.pos))
+            return false;
+    } while (end ? remaining != 0 : in.pos < in.size);
+    return true;
+}
+#endif
+
 #ifdef HAS_ZLIB
 static void *
 redirect_malloc(void *drcontext, uint items, uint per_size)
@@ -338,6 +423,8 @@ static void
 close_thread_file(void *drcontext)
 {
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (async_writer_enabled)
+        async_writer.drain(data);
 #ifdef HAS_SNAPPY
     if (op_offline.get_value() && snappy_enabled()) {
         data->snappy_writer->~snappy_file_writer_t();
@@ -362,8 +449,8 @@ close_thread_file(void *drcontext)
             NOTIFY(3, "final deflate => %d in=%d out=%d => in=%d, out=%d, wrote=%d\n",
                    res, 0, max_buf_size, data->zstream.avail_in, data->zstream.avail_out,
                    max_buf_size - data->zstream.avail_out);
-            file_ops_func.write_file(data->file, data->buf_compressed,
-                                     max_buf_size - data->zstream.avail_out);
+            write_thread_file(data->file, data->buf_compressed,
+                              max_buf_size - data->zstream.avail_out);
         } while ((res == Z_OK || res == Z_BUF_ERROR) && ++iters < MAX_ITERS);
         DR_ASSERT(res == Z_STREAM_END);
         deflateEnd(&data->zstream);
@@ -375,12 +462,21 @@ close_thread_file(void *drcontext)
         size_t res =
             LZ4F_compressEnd(data->lzcxt, data->buf_lz4, data->buf_lz4_size, nullptr);
         DR_ASSERT(!LZ4F_isError(res));
-        file_ops_func.write_file(data->file, data->buf_lz4, res);
+        write_thread_file(data->file, data->buf_lz4, res);
         res = LZ4F_freeCompressionContext(data->lzcxt);
         DR_ASSERT(!LZ4F_isError(res));
     }
 #endif
-    file_ops_func.close_file(data->file);
+#ifdef HAS_ZSTD
+    if (zstd_enabled()) {
+        // Flush remaining data and end the frame.
+        bool ok = zstd_compress_and_write(data, nullptr, 0, /*end=*/true);
+        DR_ASSERT(ok);
+        ZSTD_freeCCtx(data->zstd_cctx);
+        data->zstd_cctx = nullptr;
+    }
+#endif
+    close_thread_file_handle(data->file);
     data->file = INVALID_FILE;
 }
 
@@ -391,6 +487,9 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     bool opened_new_file = false;
     DR_ASSERT(op_offline.get_value());
+    // Queued buffers belong in the current file.
+    if (async_writer_enabled)
+        async_writer.drain(data);
     const char *dir = logsubdir;
     char windir[MAXIMUM_PATH];
     if (has_tracing_windows()) {
@@ -429,14 +528,18 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
 #ifdef HAS_LZ4
     if (op_raw_compress.get_value() == "lz4")
         suffix = OUTFILE_SUFFIX_LZ4;
+#endif
+#ifdef HAS_ZSTD
+    if (op_raw_compress.get_value() == "zstd")
+        suffix = OUTFILE_SUFFIX_ZSTD;
 #endif
     for (i = 0; i < NUM_OF_TRIES; i++) {
         drx_open_unique_appid_file(dir, dr_get_thread_id(drcontext), subdir_prefix,
                                    suffix, DRX_FILE_SKIP_OPEN, buf,
                                    BUFFER_SIZE_ELEMENTS(buf));
         NULL_TERMINATE_BUFFER(buf);
-        file_t new_file = file_ops_func.call_open_file(
-            buf, flags, dr_get_thread_id(drcontext), window_num);
+        file_t new_file =
+            open_thread_file(buf, flags, dr_get_thread_id(drcontext), window_num);
         if (new_file == INVALID_FILE)
             continue;
         if (new_file == data->file)
@@ -453,7 +556,7 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
                 nullptr, static_cast<dr_alloc_flags_t>(0), sizeof(*data->snappy_writer),
                 DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr);
             data->snappy_writer = new (placement)
-                snappy_file_writer_t(data->file, file_ops_func.write_file,
+                snappy_file_writer_t(data->file, write_thread_file,
                                      op_raw_compress.get_value() != "snappy_nocrc");
             data->snappy_writer->write_file_header();
         }
@@ -489,9 +592,18 @@ open_new_thread_file(void *drcontext, ptr_int_t window_num)
             res = LZ4F_compressBegin(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
                                      &lz4_ops);
             DR_ASSERT(!LZ4F_isError(res));
-            ssize_t wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
+            ssize_t wrote = write_thread_file(data->file, data->buf_lz4, res);
             DR_ASSERT(static_cast<size_t>(wrote) == res);
         }
+#endif
+#ifdef HAS_ZSTD
+        if (zstd_enabled()) {
+            data->zstd_cctx = ZSTD_createCCtx();
+            DR_ASSERT(data->zstd_cctx != nullptr);
+            size_t res = ZSTD_CCtx_setParameter(data->zstd_cctx,
+                                                ZSTD_c_compressionLevel, ZSTD_RAW_LEVEL);
+            DR_ASSERT(!ZSTD_isError(res));
+        }
 #endif
         break;
     }
@@ -537,68 +649,85 @@ atomic_pipe_write(void *drcontext, byte *pipe_start, byte *pipe_end, ptr_int_t w
     return pipe_start;
 }
 
-static inline byte *
-write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end,
-                 ptr_int_t window)
+// Writes offline trace data for the thread owning data, which may not be the
+// calling thread for -async_writers.
+static void
+write_offline_trace_data(per_thread_t *data, thread_id_t tid, byte *towrite_start,
+                         byte *towrite_end, ptr_int_t window)
 {
-    if (op_offline.get_value()) {
-        per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
-        ssize_t size = towrite_end - towrite_start;
-        DR_ASSERT(data->file != INVALID_FILE);
-        if (file_ops_func.handoff_buf != NULL) {
-            if (!file_ops_func.handoff_buf(data->file, towrite_start, size,
-                                           max_buf_size)) {
-                FATAL("Fatal error: failed to hand off trace\n");
-            }
-        } else {
-            ssize_t wrote;
+    ssize_t size = towrite_end - towrite_start;
+    DR_ASSERT(data->file != INVALID_FILE);
+    if (file_ops_func.handoff_buf != NULL) {
+        if (!file_ops_func.handoff_buf(data->file, towrite_start, size, max_buf_size)) {
+            FATAL("Fatal error: failed to hand off trace\n");
+        }
+    } else {
+        ssize_t wrote;
 #ifdef HAS_SNAPPY
-            if (op_offline.get_value() && snappy_enabled())
-                wrote = data->snappy_writer->compress_and_write(towrite_start, size);
-            else
+        if (op_offline.get_value() && snappy_enabled())
+            wrote = data->snappy_writer->compress_and_write(towrite_start, size);
+        else
 #endif
 #ifdef HAS_ZLIB
-                if (op_offline.get_value() &&
-                    (op_raw_compress.get_value() == "zlib" ||
-                     op_raw_compress.get_value() == "gzip")) {
-                data->zstream.next_in = (Bytef *)towrite_start;
-                data->zstream.avail_in = static_cast<uInt>(size);
-                int res;
-                do {
-                    data->zstream.next_out = (Bytef *)data->buf_compressed;
-                    data->zstream.avail_out = static_cast<uInt>(max_buf_size);
-                    res = deflate(&data->zstream, Z_NO_FLUSH);
-                    NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
-                           res, size, size, data->zstream.avail_in,
-                           data->zstream.avail_out,
-                           max_buf_size - data->zstream.avail_out);
-                    DR_ASSERT(res != Z_STREAM_ERROR);
-                    wrote =
-                        file_ops_func.write_file(data->file, data->buf_compressed,
-                                                 max_buf_size - data->zstream.avail_out);
-                } while (data->zstream.avail_out == 0);
-                DR_ASSERT(data->zstream.avail_in == 0);
-                wrote = size;
-            } else
+            if (op_offline.get_value() &&
+                (op_raw_compress.get_value() == "zlib" ||
+                 op_raw_compress.get_value() == "gzip")) {
+            data->zstream.next_in = (Bytef *)towrite_start;
+            data->zstream.avail_in = static_cast<uInt>(size);
+            int res;
+            do {
+                data->zstream.next_out = (Bytef *)data->buf_compressed;
+                data->zstream.avail_out = static_cast<uInt>(max_buf_size);
+                res = deflate(&data->zstream, Z_NO_FLUSH);
+                NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
+                       res, size, size, data->zstream.avail_in, data->zstream.avail_out,
+                       max_buf_size - data->zstream.avail_out);
+                DR_ASSERT(res != Z_STREAM_ERROR);
+                wrote = write_thread_file(data->file, data->buf_compressed,
+                                          max_buf_size - data->zstream.avail_out);
+            } while (data->zstream.avail_out == 0);
+            DR_ASSERT(data->zstream.avail_in == 0);
+            wrote = size;
+        } else
 #endif
 #ifdef HAS_LZ4
-                if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
-                size_t res =
-                    LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
-                                        towrite_start, size, nullptr);
-                DR_ASSERT(!LZ4F_isError(res));
-                wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
-                DR_ASSERT(static_cast<size_t>(wrote) == res);
-                wrote = size;
-            } else
+            if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
+            size_t res =
+                LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
+                                    towrite_start, size, nullptr);
+            DR_ASSERT(!LZ4F_isError(res));
+            wrote = write_thread_file(data->file, data->buf_lz4, res);
+            DR_ASSERT(static_cast<size_t>(wrote) == res);
+            wrote = size;
+        } else
 #endif
-                wrote = file_ops_func.write_file(data->file, towrite_start, size);
-            if (wrote < size) {
-                FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
-                      "of %zd\n",
-                      dr_get_thread_id(drcontext), get_local_window(data), wrote, size);
-            }
+#ifdef HAS_ZSTD
+            if (zstd_enabled()) {
+            wrote = zstd_compress_and_write(data, towrite_start, size, /*end=*/false)
+                ? size
+                : 0;
+        } else
+#endif
+            wrote = write_thread_file(data->file, towrite_start, size);
+        if (wrote < size) {
+            FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
+                  "of %zd\n",
+                  tid, window, wrote, size);
         }
+    }
+}
+
+static inline byte *
+write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end,
+                 ptr_int_t window)
+{
+    if (op_offline.get_value()) {
+        per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+        // Our own queued buffers must be written first.
+        if (async_writer_enabled)
+            async_writer.drain(data);
+        write_offline_trace_data(data, dr_get_thread_id(drcontext), towrite_start,
+                                 towrite_end, window);
         return towrite_start;
     } else {
 #ifdef HAS_SNAPPY
@@ -820,6 +949,18 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
                                                              instru->sizeof_entry())));
             atomic_pipe_write(drcontext, pipe_start, buf_ptr, get_local_window(data));
         }
+    } else if (async_writer_enabled && buf_base == data->buf_base) {
+        // Hand the whole trace buffer to a writer thread and continue tracing
+        // into a spare one.
+        byte *spare = async_writer.submit(data, dr_get_thread_id(drcontext), buf_base,
+                                          pipe_start, buf_ptr, get_local_window(data));
+        if (spare != nullptr)
+            data->buf_base = spare;
+        else {
+            // The pool is exhausted: we write this one ourselves, which also
+            // throttles this thread until the writers catch up.
+            write_trace_data(drcontext, pipe_start, buf_ptr, get_local_window(data));
+        }
     } else {
         write_trace_data(drcontext, pipe_start, buf_ptr, get_local_window(data));
     }
@@ -1033,6 +1174,7 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     byte *mem_ref, *buf_ptr;
     byte *redzone;
+    bool handed_off = false;
     bool do_write = true;
     uint current_num_refs = 0;
 
@@ -1251,11 +1393,15 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
         if (op_use_physical.get_value()) {
             skip = process_buffer_for_physaddr(drcontext, data, header_size, buf_ptr);
         }
+        byte *written_buf = data->buf_base;
         current_num_refs +=
             output_buffer(drcontext, data, data->buf_base + skip, buf_ptr, header_size);
+        handed_off = data->buf_base != written_buf;
     }
 
-    if (file_ops_func.handoff_buf == NULL) {
+    // A buffer handed to -async_writers is reset by the writer, and we now have
+    // a clean spare.
+    if (file_ops_func.handoff_buf == NULL && !handed_off) {
         // Our instrumentation reads from buffer and skips the clean call if the
         // content is 0, so we need set zero in the trace buffer and set non-zero
         // in redzone.
@@ -1330,6 +1476,13 @@ init_thread_io(void *drcontext)
             data->buf_lz4_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
     }
 #endif
+#ifdef HAS_ZSTD
+    if (zstd_enabled()) {
+        data->buf_zstd_size = ZSTD_CStreamOutSize();
+        data->buf_zstd = static_cast<byte *>(dr_raw_mem_alloc(
+            data->buf_zstd_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+    }
+#endif
 
     if (op_use_physical.get_value()) {
         if (!data->physaddr.init()) {
@@ -1434,6 +1587,9 @@ exit_thread_io(void *drcontext)
                                    */
                                   data->bytes_written > 0);
     }
+    // The writers must be done with data before our caller frees it.
+    if (async_writer_enabled)
+        async_writer.drain(data);
     if (op_offline.get_value() && data->file != INVALID_FILE)
         close_thread_file(drcontext);
 
@@ -1449,6 +1605,10 @@ exit_thread_io(void *drcontext)
         dr_raw_mem_free(data->buf_lz4, data->buf_lz4_size);
     }
 #endif
+#ifdef HAS_ZSTD
+    if (zstd_enabled())
+        dr_raw_mem_free(data->buf_zstd, data->buf_zstd_size);
+#endif
 }
 
 void
@@ -1464,6 +1624,9 @@ init_io()
 #endif
 #ifdef HAS_LZ4
         || op_raw_compress.get_value() == "lz4"
+#endif
+#ifdef HAS_ZSTD
+        || op_raw_compress.get_value() == "zstd"
 #endif
     ) {
         // Valid option.
@@ -1494,6 +1657,17 @@ init_io()
 #    endif
     }
 #endif
+#ifdef HAS_ZSTD
+    if (zstd_enabled()) {
+        /* We do not pass a custom allocator to zstd (that requires its
+         * experimental static-linking-only API), so the same applies.
+         */
+        dr_allow_unsafe_static_behavior();
+#    ifdef DRMEMTRACE_STATIC
+        NOTIFY(0, "-raw_compress zstd is unsafe with statically linked clients\n");
+#    endif
+    }
+#endif
 
     DR_ASSERT(cur_window_instr_count.is_lock_free());
 }
@@ -1504,5 +1678,100 @@ exit_io()
     notify_beyond_global_max_once = 0;
 }
 
+void
+init_async_io()
+{
+    if (op_async_writers.get_value() == 0)
+        return;
+#ifdef DRMEMTRACE_STATIC
+    /* DR does not reliably clean up client threads on detach (i#297), so
+     * dr_app_stop_and_cleanup() can hang with our writer threads present.
+     */
+    NOTIFY(0, "WARNING: -async_writers is not supported with statically linked "
+              "clients: using regular writes.\n");
+    return;
+#endif
+    if (!op_offline.get_value() || file_ops_func.handoff_buf != NULL ||
+        op_use_physical.get_value() || op_L0_filter_until_instrs.get_value() > 0) {
+        FATAL("Usage error: -async_writers requires -offline and is not supported "
+              "with a buffer handoff function, -use_physical, or "
+              "-L0_filter_until_instrs.\n");
+    }
+    if (!async_writer.init(op_async_writers.get_value(), op_async_buffers.get_value(),
+                           max_buf_size, trace_buf_size, write_offline_trace_data))
+        FATAL("Usage error: -async_buffers must be non-zero.\n");
+    async_writer_enabled = true;
+}
+
+void
+exit_async_io()
+{
+    if (!async_writer_enabled)
+        return;
+    async_writer.print_stats();
+    async_writer.exit();
+    async_writer_enabled = false;
+}
+
+void
+fork_init_async_io()
+{
+    if (async_writer_enabled)
+        async_writer.fork_init();
+}
+
+void
+init_uring_io()
+{
+    if (!op_raw_io_uring.get_value())
+        return;
+#ifdef DRMEMTRACE_STATIC
+    /* DR does not reliably clean up client threads on detach (i#297), so
+     * dr_app_stop_and_cleanup() can hang with our completion thread present.
+     */
+    NOTIFY(0, "WARNING: -raw_io_uring is not supported with statically linked "
+              "clients: using regular writes.\n");
+    return;
+#endif
+    if (!op_offline.get_value() || file_ops_func.handoff_buf != NULL ||
+        file_ops_func.open_file != dr_open_file ||
+        file_ops_func.open_file_ex != nullptr ||
+        file_ops_func.write_file != dr_write_file ||
+        file_ops_func.close_file != dr_close_file) {
+        FATAL("Usage error: -raw_io_uring requires -offline and is not supported with "
+              "replaced file operations or a buffer handoff function.\n");
+    }
+#ifdef HAS_IO_URING
+    if (uring_writer.init(op_raw_io_uring_chunks.get_value(), URING_CHUNK_SIZE))
+        uring_enabled = true;
+    else
+        NOTIFY(0, "WARNING: io_uring is unavailable: using regular writes.\n");
+#else
+    NOTIFY(0, "WARNING: -raw_io_uring is not supported in this build: using regular "
+              "writes.\n");
+#endif
+}
+
+void
+exit_uring_io()
+{
+    if (!uring_enabled)
+        return;
+#ifdef HAS_IO_URING
+    uring_writer.print_stats();
+    uring_writer.exit();
+#endif
+    uring_enabled = false;
+}
+
+void
+fork_init_uring_io()
+{
+#ifdef HAS_IO_URING
+    if (uring_enabled && !uring_writer.fork_init())
+        FATAL("Fatal error: failed to set up io_uring in the child process.\n");
+#endif
+}
+
 } // namespace drmemtrace
 } // namespace dynamorio
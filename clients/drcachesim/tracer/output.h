@@ -64,6 +64,28 @@ init_io();
 void
 exit_io();
 
+// For -async_writers.  Must be called after the buffer sizes are set.
+void
+init_async_io();
+
+// Must be called after all threads have exited.
+void
+exit_async_io();
+
+void
+fork_init_async_io();
+
+// For -raw_io_uring.  Falls back to regular writes if io_uring is unavailable.
+void
+init_uring_io();
+
+// Must be called after all thread files are closed.
+void
+exit_uring_io();
+
+void
+fork_init_uring_io();
+
 // Returns true for an empty new (non-initial) buffer for a tracing window
 // with no instructions traced yet in the window.
 inline bool
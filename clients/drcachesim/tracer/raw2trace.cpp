@@ -36,6 +36,7 @@
 
 #define NOMINMAX // Avoid windows.h messing up std::min.
 #include "archive_ostream.h"
+#include "chunk_index.h"
 #include "dr_api.h"
 #include "drcovlib.h"
 #include "raw2trace.h"
@@ -1127,6 +1128,33 @@ raw2trace_t::check_thread_file(std::istream *f)
     return trace_metadata_reader_t::check_entry_thread_start(&ver_entry);
 }
 
+uint64_t
+raw2trace_t::get_thread_file_size(std::istream *f)
+{
+    if (f == nullptr)
+        return 0;
+    // Our decompressing streams do not support seeking to the end, in which case
+    // we return 0 and leave the stream as it was.  Their tellg() results are only
+    // offsets into an internal buffer, so we must not seek back to one of those
+    // unless seeking to the end succeeded.
+    std::streampos cur = f->tellg();
+    if (cur == std::streampos(-1)) {
+        f->clear();
+        return 0;
+    }
+    if (!f->seekg(0, f->end)) {
+        f->clear();
+        return 0;
+    }
+    uint64_t size = 0;
+    std::streampos end = f->tellg();
+    if (end != std::streampos(-1))
+        size = static_cast<uint64_t>(end);
+    f->clear();
+    f->seekg(cur);
+    return size;
+}
+
 #ifdef BUILD_PT_POST_PROCESSOR
 std::string
 raw2trace_t::get_kthread_file_tid(std::istream *f, thread_id_t *tid)
@@ -3104,7 +3132,11 @@ raw2trace_t::open_new_chunk(raw2trace_thread_data_t *tdata)
     }
     stream << TRACE_CHUNK_PREFIX << std::setfill('0')
            << std::setw(TRACE_CHUNK_SUFFIX_WIDTH) << tdata->chunk_count_;
-    tdata->error = tdata->out_archive->open_new_component(stream.str());
+    chunk_index_entry_t index_entry;
+    index_entry.instr_ordinal = tdata->chunk_count_ * chunk_instr_count_;
+    index_entry.timestamp = tdata->last_timestamp_;
+    tdata->error = tdata->out_archive->open_new_component_with_comment(
+        stream.str(), encode_chunk_index_comment(index_entry));
     if (!tdata->error.empty())
         return false;
     tdata->cur_chunk_instr_count = 0;
@@ -3553,9 +3585,12 @@ raw2trace_t::raw2trace_t(
             thread_data_[i]->out_file = out_files[i];
         }
     }
-    // Since we know the traced-thread count up front, we use a simple round-robin
-    // static work assignment.  This won't be as load balanced as a dynamic work
-    // queue but it is much simpler.
+    // Since we know the traced-thread count up front, we use a static work
+    // assignment.  A single traced thread's buffers cannot be converted in
+    // parallel (decode, delayed-branch, and chunk state all carry across buffers),
+    // so the best we can do is keep one large thread from sharing its worker:
+    // we place the largest files first, each on the least-loaded worker.  When
+    // sizes are unknown (compressed inputs) this degrades to round-robin.
     if (worker_count_ < 0) {
         worker_count_ = std::thread::hardware_concurrency();
         if (worker_count_ > kDefaultJobMax)
@@ -3564,12 +3599,31 @@ raw2trace_t::raw2trace_t(
     int cache_count = worker_count_;
     if (worker_count_ > 0) {
         worker_tasks_.resize(worker_count_);
-        int worker = 0;
+        std::vector<uint64_t> file_size(thread_data_.size());
+        std::vector<size_t> order(thread_data_.size());
         for (size_t i = 0; i < thread_data_.size(); ++i) {
-            VPRINT(2, "Worker %d assigned trace thread %zd\n", worker, i);
+            file_size[i] = get_thread_file_size(thread_data_[i]->thread_file);
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&file_size](size_t a, size_t b) {
+            return file_size[a] > file_size[b];
+        });
+        std::vector<uint64_t> worker_bytes(worker_count_, 0);
+        for (size_t i : order) {
+            int worker = 0;
+            for (int w = 1; w < worker_count_; ++w) {
+                if (worker_bytes[w] < worker_bytes[worker] ||
+                    (worker_bytes[w] == worker_bytes[worker] &&
+                     worker_tasks_[w].size() < worker_tasks_[worker].size()))
+                    worker = w;
+            }
+            VPRINT(2,
+                   "Worker %d assigned trace thread %zd (" UINT64_FORMAT_STRING
+                   " bytes)\n",
+                   worker, i, file_size[i]);
             worker_tasks_[worker].push_back(thread_data_[i].get());
+            worker_bytes[worker] += file_size[i];
             thread_data_[i]->worker = worker;
-            worker = (worker + 1) % worker_count_;
         }
     } else
         cache_count = 1;
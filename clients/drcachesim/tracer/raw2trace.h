@@ -90,6 +90,10 @@ namespace drmemtrace {
 #    define TRACE_SUFFIX_LZ4 "trace.lz4"
 #endif
 
+#ifdef HAS_ZSTD
+#    define TRACE_SUFFIX_ZSTD "trace.zst"
+#endif
+
 #ifdef HAS_ZIP
 #    define TRACE_SUFFIX_ZIP "trace.zip"
 #endif
@@ -886,6 +890,11 @@ protected:
     process_next_thread_buffer(raw2trace_thread_data_t *tdata,
                                DR_PARAM_OUT bool *end_of_record);
 
+    // Returns the size in bytes of a raw thread file, or 0 if it cannot be
+    // determined without disturbing the stream.
+    uint64_t
+    get_thread_file_size(std::istream *f);
+
     bool
     maybe_inject_pending_syscall_sequence(raw2trace_thread_data_t *tdata,
                                           const offline_entry_t &entry, byte *buf_base);
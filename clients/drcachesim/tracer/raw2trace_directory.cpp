@@ -78,6 +78,10 @@
 #    include "common/lz4_istream.h"
 #    include "common/lz4_ostream.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "common/zstd_istream.h"
+#    include "common/zstd_ostream.h"
+#endif
 
 namespace dynamorio {
 namespace drmemtrace {
@@ -114,6 +118,27 @@ typedef dynamorio::drmemtrace::record_file_reader_t<std::ifstream>
         }                                      \
     } while (0)
 
+// The -compress values that produce a zipfile, and which of those use the
+// columnar layout or zstd-compressed components.
+static bool
+is_zip_compress_type(const std::string &type)
+{
+    return type == "zip" || type == "zip_columnar" || type == "zip_zstd" ||
+        type == "zip_columnar_zstd";
+}
+
+static bool
+is_columnar_compress_type(const std::string &type)
+{
+    return type == "zip_columnar" || type == "zip_columnar_zstd";
+}
+
+static bool
+is_zstd_zip_compress_type(const std::string &type)
+{
+    return type == "zip_zstd" || type == "zip_columnar_zstd";
+}
+
 std::string
 raw2trace_directory_t::open_thread_files()
 {
@@ -134,7 +159,7 @@ raw2trace_directory_t::open_thread_files()
 std::string
 raw2trace_directory_t::trace_suffix()
 {
-    if (compress_type_ == "zip") {
+    if (is_zip_compress_type(compress_type_)) {
 #ifdef HAS_ZIP
         return TRACE_SUFFIX_ZIP;
 #endif
@@ -145,6 +170,10 @@ raw2trace_directory_t::trace_suffix()
     } else if (compress_type_ == "lz4") {
 #ifdef HAS_LZ4
         return TRACE_SUFFIX_LZ4;
+#endif
+    } else if (compress_type_ == "zstd") {
+#ifdef HAS_ZSTD
+        return TRACE_SUFFIX_ZSTD;
 #endif
     }
     return TRACE_SUFFIX;
@@ -211,6 +240,19 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
         }
     }
 #endif
+#ifdef HAS_ZSTD
+    bool is_zstd = false;
+    if (strlen(basename) > strlen(OUTFILE_SUFFIX_ZSTD) + 1) {
+        if (basename_pre_suffix == nullptr) {
+            basename_pre_suffix =
+                strstr(basename + strlen(basename) - strlen(OUTFILE_SUFFIX_ZSTD),
+                       OUTFILE_SUFFIX_ZSTD);
+            if (basename_pre_suffix != nullptr) {
+                is_zstd = true;
+            }
+        }
+    }
+#endif
 
     if (basename_pre_suffix == nullptr)
         basename_pre_suffix = strstr(basename_dot, OUTFILE_SUFFIX);
@@ -241,6 +283,13 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
             return "Internal Error in determining input file type.";
         ifile = new lz4_istream_t(path);
     }
+#endif
+#ifdef HAS_ZSTD
+    if (is_zstd) {
+        if (ifile != nullptr)
+            return "Internal Error in determining input file type.";
+        ifile = new zstd_istream_t(path);
+    }
 #endif
     if (ifile == nullptr)
         ifile = new std::ifstream(path, std::ifstream::binary);
@@ -266,9 +315,14 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
     }
 
     std::ostream *ofile = nullptr;
-    if (compress_type_ == "zip") {
+    if (is_zip_compress_type(compress_type_)) {
 #ifdef HAS_ZIP
-        ofile = new zipfile_ostream_t(path);
+#    ifndef HAS_ZSTD
+        if (is_zstd_zip_compress_type(compress_type_))
+            return "This build does not support zstd compression";
+#    endif
+        ofile = new zipfile_ostream_t(path, is_columnar_compress_type(compress_type_),
+                                      is_zstd_zip_compress_type(compress_type_));
         out_archives_.push_back(reinterpret_cast<archive_ostream_t *>(ofile));
         if (!(*out_archives_.back()))
             return "Failed to open output file " + std::string(path);
@@ -283,6 +337,12 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
     } else if (compress_type_ == "lz4") {
 #ifdef HAS_LZ4
         ofile = new lz4_ostream_t(path);
+#endif
+    } else if (compress_type_ == "zstd") {
+#ifdef HAS_ZSTD
+        ofile = new zstd_ostream_t(path);
+#else
+        return "This build does not support zstd compression";
 #endif
     }
     if (!ofile) {
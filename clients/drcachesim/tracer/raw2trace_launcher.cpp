@@ -92,9 +92,18 @@ static droption_t<int>
 
 static droption_t<std::string> op_trace_compress(
     DROPTION_SCOPE_FRONTEND, "compress", DEFAULT_TRACE_COMPRESSION_TYPE,
-    "Trace compression: \"zip\",\"gzip\",\"zlib\",\"lz4\",\"none\"",
+    "Trace compression: \"zip\",\"zip_columnar\",\"zip_zstd\",\"zip_columnar_zstd\","
+    "\"gzip\",\"zlib\",\"lz4\",\"zstd\",\"none\"",
     "Specifies the compression type to use for trace files: \"zip\", "
-    "\"gzip\", \"zlib\", \"lz4\", or \"none\". "
+    "\"zip_columnar\", \"zip_zstd\", \"zip_columnar_zstd\", \"gzip\", \"zlib\", "
+    "\"lz4\", \"zstd\", or \"none\". "
+    "\"zip_columnar\" produces a zipfile like \"zip\" but stores the records of "
+    "each chunk column by column with delta-encoded addresses; readers detect it "
+    "automatically.  For one real application trace it was about 3x smaller than "
+    "\"zip\" and decoded at a similar speed. "
+    "The \"_zstd\" variants compress each zipfile component with zstd instead of "
+    "deflate while keeping fast skipping; \"zstd\" writes a single zstd stream per "
+    "thread. "
     "In most cases where fast skipping by instruction count is not needed "
     "lz4 compression generally improves performance and is recommended. "
     "When it comes to storage types, the impact on overhead varies: "
@@ -67,6 +67,9 @@ namespace drmemtrace {
 #ifdef HAS_LZ4
 #    define OUTFILE_SUFFIX_LZ4 "raw.lz4"
 #endif
+#ifdef HAS_ZSTD
+#    define OUTFILE_SUFFIX_ZSTD "raw.zst"
+#endif
 #define OUTFILE_SUBDIR "raw"
 #define WINDOW_SUBDIR_PREFIX "window"
 #define WINDOW_SUBDIR_FORMAT "window.%04zd" /* ptr_int_t is the window number type. */
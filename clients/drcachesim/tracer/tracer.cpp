@@ -1974,6 +1974,8 @@ event_exit(void)
     instru->~instru_t();
     dr_global_free(instru, MAX_INSTRU_SIZE);
 
+    exit_async_io();
+    exit_uring_io();
     if (op_offline.get_value()) {
         file_ops_func.close_file(module_file);
         if (funclist_file != INVALID_FILE)
@@ -2136,6 +2138,10 @@ fork_init(void *drcontext)
      * initial header in process_and_output_buffer() for offline).
      */
     data->num_refs = 0;
+    /* The writer threads did not survive the fork. */
+    fork_init_async_io();
+    data->async_pending = 0;
+    fork_init_uring_io();
     if (op_offline.get_value()) {
         data->file = INVALID_FILE;
         if (!init_offline_dir()) {
@@ -2513,6 +2519,8 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     dr_log(NULL, DR_LOG_ALL, 1, "drcachesim client initializing\n");
 
     init_io();
+    init_async_io();
+    init_uring_io();
 
     if (op_max_global_trace_refs.get_value() > 0) {
         /* We need the same is-buffer-zero checks in the instrumentation. */
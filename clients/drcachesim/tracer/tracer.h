@@ -57,6 +57,9 @@
 #ifdef HAS_LZ4
 #    include <lz4frame.h>
 #endif
+#ifdef HAS_ZSTD
+#    include <zstd.h>
+#endif
 #ifdef BUILD_PT_TRACER
 #    include "syscall_pt_trace.h"
 #endif
@@ -89,6 +92,8 @@ typedef struct {
     /* For file_ops_func.handoff_buf */
     uint num_buffers;
     byte *reserve_buf;
+    /* For -async_writers: buffers handed off but not yet written. */
+    volatile int async_pending;
     /* For level 0 filters */
     byte *l0_dcache;
     byte *l0_icache;
@@ -108,6 +113,11 @@ typedef struct {
     LZ4F_compressionContext_t lzcxt;
     size_t buf_lz4_size;
     byte *buf_lz4;
+#endif
+#ifdef HAS_ZSTD
+    ZSTD_CCtx *zstd_cctx;
+    size_t buf_zstd_size;
+    byte *buf_zstd;
 #endif
     bool has_thread_header;
     // The physaddr_t class is designed to be per-thread.
@@ -0,0 +1,205 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* uring_writer: an io_uring-based backend for offline trace files. */
+
+#ifndef _URING_WRITER_H_
+#define _URING_WRITER_H_ 1
+
+#include <sys/uio.h>
+
+#include "dr_api.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// Writes offline thread files through a single io_uring instance shared by
+// all threads.  Written data is copied into page-aligned staging chunks, and
+// each full chunk is queued as one write to the submission ring without a
+// system call.  A DR client thread submits everything queued so far with a
+// single io_uring_enter call and reaps completions, so a busy process gets
+// many writes per system call and application threads rarely enter the
+// kernel at all.  Files are switched to O_DIRECT when the filesystem allows
+// it, keeping trace data out of the page cache; the final partial chunk is
+// padded to the direct I/O alignment and the file truncated back afterward.
+//
+// The file_t values handed out are our own handles and may only be passed
+// to this class's write_file() and close_file().  Writes to one file must
+// not be concurrent, but different files may be written in parallel.
+//
+// Like the rest of the tracer we avoid C++ containers so this works when
+// drmemtrace is statically linked into the application.
+class uring_writer_t {
+public:
+    // Creates the ring and num_chunks staging chunks of chunk_size bytes,
+    // which must be a multiple of the page size.  The completion thread is
+    // started by the first write submitted to the ring.  Returns false if io_uring is unavailable, such as on kernels
+    // older than 5.1 or where it is disabled, and the caller should use
+    // regular writes instead.
+    bool
+    init(uint num_chunks, size_t chunk_size);
+    // Stops the completion thread and frees all resources.  All files must
+    // have been closed beforehand.
+    void
+    exit();
+    // Called in a fork child, which shares the parent's ring and has none of
+    // our threads: we set up a fresh ring.  Returns false if that fails.
+    bool
+    fork_init();
+
+    // Takes the same parameters as dr_open_file().
+    file_t
+    open_file(const char *fname, uint mode_flags);
+    // Returns count, or -1 if an earlier write to f failed.  The data is
+    // copied, so the caller may reuse its buffer right away.
+    ssize_t
+    write_file(file_t f, const void *data, size_t count);
+    // Flushes f, waits for its writes to complete, and closes it.
+    void
+    close_file(file_t f);
+
+    // Prints submission statistics under -verbose 1.
+    void
+    print_stats();
+
+private:
+    struct chunk_t;
+    struct file_state_t {
+        file_t fd;
+        bool direct;
+        // File offset where the chunk being filled will be written.
+        uint64 offset;
+        // Bytes the caller has written.
+        uint64 size;
+        chunk_t *chunk;
+        size_t fill;
+        volatile int inflight;
+        volatile int failed;
+        int next_free;
+    };
+    struct chunk_t {
+        byte *buf;
+        // Index into the registered buffers, or -1 if not registered.
+        int buf_index;
+        size_t len;
+        file_state_t *file;
+        chunk_t *next;
+        // Links chunks allocated beyond the initial set, for freeing.
+        chunk_t *next_extra;
+        struct iovec iov;
+    };
+
+    bool
+    setup_ring();
+    void
+    teardown_ring();
+    void
+    reset_free_lists();
+    void
+    start_thread();
+    static void
+    reaper_thread(void *arg);
+    void
+    reap();
+    chunk_t *
+    take_chunk();
+    chunk_t *
+    new_chunk();
+    void
+    submit_chunk(file_state_t *file, size_t len);
+    file_state_t *
+    lookup(file_t f);
+
+    void *lock_ = nullptr;
+    void *event_ = nullptr;
+    file_t ring_fd_ = INVALID_FILE;
+    uint sq_entries_ = 0;
+    // The shared ring mappings and pointers into them.
+    void *sq_map_ = nullptr;
+    size_t sq_map_size_ = 0;
+    void *cq_map_ = nullptr;
+    size_t cq_map_size_ = 0;
+    struct io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    uint *sq_khead_ = nullptr;
+    uint *sq_ktail_ = nullptr;
+    uint sq_mask_ = 0;
+    uint *sq_array_ = nullptr;
+    uint *cq_khead_ = nullptr;
+    uint *cq_ktail_ = nullptr;
+    uint cq_mask_ = 0;
+    struct io_uring_cqe *cqes_ = nullptr;
+    // Our copy of the submission tail, protected by lock_.
+    uint sq_tail_ = 0;
+    // Queued plus in-progress writes, protected by lock_.  We keep this at or
+    // below sq_entries_ so neither ring can overflow.
+    uint inflight_ = 0;
+    bool reaper_idle_ = false;
+    // Whether start_thread() has been called, protected by lock_.
+    bool started_ = false;
+    volatile int exiting_ = 0;
+    volatile int reaper_live_ = 0;
+    volatile int broken_ = 0;
+
+    // Staging chunks.  The first num_chunks_ are allocated up front and
+    // registered with the kernel; more are added if every chunk is held by a
+    // file still filling it.  Protected by lock_.
+    chunk_t *chunks_ = nullptr;
+    uint num_chunks_ = 0;
+    size_t chunk_size_ = 0;
+    chunk_t *free_chunks_ = nullptr;
+    chunk_t *extra_chunks_ = nullptr;
+    bool registered_ = false;
+
+    // File handles index a two-level table so lookups need no lock.
+    static const int FILES_PER_TABLE = 256;
+    static const int MAX_FILE_TABLES = 256;
+    file_state_t *file_tables_[MAX_FILE_TABLES] = {};
+    int num_file_tables_ = 0;
+    int free_file_ = -1;
+
+    // Statistics, protected by lock_.
+    uint64 num_writes_ = 0;
+    uint64 num_enters_ = 0;
+    uint64 num_extra_chunks_ = 0;
+    uint64 num_full_waits_ = 0;
+    uint64 bytes_written_ = 0;
+};
+
+} // namespace drmemtrace
+} // namespace dynamorio
+
+#endif /* _URING_WRITER_H_ */
@@ -0,0 +1,569 @@
+/* **********************************************************
+ * Copyright (c) 2025 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+#include "uring_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "dr_api.h"
+#include "options.h"
+#include "tracer.h"
+#include "utils.h"
+
+namespace dynamorio {
+namespace drmemtrace {
+
+// O_DIRECT requires file offsets and lengths to be multiples of the device's
+// logical block size, which is at most this on the devices we expect.
+static const size_t DIRECT_IO_ALIGN = 4096;
+
+bool
+uring_writer_t::init(uint num_chunks, size_t chunk_size)
+{
+    if (num_chunks == 0 || chunk_size == 0 || chunk_size % dr_page_size() != 0)
+        return false;
+    num_chunks_ = num_chunks;
+    chunk_size_ = chunk_size;
+    chunks_ = static_cast<chunk_t *>(dr_global_alloc(num_chunks * sizeof(chunk_t)));
+    for (uint i = 0; i < num_chunks; ++i) {
+        chunks_[i].buf = static_cast<byte *>(
+            dr_raw_mem_alloc(chunk_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+        if (chunks_[i].buf == nullptr) {
+            for (uint j = 0; j < i; ++j)
+                dr_raw_mem_free(chunks_[j].buf, chunk_size);
+            dr_global_free(chunks_, num_chunks * sizeof(chunk_t));
+            chunks_ = nullptr;
+            return false;
+        }
+    }
+    if (!setup_ring()) {
+        for (uint i = 0; i < num_chunks; ++i)
+            dr_raw_mem_free(chunks_[i].buf, chunk_size);
+        dr_global_free(chunks_, num_chunks * sizeof(chunk_t));
+        chunks_ = nullptr;
+        return false;
+    }
+    reset_free_lists();
+    lock_ = dr_mutex_create();
+    event_ = dr_event_create();
+    // See async_writer_t::init() on why we do not create our thread here.
+    started_ = false;
+    return true;
+}
+
+bool
+uring_writer_t::setup_ring()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, num_chunks_, &params));
+    if (fd < 0) {
+        NOTIFY(1, "io_uring_setup failed: %d\n", errno);
+        return false;
+    }
+    // Move the descriptor out of the application's range.
+    ring_fd_ = dr_dup_file_handle(fd);
+    close(fd);
+    if (ring_fd_ == INVALID_FILE)
+        return false;
+    sq_entries_ = params.sq_entries;
+    sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(uint);
+    sq_map_ = dr_map_file(ring_fd_, &sq_map_size_, IORING_OFF_SQ_RING, nullptr,
+                          DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0);
+    cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    cq_map_ = dr_map_file(ring_fd_, &cq_map_size_, IORING_OFF_CQ_RING, nullptr,
+                          DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0);
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe *>(
+        dr_map_file(ring_fd_, &sqes_size_, IORING_OFF_SQES, nullptr,
+                    DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0));
+    if (sq_map_ == nullptr || cq_map_ == nullptr || sqes_ == nullptr) {
+        teardown_ring();
+        return false;
+    }
+    byte *sq = static_cast<byte *>(sq_map_);
+    sq_khead_ = reinterpret_cast<uint *>(sq + params.sq_off.head);
+    sq_ktail_ = reinterpret_cast<uint *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint *>(sq + params.sq_off.array);
+    byte *cq = static_cast<byte *>(cq_map_);
+    cq_khead_ = reinterpret_cast<uint *>(cq + params.cq_off.head);
+    cq_ktail_ = reinterpret_cast<uint *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    sq_tail_ = *sq_ktail_;
+    inflight_ = 0;
+
+    // Registering the chunks saves the kernel from pinning their pages on every
+    // write.  It can fail under a low RLIMIT_MEMLOCK, in which case we use
+    // vectored writes instead.
+    struct iovec *iovs =
+        static_cast<struct iovec *>(dr_global_alloc(num_chunks_ * sizeof(*iovs)));
+    for (uint i = 0; i < num_chunks_; ++i) {
+        iovs[i].iov_base = chunks_[i].buf;
+        iovs[i].iov_len = chunk_size_;
+    }
+    registered_ = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS,
+                          iovs, num_chunks_) == 0;
+    dr_global_free(iovs, num_chunks_ * sizeof(*iovs));
+    for (uint i = 0; i < num_chunks_; ++i)
+        chunks_[i].buf_index = registered_ ? static_cast<int>(i) : -1;
+    return true;
+}
+
+void
+uring_writer_t::teardown_ring()
+{
+    if (sqes_ != nullptr)
+        dr_unmap_file(sqes_, sqes_size_);
+    if (cq_map_ != nullptr)
+        dr_unmap_file(cq_map_, cq_map_size_);
+    if (sq_map_ != nullptr)
+        dr_unmap_file(sq_map_, sq_map_size_);
+    sqes_ = nullptr;
+    cq_map_ = nullptr;
+    sq_map_ = nullptr;
+    // Closing the ring also unregisters the chunks.
+    if (ring_fd_ != INVALID_FILE)
+        dr_close_file(ring_fd_);
+    ring_fd_ = INVALID_FILE;
+}
+
+void
+uring_writer_t::reset_free_lists()
+{
+    free_chunks_ = nullptr;
+    for (uint i = 0; i < num_chunks_; ++i) {
+        chunks_[i].next = free_chunks_;
+        free_chunks_ = &chunks_[i];
+    }
+    for (chunk_t *chunk = extra_chunks_; chunk != nullptr; chunk = chunk->next_extra) {
+        chunk->next = free_chunks_;
+        free_chunks_ = chunk;
+    }
+    free_file_ = -1;
+    for (int t = num_file_tables_ - 1; t >= 0; --t) {
+        for (int i = FILES_PER_TABLE - 1; i >= 0; --i) {
+            file_tables_[t][i].next_free = free_file_;
+            free_file_ = t * FILES_PER_TABLE + i;
+        }
+    }
+}
+
+void
+uring_writer_t::start_thread()
+{
+    // Counted up front so exit() waits for a thread not yet scheduled.
+    dr_atomic_store32(&reaper_live_, 1);
+    if (!dr_create_client_thread(reaper_thread, this))
+        FATAL("Fatal error: failed to create io_uring completion thread\n");
+}
+
+void
+uring_writer_t::exit()
+{
+    if (lock_ == nullptr)
+        return;
+    dr_atomic_store32(&exiting_, 1);
+    dr_event_signal(event_);
+    // See async_writer_t::exit() on why we bound the wait.
+    static const int MAX_WAIT_MS = 5000;
+    for (int waited = 0; dr_atomic_load32(&reaper_live_) > 0 && waited < MAX_WAIT_MS;
+         ++waited)
+        dr_sleep(1);
+    if (dr_atomic_load32(&reaper_live_) > 0) {
+        NOTIFY(0, "drmemtrace io_uring completion thread failed to exit\n");
+        return;
+    }
+    teardown_ring();
+    for (uint i = 0; i < num_chunks_; ++i)
+        dr_raw_mem_free(chunks_[i].buf, chunk_size_);
+    dr_global_free(chunks_, num_chunks_ * sizeof(chunk_t));
+    for (chunk_t *chunk = extra_chunks_, *next; chunk != nullptr; chunk = next) {
+        next = chunk->next_extra;
+        dr_raw_mem_free(chunk->buf, chunk_size_);
+        dr_global_free(chunk, sizeof(*chunk));
+    }
+    for (int t = 0; t < num_file_tables_; ++t)
+        dr_global_free(file_tables_[t], FILES_PER_TABLE * sizeof(file_state_t));
+    chunks_ = nullptr;
+    extra_chunks_ = nullptr;
+    free_chunks_ = nullptr;
+    num_file_tables_ = 0;
+    free_file_ = -1;
+    dr_event_destroy(event_);
+    dr_mutex_destroy(lock_);
+    lock_ = nullptr;
+}
+
+bool
+uring_writer_t::fork_init()
+{
+    if (lock_ == nullptr)
+        return true;
+    // A parent thread may have held the lock across the fork, in which case
+    // we replace it, leaking the old one as its owner is gone.  The parent's
+    // files were closed on the fork, so we discard any data it had staged or
+    // queued and give the child a ring of its own.
+    if (dr_mutex_trylock(lock_))
+        dr_mutex_unlock(lock_);
+    else
+        lock_ = dr_mutex_create();
+    dr_event_reset(event_);
+    teardown_ring();
+    broken_ = 0;
+    exiting_ = 0;
+    reaper_live_ = 0;
+    reaper_idle_ = false;
+    started_ = false;
+    num_writes_ = 0;
+    num_enters_ = 0;
+    num_full_waits_ = 0;
+    bytes_written_ = 0;
+    if (!setup_ring())
+        return false;
+    reset_free_lists();
+    return true;
+}
+
+uring_writer_t::file_state_t *
+uring_writer_t::lookup(file_t f)
+{
+    if (f < 0 || f >= MAX_FILE_TABLES * FILES_PER_TABLE)
+        return nullptr;
+    // A handle's table is published before the handle is returned from
+    // open_file(), so we need no lock here.
+    file_state_t *table = file_tables_[f / FILES_PER_TABLE];
+    if (table == nullptr)
+        return nullptr;
+    return &table[f % FILES_PER_TABLE];
+}
+
+file_t
+uring_writer_t::open_file(const char *fname, uint mode_flags)
+{
+    file_t fd = dr_open_file(fname, mode_flags);
+    if (fd == INVALID_FILE)
+        return INVALID_FILE;
+    // Filesystems without direct I/O support, such as older tmpfs, refuse the
+    // flag and we fall back to buffered writes.
+    int fl = fcntl(fd, F_GETFL);
+    bool direct = fl != -1 && fcntl(fd, F_SETFL, fl | O_DIRECT) == 0;
+    dr_mutex_lock(lock_);
+    if (free_file_ < 0) {
+        if (num_file_tables_ == MAX_FILE_TABLES) {
+            dr_mutex_unlock(lock_);
+            dr_close_file(fd);
+            return INVALID_FILE;
+        }
+        file_state_t *table = static_cast<file_state_t *>(
+            dr_global_alloc(FILES_PER_TABLE * sizeof(file_state_t)));
+        for (int i = FILES_PER_TABLE - 1; i >= 0; --i) {
+            table[i].next_free = free_file_;
+            free_file_ = num_file_tables_ * FILES_PER_TABLE + i;
+        }
+        file_tables_[num_file_tables_++] = table;
+    }
+    file_t handle = free_file_;
+    file_state_t *file = lookup(handle);
+    free_file_ = file->next_free;
+    dr_mutex_unlock(lock_);
+    file->fd = fd;
+    file->direct = direct;
+    file->offset = 0;
+    file->size = 0;
+    file->chunk = nullptr;
+    file->fill = 0;
+    file->inflight = 0;
+    file->failed = 0;
+    file->next_free = -1;
+    return handle;
+}
+
+uring_writer_t::chunk_t *
+uring_writer_t::new_chunk()
+{
+    // Called with lock_ held.
+    byte *buf = static_cast<byte *>(
+        dr_raw_mem_alloc(chunk_size_, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+    if (buf == nullptr)
+        return nullptr;
+    chunk_t *chunk = static_cast<chunk_t *>(dr_global_alloc(sizeof(*chunk)));
+    chunk->buf = buf;
+    chunk->buf_index = -1;
+    chunk->next_extra = extra_chunks_;
+    extra_chunks_ = chunk;
+    ++num_extra_chunks_;
+    return chunk;
+}
+
+uring_writer_t::chunk_t *
+uring_writer_t::take_chunk()
+{
+    bool waited = false;
+    while (dr_atomic_load32(&broken_) == 0) {
+        dr_mutex_lock(lock_);
+        chunk_t *chunk = free_chunks_;
+        if (chunk != nullptr)
+            free_chunks_ = chunk->next;
+        else if (inflight_ == 0) {
+            // Every chunk is held by a file still filling it, so waiting would
+            // never end.
+            chunk = new_chunk();
+        } else if (!waited) {
+            // Completions will free chunks: this is our backpressure.
+            ++num_full_waits_;
+            waited = true;
+        }
+        dr_mutex_unlock(lock_);
+        if (chunk != nullptr)
+            return chunk;
+        dr_thread_yield();
+    }
+    return nullptr;
+}
+
+void
+uring_writer_t::submit_chunk(file_state_t *file, size_t len)
+{
+    chunk_t *chunk = file->chunk;
+    chunk->len = len;
+    chunk->file = file;
+    bool waited = false;
+    dr_mutex_lock(lock_);
+    while (inflight_ >= sq_entries_ && dr_atomic_load32(&broken_) == 0) {
+        if (!waited) {
+            ++num_full_waits_;
+            waited = true;
+        }
+        dr_mutex_unlock(lock_);
+        dr_thread_yield();
+        dr_mutex_lock(lock_);
+    }
+    if (dr_atomic_load32(&broken_) != 0) {
+        chunk->next = free_chunks_;
+        free_chunks_ = chunk;
+        dr_mutex_unlock(lock_);
+        dr_atomic_store32(&file->failed, 1);
+    } else {
+        uint idx = sq_tail_ & sq_mask_;
+        struct io_uring_sqe *sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = file->fd;
+        sqe->off = file->offset;
+        if (chunk->buf_index >= 0) {
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->addr = reinterpret_cast<ptr_uint_t>(chunk->buf);
+            sqe->len = static_cast<uint>(len);
+            sqe->buf_index = static_cast<uint16_t>(chunk->buf_index);
+        } else {
+            chunk->iov.iov_base = chunk->buf;
+            chunk->iov.iov_len = len;
+            sqe->opcode = IORING_OP_WRITEV;
+            sqe->addr = reinterpret_cast<ptr_uint_t>(&chunk->iov);
+            sqe->len = 1;
+        }
+        sqe->user_data = reinterpret_cast<ptr_uint_t>(chunk);
+        sq_array_[idx] = idx;
+        dr_atomic_add32_return_sum(&file->inflight, 1);
+        // The kernel must see the entry before the new tail.
+        __atomic_store_n(sq_ktail_, ++sq_tail_, __ATOMIC_RELEASE);
+        ++inflight_;
+        ++num_writes_;
+        bytes_written_ += len;
+        bool wake = reaper_idle_;
+        reaper_idle_ = false;
+        bool need_start = !started_;
+        started_ = true;
+        dr_mutex_unlock(lock_);
+        if (need_start)
+            start_thread();
+        else if (wake)
+            dr_event_signal(event_);
+    }
+    file->offset += len;
+    file->chunk = nullptr;
+    file->fill = 0;
+}
+
+ssize_t
+uring_writer_t::write_file(file_t f, const void *data, size_t count)
+{
+    file_state_t *file = lookup(f);
+    if (file == nullptr || dr_atomic_load32(&file->failed) != 0 ||
+        dr_atomic_load32(&broken_) != 0)
+        return -1;
+    const byte *src = static_cast<const byte *>(data);
+    size_t left = count;
+    while (left > 0) {
+        if (file->chunk == nullptr) {
+            file->chunk = take_chunk();
+            if (file->chunk == nullptr)
+                return -1;
+        }
+        size_t tocopy = chunk_size_ - file->fill;
+        if (tocopy > left)
+            tocopy = left;
+        memcpy(file->chunk->buf + file->fill, src, tocopy);
+        file->fill += tocopy;
+        src += tocopy;
+        left -= tocopy;
+        if (file->fill == chunk_size_)
+            submit_chunk(file, chunk_size_);
+    }
+    file->size += count;
+    return static_cast<ssize_t>(count);
+}
+
+void
+uring_writer_t::close_file(file_t f)
+{
+    file_state_t *file = lookup(f);
+    if (file == nullptr)
+        return;
+    if (file->chunk != nullptr) {
+        size_t len = file->fill;
+        if (file->direct) {
+            size_t padded = ALIGN_FORWARD(len, DIRECT_IO_ALIGN);
+            memset(file->chunk->buf + len, 0, padded - len);
+            len = padded;
+        }
+        submit_chunk(file, len);
+    }
+    while (dr_atomic_load32(&file->inflight) > 0 && dr_atomic_load32(&broken_) == 0)
+        dr_thread_yield();
+    if (file->offset != file->size && ftruncate(file->fd, file->size) != 0)
+        NOTIFY(0, "drmemtrace failed to truncate io_uring trace file: %d\n", errno);
+    dr_close_file(file->fd);
+    dr_mutex_lock(lock_);
+    file->next_free = free_file_;
+    free_file_ = f;
+    dr_mutex_unlock(lock_);
+}
+
+void
+uring_writer_t::reap()
+{
+    // Only this thread consumes completions, so it alone writes the head.
+    uint head = *cq_khead_;
+    uint tail = __atomic_load_n(cq_ktail_, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return;
+    chunk_t *done = nullptr;
+    uint count = 0;
+    for (; head != tail; ++head) {
+        struct io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+        chunk_t *chunk = reinterpret_cast<chunk_t *>(cqe->user_data);
+        // We do not retry short writes, which for regular files only happen on
+        // errors such as a full disk.
+        if (cqe->res != static_cast<int>(chunk->len) &&
+            dr_atomic_add32_return_sum(&chunk->file->failed, 1) == 1)
+            NOTIFY(0, "drmemtrace io_uring trace write failed: %d\n", cqe->res);
+        // The file may be closed and reused once this drops to zero.
+        dr_atomic_add32_return_sum(&chunk->file->inflight, -1);
+        chunk->next = done;
+        done = chunk;
+        ++count;
+    }
+    __atomic_store_n(cq_khead_, head, __ATOMIC_RELEASE);
+    dr_mutex_lock(lock_);
+    for (chunk_t *chunk = done, *next; chunk != nullptr; chunk = next) {
+        next = chunk->next;
+        chunk->next = free_chunks_;
+        free_chunks_ = chunk;
+    }
+    inflight_ -= count;
+    dr_mutex_unlock(lock_);
+}
+
+void
+uring_writer_t::reaper_thread(void *arg)
+{
+    uring_writer_t *self = static_cast<uring_writer_t *>(arg);
+    while (true) {
+        dr_mutex_lock(self->lock_);
+        // inflight_ includes entries not yet submitted.
+        if (self->inflight_ == 0) {
+            if (dr_atomic_load32(&self->exiting_) != 0) {
+                dr_mutex_unlock(self->lock_);
+                break;
+            }
+            // The event is auto-reset and stays set if signaled before we
+            // wait, so we cannot miss a submission.
+            self->reaper_idle_ = true;
+            dr_mutex_unlock(self->lock_);
+            dr_event_wait(self->event_);
+            continue;
+        }
+        uint to_submit =
+            self->sq_tail_ - __atomic_load_n(self->sq_khead_, __ATOMIC_ACQUIRE);
+        ++self->num_enters_;
+        dr_mutex_unlock(self->lock_);
+        // Submit everything queued so far and wait for at least one write to
+        // complete.  Entries queued while we wait go out together next time.
+        long res = syscall(__NR_io_uring_enter, self->ring_fd_, to_submit, 1,
+                           IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            NOTIFY(0, "drmemtrace io_uring_enter failed: %d\n", errno);
+            dr_atomic_store32(&self->broken_, 1);
+            break;
+        }
+        self->reap();
+    }
+    dr_atomic_add32_return_sum(&self->reaper_live_, -1);
+    // See async_writer_t::writer_thread() on why we park instead of returning.
+    while (true)
+        dr_sleep(1000);
+}
+
+void
+uring_writer_t::print_stats()
+{
+    if (lock_ == nullptr)
+        return;
+    NOTIFY(1,
+           "drmemtrace io_uring: " UINT64_FORMAT_STRING " writes of " UINT64_FORMAT_STRING
+           " bytes in " UINT64_FORMAT_STRING " submit calls; " UINT64_FORMAT_STRING
+           " extra chunks, " UINT64_FORMAT_STRING " waits for a full ring; %s"
+           " buffers.\n",
+           num_writes_, bytes_written_, num_enters_, num_extra_chunks_, num_full_waits_,
+           registered_ ? "registered" : "unregistered");
+}
+
+} // namespace drmemtrace
+} // namespace dynamorio
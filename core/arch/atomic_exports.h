@@ -185,7 +185,11 @@
 #        define ATOMIC_ADD_PTR(type, var, val) ATOMIC_ADD_int(var, val)
 #        define ATOMIC_COMPARE_EXCHANGE_PTR ATOMIC_COMPARE_EXCHANGE_int
 #    endif
-#    define MEMORY_STORE_BARRIER()       /* not needed on x86 */
+/* The hardware does not reorder stores or loads among themselves on x86, but the
+ * compiler still can.
+ */
+#    define MEMORY_STORE_BARRIER() _ReadWriteBarrier()
+#    define MEMORY_LOAD_BARRIER() _ReadWriteBarrier()
 #    define SPINLOCK_PAUSE() _mm_pause() /* PAUSE = 0xf3 0x90 = repz nop */
 #    define SERIALIZE_INSTRUCTIONS()     \
         do {                             \
@@ -377,7 +381,11 @@ atomic_add_exchange_int64(volatile int64 *var, int64 value)
                              : "=r"(result), "=m"(var) \
                              : "0"(newval), "m"(var))
 
-#        define MEMORY_STORE_BARRIER() /* not needed on x86 */
+/* The hardware does not reorder stores or loads among themselves on x86, but the
+ * compiler still can.
+ */
+#        define MEMORY_STORE_BARRIER() __asm__ __volatile__("" : : : "memory")
+#        define MEMORY_LOAD_BARRIER() __asm__ __volatile__("" : : : "memory")
 #        define SPINLOCK_PAUSE() __asm__ __volatile__("pause")
 #        define SERIALIZE_INSTRUCTIONS()                   \
             __asm__ __volatile__("xor %%eax, %%eax; cpuid" \
@@ -553,6 +561,7 @@ DEF_ATOMIC_incdec(ATOMIC_INC_int, int, "w", "add") DEF_ATOMIC_incdec(ATOMIC_INC_
 }
 
 #        define MEMORY_STORE_BARRIER() __asm__ __volatile__("dmb st")
+#        define MEMORY_LOAD_BARRIER() __asm__ __volatile__("dmb ishld" : : : "memory")
 /* i#4719: QEMU crashes on "wfi" so we use the superset "wfe".
  * XXX: Consider issuing "sev" on lock release?
  */
@@ -713,6 +722,7 @@ atomic_dec_becomes_zero(volatile int *var)
                                  : "cc", "memory", "r2", "r3");
 
 #        define MEMORY_STORE_BARRIER() __asm__ __volatile__("dmb st")
+#        define MEMORY_LOAD_BARRIER() __asm__ __volatile__("dmb ish" : : : "memory")
 /* QEMU crashes on "wfi" so we use the superset "wfe".
  * XXX: Consider issuing "sev" on lock release?
  */
@@ -998,6 +1008,8 @@ atomic_exchange_int(volatile int *var, int newval)
 
 /* Ensure no store reordering for normal memory writes. */
 #        define MEMORY_STORE_BARRIER() __asm__ __volatile__("fence w,w")
+/* Ensure no load reordering for normal memory reads. */
+#        define MEMORY_LOAD_BARRIER() __asm__ __volatile__("fence r,r" : : : "memory")
 
 /* Insert pause hint directly to be compatible with old compilers. This
  * will work even on platforms without Zihintpause extension because this
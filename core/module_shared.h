@@ -36,6 +36,7 @@
 
 #include "heap.h" /* for HEAPACCT */
 #include "module_api.h"
+
 #include "module.h" /* include os_specific header */
 
 #ifdef WINDOWS
@@ -344,6 +345,14 @@ module_info_exists(const app_pc pc)
     return os_get_module_info(pc, NULL, NULL, NULL, NULL, NULL, NULL);
 }
 
+/* Copies into buf the build ID of the module containing pc: the GNU build ID on
+ * Linux or the LC_UUID on Mac.  Returns the number of bytes copied, or 0 if
+ * there is no such module or it has no build ID.
+ * Caller must hold the module info lock.
+ */
+uint
+os_get_module_build_id(const app_pc pc, byte *buf, uint buf_len);
+
 bool
 get_named_section_bounds(app_pc module_base, const char *name, app_pc *start /*OUT*/,
                          app_pc *end /*OUT*/);
@@ -2256,6 +2256,9 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
     const char *name;
     uint hash;
     char dir[MAXIMUM_PATH];
+    byte build_id[MODULE_BUILD_ID_MAX_LEN];
+    uint build_id_len, i;
+    char build_id_name[MODULE_BUILD_ID_MAX_LEN * 2 + 1];
 
     os_get_module_info_lock();
     if (!os_get_module_info(modbase, &checksum, &timestamp, &size, &name, &code_size,
@@ -2293,6 +2296,21 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
         }
     }
 
+    /* A module with a build ID is named by it rather than by its file name, so a
+     * renamed or moved copy of the same build finds the same file.  The exclude
+     * list above still applies to the file name.
+     */
+    build_id_len = os_get_module_build_id(modbase, build_id, sizeof(build_id));
+    if (build_id_len > 0) {
+        for (i = 0; i < build_id_len; i++) {
+            snprintf(build_id_name + i * 2, BUFFER_SIZE_ELEMENTS(build_id_name) - i * 2,
+                     "%02x", build_id[i]);
+        }
+        NULL_TERMINATE_BUFFER(build_id_name);
+        LOG(GLOBAL, LOG_CACHE, 2, "\tnaming %s by build id %s\n", name, build_id_name);
+        name = build_id_name;
+    }
+
     /* Prepend the perscache dir.  We assume it has already been created.
      * FIXME: cache this, or better, cache the dir handle and use an
      * os_open that can take it in.  Note that the directory handle
@@ -2354,7 +2372,6 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
     snprintf(filename, filename_max, "%s%c%s%s-0x%08x.%s", dir, DIRSEP, name,
              IF_DEBUG_ELSE("-dbg", ""), hash, PERSCACHE_FILE_SUFFIX);
     filename[filename_max - 1] = '\0';
-    os_get_module_info_unlock();
     if (modinfo != NULL) {
         modinfo->base = modbase;
         modinfo->checksum = checksum;
@@ -2362,7 +2379,13 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
         modinfo->image_size = size;
         modinfo->code_size = code_size;
         modinfo->file_version = file_version;
+        /* The file name holds only a 32-bit hash of the rest of the module info,
+         * so we store the whole build ID to reject other builds at load time.
+         */
+        memset(modinfo->build_id, 0, sizeof(modinfo->build_id));
+        memcpy(modinfo->build_id, build_id, build_id_len);
     }
+    os_get_module_info_unlock();
     return true;
 }
 
@@ -316,7 +316,7 @@ coarse_unit_merge(dcontext_t *dcontext, coarse_info_t *info1, coarse_info_t *inf
 
 enum {
     PERSISTENT_CACHE_MAGIC = 0x244f4952, /* RIO$ */
-    PERSISTENT_CACHE_VERSION = 10,
+    PERSISTENT_CACHE_VERSION = 11, /* 11: added persisted_module_info_t.build_id */
 };
 
 /* Global flags we need to process if present in a persisted cache */
@@ -390,6 +390,8 @@ typedef struct _persisted_module_info_t {
     uint64 image_size;
     uint64 code_size; /* sum of sizes of executable sections in module */
     uint64 file_version;
+    /* ELF build ID or Mach-O UUID, zero-padded; all zero on Windows */
+    byte build_id[MODULE_BUILD_ID_MAX_LEN];
 
     /* FIXME case 10087: move to module list and share w/ module-level
      * process control, aslr?
@@ -194,8 +194,16 @@ os_module_area_init(module_area_t *ma, app_pc base, size_t view_size, bool at_ma
      */
     if (ma->os_data.checksum == 0 &&
         (DYNAMO_OPTION(coarse_enable_freeze) || DYNAMO_OPTION(use_persisted))) {
-        /* Use something so we have usable pcache names */
-        ma->os_data.checksum = d_r_crc32((const char *)ma->start, PAGE_SIZE);
+        /* Use something so we have usable pcache names: preferably the build ID,
+         * which unlike the first page is unique to each build.
+         */
+#    ifdef LINUX
+        if (ma->os_data.build_id_len > 0) {
+            ma->os_data.checksum = d_r_crc32((const char *)ma->os_data.build_id,
+                                             ma->os_data.build_id_len);
+        } else
+#    endif
+            ma->os_data.checksum = d_r_crc32((const char *)ma->start, PAGE_SIZE);
     }
     /* Timestamp we just leave as 0 */
 
@@ -442,6 +450,27 @@ os_get_module_info(const app_pc pc, uint *checksum, uint *timestamp, size_t *siz
     return (ma != NULL);
 }
 
+uint
+os_get_module_build_id(const app_pc pc, byte *buf, uint buf_len)
+{
+    module_area_t *ma;
+    uint len = 0;
+    if (!is_module_list_initialized())
+        return 0;
+    ASSERT(os_get_module_info_locked());
+    ma = module_pc_lookup(pc);
+    if (ma != NULL) {
+#    ifdef LINUX
+        len = MIN(buf_len, ma->os_data.build_id_len);
+        memcpy(buf, ma->os_data.build_id, len);
+#    else
+        len = MIN(buf_len, sizeof(ma->os_data.uuid));
+        memcpy(buf, ma->os_data.uuid, len);
+#    endif
+    }
+    return len;
+}
+
 bool
 os_get_module_info_all_names(const app_pc pc, uint *checksum, uint *timestamp,
                              size_t *size, module_names_t **names, size_t *code_size,
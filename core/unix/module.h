@@ -39,6 +39,9 @@
 #define OS_IMAGE_WRITE (MEMPROT_WRITE)
 #define OS_IMAGE_EXECUTE (MEMPROT_EXEC)
 
+/* Large enough for the usual SHA-1 GNU build ID and the Mach-O UUID */
+#define MODULE_BUILD_ID_MAX_LEN 20
+
 /* i#160/PR 562667: support non-contiguous library mappings.  While we're at
  * it we go ahead and store info on each segment whether contiguous or not.
  */
@@ -86,6 +89,11 @@ typedef struct _os_module_data_t {
     size_t dynstr_size;     /* size of .dynstr */
     size_t symentry_size;   /* size of a .dynsym entry */
     bool has_runpath;       /* is DT_RUNPATH present? */
+    /* GNU build ID (NT_GNU_BUILD_ID note), truncated to the buffer; 0-length if
+     * absent.  Identifies pcaches (PR 295534).
+     */
+    byte build_id[MODULE_BUILD_ID_MAX_LEN];
+    uint build_id_len;
     /* for .gnu.hash */
     app_pc gnu_bitmask;
     ptr_uint_t gnu_shift;
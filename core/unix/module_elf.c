@@ -329,11 +329,54 @@ module_fill_os_data(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_DYNAMIC entry */
     return res;
 }
 
+/* Fills in out_data's build_id from a PT_NOTE segment, if it holds one.
+ * As with module_fill_os_data(), if at_map we use the file offset.
+ */
+static void
+module_fill_build_id(ELF_PROGRAM_HEADER_TYPE *prog_hdr, /* PT_NOTE entry */
+                     app_pc base, size_t view_size, bool at_map, ptr_int_t load_delta,
+                     DR_PARAM_OUT os_module_data_t *out_data)
+{
+    app_pc note = at_map ? base + prog_hdr->p_offset
+                         : (app_pc)(prog_hdr->p_vaddr + load_delta);
+    app_pc note_end = note + prog_hdr->p_filesz;
+    /* Notes are 4-aligned, except for 8-aligned segments (e.g., gnu properties). */
+    size_t align = prog_hdr->p_align == 8 ? 8 : 4;
+    dcontext_t *dcontext = get_thread_private_dcontext();
+    ASSERT(prog_hdr->p_type == PT_NOTE);
+    /* The notes are normally in the first segment, which is all we have at map time. */
+    if (note < base || note_end > base + view_size || note_end < note)
+        return;
+    TRY_EXCEPT_ALLOW_NO_DCONTEXT(
+        dcontext,
+        {
+            while (note + sizeof(ELF_NOTE_HEADER_TYPE) <= note_end) {
+                ELF_NOTE_HEADER_TYPE *nhdr = (ELF_NOTE_HEADER_TYPE *)note;
+                app_pc name = note + sizeof(*nhdr);
+                app_pc desc = (app_pc)ALIGN_FORWARD(name + nhdr->n_namesz, align);
+                if (desc + nhdr->n_descsz > note_end || desc < name)
+                    break;
+                if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+                    strncmp((char *)name, "GNU", 4) == 0 && nhdr->n_descsz > 0) {
+                    out_data->build_id_len =
+                        MIN(nhdr->n_descsz, BUFFER_SIZE_ELEMENTS(out_data->build_id));
+                    memcpy(out_data->build_id, desc, out_data->build_id_len);
+                    break;
+                }
+                note = (app_pc)ALIGN_FORWARD(desc + nhdr->n_descsz, align);
+            }
+        },
+        { /* EXCEPT */
+          ASSERT_CURIOSITY(false && "crashed while walking note segment");
+          out_data->build_id_len = 0;
+        });
+}
+
 /* Identifies the bounds of each segment in the ELF at base.
  * Returned addresses out_base and out_end are relative to the actual
  * loaded module base, so the "base" param should be added to produce
  * absolute addresses.
- * If out_data != NULL, fills in the dynamic section fields and adds
+ * If out_data != NULL, fills in the dynamic section fields and build ID and adds
  * entries to the module list vector: so the caller must be
  * os_module_area_init() if out_data != NULL!
  * Optionally returns the first segment bounds, the max segment end, and the soname.
@@ -391,6 +434,11 @@ module_walk_program_headers(app_pc base, size_t view_size, bool at_map, bool dyn
                 }
                 found_load = true;
             }
+            if (out_data != NULL && prog_hdr->p_type == PT_NOTE &&
+                out_data->build_id_len == 0) {
+                module_fill_build_id(prog_hdr, base, view_size, at_map, load_delta,
+                                     out_data);
+            }
             if ((out_soname != NULL || out_data != NULL) &&
                 prog_hdr->p_type == PT_DYNAMIC) {
                 module_fill_os_data(prog_hdr, mod_base, max_end, base, view_size, at_map,
@@ -1220,6 +1220,17 @@ d_r_read_lock(read_write_lock_t *rw)
     DEADLOCK_AVOIDANCE_LOCK(&rw->lock, true, LOCK_NOT_OWNABLE);
 }
 
+/* Called once the write lock is held, before any protected data is written.
+ * Makes rw->write_seq odd for rwlock_seq_read_begin().
+ */
+static inline void
+rwlock_seq_write_begin(read_write_lock_t *rw)
+{
+    ATOMIC_INC(int, rw->write_seq);
+    /* Our subsequent data writes must not become visible before the increment. */
+    MEMORY_STORE_BARRIER();
+}
+
 void
 d_r_write_lock(read_write_lock_t *rw)
 {
@@ -1237,6 +1248,7 @@ d_r_write_lock(read_write_lock_t *rw)
             os_thread_yield();
         }
         rw->writer = d_r_get_thread_id();
+        rwlock_seq_write_begin(rw);
         return;
     }
 
@@ -1250,6 +1262,7 @@ d_r_write_lock(read_write_lock_t *rw)
         rwlock_wait_contended_writer(rw);
     }
     rw->writer = d_r_get_thread_id();
+    rwlock_seq_write_begin(rw);
 }
 
 bool
@@ -1260,6 +1273,7 @@ d_r_write_trylock(read_write_lock_t *rw)
         /* We have the lock so we do not need a load-acquire. */
         if (rw->num_readers == 0) {
             rw->writer = d_r_get_thread_id();
+            rwlock_seq_write_begin(rw);
             return true;
         } else {
             /* We need to duplicate the bottom of d_r_write_unlock() */
@@ -1325,6 +1339,8 @@ d_r_write_unlock(read_write_lock_t *rw)
 #ifdef DEADLOCK_AVOIDANCE
     ASSERT(!mutex_ownable(&rw->lock) || rw->writer == rw->lock.owner);
 #endif
+    /* Publishes all of our writes to optimistic readers. */
+    ATOMIC_INC(int, rw->write_seq);
     rw->writer = INVALID_THREAD_ID;
     if (INTERNAL_OPTION(spin_yield_rwlock)) {
         d_r_mutex_unlock(&rw->lock);
@@ -1352,6 +1368,31 @@ self_owns_write_lock(read_write_lock_t *rw)
     return (ATOMIC_READ_THREAD_ID(&rw->writer) == d_r_get_thread_id());
 }
 
+/* Optimistic lock-free reads: a reader calls rwlock_seq_read_begin(), reads the
+ * protected data without taking the lock, and then keeps what it read only if
+ * rwlock_seq_read_valid() says no writer held the lock in between.  An odd
+ * sequence means a writer currently holds the lock and the caller should take
+ * the read lock instead.  The data must remain safe to read (though not
+ * necessarily consistent) while a writer modifies it: e.g., vmareas.c retires
+ * rather than frees the arrays of VECTOR_LOCKLESS_READ vectors.
+ */
+int
+rwlock_seq_read_begin(read_write_lock_t *rw)
+{
+    /* On ARM this is a load-acquire, ordering the caller's data reads after it. */
+    int seq = atomic_aligned_read_int(&rw->write_seq);
+    MEMORY_LOAD_BARRIER();
+    return seq;
+}
+
+bool
+rwlock_seq_read_valid(read_write_lock_t *rw, int seq)
+{
+    /* Order the caller's data reads before re-reading the sequence. */
+    MEMORY_LOAD_BARRIER();
+    return !TEST(1, seq) && atomic_aligned_read_int(&rw->write_seq) == seq;
+}
+
 /****************************************************************************/
 /* HASHING */
 
@@ -361,6 +361,10 @@ typedef struct _read_write_lock_t {
     volatile int num_pending_readers; /* readers that have contended with a writer */
     contention_event_t writer_waiting_readers; /* event object for writer to wait on */
     contention_event_t readers_waiting_writer; /* event object for readers to wait on */
+    /* Odd while a writer holds the lock and bumped on every write acquire and
+     * release, for optimistic lock-free readers: see rwlock_seq_read_begin().
+     */
+    volatile int write_seq;
     /* make sure to update the two INIT_READWRITE_LOCK cases if you add new fields  */
 } read_write_lock_t;
 
@@ -734,7 +738,8 @@ thread_owns_first_or_both_locks_only(dcontext_t *dcontext, mutex_t *lock1,
         INIT_LOCK_NO_TYPE(#lock "(readwrite)"                                         \
                                 "@" __FILE__ ":" STRINGIFY(__LINE__),                 \
                           LOCK_RANK(lock)),                                           \
-            0, INVALID_THREAD_ID, 0, KSYNCH_TYPE_STATIC_INIT, KSYNCH_TYPE_STATIC_INIT \
+            0, INVALID_THREAD_ID, 0, KSYNCH_TYPE_STATIC_INIT,                         \
+            KSYNCH_TYPE_STATIC_INIT, 0                                                \
     }
 
 #define ASSIGN_INIT_READWRITE_LOCK_FREE(var, lock)                                 \
@@ -747,7 +752,8 @@ thread_owns_first_or_both_locks_only(dcontext_t *dcontext, mutex_t *lock1,
             INVALID_THREAD_ID,                                                     \
             0,                                                                     \
             KSYNCH_TYPE_STATIC_INIT,                                               \
-            KSYNCH_TYPE_STATIC_INIT                                                \
+            KSYNCH_TYPE_STATIC_INIT,                                               \
+            0                                                                      \
         };                                                                         \
         var = initializer_##lock;                                                  \
     } while (0)
@@ -863,6 +869,11 @@ void
 d_r_write_unlock(read_write_lock_t *rw);
 bool
 self_owns_write_lock(read_write_lock_t *rw);
+/* Optimistic lock-free reads of data protected by a read write lock */
+int
+rwlock_seq_read_begin(read_write_lock_t *rw);
+bool
+rwlock_seq_read_valid(read_write_lock_t *rw, int seq);
 
 #if defined(MACOS) || (defined(X64) && defined(WINDOWS))
 #    define ATOMIC_READ_THREAD_ID(id) \
@@ -842,6 +842,25 @@ writelock_if_not_already(vm_area_vector_t *v)
     return false;
 }
 
+/* An array replaced by growth of a VECTOR_LOCKLESS_READ vector, overlaid on the
+ * array itself.
+ */
+typedef struct _retired_vmarea_buf_t {
+    struct _retired_vmarea_buf_t *next;
+    int size; /* capacity */
+} retired_vmarea_buf_t;
+
+static void
+vm_area_vector_free_retired(vm_area_vector_t *v)
+{
+    while (v->retired_bufs != NULL) {
+        retired_vmarea_buf_t *retired = v->retired_bufs;
+        v->retired_bufs = retired->next;
+        global_heap_free(retired,
+                         retired->size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+    }
+}
+
 static void
 vm_area_vector_check_size(vm_area_vector_t *v)
 {
@@ -850,9 +869,32 @@ vm_area_vector_check_size(vm_area_vector_t *v)
     /* check if at capacity */
     if (v->size == v->length) {
         if (v->length == 0) {
-            v->size = INTERNAL_OPTION(vmarea_initial_size);
+            int new_size = INTERNAL_OPTION(vmarea_initial_size);
             v->buf = (vm_area_t *)global_heap_alloc(
-                v->size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+                new_size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+            /* lookup_addr_lockless() reads size before buf */
+            MEMORY_STORE_BARRIER();
+            v->size = new_size;
+        } else if (TEST(VECTOR_LOCKLESS_READ, v->flags)) {
+            /* A lock-free reader may still be searching the old array, so we
+             * retire it rather than freeing it, and double the size so the
+             * retired arrays never add up to more than the live one.
+             */
+            int old_size = v->size;
+            int new_size = 2 * old_size;
+            vm_area_t *new_buf = (vm_area_t *)global_heap_alloc(
+                new_size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+            retired_vmarea_buf_t *retired = (retired_vmarea_buf_t *)v->buf;
+            ASSERT(sizeof(*retired) <= sizeof(struct vm_area_t));
+            STATS_INC(num_vmareas_resized);
+            memcpy(new_buf, v->buf, v->length * sizeof(struct vm_area_t));
+            v->buf = new_buf;
+            MEMORY_STORE_BARRIER();
+            v->size = new_size;
+            /* Only readers that will fail validation can see these writes. */
+            retired->size = old_size;
+            retired->next = v->retired_bufs;
+            v->retired_bufs = retired;
         } else {
             /* FIXME: case 4471 we should be doubling size here */
             int new_size = (INTERNAL_OPTION(vmarea_increment_size) + v->length);
@@ -1573,6 +1615,56 @@ lookup_addr(vm_area_vector_t *v, app_pc addr, vm_area_t **area)
                          false);
 }
 
+/* Lock-free counterpart of lookup_addr() for VECTOR_LOCKLESS_READ vectors.
+ * Does not acquire v->lock: returns false if a writer interfered (or holds the
+ * lock), in which case the caller must fall back to a locked lookup_addr().
+ * Otherwise sets *found and, if found and area is non-NULL, copies the area
+ * containing addr into *area.
+ * If uptodate is non-NULL, also returns false unless *uptodate, a flag written
+ * only under v->lock, is set.
+ */
+static bool
+lookup_addr_lockless(vm_area_vector_t *v, app_pc addr, volatile bool *uptodate,
+                     bool *found /*OUT*/, vm_area_t *area /*OUT*/)
+{
+    app_pc end = (app_pc)((ptr_uint_t)addr + 1) /*open end*/;
+    vm_area_t *buf, copy;
+    int min, max, size, seq;
+    ASSERT(TEST(VECTOR_LOCKLESS_READ, v->flags) && TEST(VECTOR_SHARED, v->flags) &&
+           !TEST(VECTOR_NO_LOCK, v->flags));
+    seq = rwlock_seq_read_begin(&v->lock);
+    if (TEST(1, seq) || (uptodate != NULL && !*uptodate))
+        return false;
+    /* A concurrent writer may be growing or shifting the array underneath us:
+     * we only need to stay within the array we read, as validation will fail.
+     * Growth publishes the new buf before the new size, and arrays are never
+     * freed while readers can reach them.
+     */
+    size = v->size;
+    MEMORY_LOAD_BARRIER();
+    buf = v->buf;
+    max = MIN(v->length, size) - 1;
+    min = 0;
+    *found = false;
+    while (max >= min) {
+        int i = (min + max) / 2;
+        copy = buf[i];
+        if (end != NULL && end <= copy.start)
+            max = i - 1;
+        else if (addr >= copy.end)
+            min = i + 1;
+        else {
+            *found = true;
+            break;
+        }
+    }
+    if (!rwlock_seq_read_valid(&v->lock, seq))
+        return false;
+    if (*found && area != NULL)
+        *area = copy;
+    return true;
+}
+
 /* returns true if the passed in area overlaps any known executable areas
  * Assumes caller holds v->lock, if necessary
  */
@@ -1597,7 +1689,8 @@ vm_areas_reset_init(void)
 void
 dynamo_vm_areas_init()
 {
-    VMVECTOR_ALLOC_VECTOR(dynamo_areas, GLOBAL_DCONTEXT, VECTOR_SHARED, dynamo_areas);
+    VMVECTOR_ALLOC_VECTOR(dynamo_areas, GLOBAL_DCONTEXT,
+                          VECTOR_SHARED | VECTOR_LOCKLESS_READ, dynamo_areas);
 }
 
 void
@@ -1620,8 +1713,8 @@ vm_areas_init()
      * We're already paying the indirection cost by passing their addresses
      * to generic routines, after all.
      */
-    VMVECTOR_ALLOC_VECTOR(executable_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
-                          executable_areas);
+    VMVECTOR_ALLOC_VECTOR(executable_areas, GLOBAL_DCONTEXT,
+                          VECTOR_SHARED | VECTOR_LOCKLESS_READ, executable_areas);
     VMVECTOR_ALLOC_VECTOR(pretend_writable_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
                           pretend_writable_areas);
     VMVECTOR_ALLOC_VECTOR(patch_proof_areas, GLOBAL_DCONTEXT, VECTOR_SHARED,
@@ -2025,8 +2118,21 @@ vmvector_lookup_data(vm_area_vector_t *v, app_pc pc, app_pc *start /* OUT */,
 {
     bool overlap;
     vm_area_t *area = NULL;
+    vm_area_t area_copy;
     bool release_lock; /* 'true' means this routine needs to unlock */
 
+    if (TEST(VECTOR_LOCKLESS_READ, v->flags) && SHOULD_LOCK_VECTOR(v) &&
+        lookup_addr_lockless(v, pc, NULL, &overlap, &area_copy)) {
+        if (overlap) {
+            if (start != NULL)
+                *start = area_copy.start;
+            if (end != NULL)
+                *end = area_copy.end;
+            if (data != NULL)
+                *data = area_copy.custom.client;
+        }
+        return overlap;
+    }
     LOCK_VECTOR(v, release_lock, read);
     ASSERT_OWN_READWRITE_LOCK(SHOULD_LOCK_VECTOR(v), &v->lock);
     overlap = lookup_addr(v, pc, &area);
@@ -2171,8 +2277,9 @@ vmvector_reset_vector(dcontext_t *dcontext, vm_area_vector_t *v)
         v->size = 0;
         v->length = 0;
         v->buf = NULL;
+        vm_area_vector_free_retired(v);
     } else
-        ASSERT(v->size == 0 && v->length == 0);
+        ASSERT(v->size == 0 && v->length == 0 && v->retired_bufs == NULL);
 }
 
 static void
@@ -2991,6 +3098,8 @@ bool
 is_executable_address(app_pc addr)
 {
     bool found;
+    if (lookup_addr_lockless(executable_areas, addr, NULL, &found, NULL))
+        return found;
     d_r_read_lock(&executable_areas->lock);
     found = lookup_addr(executable_areas, addr, NULL);
     d_r_read_unlock(&executable_areas->lock);
@@ -3005,7 +3114,12 @@ bool
 get_executable_area_vm_flags(app_pc addr, uint *vm_flags)
 {
     bool found = false;
-    vm_area_t *area;
+    vm_area_t *area, area_copy;
+    if (lookup_addr_lockless(executable_areas, addr, NULL, &found, &area_copy)) {
+        if (found)
+            *vm_flags = area_copy.vm_flags;
+        return found;
+    }
     d_r_read_lock(&executable_areas->lock);
     if (lookup_addr(executable_areas, addr, &area)) {
         *vm_flags = area->vm_flags;
@@ -3025,7 +3139,12 @@ bool
 get_executable_area_flags(app_pc addr, uint *frag_flags)
 {
     bool found = false;
-    vm_area_t *area;
+    vm_area_t *area, area_copy;
+    if (lookup_addr_lockless(executable_areas, addr, NULL, &found, &area_copy)) {
+        if (found)
+            *frag_flags = area_copy.frag_flags;
+        return found;
+    }
     d_r_read_lock(&executable_areas->lock);
     if (lookup_addr(executable_areas, addr, &area)) {
         *frag_flags = area->frag_flags;
@@ -3769,6 +3888,8 @@ is_dynamo_address(app_pc addr)
     /* case 3045: areas inside the vmheap reservation are not added to the list */
     if (is_vmm_reserved_address(addr, 1, NULL, NULL))
         return true;
+    if (lookup_addr_lockless(dynamo_areas, addr, &dynamo_areas_uptodate, &found, NULL))
+        return found;
     dynamo_vm_areas_start_reading();
     found = lookup_addr(dynamo_areas, addr, NULL);
     dynamo_vm_areas_done_reading();
@@ -11715,6 +11836,32 @@ vmvector_tests()
         vmvector_remove(&v, INT_TO_PC(0x20), INT_TO_PC(0x210)); /* truncation allowed? */
     EXPECT(res, true);
     vmvector_print(&v, STDERR);
+
+    /* lock-free lookups, across growth of the array */
+    {
+        vm_area_vector_t lv = { 0, 0, 0,
+                                VECTOR_SHARED | VECTOR_NEVER_MERGE | VECTOR_LOCKLESS_READ,
+                                INIT_READWRITE_LOCK(thread_vm_areas) };
+        int i, count = 3 * INTERNAL_OPTION(vmarea_initial_size);
+        for (i = 0; i < count; i++)
+            vmvector_add(&lv, INT_TO_PC(0x1000 + 0x10 * i), INT_TO_PC(0x1008 + 0x10 * i),
+                         INT_TO_PC(i + 1));
+        EXPECT(lv.retired_bufs != NULL, true);
+        for (i = 0; i < count; i++) {
+            void *data = NULL;
+            res = vmvector_lookup_data(&lv, INT_TO_PC(0x1004 + 0x10 * i), &start, &end,
+                                       &data);
+            EXPECT(res, true);
+            EXPECT(start, 0x1000 + 0x10 * i);
+            EXPECT(end, 0x1008 + 0x10 * i);
+            EXPECT(data, i + 1);
+            res = vmvector_lookup_data(&lv, INT_TO_PC(0x100c + 0x10 * i), NULL, NULL,
+                                       NULL);
+            EXPECT(res, false);
+        }
+        vmvector_reset_vector(GLOBAL_DCONTEXT, &lv);
+        EXPECT(lv.retired_bufs == NULL, true);
+    }
 }
 
 /* initial vector tests
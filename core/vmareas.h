@@ -67,6 +67,11 @@ enum {
      * flag to avoid the redundant vector-level lock
      */
     VECTOR_NO_LOCK = 0x0010,
+    /* Lookups may be made without the lock (see rwlock_seq_read_begin()):
+     * the array is never freed while the vector is live, so growing it
+     * retires the old copy until the vector is reset.
+     */
+    VECTOR_LOCKLESS_READ = 0x0020,
 };
 
 #define VECTOR_NEVER_MERGE (VECTOR_NEVER_MERGE_ADJACENT | VECTOR_NEVER_OVERLAP)
@@ -89,6 +94,8 @@ struct vm_area_vector_t {
      * to perform a read (don't need full recursive lock)
      */
     read_write_lock_t lock;
+    /* VECTOR_LOCKLESS_READ arrays replaced by growth, freed on reset */
+    struct _retired_vmarea_buf_t *retired_bufs;
 
     /* Callbacks to support payloads */
     /* Frees a payload */
@@ -4132,6 +4132,15 @@ os_get_module_info(const app_pc pc, DR_PARAM_OUT uint *checksum,
     return ok;
 }
 
+uint
+os_get_module_build_id(const app_pc pc, byte *buf, uint buf_len)
+{
+    /* XXX: We could return the CodeView GUID from the debug directory, but the
+     * PE checksum and timestamp already identify pcaches.
+     */
+    return 0;
+}
+
 /* Gets module information of module containing pc, cached in our module list.
  * Returns false if not in module; none of the OUT arguments are set in that case.
  * Note: this function returns all types of module names as fix for case 9842.
@@ -43,6 +43,9 @@
 #define OS_IMAGE_WRITE IMAGE_SCN_MEM_WRITE
 #define OS_IMAGE_EXECUTE IMAGE_SCN_MEM_EXECUTE
 
+/* Sizes persisted_module_info_t.build_id; PE modules do not fill it in yet. */
+#define MODULE_BUILD_ID_MAX_LEN 20
+
 #ifndef IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE
 #    define IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE 0x0040
 #endif
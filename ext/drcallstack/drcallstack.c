@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2013-2021 Google, Inc.   All rights reserved.
+ * Copyright (c) 2013-2025 Google, Inc.   All rights reserved.
  * **********************************************************/
 
 /*
@@ -33,37 +33,445 @@
 /* DynamoRIO Callstack Walker. */
 
 #include "dr_api.h"
+#include "drmgr.h"
+#include "drreg.h"
 #include "drcallstack.h"
 #include "../ext_utils.h"
 #include "../../core/unix/os_public.h" /* SIGCXT_FROM_UCXT, SC_FIELD */
+#include <stddef.h>                    /* offsetof */
 #include <string.h>
 
 #define UNW_LOCAL_ONLY /* Speed up libunwind by disallowing remote. */
 #include <libunwind.h>
 
+#ifdef DEBUG
+#    define ASSERT(x, msg) DR_ASSERT_MSG(x, msg)
+#else
+#    define ASSERT(x, msg) /* nothing */
+#endif
+
+#if defined(X86) || defined(AARCH64)
+#    define SHADOW_STACK_SUPPORTED 1
+#endif
+
+#define SHADOW_DEFAULT_MAX_DEPTH 16384
+#define SHADOW_INITIAL_DEPTH 256
+
+/* Raw TLS slots holding the innermost shadow frame and the lowest frame address. */
+#define SHADOW_TLS_SLOT_TOP 0
+#define SHADOW_TLS_SLOT_LIMIT 1
+#define SHADOW_TLS_SLOT_COUNT 2
+#define SHADOW_TLS_OFFS(slot) (shadow_tls_offs + (slot) * sizeof(void *))
+
 static int drcallstack_init_count;
 
+static drcallstack_options_t ops;
+
 struct _drcallstack_walk_t {
     /* For now we only support libunwind. */
     unw_context_t uc;
     unw_cursor_t cursor;
 };
 
+/***************************************************************************
+ * SHADOW STACK
+ */
+
+/* Each thread's shadow stack grows downward like the application stack, so the
+ * live frames form one innermost-first run from the top to the end of the buffer
+ * that drcallstack_capture() can copy out.  Calls push their return address and
+ * stack pointer and returns pop every frame whose call-time stack pointer is not
+ * above the one being returned to, which also discards frames abandoned by
+ * longjmp and the like.  A sentinel frame with the highest possible stack pointer
+ * sits past the end so the inlined pop loop needs no empty check.
+ */
+typedef struct _shadow_stack_t {
+    /* capacity frames followed by the sentinel. */
+    drcallstack_sample_frame_t *buf;
+    uint capacity;
+} shadow_stack_t;
+
+static int shadow_tls_idx = -1;
+static reg_id_t shadow_tls_seg;
+static uint shadow_tls_offs;
+
+static inline drcallstack_sample_frame_t **
+shadow_tls_slot(uint slot)
+{
+    byte *base = dr_get_dr_segment_base(shadow_tls_seg);
+    return (drcallstack_sample_frame_t **)(base + SHADOW_TLS_OFFS(slot));
+}
+
+#ifdef SHADOW_STACK_SUPPORTED
+
+static void
+shadow_stack_alloc(void *drcontext, shadow_stack_t *ss, uint capacity)
+{
+    ss->capacity = capacity;
+    ss->buf = dr_thread_alloc(drcontext, (capacity + 1) * sizeof(*ss->buf));
+    ss->buf[capacity].pc = NULL;
+    ss->buf[capacity].sp = ~(reg_t)0;
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    shadow_stack_t *ss = dr_thread_alloc(drcontext, sizeof(*ss));
+    uint depth = ops.shadow_max_depth < SHADOW_INITIAL_DEPTH ? ops.shadow_max_depth
+                                                              : SHADOW_INITIAL_DEPTH;
+    shadow_stack_alloc(drcontext, ss, depth);
+    drmgr_set_tls_field(drcontext, shadow_tls_idx, ss);
+    *shadow_tls_slot(SHADOW_TLS_SLOT_TOP) = ss->buf + ss->capacity;
+    *shadow_tls_slot(SHADOW_TLS_SLOT_LIMIT) = ss->buf;
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    shadow_stack_t *ss = (shadow_stack_t *)drmgr_get_tls_field(drcontext, shadow_tls_idx);
+    if (ss == NULL)
+        return;
+    /* Later thread exit events fall back to libunwind. */
+    drmgr_set_tls_field(drcontext, shadow_tls_idx, NULL);
+    dr_thread_free(drcontext, ss->buf, (ss->capacity + 1) * sizeof(*ss->buf));
+    dr_thread_free(drcontext, ss, sizeof(*ss));
+}
+
+/* Called via clean call for a call made with the shadow stack full: grows it if
+ * allowed and performs the push, or else drops the frame.  Returns for dropped
+ * frames never match an outer frame, so the rest of the stack stays consistent.
+ */
+static void
+shadow_stack_push_slow(app_pc retaddr, reg_t sp)
+{
+    void *drcontext = dr_get_current_drcontext();
+    shadow_stack_t *ss = (shadow_stack_t *)drmgr_get_tls_field(drcontext, shadow_tls_idx);
+    drcallstack_sample_frame_t **top = shadow_tls_slot(SHADOW_TLS_SLOT_TOP);
+    drcallstack_sample_frame_t *buf;
+    uint depth, capacity;
+    if (ss == NULL || ss->capacity >= ops.shadow_max_depth)
+        return;
+    depth = (uint)(ss->buf + ss->capacity - *top);
+    capacity = ss->capacity * 2;
+    if (capacity > ops.shadow_max_depth)
+        capacity = ops.shadow_max_depth;
+    buf = dr_thread_alloc(drcontext, (capacity + 1) * sizeof(*buf));
+    /* Copy the live frames along with the sentinel. */
+    memcpy(buf + capacity - depth, *top, (depth + 1) * sizeof(*buf));
+    dr_thread_free(drcontext, ss->buf, (ss->capacity + 1) * sizeof(*ss->buf));
+    ss->buf = buf;
+    ss->capacity = capacity;
+    *top = buf + capacity - depth - 1;
+    (*top)->pc = retaddr;
+    (*top)->sp = sp;
+    *shadow_tls_slot(SHADOW_TLS_SLOT_LIMIT) = buf;
+}
+
+/* Far calls and returns and the like are left alone. */
+static bool
+shadow_is_call(instr_t *instr)
+{
+#    ifdef X86
+    return instr_get_opcode(instr) == OP_call || instr_get_opcode(instr) == OP_call_ind;
+#    else
+    return instr_is_call(instr);
+#    endif
+}
+
+static bool
+shadow_is_return(instr_t *instr)
+{
+#    ifdef X86
+    return instr_get_opcode(instr) == OP_ret;
+#    else
+    return instr_is_return(instr);
+#    endif
+}
+
+static bool
+shadow_reserve(void *drcontext, instrlist_t *ilist, instr_t *where, reg_id_t *reg,
+               uint num_regs)
+{
+    uint i;
+    for (i = 0; i < num_regs; i++) {
+        if (drreg_reserve_register(drcontext, ilist, where, NULL, &reg[i]) !=
+            DRREG_SUCCESS) {
+            ASSERT(false, "failed to reserve shadow stack scratch register");
+            while (i-- > 0)
+                drreg_unreserve_register(drcontext, ilist, where, reg[i]);
+            return false;
+        }
+    }
+    if (drreg_reserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS) {
+        ASSERT(false, "failed to reserve aflags");
+        for (i = 0; i < num_regs; i++)
+            drreg_unreserve_register(drcontext, ilist, where, reg[i]);
+        return false;
+    }
+    return true;
+}
+
+static void
+shadow_unreserve(void *drcontext, instrlist_t *ilist, instr_t *where, reg_id_t *reg,
+                 uint num_regs)
+{
+    uint i;
+    if (drreg_unreserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS)
+        ASSERT(false, "failed to unreserve aflags");
+    for (i = 0; i < num_regs; i++) {
+        if (drreg_unreserve_register(drcontext, ilist, where, reg[i]) != DRREG_SUCCESS)
+            ASSERT(false, "failed to unreserve shadow stack scratch register");
+    }
+}
+
+/* Loads the application stack pointer at the point of the call being pushed or
+ * returned from, which is the stack pointer a walk reports for the caller's frame.
+ */
+static void
+shadow_insert_load_sp(void *drcontext, instrlist_t *ilist, instr_t *where, reg_id_t reg,
+                      int offs)
+{
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_add_2src(drcontext, opnd_create_reg(reg),
+                                                   opnd_create_reg(DR_REG_XSP),
+                                                   OPND_CREATE_INT16(offs)));
+}
+
+static void
+shadow_insert_push(void *drcontext, instrlist_t *ilist, instr_t *where, app_pc retaddr)
+{
+    instr_t *full = INSTR_CREATE_label(drcontext);
+    instr_t *done = INSTR_CREATE_label(drcontext);
+    reg_id_t reg[2];
+    reg_id_t reg_top, reg_tmp;
+    if (!shadow_reserve(drcontext, ilist, where, reg, BUFFER_SIZE_ELEMENTS(reg)))
+        return;
+    reg_top = reg[0];
+    reg_tmp = reg[1];
+    dr_insert_read_raw_tls(drcontext, ilist, where, shadow_tls_seg,
+                           SHADOW_TLS_OFFS(SHADOW_TLS_SLOT_TOP), reg_top);
+    dr_insert_read_raw_tls(drcontext, ilist, where, shadow_tls_seg,
+                           SHADOW_TLS_OFFS(SHADOW_TLS_SLOT_LIMIT), reg_tmp);
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_top), opnd_create_reg(reg_tmp)));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_jump_cond(drcontext, DR_PRED_EQ, opnd_create_instr(full)));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_sub(drcontext, opnd_create_reg(reg_top),
+                         OPND_CREATE_INT16(sizeof(drcallstack_sample_frame_t))));
+    instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)retaddr,
+                                     opnd_create_reg(reg_tmp), ilist, where, NULL, NULL);
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_store(
+            drcontext,
+            OPND_CREATE_MEMPTR(reg_top, offsetof(drcallstack_sample_frame_t, pc)),
+            opnd_create_reg(reg_tmp)));
+    shadow_insert_load_sp(drcontext, ilist, where, reg_tmp, 0);
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_store(
+            drcontext,
+            OPND_CREATE_MEMPTR(reg_top, offsetof(drcallstack_sample_frame_t, sp)),
+            opnd_create_reg(reg_tmp)));
+    dr_insert_write_raw_tls(drcontext, ilist, where, shadow_tls_seg,
+                            SHADOW_TLS_OFFS(SHADOW_TLS_SLOT_TOP), reg_top);
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_jump(drcontext, opnd_create_instr(done)));
+    instrlist_meta_preinsert(ilist, where, full);
+    shadow_insert_load_sp(drcontext, ilist, where, reg_tmp, 0);
+    dr_insert_clean_call(drcontext, ilist, where, (void *)shadow_stack_push_slow,
+                         false /*!fpstate*/, 2, OPND_CREATE_INTPTR((ptr_int_t)retaddr),
+                         opnd_create_reg(reg_tmp));
+    instrlist_meta_preinsert(ilist, where, done);
+    shadow_unreserve(drcontext, ilist, where, reg, BUFFER_SIZE_ELEMENTS(reg));
+}
+
+static void
+shadow_insert_pop(void *drcontext, instrlist_t *ilist, instr_t *where)
+{
+    instr_t *loop = INSTR_CREATE_label(drcontext);
+    instr_t *done = INSTR_CREATE_label(drcontext);
+    reg_id_t reg[3];
+    reg_id_t reg_top, reg_sp, reg_tmp;
+    if (!shadow_reserve(drcontext, ilist, where, reg, BUFFER_SIZE_ELEMENTS(reg)))
+        return;
+    reg_top = reg[0];
+    reg_sp = reg[1];
+    reg_tmp = reg[2];
+    dr_insert_read_raw_tls(drcontext, ilist, where, shadow_tls_seg,
+                           SHADOW_TLS_OFFS(SHADOW_TLS_SLOT_TOP), reg_top);
+    /* On x86 the return address is still on the stack. */
+    shadow_insert_load_sp(drcontext, ilist, where, reg_sp,
+                          IF_X86_ELSE(sizeof(void *), 0));
+    instrlist_meta_preinsert(ilist, where, loop);
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_load(
+            drcontext, opnd_create_reg(reg_tmp),
+            OPND_CREATE_MEMPTR(reg_top, offsetof(drcallstack_sample_frame_t, sp))));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_tmp), opnd_create_reg(reg_sp)));
+    /* Unsigned: the sentinel's stack pointer is the highest value. */
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_jump_cond(drcontext,
+                                                    IF_X86_ELSE(DR_PRED_NBE, DR_PRED_HI),
+                                                    opnd_create_instr(done)));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_add(drcontext, opnd_create_reg(reg_top),
+                         OPND_CREATE_INT16(sizeof(drcallstack_sample_frame_t))));
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_jump(drcontext, opnd_create_instr(loop)));
+    instrlist_meta_preinsert(ilist, where, done);
+    dr_insert_write_raw_tls(drcontext, ilist, where, shadow_tls_seg,
+                            SHADOW_TLS_OFFS(SHADOW_TLS_SLOT_TOP), reg_top);
+    shadow_unreserve(drcontext, ilist, where, reg, BUFFER_SIZE_ELEMENTS(reg));
+}
+
+static dr_emit_flags_t
+event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *instr,
+                      bool for_trace, bool translating, void *user_data)
+{
+    if (!instr_is_app(instr))
+        return DR_EMIT_DEFAULT;
+    if (shadow_is_call(instr)) {
+        shadow_insert_push(drcontext, bb, instr,
+                           instr_get_app_pc(instr) + instr_length(drcontext, instr));
+    } else if (shadow_is_return(instr))
+        shadow_insert_pop(drcontext, bb, instr);
+    return DR_EMIT_DEFAULT;
+}
+#endif /* SHADOW_STACK_SUPPORTED */
+
+static bool
+shadow_init(void)
+{
+#ifdef SHADOW_STACK_SUPPORTED
+    drreg_options_t drreg_ops = { sizeof(drreg_ops), 3 + 1 /*aflags*/, false };
+    drmgr_priority_t pri_insert = { sizeof(pri_insert), DRMGR_PRIORITY_NAME_DRCALLSTACK,
+                                    NULL, NULL, DRMGR_PRIORITY_INSERT_DRCALLSTACK };
+    if (drreg_init(&drreg_ops) != DRREG_SUCCESS ||
+        !dr_raw_tls_calloc(&shadow_tls_seg, &shadow_tls_offs, SHADOW_TLS_SLOT_COUNT, 0))
+        return false;
+    shadow_tls_idx = drmgr_register_tls_field();
+    if (shadow_tls_idx == -1 || !drmgr_register_thread_init_event(event_thread_init) ||
+        !drmgr_register_thread_exit_event(event_thread_exit) ||
+        !drmgr_register_bb_instrumentation_event(NULL, event_app_instruction,
+                                                 &pri_insert))
+        return false;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void
+shadow_exit(void)
+{
+#ifdef SHADOW_STACK_SUPPORTED
+    drmgr_unregister_bb_insertion_event(event_app_instruction);
+    drmgr_unregister_thread_init_event(event_thread_init);
+    drmgr_unregister_thread_exit_event(event_thread_exit);
+    drmgr_unregister_tls_field(shadow_tls_idx);
+    shadow_tls_idx = -1;
+    if (!dr_raw_tls_cfree(shadow_tls_offs, SHADOW_TLS_SLOT_COUNT))
+        ASSERT(false, "failed to free raw TLS slots");
+    drreg_exit();
+#endif
+}
+
+/* Copies the live shadow frames of the current thread.  Returns false if it has
+ * no shadow stack.
+ */
+static bool
+shadow_capture(void *drcontext, dr_mcontext_t *mc, drcallstack_sample_frame_t *frames,
+               size_t max_frames, size_t *num_frames)
+{
+    shadow_stack_t *ss = (shadow_stack_t *)drmgr_get_tls_field(drcontext, shadow_tls_idx);
+    drcallstack_sample_frame_t *top, *end;
+    size_t num;
+    if (ss == NULL)
+        return false;
+    top = *shadow_tls_slot(SHADOW_TLS_SLOT_TOP);
+    end = ss->buf + ss->capacity;
+    /* Skip frames abandoned below the current stack pointer but not yet popped.
+     * The sentinel ends the scan.
+     */
+    while (top->sp < mc->xsp)
+        top++;
+    num = end - top;
+    if (num > max_frames)
+        num = max_frames;
+    memcpy(frames, top, num * sizeof(*frames));
+    *num_frames = num;
+    return true;
+}
+
+/***************************************************************************
+ * UNWIND INFO CACHE
+ */
+
+static void
+event_module_unload(void *drcontext, const module_data_t *info)
+{
+    unw_flush_cache(unw_local_addr_space, (unw_word_t)info->start,
+                    (unw_word_t)info->end);
+}
+
+/***************************************************************************
+ * INIT
+ */
+
 drcallstack_status_t
 drcallstack_init(drcallstack_options_t *ops_in)
 {
-    /* This does nothing now.  We anticipate adding callstack storage and
-     * module indexing which might need event registration in the future.
-     */
-    if (ops_in->struct_size != sizeof(*ops_in))
+    drcallstack_options_t opts = {
+        0,
+    };
+    if (ops_in->struct_size > sizeof(*ops_in) ||
+        /* This is the first size we exported so it shouldn't be smaller. */
+        ops_in->struct_size < offsetof(drcallstack_options_t, flags))
         return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+    /* Fields beyond ops_in are left zero. */
+    memcpy(&opts, ops_in, ops_in->struct_size);
+    if (TEST(DRCALLSTACK_SHADOW_VALIDATE, opts.flags) &&
+        !TEST(DRCALLSTACK_SHADOW_STACK, opts.flags))
+        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+#ifndef SHADOW_STACK_SUPPORTED
+    if (TEST(DRCALLSTACK_SHADOW_STACK, opts.flags))
+        return DRCALLSTACK_ERROR_FEATURE_NOT_AVAILABLE;
+#endif
     int count = dr_atomic_add32_return_sum(&drcallstack_init_count, 1);
     if (count > 1) {
-        /* If we have failure modes in the future we may need to store the
-         * failure code and return it here on additional calls.
-         */
+        /* Only the first caller's options take effect. */
+        if (TEST(DRCALLSTACK_SHADOW_STACK, opts.flags) &&
+            !TEST(DRCALLSTACK_SHADOW_STACK, ops.flags))
+            return DRCALLSTACK_ERROR_FEATURE_NOT_AVAILABLE;
         return DRCALLSTACK_SUCCESS;
     }
+    ops = opts;
+    ops.struct_size = sizeof(ops);
+    if (ops.shadow_max_depth == 0)
+        ops.shadow_max_depth = SHADOW_DEFAULT_MAX_DEPTH;
+
+    if (TESTANY(DRCALLSTACK_SHADOW_STACK | DRCALLSTACK_CACHE_UNWIND_INFO, ops.flags) &&
+        !drmgr_init())
+        return DRCALLSTACK_ERROR;
+    if (TEST(DRCALLSTACK_CACHE_UNWIND_INFO, ops.flags)) {
+        /* libunwind caches by program counter without knowing when code goes away,
+         * so we flush the ranges of unloaded modules.
+         */
+        if (unw_set_caching_policy(unw_local_addr_space, UNW_CACHE_GLOBAL) != 0 ||
+            !drmgr_register_module_unload_event(event_module_unload))
+            return DRCALLSTACK_ERROR;
+    }
+    if (TEST(DRCALLSTACK_SHADOW_STACK, ops.flags) && !shadow_init())
+        return DRCALLSTACK_ERROR;
     return DRCALLSTACK_SUCCESS;
 }
 
@@ -73,9 +481,20 @@ drcallstack_exit(void)
     int count = dr_atomic_add32_return_sum(&drcallstack_init_count, -1);
     if (count != 0)
         return DRCALLSTACK_SUCCESS;
+    if (TEST(DRCALLSTACK_SHADOW_STACK, ops.flags))
+        shadow_exit();
+    if (TEST(DRCALLSTACK_CACHE_UNWIND_INFO, ops.flags))
+        drmgr_unregister_module_unload_event(event_module_unload);
+    if (TESTANY(DRCALLSTACK_SHADOW_STACK | DRCALLSTACK_CACHE_UNWIND_INFO, ops.flags))
+        drmgr_exit();
+    memset(&ops, 0, sizeof(ops));
     return DRCALLSTACK_SUCCESS;
 }
 
+/***************************************************************************
+ * WALKING
+ */
+
 drcallstack_status_t
 drcallstack_init_walk(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_walk_t **walk_out)
 {
@@ -186,3 +605,74 @@ drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_
         return DRCALLSTACK_ERROR;
     return DRCALLSTACK_SUCCESS;
 }
+
+/* Fills frames by walking with libunwind.  Returns DRCALLSTACK_ERROR with
+ * *num_frames set if the walk failed part way.
+ */
+static drcallstack_status_t
+unwind_capture(dr_mcontext_t *mc, drcallstack_sample_frame_t *frames, size_t max_frames,
+               size_t *num_frames)
+{
+    drcallstack_walk_t *walk;
+    drcallstack_frame_t frame = {
+        sizeof(frame),
+    };
+    size_t num = 0;
+    drcallstack_status_t res = drcallstack_init_walk(mc, &walk);
+    *num_frames = 0;
+    if (res != DRCALLSTACK_SUCCESS)
+        return res;
+    while (num < max_frames) {
+        res = drcallstack_next_frame(walk, &frame);
+        if (res != DRCALLSTACK_SUCCESS)
+            break;
+        frames[num].pc = frame.pc;
+        frames[num].sp = frame.sp;
+        num++;
+    }
+    drcallstack_cleanup_walk(walk);
+    *num_frames = num;
+    return res == DRCALLSTACK_NO_MORE_FRAMES ? DRCALLSTACK_SUCCESS : res;
+}
+
+drcallstack_status_t
+drcallstack_capture(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_sample_frame_t *frames,
+                    DR_PARAM_INOUT size_t *num_frames)
+{
+    void *drcontext = dr_get_current_drcontext();
+    drcallstack_sample_frame_t *unwound;
+    drcallstack_status_t res;
+    size_t max_frames, num_unwound, i;
+    if (mc == NULL || frames == NULL || num_frames == NULL ||
+        !TEST(DR_MC_CONTROL, mc->flags))
+        return DRCALLSTACK_ERROR_INVALID_PARAMETER;
+    max_frames = *num_frames;
+    if (!TEST(DRCALLSTACK_SHADOW_STACK, ops.flags) ||
+        !shadow_capture(drcontext, mc, frames, max_frames, num_frames))
+        return unwind_capture(mc, frames, max_frames, num_frames);
+    if (!TEST(DRCALLSTACK_SHADOW_VALIDATE, ops.flags) || max_frames == 0)
+        return DRCALLSTACK_SUCCESS;
+
+    unwound = dr_thread_alloc(drcontext, max_frames * sizeof(*unwound));
+    res = unwind_capture(mc, unwound, max_frames, &num_unwound);
+    if (res == DRCALLSTACK_SUCCESS || res == DRCALLSTACK_ERROR) {
+        /* Frames from before drcallstack_init() or beyond where libunwind gives up
+         * are only in one of the two, so compare the common part.
+         */
+        res = DRCALLSTACK_SUCCESS;
+        for (i = 0; i < *num_frames && i < num_unwound; i++) {
+            if (frames[i].pc != unwound[i].pc) {
+#ifdef VERBOSE
+                dr_fprintf(STDERR, "shadow frame #%d " PFX " != unwound " PFX "\n",
+                           (int)i, frames[i].pc, unwound[i].pc);
+#endif
+                memcpy(frames, unwound, num_unwound * sizeof(*frames));
+                *num_frames = num_unwound;
+                res = DRCALLSTACK_SHADOW_MISMATCH;
+                break;
+            }
+        }
+    }
+    dr_thread_free(drcontext, unwound, max_frames * sizeof(*unwound));
+    return res;
+}
@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2021 Google, Inc.   All rights reserved.
+ * Copyright (c) 2021-2025 Google, Inc.   All rights reserved.
  * **********************************************************/
 
 /*
@@ -56,17 +56,67 @@ typedef enum {
     DRCALLSTACK_ERROR,                       /**< Operation failed. */
     DRCALLSTACK_ERROR_INVALID_PARAMETER,     /**< Operation failed: invalid parameter */
     DRCALLSTACK_ERROR_FEATURE_NOT_AVAILABLE, /**< Operation failed: not available */
+    /**
+     * drcallstack_capture() found the shadow stack disagreeing with libunwind
+     * under #DRCALLSTACK_SHADOW_VALIDATE.  The libunwind frames were returned.
+     */
+    DRCALLSTACK_SHADOW_MISMATCH,
 } drcallstack_status_t;
 
+/**
+ * Priority of the drmgr instrumentation pass used by drcallstack to maintain the
+ * shadow stack.  It is late so that other components' instrumentation before a
+ * call or return, such as a sampling clean call, sees the shadow stack matching
+ * the application stack.
+ */
+enum {
+    DRMGR_PRIORITY_INSERT_DRCALLSTACK = 5000, /**< Priority of shadow stack updates. */
+};
+
+/** Name of the drmgr instrumentation pass priority used by drcallstack. */
+#define DRMGR_PRIORITY_NAME_DRCALLSTACK "drcallstack"
+
 /***************************************************************************
  * INIT
  */
 
+/** Flags controlling drcallstack's optional features. */
+typedef enum {
+    /**
+     * Maintain a per-thread shadow stack of return addresses by instrumenting every
+     * call and return, so that drcallstack_capture() can copy it rather than unwind.
+     * This adds inline code to each call and return.  Currently only available on
+     * x86 and AArch64.
+     */
+    DRCALLSTACK_SHADOW_STACK = 0x01,
+    /**
+     * Have drcallstack_capture() also unwind with libunwind and compare the results.
+     * This removes the speed benefit of the shadow stack and is meant for testing.
+     * Requires #DRCALLSTACK_SHADOW_STACK.
+     */
+    DRCALLSTACK_SHADOW_VALIDATE = 0x02,
+    /**
+     * Enable libunwind's cache of parsed unwind information, which is keyed by
+     * program counter, and flush entries for modules as they are unloaded.
+     */
+    DRCALLSTACK_CACHE_UNWIND_INFO = 0x04,
+} drcallstack_flags_t;
+
 /** Specifies the options when initializing drcallstack. */
 typedef struct _drcallstack_options_t {
     /** Set this to the size of this structure. */
     size_t struct_size;
-    /* We expect to add more options in the future. */
+    /**
+     * Optional features to enable.  Only the options passed to the first
+     * drcallstack_init() call take effect.
+     */
+    drcallstack_flags_t flags;
+    /**
+     * The maximum number of frames held by each thread's shadow stack under
+     * #DRCALLSTACK_SHADOW_STACK.  Calls nested deeper than this are not recorded.
+     * A value of 0 selects a default of 16384.
+     */
+    uint shadow_max_depth;
 } drcallstack_options_t;
 
 /** Describes one callstack frame. */
@@ -79,6 +129,14 @@ typedef struct _drcallstack_frame_t {
     reg_t sp;
 } drcallstack_frame_t;
 
+/** Describes one frame captured by drcallstack_capture(). */
+typedef struct _drcallstack_sample_frame_t {
+    /** The return address into the frame. */
+    app_pc pc;
+    /** The stack pointer of the frame at the point of its call. */
+    reg_t sp;
+} drcallstack_sample_frame_t;
+
 /** Opaque type. */
 struct _drcallstack_walk_t;
 /** Opaque type. */
@@ -139,6 +197,33 @@ DR_EXPORT
 drcallstack_status_t
 drcallstack_next_frame(drcallstack_walk_t *walk, DR_PARAM_OUT drcallstack_frame_t *frame);
 
+DR_EXPORT
+/**
+ * Captures the current thread's callstack at the context 'mc' into 'frames',
+ * innermost frame first, producing the same frames as a walk with
+ * drcallstack_next_frame().  On input, 'num_frames' holds the capacity of
+ * 'frames'; on output, the number of frames written.  Frames beyond the capacity
+ * are omitted from the outer end.
+ *
+ * Under #DRCALLSTACK_SHADOW_STACK this copies the thread's shadow stack and only
+ * requires #DR_MC_CONTROL in 'mc'.  Otherwise, or if the thread has no shadow
+ * stack, it walks with libunwind, requiring #DR_MC_CONTROL and #DR_MC_INTEGER.
+ * Under #DRCALLSTACK_SHADOW_VALIDATE both are produced and their program counters
+ * compared: on a difference the libunwind frames are returned along with
+ * #DRCALLSTACK_SHADOW_MISMATCH.
+ *
+ * Must be called by the thread whose callstack is captured.
+ *
+ * \note The shadow stack is only updated by calls and returns.  Frames abandoned
+ * by longjmp or exception unwinding are discarded lazily, and switching to
+ * another stack at a higher address, such as by returning from a signal handler
+ * on an alternate stack, can discard live frames.  Frames from calls made before
+ * drcallstack_init() are not present.
+ */
+drcallstack_status_t
+drcallstack_capture(dr_mcontext_t *mc, DR_PARAM_OUT drcallstack_sample_frame_t *frames,
+                    DR_PARAM_INOUT size_t *num_frames);
+
 /**@}*/ /* end doxygen group */
 
 #ifdef __cplusplus
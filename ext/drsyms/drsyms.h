@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2014 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * Copyright (c) 2009-2010 VMware, Inc.  All rights reserved.
  * **********************************************************/
 
@@ -239,6 +239,33 @@ drsym_error_t
 drsym_lookup_address(const char *modpath, size_t modoffs, drsym_info_t *info /*INOUT*/,
                      uint flags);
 
+DR_EXPORT
+/**
+ * Controls whether line information for drsym_lookup_address() on modules with
+ * DWARF debug information comes from a sorted per-module index.  The index is
+ * built from all of a module's line tables the first time line information is
+ * requested for it, after which each line lookup is a binary search rather than
+ * a search of a compilation unit's line program.  This is worthwhile when many
+ * addresses are looked up per module.  The index is off by default.
+ *
+ * If \p cache_dir is non-NULL, the index for each module with a build id is
+ * saved in that directory, which is created if it does not exist, under a name
+ * derived from the build id.  Later lookups, including from other processes,
+ * map the saved index instead of decoding the DWARF line tables again.
+ *
+ * The setting applies to modules whose line information has not yet been
+ * requested.  This routine is not thread-safe with respect to concurrent
+ * queries and should be called soon after drsym_init().
+ *
+ * @param[in] enable     Whether to use the line index.
+ * @param[in] cache_dir  Directory for saved indices, or NULL for none.
+ *   Ignored if \p enable is false.
+ *
+ * \note Has no effect on modules with PDB debug information.
+ */
+drsym_error_t
+drsym_enable_line_index(bool enable, const char *cache_dir);
+
 enum {
     DRSYM_TYPE_OTHER,    /**< Unknown type, cannot downcast. */
     DRSYM_TYPE_INT,      /**< Integer, cast to drsym_int_type_t. */
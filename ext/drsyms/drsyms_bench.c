@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2020 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -32,8 +32,9 @@
 
 /* DRSyms benchmarking standalone app. */
 
-/* This is a standalone app for benchmarking drsyms.  Currently we just time
- * symbol enumeration of an arbitrary object file.
+/* This is a standalone app for benchmarking drsyms.  We time symbol enumeration
+ * of an arbitrary object file, and then address lookups of its symbols from one
+ * thread and from several threads at once.
  */
 
 #include <stdio.h>
@@ -42,9 +43,28 @@
 
 #include "dr_api.h"
 #include "drsyms.h"
+/* UNIX comes from dr_api.h. */
+#ifdef UNIX
+#    include <pthread.h>
+#endif
 
 static char sym_buf[4096];
 
+#define DEFAULT_LOOKUP_THREADS 4
+#define DEFAULT_LOOKUPS_PER_THREAD 100000
+#define MAX_LOOKUP_ADDRS 100000
+
+/* Symbol addresses to look up, collected by enumeration. */
+static size_t lookup_addrs[MAX_LOOKUP_ADDRS];
+static uint num_lookup_addrs;
+
+typedef struct _lookup_thread_t {
+    const char *modpath;
+    uint first;
+    uint count;
+    uint found;
+} lookup_thread_t;
+
 static int
 usage(const char *msg)
 {
@@ -58,7 +78,8 @@ usage(const char *msg)
     if (msg != NULL && msg[0] != '\0') {
         dr_fprintf(STDERR, "%s\n", msg);
     }
-    dr_fprintf(STDERR, "usage: bench <modpath>\n");
+    dr_fprintf(STDERR,
+               "usage: bench <modpath> [<lookup_threads> [<lookups_per_thread>]]\n");
     return 1;
 }
 
@@ -103,10 +124,93 @@ enumerate_with_flags(const char *modpath, drsym_flags_t flags)
     dr_printf("Took %d.%03d seconds.\n", (int)(time / 1000), (int)(time % 1000));
 }
 
+static bool
+collect_callback(const char *name, size_t modoffs, void *data)
+{
+    if (modoffs != 0)
+        lookup_addrs[num_lookup_addrs++] = modoffs;
+    return num_lookup_addrs < MAX_LOOKUP_ADDRS;
+}
+
+#ifdef UNIX
+static void *
+#else
+static void
+#endif
+lookup_thread(void *arg)
+{
+    lookup_thread_t *thread = (lookup_thread_t *)arg;
+    char name[256];
+    char file[MAXIMUM_PATH];
+    uint i;
+    for (i = 0; i < thread->count; i++) {
+        drsym_info_t info;
+        drsym_error_t res;
+        info.struct_size = sizeof(info);
+        info.name = name;
+        info.name_size = sizeof(name);
+        info.file = file;
+        info.file_size = sizeof(file);
+        res = drsym_lookup_address(
+            thread->modpath, lookup_addrs[(thread->first + i) % num_lookup_addrs], &info,
+            DRSYM_DEFAULT_FLAGS);
+        if (res == DRSYM_SUCCESS || res == DRSYM_ERROR_LINE_NOT_AVAILABLE)
+            thread->found++;
+    }
+#ifdef UNIX
+    return NULL;
+#endif
+}
+
+/* Looks up the collected addresses from num_threads threads at once.  Each thread
+ * starts at a different address so they do not all query the same one.
+ */
+static void
+lookup_with_threads(const char *modpath, uint num_threads, uint lookups_per_thread)
+{
+    uint64 start, end, time;
+    uint i, found = 0;
+    lookup_thread_t *threads;
+
+#ifndef UNIX
+    /* XXX: The dbghelp-based lookups serialize on a single lock anyway. */
+    num_threads = 1;
+#endif
+    threads = (lookup_thread_t *)calloc(num_threads, sizeof(*threads));
+    for (i = 0; i < num_threads; i++) {
+        threads[i].modpath = modpath;
+        threads[i].first = (uint)(((uint64)num_lookup_addrs * i) / num_threads);
+        threads[i].count = lookups_per_thread;
+    }
+    dr_printf("Beginning address lookups on %u thread(s)\n", num_threads);
+    start = dr_get_milliseconds();
+#ifdef UNIX
+    pthread_t *pthreads = (pthread_t *)calloc(num_threads, sizeof(*pthreads));
+    for (i = 0; i < num_threads; i++)
+        pthread_create(&pthreads[i], NULL, lookup_thread, &threads[i]);
+    for (i = 0; i < num_threads; i++)
+        pthread_join(pthreads[i], NULL);
+    free(pthreads);
+#else
+    lookup_thread(&threads[0]);
+#endif
+    end = dr_get_milliseconds();
+    for (i = 0; i < num_threads; i++)
+        found += threads[i].found;
+    free(threads);
+
+    time = end - start;
+    dr_printf("Finished %u lookups (%u found).\n", num_threads * lookups_per_thread,
+              found);
+    dr_printf("Took %d.%03d seconds.\n", (int)(time / 1000), (int)(time % 1000));
+}
+
 int
 main(int argc, char **argv)
 {
     const char *modpath;
+    uint num_threads = DEFAULT_LOOKUP_THREADS;
+    uint lookups_per_thread = DEFAULT_LOOKUPS_PER_THREAD;
 #ifdef WINDOWS
     char full_path[2048];
 #endif
@@ -114,10 +218,16 @@ main(int argc, char **argv)
     dr_standalone_init();
     drsym_init(0);
 
-    if (argc != 2) {
+    if (argc < 2 || argc > 4) {
         return usage(NULL);
     }
     modpath = argv[1];
+    if (argc > 2)
+        num_threads = (uint)atoi(argv[2]);
+    if (argc > 3)
+        lookups_per_thread = (uint)atoi(argv[3]);
+    if (num_threads == 0 || lookups_per_thread == 0)
+        return usage("Thread and lookup counts must be positive.");
 #ifdef WINDOWS
     /* Work around i#289. */
     if (GetFullPathName(modpath, sizeof(full_path), full_path, NULL) == 0) {
@@ -135,6 +245,22 @@ main(int argc, char **argv)
     enumerate_with_flags(modpath, DRSYM_DEFAULT_FLAGS);
     enumerate_with_flags(modpath, DRSYM_DEFAULT_FLAGS);
 
+    /* Compare a single thread against several, with line information included. */
+    drsym_enumerate_symbols(modpath, collect_callback, NULL, DRSYM_LEAVE_MANGLED);
+    if (num_lookup_addrs > 0) {
+        lookup_with_threads(modpath, 1, lookups_per_thread);
+        if (num_threads > 1)
+            lookup_with_threads(modpath, num_threads, lookups_per_thread);
+        /* Repeat on one thread with the sorted line index.  Its one-time
+         * construction is included in the time.
+         */
+        drsym_free_resources(modpath);
+        if (drsym_enable_line_index(true, NULL) == DRSYM_SUCCESS) {
+            dr_printf("Using the line index\n");
+            lookup_with_threads(modpath, 1, lookups_per_thread);
+        }
+    }
+
     drsym_exit();
     dr_standalone_exit();
 }
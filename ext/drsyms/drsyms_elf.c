@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2024 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -47,6 +47,7 @@
 #    include "libdwarf.h"
 #endif
 
+#include <stdlib.h> /* qsort */
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -57,14 +58,6 @@
 #    define MIN(x, y) ((x) <= (y) ? (x) : (y))
 #endif
 
-#ifndef SIZE_T_MAX
-#    ifdef X64
-#        define SIZE_T_MAX ULLONG_MAX
-#    else
-#        define SIZE_T_MAX UINT_MAX
-#    endif
-#endif
-
 static int verbose = 0;
 
 #undef NOTIFY
@@ -128,16 +121,37 @@ static int verbose = 0;
 #    endif
 #endif
 
+/* A range of module offsets attributed to symbol idx. */
+typedef struct _sym_range_t {
+    size_t start;
+    size_t end;
+    uint idx;
+} sym_range_t;
+
 typedef struct _elf_info_t {
     Elf *elf;
     Elf_Sym *syms;
     int strtab_idx;
     int num_syms;
+    /* The raw string table, so names can be read without libelf's state. */
+    const char *strtab;
+    size_t strtab_size;
     byte *map_base;
     ptr_uint_t load_base;
     drsym_debug_kind_t debug_kind;
 #define MAX_BUILD_ID_LENGTH 128
     char build_id[MAX_BUILD_ID_LENGTH];
+    /* Address index for drsym_obj_addrsearch_symtab(), built at load time and
+     * read-only afterward so that lookups can proceed in parallel.
+     * ranges holds sorted, disjoint ranges each attributed to the lowest-index
+     * symbol containing it.  starts holds, sorted, each distinct symbol start with
+     * the lowest-index symbol there, for the closest-symbol fallback for
+     * st_size==0 symbols (i#1337).  The end field of starts is unused.
+     */
+    sym_range_t *ranges;
+    uint num_ranges;
+    sym_range_t *starts;
+    uint num_starts;
 } elf_info_t;
 
 /* Looks for a section with real data, not just a section with a header */
@@ -258,6 +272,180 @@ find_load_base(Elf *elf)
     return load_base;
 }
 
+/******************************************************************************
+ * Address index.
+ */
+
+static int
+compare_sym_ranges(const void *a_in, const void *b_in)
+{
+    const sym_range_t *a = (const sym_range_t *)a_in;
+    const sym_range_t *b = (const sym_range_t *)b_in;
+    if (a->start != b->start)
+        return a->start < b->start ? -1 : 1;
+    if (a->idx != b->idx)
+        return a->idx < b->idx ? -1 : 1;
+    return 0;
+}
+
+static int
+compare_offsets(const void *a_in, const void *b_in)
+{
+    size_t a = *(const size_t *)a_in;
+    size_t b = *(const size_t *)b_in;
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/* A min-heap of symbol indices, for finding the lowest-index symbol among those
+ * covering an offset.
+ */
+static void
+sym_heap_push(uint *heap, uint *count, uint idx)
+{
+    uint i = (*count)++;
+    while (i > 0 && heap[(i - 1) / 2] > idx) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = idx;
+}
+
+static void
+sym_heap_pop(uint *heap, uint *count)
+{
+    uint last = heap[--(*count)];
+    uint i = 0;
+    while (true) {
+        uint child = 2 * i + 1;
+        if (child >= *count)
+            break;
+        if (child + 1 < *count && heap[child + 1] < heap[child])
+            child++;
+        if (last <= heap[child])
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (*count > 0)
+        heap[i] = last;
+}
+
+static void
+free_addr_index(elf_info_t *mod)
+{
+    if (mod->ranges != NULL)
+        dr_global_free(mod->ranges, mod->num_ranges * sizeof(*mod->ranges));
+    if (mod->starts != NULL)
+        dr_global_free(mod->starts, mod->num_starts * sizeof(*mod->starts));
+    mod->ranges = NULL;
+    mod->num_ranges = 0;
+    mod->starts = NULL;
+    mod->num_starts = 0;
+}
+
+/* Builds mod->ranges and mod->starts so that drsym_obj_addrsearch_symtab() returns
+ * exactly what a linear walk of the symbol table would, using binary searches.
+ * The offsets depend on mod->load_base, so this must be re-run if it changes.
+ */
+static void
+build_addr_index(elf_info_t *mod)
+{
+    uint n = (uint)mod->num_syms;
+    uint i, num_ivals = 0, num_bounds = 0, num_unique, heap_count = 0, next_ival = 0;
+    uint count;
+    sym_range_t *ivals, *ranges;
+    size_t *bounds;
+    uint *heap;
+
+    free_addr_index(mod);
+    if (mod->syms == NULL || n == 0)
+        return;
+
+    /* The closest-symbol fallback considers every symbol, including imports. */
+    ivals = dr_global_alloc(n * sizeof(*ivals));
+    for (i = 0; i < n; i++) {
+        ivals[i].start = mod->syms[i].st_value - mod->load_base;
+        ivals[i].end = ivals[i].start + mod->syms[i].st_size;
+        ivals[i].idx = i;
+    }
+    qsort(ivals, n, sizeof(*ivals), compare_sym_ranges);
+    for (i = 0, count = 0; i < n; i++) {
+        if (i == 0 || ivals[i].start != ivals[i - 1].start)
+            count++;
+    }
+    mod->starts = dr_global_alloc(count * sizeof(*mod->starts));
+    mod->num_starts = count;
+    for (i = 0, count = 0; i < n; i++) {
+        if (i == 0 || ivals[i].start != ivals[i - 1].start)
+            mod->starts[count++] = ivals[i];
+    }
+
+    /* Drop the empty (and wrapped-around) ranges, which can never contain an
+     * offset, keeping the (start, idx) order.
+     */
+    for (i = 0; i < n; i++) {
+        if (ivals[i].start < ivals[i].end)
+            ivals[num_ivals++] = ivals[i];
+    }
+    if (num_ivals == 0) {
+        dr_global_free(ivals, n * sizeof(*ivals));
+        return;
+    }
+
+    /* Sweep over every range boundary, maintaining the covering symbols in a
+     * heap whose top is the answer.  Covering symbols that have ended are only
+     * removed once they reach the top.
+     */
+    bounds = dr_global_alloc(2 * num_ivals * sizeof(*bounds));
+    for (i = 0; i < num_ivals; i++) {
+        bounds[num_bounds++] = ivals[i].start;
+        bounds[num_bounds++] = ivals[i].end;
+    }
+    qsort(bounds, num_bounds, sizeof(*bounds), compare_offsets);
+    for (i = 1, count = 1; i < num_bounds; i++) {
+        if (bounds[i] != bounds[count - 1])
+            bounds[count++] = bounds[i];
+    }
+    num_unique = count;
+    heap = dr_global_alloc(num_ivals * sizeof(*heap));
+    ranges = dr_global_alloc(num_unique * sizeof(*ranges));
+    count = 0;
+    /* Nothing covers the last boundary, which is the largest end. */
+    for (i = 0; i + 1 < num_unique; i++) {
+        size_t pos = bounds[i];
+        while (next_ival < num_ivals && ivals[next_ival].start == pos)
+            sym_heap_push(heap, &heap_count, ivals[next_ival++].idx);
+        while (heap_count > 0 &&
+               mod->syms[heap[0]].st_value - mod->load_base +
+                       mod->syms[heap[0]].st_size <=
+                   pos)
+            sym_heap_pop(heap, &heap_count);
+        if (heap_count == 0)
+            continue;
+        if (count > 0 && ranges[count - 1].idx == heap[0] &&
+            ranges[count - 1].end == pos) {
+            ranges[count - 1].end = bounds[i + 1];
+        } else {
+            ranges[count].start = pos;
+            ranges[count].end = bounds[i + 1];
+            ranges[count].idx = heap[0];
+            count++;
+        }
+    }
+    if (count > 0) {
+        mod->ranges = dr_global_alloc(count * sizeof(*mod->ranges));
+        mod->num_ranges = count;
+        memcpy(mod->ranges, ranges, count * sizeof(*mod->ranges));
+    }
+
+    dr_global_free(ranges, num_unique * sizeof(*ranges));
+    dr_global_free(heap, num_ivals * sizeof(*heap));
+    dr_global_free(bounds, 2 * num_ivals * sizeof(*bounds));
+    dr_global_free(ivals, n * sizeof(*ivals));
+    NOTIFY(1, "%s: %d symbols => %u ranges, %u starts\n", __FUNCTION__, mod->num_syms,
+           mod->num_ranges, mod->num_starts);
+}
+
 /******************************************************************************
  * ELF interface to drsyms_unix.c
  */
@@ -311,6 +499,12 @@ drsym_obj_mod_init_pre(byte *map_base, size_t map_size)
              * probably loaded in the current process.
              */
             mod->syms = (Elf_Sym *)(((char *)mod->map_base) + symtab_shdr->sh_offset);
+            Elf_Shdr *strtab_shdr = elf_getshdr(strtab_scn);
+            if (strtab_shdr != NULL && strtab_shdr->sh_offset < map_size &&
+                strtab_shdr->sh_size <= map_size - strtab_shdr->sh_offset) {
+                mod->strtab = ((char *)mod->map_base) + strtab_shdr->sh_offset;
+                mod->strtab_size = strtab_shdr->sh_size;
+            }
         }
     }
 
@@ -320,6 +514,11 @@ drsym_obj_mod_init_pre(byte *map_base, size_t map_size)
 
     read_build_id(mod->elf, mod);
 
+    /* The load base is still 0 here.  Modules which stay partially initialized
+     * (such as one whose DWARF is in a debuglink file) keep that value.
+     */
+    build_addr_index(mod);
+
     return (void *)mod;
 }
 
@@ -329,6 +528,8 @@ drsym_obj_mod_init_post(void *mod_in, byte *map_base, void *dwarf_info)
     elf_info_t *mod = (elf_info_t *)mod_in;
     mod->map_base = map_base; /* shouldn't change, though */
     mod->load_base = find_load_base(mod->elf);
+    if (mod->load_base != 0)
+        build_addr_index(mod);
     return true;
 }
 
@@ -359,6 +560,7 @@ drsym_obj_mod_exit(void *mod_in)
     elf_info_t *mod = (elf_info_t *)mod_in;
     if (mod == NULL)
         return;
+    free_addr_index(mod);
     if (mod->elf != NULL)
         elf_end(mod->elf);
     dr_global_free(mod, sizeof(*mod));
@@ -415,6 +617,14 @@ drsym_obj_symbol_name(void *mod_in, uint idx)
     elf_info_t *mod = (elf_info_t *)mod_in;
     if (mod == NULL || idx >= mod->num_syms || mod->syms == NULL)
         return NULL;
+    if (mod->strtab != NULL) {
+        /* Avoid libelf so that concurrent lookups are safe. */
+        size_t offs = mod->syms[idx].st_name;
+        if (offs >= mod->strtab_size ||
+            memchr(mod->strtab + offs, '\0', mod->strtab_size - offs) == NULL)
+            return NULL;
+        return mod->strtab + offs;
+    }
     return elf_strptr(mod->elf, mod->strtab_idx, mod->syms[idx].st_name);
 }
 
@@ -449,13 +659,28 @@ drsym_obj_symbol_offs(void *mod_in, uint idx, size_t *offs_start DR_PARAM_OUT,
     return DRSYM_SUCCESS;
 }
 
+/* Returns the index of the last element of the sorted array with start <= offs,
+ * or -1 if there is none.
+ */
+static int
+find_last_start_at_or_below(const sym_range_t *array, uint count, size_t offs)
+{
+    uint lo = 0, hi = count;
+    while (lo < hi) {
+        uint mid = lo + (hi - lo) / 2;
+        if (array[mid].start <= offs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (int)lo - 1;
+}
+
 drsym_error_t
 drsym_obj_addrsearch_symtab(void *mod_in, size_t modoffs, uint *idx DR_PARAM_OUT)
 {
     elf_info_t *mod = (elf_info_t *)mod_in;
     int i;
-    int closest_idx = -1;
-    size_t closest_diff = SIZE_T_MAX;
 
     if (mod == NULL || mod->syms == NULL || idx == NULL)
         return DRSYM_ERROR;
@@ -464,33 +689,26 @@ drsym_obj_addrsearch_symtab(void *mod_in, size_t modoffs, uint *idx DR_PARAM_OUT
     /* XXX: if a function is split into non-contiguous pieces, will it
      * have multiple entries?
      */
-    for (i = 0; i < mod->num_syms; i++) {
-        size_t lo_offs = mod->syms[i].st_value - mod->load_base;
-        size_t hi_offs = lo_offs + mod->syms[i].st_size;
-        NOTIFY(3, "\tcomparing +" PIFX " to " PIFX "-" PIFX "\n", modoffs, lo_offs,
-               hi_offs);
-        if (lo_offs <= modoffs && modoffs < hi_offs) {
-            NOTIFY(2, "\tfound +" PIFX " in " PIFX "-" PIFX "\n", modoffs, lo_offs,
-                   hi_offs);
-            *idx = i;
-            return DRSYM_SUCCESS;
-        }
-        /* i#1337: handle st_size==0 asm routines */
-        if (modoffs >= lo_offs) {
-            if (modoffs - lo_offs < closest_diff) {
-                closest_idx = i;
-                closest_diff = modoffs - lo_offs;
-                NOTIFY(3, "\tclosest diff is now " PIFX "\n", closest_diff);
-            }
-        }
+    /* If several symbols contain modoffs, the index has the first one. */
+    i = find_last_start_at_or_below(mod->ranges, mod->num_ranges, modoffs);
+    if (i >= 0 && modoffs < mod->ranges[i].end) {
+        NOTIFY(2, "\tfound +" PIFX " in " PIFX "-" PIFX "\n", modoffs,
+               mod->ranges[i].start, mod->ranges[i].end);
+        *idx = mod->ranges[i].idx;
+        return DRSYM_SUCCESS;
     }
 
-    if (closest_idx >= 0 && mod->syms[closest_idx].st_size == 0) {
+    /* i#1337: handle st_size==0 asm routines by taking the closest preceding
+     * symbol, the first one if several start there.
+     */
+    i = find_last_start_at_or_below(mod->starts, mod->num_starts, modoffs);
+    if (i >= 0 && mod->syms[mod->starts[i].idx].st_size == 0) {
         /* i#1337: rule out anything without a name */
-        const char *name = drsym_obj_symbol_name(mod_in, closest_idx);
-        NOTIFY(2, "\tusing closest +" PIFX " diff " PIFX "\n", modoffs, closest_diff);
+        const char *name = drsym_obj_symbol_name(mod_in, mod->starts[i].idx);
+        NOTIFY(2, "\tusing closest +" PIFX " diff " PIFX "\n", modoffs,
+               modoffs - mod->starts[i].start);
         if (name != NULL && name[0] != '\0') {
-            *idx = closest_idx;
+            *idx = mod->starts[i].idx;
             return DRSYM_SUCCESS;
         }
     }
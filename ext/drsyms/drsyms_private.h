@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2016 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -82,7 +82,8 @@ pool_alloc(mempool_t *pool, size_t sz);
 
 /***************************************************************************
  * Cygwin interface from Unix to Windows
- * For all of these, the caller is responsible for synchronization
+ * For all of these, the caller is responsible for synchronization, except that
+ * drsym_unix_lookup_address() may be called concurrently for the same module.
  */
 
 void
@@ -91,6 +92,9 @@ drsym_unix_init(void);
 void
 drsym_unix_exit(void);
 
+drsym_error_t
+drsym_unix_enable_line_index(bool enable, const char *cache_dir);
+
 void *
 drsym_unix_load(const char *modpath);
 
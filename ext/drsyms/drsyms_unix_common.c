@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2024 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -42,7 +42,9 @@
 
 #include <string.h> /* strlen */
 #include <errno.h>
+#include <limits.h> /* UINT_MAX */
 #include <stddef.h> /* offsetof */
+#include <stdlib.h> /* qsort */
 
 #include "demangle.h"
 #ifdef DRSYM_HAVE_LIBELFTC
@@ -58,6 +60,50 @@
 /* For debugging */
 static bool verbose = false;
 
+/* Options for the sorted line index: see drsym_enable_line_index(). */
+static bool line_index_enabled;
+static char line_index_dir[MAXIMUM_PATH];
+
+/* A line index is a single image holding a header, an array of entries sorted
+ * by address, a table of file name offsets, and the file name strings.  The
+ * same layout is used in memory and in the cache file, so a cached index is
+ * used directly from its file mapping.
+ */
+#define LINE_INDEX_MAGIC 0x4e494c44 /* "DLIN" */
+#define LINE_INDEX_VERSION 1
+#define LINE_INDEX_SUFFIX ".drsymlines"
+
+typedef struct _line_index_header_t {
+    uint magic;
+    uint version;
+    uint num_entries;
+    uint num_files;
+    uint strings_size;
+    uint unused; /* Keeps the entries 8-byte aligned. */
+} line_index_header_t;
+
+typedef struct _line_index_entry_t {
+    /* Offset in the same terms as drsym_line_info_t.line_addr. */
+    uint64 addr;
+    uint line;
+    uint file; /* Index into the file table. */
+} line_index_entry_t;
+
+typedef struct _line_index_t {
+    byte *image;
+    size_t image_size;
+    /* If fd is not INVALID_FILE, image is a mapping of size map_size of the
+     * cache file rather than a heap allocation.
+     */
+    file_t fd;
+    size_t map_size;
+    const line_index_entry_t *entries;
+    uint num_entries;
+    const uint *file_offs;
+    uint num_files;
+    const char *strings;
+} line_index_t;
+
 typedef struct _dbg_module_t {
     file_t fd;
     size_t file_size;
@@ -73,6 +119,16 @@ typedef struct _dbg_module_t {
     struct _dbg_module_t *mod_with_dwarf;
 #define SYMTABLE_HASH_BITS 12
     hashtable_t symtable;
+    /* Guards the libdwarf state and our cached line table, which line lookups
+     * modify, so that address lookups on a module may run concurrently.
+     */
+    void *dwarf_lock;
+    /* Set up under dwarf_lock on the first line lookup when the line index is
+     * enabled.  Once line_index_ready is set, line_index is immutable and is
+     * read without the lock; it is NULL if no index could be produced.
+     */
+    line_index_t *line_index;
+    volatile int line_index_ready;
 } dbg_module_t;
 
 /******************************************************************************
@@ -86,6 +142,8 @@ follow_debuglink(const char *modpath, dbg_module_t *mod, const char *debuglink,
                  char debug_modpath[MAXIMUM_PATH]);
 static void
 drsym_free_hash_key(void *key);
+static void
+line_index_free(line_index_t *idx);
 
 /******************************************************************************
  * Module loading and unloading.
@@ -100,7 +158,7 @@ load_module(const char *modpath)
     uint64 file_size;
 
     /* static depth count to prevent stack overflow from circular .gnu_debuglink
-     * sections.  We're protected by symbol_lock.
+     * sections.  The caller serializes loads.
      */
     static int load_module_depth;
 
@@ -115,6 +173,7 @@ load_module(const char *modpath)
     /* Alloc and zero the struct so it can be unloaded safely in case of error. */
     mod = dr_global_alloc(sizeof(*mod));
     memset(mod, 0, sizeof(*mod));
+    mod->dwarf_lock = dr_mutex_create();
 
     mod->fd = dr_open_file(modpath, DR_FILE_READ);
     if (mod->fd == INVALID_FILE) {
@@ -317,6 +376,8 @@ follow_debuglink(const char *modpath, dbg_module_t *mod, const char *debuglink,
 static void
 unload_module(dbg_module_t *mod)
 {
+    if (mod->line_index != NULL)
+        line_index_free(mod->line_index);
     if (mod->dwarf_info != NULL)
         drsym_dwarf_exit(mod->dwarf_info);
     if (mod->obj_info != NULL)
@@ -329,6 +390,8 @@ unload_module(dbg_module_t *mod)
         dr_close_file(mod->fd);
     if (mod->mod_with_dwarf != NULL)
         unload_module(mod->mod_with_dwarf);
+    if (mod->dwarf_lock != NULL)
+        dr_mutex_destroy(mod->dwarf_lock);
     dr_global_free(mod, sizeof(*mod));
 }
 
@@ -573,6 +636,358 @@ drsym_fill_symtable_cb(const char *sym, size_t modoffs, void *data DR_PARAM_OUT)
     return true;
 }
 
+/******************************************************************************
+ * Sorted line index.
+ *
+ * Searching the DWARF line tables decodes a compilation unit's line program on
+ * each miss in the single-CU cache kept by the DWARF backends, and locating
+ * the CU can require walking every CU.  When enabled, we instead flatten all of
+ * a module's lines into one array sorted by address the first time line
+ * information is requested, and answer lookups with a binary search.  If a
+ * cache directory is set, the index is saved there under the module's build
+ * id and later processes map it rather than decoding the DWARF again.
+ */
+
+typedef struct _line_build_entry_t {
+    line_index_entry_t entry;
+    uint seq; /* Enumeration order, for a stable sort. */
+} line_build_entry_t;
+
+typedef struct _line_builder_t {
+    line_build_entry_t *entries;
+    size_t num_entries;
+    size_t entries_capacity;
+    /* File name to file index + 1. */
+    hashtable_t files;
+    uint *file_offs;
+    uint num_files;
+    uint files_capacity;
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+    bool failed;
+} line_builder_t;
+
+static bool
+line_builder_add_cb(drsym_line_info_t *info, void *data)
+{
+    line_builder_t *b = (line_builder_t *)data;
+    line_build_entry_t *e;
+    uint file;
+    /* Compilation units without line information carry no file. */
+    if (info->file == NULL)
+        return true;
+    file = (uint)(ptr_uint_t)hashtable_lookup(&b->files, (void *)info->file);
+    if (file == 0) {
+        size_t len = strlen(info->file) + 1;
+        if (b->num_files == UINT_MAX - 1 || b->strings_size + len > UINT_MAX) {
+            b->failed = true;
+            return false;
+        }
+        if (b->num_files == b->files_capacity) {
+            b->files_capacity = b->files_capacity == 0 ? 64 : b->files_capacity * 2;
+            b->file_offs = (uint *)__wrap_realloc(
+                b->file_offs, b->files_capacity * sizeof(*b->file_offs));
+        }
+        while (b->strings_size + len > b->strings_capacity) {
+            b->strings_capacity =
+                b->strings_capacity == 0 ? 4096 : b->strings_capacity * 2;
+            b->strings = (char *)__wrap_realloc(b->strings, b->strings_capacity);
+        }
+        memcpy(b->strings + b->strings_size, info->file, len);
+        b->file_offs[b->num_files] = (uint)b->strings_size;
+        b->strings_size += len;
+        file = ++b->num_files;
+        hashtable_add(&b->files, (void *)info->file, (void *)(ptr_uint_t)file);
+    }
+    if (b->num_entries == UINT_MAX) {
+        b->failed = true;
+        return false;
+    }
+    if (b->num_entries == b->entries_capacity) {
+        b->entries_capacity = b->entries_capacity == 0 ? 1024 : b->entries_capacity * 2;
+        b->entries = (line_build_entry_t *)__wrap_realloc(
+            b->entries, b->entries_capacity * sizeof(*b->entries));
+    }
+    e = &b->entries[b->num_entries];
+    e->entry.addr = info->line_addr;
+    e->entry.line = (uint)info->line;
+    e->entry.file = file - 1;
+    e->seq = (uint)b->num_entries;
+    b->num_entries++;
+    return true;
+}
+
+static int
+line_builder_compare(const void *a_in, const void *b_in)
+{
+    const line_build_entry_t *a = (const line_build_entry_t *)a_in;
+    const line_build_entry_t *b = (const line_build_entry_t *)b_in;
+    if (a->entry.addr != b->entry.addr)
+        return a->entry.addr < b->entry.addr ? -1 : 1;
+    return a->seq < b->seq ? -1 : (a->seq > b->seq ? 1 : 0);
+}
+
+/* Points idx's fields into its image, which is image_size bytes long.
+ * Returns false if the image is not a well-formed index.
+ */
+static bool
+line_index_attach(line_index_t *idx)
+{
+    const line_index_header_t *hdr = (const line_index_header_t *)idx->image;
+    uint64 needed;
+    uint i;
+    if (idx->image_size < sizeof(*hdr) || hdr->magic != LINE_INDEX_MAGIC ||
+        hdr->version != LINE_INDEX_VERSION)
+        return false;
+    needed = sizeof(*hdr) + (uint64)hdr->num_entries * sizeof(line_index_entry_t) +
+        (uint64)hdr->num_files * sizeof(uint) + hdr->strings_size;
+    if (needed != idx->image_size)
+        return false;
+    idx->num_entries = hdr->num_entries;
+    idx->entries = (const line_index_entry_t *)(idx->image + sizeof(*hdr));
+    idx->num_files = hdr->num_files;
+    idx->file_offs = (const uint *)(idx->entries + idx->num_entries);
+    idx->strings = (const char *)(idx->file_offs + idx->num_files);
+    /* Entries' file indices are checked on lookup so we need not touch every
+     * page of a large mapping here.
+     */
+    if (hdr->strings_size > 0 && idx->strings[hdr->strings_size - 1] != '\0')
+        return false;
+    for (i = 0; i < idx->num_files; i++) {
+        if (idx->file_offs[i] >= hdr->strings_size)
+            return false;
+    }
+    return true;
+}
+
+static void
+line_index_free(line_index_t *idx)
+{
+    if (idx->fd != INVALID_FILE) {
+        if (idx->image != NULL)
+            dr_unmap_file(idx->image, idx->map_size);
+        dr_close_file(idx->fd);
+    } else if (idx->image != NULL)
+        dr_global_free(idx->image, idx->image_size);
+    dr_global_free(idx, sizeof(*idx));
+}
+
+static line_index_t *
+line_index_build(dbg_module_t *mod)
+{
+    line_builder_t b;
+    line_index_t *idx = NULL;
+    line_index_header_t *hdr;
+    line_index_entry_t *out;
+    size_t i, num_out;
+    drsym_error_t res;
+
+    memset(&b, 0, sizeof(b));
+    hashtable_init(&b.files, 8, HASH_STRING, true /*strdup*/);
+    res = drsym_dwarf_enumerate_lines(mod->dwarf_info, line_builder_add_cb, &b);
+    if (res != DRSYM_SUCCESS || b.failed) {
+        NOTIFY("%s: failed to enumerate lines\n", __FUNCTION__);
+        goto done;
+    }
+    qsort(b.entries, b.num_entries, sizeof(*b.entries), line_builder_compare);
+    /* When several lines start at the same address, a search of the DWARF
+     * line table lands on the last of them, so that is the one we keep.
+     */
+    num_out = 0;
+    for (i = 0; i < b.num_entries; i++) {
+        if (i + 1 < b.num_entries &&
+            b.entries[i + 1].entry.addr == b.entries[i].entry.addr)
+            continue;
+        b.entries[num_out++].entry = b.entries[i].entry;
+    }
+
+    idx = (line_index_t *)dr_global_alloc(sizeof(*idx));
+    memset(idx, 0, sizeof(*idx));
+    idx->fd = INVALID_FILE;
+    idx->image_size = sizeof(*hdr) + num_out * sizeof(*out) +
+        b.num_files * sizeof(*b.file_offs) + b.strings_size;
+    idx->image = (byte *)dr_global_alloc(idx->image_size);
+    hdr = (line_index_header_t *)idx->image;
+    hdr->magic = LINE_INDEX_MAGIC;
+    hdr->version = LINE_INDEX_VERSION;
+    hdr->num_entries = (uint)num_out;
+    hdr->num_files = b.num_files;
+    hdr->strings_size = (uint)b.strings_size;
+    hdr->unused = 0;
+    out = (line_index_entry_t *)(hdr + 1);
+    for (i = 0; i < num_out; i++)
+        out[i] = b.entries[i].entry;
+    if (b.num_files > 0) {
+        memcpy(out + num_out, b.file_offs, b.num_files * sizeof(*b.file_offs));
+        memcpy((byte *)(out + num_out) + b.num_files * sizeof(*b.file_offs),
+               b.strings, b.strings_size);
+    }
+    if (!line_index_attach(idx)) {
+        DR_ASSERT_MSG(false, "freshly built line index is malformed");
+        line_index_free(idx);
+        idx = NULL;
+    }
+    NOTIFY("%s: indexed %zu lines in %u files\n", __FUNCTION__, num_out, b.num_files);
+
+done:
+    hashtable_delete(&b.files);
+    if (b.entries != NULL)
+        __wrap_free(b.entries);
+    if (b.file_offs != NULL)
+        __wrap_free(b.file_offs);
+    if (b.strings != NULL)
+        __wrap_free(b.strings);
+    return idx;
+}
+
+static line_index_t *
+line_index_load(const char *path)
+{
+    line_index_t *idx;
+    uint64 file_size;
+    file_t fd = dr_open_file(path, DR_FILE_READ);
+    if (fd == INVALID_FILE)
+        return NULL;
+    idx = (line_index_t *)dr_global_alloc(sizeof(*idx));
+    memset(idx, 0, sizeof(*idx));
+    idx->fd = fd;
+    if (!dr_file_size(fd, &file_size) || file_size == 0 ||
+        file_size != (size_t)file_size)
+        goto error;
+    idx->image_size = (size_t)file_size;
+    idx->map_size = idx->image_size;
+    idx->image =
+        (byte *)dr_map_file(fd, &idx->map_size, 0, NULL, DR_MEMPROT_READ, DR_MAP_PRIVATE);
+    if (idx->image == NULL || idx->map_size < idx->image_size) {
+        if (idx->image != NULL) {
+            dr_unmap_file(idx->image, idx->map_size);
+            idx->image = NULL;
+        }
+        goto error;
+    }
+    if (!line_index_attach(idx)) {
+        NOTIFY("%s: ignoring malformed line index %s\n", __FUNCTION__, path);
+        goto error;
+    }
+    NOTIFY("%s: mapped line index %s\n", __FUNCTION__, path);
+    return idx;
+
+error:
+    line_index_free(idx);
+    return NULL;
+}
+
+/* Writes to a private temporary file and renames it into place so that
+ * concurrent processes never map a partially written index.
+ */
+static void
+line_index_save(line_index_t *idx, const char *path)
+{
+    char tmp_path[MAXIMUM_PATH];
+    file_t fd;
+    bool ok;
+    if (!dr_directory_exists(line_index_dir) && !dr_create_dir(line_index_dir) &&
+        !dr_directory_exists(line_index_dir)) {
+        NOTIFY("%s: unable to create %s\n", __FUNCTION__, line_index_dir);
+        return;
+    }
+    dr_snprintf(tmp_path, BUFFER_SIZE_ELEMENTS(tmp_path), "%s.%d.tmp", path,
+                (int)dr_get_process_id());
+    NULL_TERMINATE_BUFFER(tmp_path);
+    fd = dr_open_file(tmp_path, DR_FILE_WRITE_REQUIRE_NEW);
+    if (fd == INVALID_FILE) {
+        NOTIFY("%s: unable to create %s\n", __FUNCTION__, tmp_path);
+        return;
+    }
+    ok = dr_write_file(fd, idx->image, idx->image_size) == (ssize_t)idx->image_size;
+    dr_close_file(fd);
+    if (!ok || !dr_rename_file(tmp_path, path, true /*replace*/)) {
+        NOTIFY("%s: unable to write %s\n", __FUNCTION__, path);
+        dr_delete_file(tmp_path);
+    }
+}
+
+static line_index_t *
+line_index_create(dbg_module_t *mod)
+{
+    line_index_t *idx;
+    char path[MAXIMUM_PATH];
+    const char *build_id = drsym_obj_build_id(mod->obj_info);
+    bool use_cache = line_index_dir[0] != '\0' && build_id != NULL && build_id[0] != '\0';
+    if (use_cache) {
+        dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s/%s" LINE_INDEX_SUFFIX,
+                    line_index_dir, build_id);
+        NULL_TERMINATE_BUFFER(path);
+        idx = line_index_load(path);
+        if (idx != NULL)
+            return idx;
+    }
+    idx = line_index_build(mod);
+    if (idx != NULL && use_cache)
+        line_index_save(idx, path);
+    return idx;
+}
+
+/* Returns mod's line index, creating it on first use, or NULL if the index is
+ * disabled or could not be produced.  mod must have DWARF info.
+ */
+static line_index_t *
+line_index_get(dbg_module_t *mod)
+{
+    if (!line_index_enabled)
+        return NULL;
+    if (dr_atomic_load32(&mod->line_index_ready) == 0) {
+        dr_mutex_lock(mod->dwarf_lock);
+        if (mod->line_index_ready == 0) {
+            mod->line_index = line_index_create(mod);
+            dr_atomic_store32(&mod->line_index_ready, 1);
+        }
+        dr_mutex_unlock(mod->dwarf_lock);
+    }
+    return mod->line_index;
+}
+
+/* Fills in the line fields of info with the same results as
+ * drsym_dwarf_search_addr2line(), for addr in drsym_line_info_t.line_addr terms.
+ */
+static bool
+line_index_lookup(line_index_t *idx, uint64 addr, drsym_info_t *info DR_PARAM_OUT)
+{
+    const line_index_entry_t *e;
+    const char *file;
+    uint lo = 0, hi = idx->num_entries;
+
+    info->file_available_size = 0;
+    if (info->file != NULL)
+        info->file[0] = '\0';
+    info->line = 0;
+    info->line_offs = 0;
+
+    /* Find the last entry at or below addr. */
+    while (lo < hi) {
+        uint mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return false;
+    e = &idx->entries[lo - 1];
+    if (e->file >= idx->num_files)
+        return false;
+    file = idx->strings + idx->file_offs[e->file];
+    info->file_available_size = strlen(file);
+    if (info->file != NULL) {
+        strncpy(info->file, file, info->file_size);
+        info->file[info->file_size - 1] = '\0';
+    }
+    info->line = e->line;
+    info->line_offs = (size_t)(addr - e->addr);
+    return true;
+}
+
 /******************************************************************************
  * Exports
  */
@@ -589,6 +1004,20 @@ drsym_unix_exit(void)
     /* nothing */
 }
 
+drsym_error_t
+drsym_unix_enable_line_index(bool enable, const char *cache_dir)
+{
+    if (cache_dir != NULL && strlen(cache_dir) >= BUFFER_SIZE_ELEMENTS(line_index_dir))
+        return DRSYM_ERROR_INVALID_PARAMETER;
+    line_index_enabled = enable;
+    if (enable && cache_dir != NULL)
+        strncpy(line_index_dir, cache_dir, BUFFER_SIZE_ELEMENTS(line_index_dir));
+    else
+        line_index_dir[0] = '\0';
+    NULL_TERMINATE_BUFFER(line_index_dir);
+    return DRSYM_SUCCESS;
+}
+
 void *
 drsym_unix_load(const char *modpath)
 {
@@ -677,15 +1106,32 @@ drsym_unix_lookup_address(void *mod_in, size_t modoffs, drsym_info_t *out DR_PAR
          * least have the name of the function.
          */
         dbg_module_t *mod4line = mod;
+        bool found_line = false;
         if (mod->mod_with_dwarf != NULL)
             mod4line = mod->mod_with_dwarf;
-        if (mod4line->dwarf_info == NULL ||
-            !drsym_dwarf_search_addr2line(
-                mod4line->dwarf_info,
-                (Dwarf_Addr)(ptr_uint_t)(drsym_obj_load_base(mod->obj_info) + modoffs),
-                out)) {
-            r = DRSYM_ERROR_LINE_NOT_AVAILABLE;
+        if (mod4line->dwarf_info != NULL) {
+            line_index_t *index = line_index_get(mod4line);
+            if (index != NULL) {
+                /* Index addresses are relative to the load base of the file
+                 * holding the DWARF, which the DWARF search subtracts implicitly.
+                 */
+                found_line = line_index_lookup(
+                    index,
+                    (uint64)(ptr_uint_t)(drsym_obj_load_base(mod->obj_info) + modoffs) -
+                        (uint64)(ptr_uint_t)drsym_obj_load_base(mod4line->obj_info),
+                    out);
+            } else {
+                dr_mutex_lock(mod4line->dwarf_lock);
+                found_line = drsym_dwarf_search_addr2line(
+                    mod4line->dwarf_info,
+                    (Dwarf_Addr)(ptr_uint_t)(drsym_obj_load_base(mod->obj_info) +
+                                             modoffs),
+                    out);
+                dr_mutex_unlock(mod4line->dwarf_lock);
+            }
         }
+        if (!found_line)
+            r = DRSYM_ERROR_LINE_NOT_AVAILABLE;
     }
 
     out->debug_kind = mod->debug_kind;
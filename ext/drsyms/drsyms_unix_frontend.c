@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2014 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -47,18 +47,27 @@
 #include "drsyms_private.h"
 #include "hashtable.h"
 
-/* Guards our internal state and libdwarf's modifications of mod->dbg.
- * We use a recursive lock to allow queries to be called from enumerate callbacks.
+/* Guards modtable and the set of loaded modules.  Queries hold it for read while
+ * they use a module, so queries on any modules proceed in parallel.  Loading and
+ * freeing a module hold it for write, as do enumerations, which serialize with
+ * everything else as their callbacks may issue nested queries: a thread that
+ * owns the write lock skips all other locking.
  */
-static void *symbol_lock;
+static void *modtable_lock;
 
-/* We have to restrict operations when operating in a nested query from a callback */
-static bool recursive_context;
-
-/* Hashtable for mapping module paths to dbg_module_t*. */
+/* Hashtable for mapping module paths to modtable_entry_t*. */
 #define MODTABLE_HASH_BITS 8
 static hashtable_t modtable;
 
+typedef struct _modtable_entry_t {
+    void *mod;
+    /* Held for read by queries which only read the module's symbol data and for
+     * write by those which build lazily-initialized state.  Line lookups
+     * additionally take a per-module DWARF lock in drsyms_unix_common.c.
+     */
+    void *lock;
+} modtable_entry_t;
+
 /* Sideline server support */
 static int shmid;
 
@@ -68,17 +77,86 @@ static int shmid;
  * Linux lookup layer
  */
 
-static void *
+static void
+free_modtable_entry(void *p)
+{
+    modtable_entry_t *entry = (modtable_entry_t *)p;
+    drsym_unix_unload(entry->mod);
+    dr_rwlock_destroy(entry->lock);
+    dr_global_free(entry, sizeof(*entry));
+}
+
+/* Must be called with modtable_lock held for write. */
+static modtable_entry_t *
 lookup_or_load(const char *modpath)
 {
-    void *mod = hashtable_lookup(&modtable, (void *)modpath);
-    if (mod == NULL) {
-        mod = drsym_unix_load(modpath);
+    modtable_entry_t *entry = hashtable_lookup(&modtable, (void *)modpath);
+    if (entry == NULL) {
+        void *mod = drsym_unix_load(modpath);
         if (mod != NULL) {
-            hashtable_add(&modtable, (void *)modpath, mod);
+            entry = dr_global_alloc(sizeof(*entry));
+            entry->mod = mod;
+            entry->lock = dr_rwlock_create();
+            hashtable_add(&modtable, (void *)modpath, entry);
         }
     }
-    return mod;
+    return entry;
+}
+
+/* Returns the module for modpath, loading it if necessary, with the locks needed
+ * to query it held.  The module lock is held for write if "write" is set.
+ * Returns NULL if the module cannot be loaded, with no locks held.
+ */
+static modtable_entry_t *
+acquire_module(const char *modpath, bool write)
+{
+    modtable_entry_t *entry;
+    if (dr_rwlock_self_owns_write_lock(modtable_lock)) {
+        /* A nested query from an enumeration callback: we are exclusive already. */
+        return lookup_or_load(modpath);
+    }
+    dr_rwlock_read_lock(modtable_lock);
+    entry = hashtable_lookup(&modtable, (void *)modpath);
+    while (entry == NULL) {
+        dr_rwlock_read_unlock(modtable_lock);
+        dr_rwlock_write_lock(modtable_lock);
+        entry = lookup_or_load(modpath);
+        dr_rwlock_write_unlock(modtable_lock);
+        if (entry == NULL)
+            return NULL;
+        /* The module may have been freed again while we held no lock. */
+        dr_rwlock_read_lock(modtable_lock);
+        entry = hashtable_lookup(&modtable, (void *)modpath);
+    }
+    if (write)
+        dr_rwlock_write_lock(entry->lock);
+    else
+        dr_rwlock_read_lock(entry->lock);
+    return entry;
+}
+
+static void
+release_module(modtable_entry_t *entry, bool write)
+{
+    if (dr_rwlock_self_owns_write_lock(modtable_lock))
+        return;
+    if (write)
+        dr_rwlock_write_unlock(entry->lock);
+    else
+        dr_rwlock_read_unlock(entry->lock);
+    dr_rwlock_read_unlock(modtable_lock);
+}
+
+/* Takes modtable_lock for write unless this thread already owns it.  Returns
+ * whether the caller must release it.
+ */
+static bool
+lock_exclusive(void)
+{
+    if (dr_rwlock_self_owns_write_lock(modtable_lock))
+        return false;
+    dr_rwlock_write_lock(modtable_lock);
+    return true;
 }
 
 static drsym_error_t
@@ -86,24 +164,26 @@ drsym_enumerate_symbols_local(const char *modpath, drsym_enumerate_cb callback,
                               drsym_enumerate_ex_cb callback_ex, size_t info_size,
                               void *data, uint flags)
 {
-    void *mod;
+    modtable_entry_t *entry;
     drsym_error_t r;
+    bool locked;
 
     if (modpath == NULL || (callback == NULL && callback_ex == NULL))
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    locked = lock_exclusive();
+    entry = lookup_or_load(modpath);
+    if (entry == NULL) {
+        if (locked)
+            dr_rwlock_write_unlock(modtable_lock);
         return DRSYM_ERROR_LOAD_FAILED;
     }
 
-    recursive_context = true;
-    r = drsym_unix_enumerate_symbols(mod, callback, callback_ex, info_size, data, flags);
-    recursive_context = false;
+    r = drsym_unix_enumerate_symbols(entry->mod, callback, callback_ex, info_size, data,
+                                     flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    if (locked)
+        dr_rwlock_write_unlock(modtable_lock);
     return r;
 }
 
@@ -111,22 +191,20 @@ static drsym_error_t
 drsym_lookup_symbol_local(const char *modpath, const char *symbol,
                           size_t *modoffs DR_PARAM_OUT, uint flags)
 {
-    void *mod;
+    modtable_entry_t *entry;
     drsym_error_t r;
 
     if (modpath == NULL || symbol == NULL || modoffs == NULL)
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    /* The first lookup builds the module's symbol hashtable. */
+    entry = acquire_module(modpath, true /*write*/);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    r = drsym_unix_lookup_symbol(mod, symbol, modoffs, flags);
+    r = drsym_unix_lookup_symbol(entry->mod, symbol, modoffs, flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    release_module(entry, true /*write*/);
     return r;
 }
 
@@ -134,7 +212,7 @@ static drsym_error_t
 drsym_lookup_address_local(const char *modpath, size_t modoffs,
                            drsym_info_t *out DR_PARAM_INOUT, uint flags)
 {
-    void *mod;
+    modtable_entry_t *entry;
     drsym_error_t r;
 
     if (modpath == NULL || out == NULL)
@@ -143,16 +221,13 @@ drsym_lookup_address_local(const char *modpath, size_t modoffs,
     if (out->struct_size != sizeof(*out))
         return DRSYM_ERROR_INVALID_SIZE;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    entry = acquire_module(modpath, false /*read*/);
+    if (entry == NULL)
         return DRSYM_ERROR_LOAD_FAILED;
-    }
 
-    r = drsym_unix_lookup_address(mod, modoffs, out, flags);
+    r = drsym_unix_lookup_address(entry->mod, modoffs, out, flags);
 
-    dr_recurlock_unlock(symbol_lock);
+    release_module(entry, false /*read*/);
     return r;
 }
 
@@ -160,22 +235,25 @@ static drsym_error_t
 drsym_enumerate_lines_local(const char *modpath, drsym_enumerate_lines_cb callback,
                             void *data)
 {
-    void *mod;
+    modtable_entry_t *entry;
     drsym_error_t res;
+    bool locked;
 
     if (modpath == NULL || callback == NULL)
         return DRSYM_ERROR_INVALID_PARAMETER;
 
-    dr_recurlock_lock(symbol_lock);
-    mod = lookup_or_load(modpath);
-    if (mod == NULL) {
-        dr_recurlock_unlock(symbol_lock);
+    locked = lock_exclusive();
+    entry = lookup_or_load(modpath);
+    if (entry == NULL) {
+        if (locked)
+            dr_rwlock_write_unlock(modtable_lock);
         return DRSYM_ERROR_LOAD_FAILED;
     }
 
-    res = drsym_unix_enumerate_lines(mod, callback, data);
+    res = drsym_unix_enumerate_lines(entry->mod, callback, data);
 
-    dr_recurlock_unlock(symbol_lock);
+    if (locked)
+        dr_rwlock_write_unlock(modtable_lock);
     return res;
 }
 
@@ -196,7 +274,7 @@ drsym_init(int shmid_in)
 
     shmid = shmid_in;
 
-    symbol_lock = dr_recurlock_create();
+    modtable_lock = dr_rwlock_create();
 
     drsym_unix_init();
 
@@ -206,8 +284,8 @@ drsym_init(int shmid_in)
          */
     } else {
         hashtable_init_ex(&modtable, MODTABLE_HASH_BITS, HASH_STRING, true /*strdup*/,
-                          false /*!synch: using symbol_lock*/,
-                          (generic_func_t)drsym_unix_unload, NULL, NULL);
+                          false /*!synch: using modtable_lock*/,
+                          (generic_func_t)free_modtable_entry, NULL, NULL);
     }
     return DRSYM_SUCCESS;
 }
@@ -229,7 +307,7 @@ drsym_exit(void)
         /* FIXME NYI i#446 */
     }
     hashtable_delete(&modtable);
-    dr_recurlock_destroy(symbol_lock);
+    dr_rwlock_destroy(modtable_lock);
     return res;
 }
 
@@ -245,6 +323,15 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_enable_line_index(bool enable, const char *cache_dir)
+{
+    if (IS_SIDELINE)
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    return drsym_unix_enable_line_index(enable, cache_dir);
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
@@ -322,16 +409,17 @@ drsym_get_module_debug_kind(const char *modpath, drsym_debug_kind_t *kind DR_PAR
     if (IS_SIDELINE) {
         return DRSYM_ERROR_NOT_IMPLEMENTED;
     } else {
-        void *mod;
+        modtable_entry_t *entry;
         drsym_error_t r;
 
         if (modpath == NULL || kind == NULL)
             return DRSYM_ERROR_INVALID_PARAMETER;
 
-        dr_recurlock_lock(symbol_lock);
-        mod = lookup_or_load(modpath);
-        r = drsym_unix_get_module_debug_kind(mod, kind);
-        dr_recurlock_unlock(symbol_lock);
+        entry = acquire_module(modpath, false /*read*/);
+        if (entry == NULL)
+            return DRSYM_ERROR_LOAD_FAILED;
+        r = drsym_unix_get_module_debug_kind(entry->mod, kind);
+        release_module(entry, false /*read*/);
         return r;
     }
 }
@@ -359,13 +447,15 @@ drsym_free_resources(const char *modpath)
         if (modpath == NULL)
             return DRSYM_ERROR_INVALID_PARAMETER;
 
-        /* unsafe to free during iteration */
-        if (recursive_context)
+        /* unsafe to free during iteration, which is the only time we own the
+         * lock
+         */
+        if (dr_rwlock_self_owns_write_lock(modtable_lock))
             return DRSYM_ERROR_RECURSIVE;
 
-        dr_recurlock_lock(symbol_lock);
+        dr_rwlock_write_lock(modtable_lock);
         found = hashtable_remove(&modtable, (void *)modpath);
-        dr_recurlock_unlock(symbol_lock);
+        dr_rwlock_write_unlock(modtable_lock);
 
         return (found ? DRSYM_SUCCESS : DRSYM_ERROR);
     }
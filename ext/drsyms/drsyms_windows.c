@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2020 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * Copyright (c) 2009-2010 VMware, Inc.  All rights reserved.
  * **********************************************************/
 
@@ -1455,6 +1455,15 @@ drsym_lookup_address(const char *modpath, size_t modoffs,
     }
 }
 
+DR_EXPORT
+drsym_error_t
+drsym_enable_line_index(bool enable, const char *cache_dir)
+{
+    if (IS_SIDELINE)
+        return DRSYM_ERROR_NOT_IMPLEMENTED;
+    return drsym_unix_enable_line_index(enable, cache_dir);
+}
+
 DR_EXPORT
 drsym_error_t
 drsym_lookup_symbol(const char *modpath, const char *symbol, size_t *modoffs DR_PARAM_OUT,
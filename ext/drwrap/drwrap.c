@@ -27,6 +27,7 @@
 #include "dr_api.h"
 #include "drwrap.h"
 #include "drmgr.h"
+#include "drreg.h"
 #include "hashtable.h"
 #include "drvector.h"
 #include "../ext_utils.h"
@@ -131,6 +132,241 @@ byte *
 get_cur_xsp(void);
 #endif
 
+/***************************************************************************
+ * LOCK-FREE LOOKUP INDEX
+ */
+
+/* The wrap and post-call hashtables below are read under wrap_lock or
+ * post_call_rwlock for every instruction of every new block and, for post-call
+ * sites, on wrapped calls: with hundreds of threads those locks' cache lines
+ * bounce between cores.  Alongside each table we keep an open-addressing index
+ * of the same keys which readers search with no lock and no stores to shared
+ * memory.  It is only ever written under the lock protecting the table it
+ * mirrors, so once that lock is dropped the two agree.  Payloads found through
+ * the index must not be dereferenced without that lock: they are freed with
+ * the hashtable entries.
+ *
+ * A slot's key only moves from empty to a key to a tombstone.  Removed slots
+ * are never reused in place, as a reader that matched the old key could then
+ * read the new key's value.  Tombstones are reclaimed by rebuilding into a new
+ * array, which is published with a single pointer store.  The old array is
+ * retired RCU-style; with no quiescent-state tracking available we keep
+ * retired arrays until the index is deleted.  Rebuilds happen only after a
+ * quarter of the slots have been consumed, so retired memory stays
+ * proportional to the number of insertions and removals, which are rare
+ * (wrap requests, new post-call sites, module unloads).
+ */
+
+#ifdef X64
+#    define atomic_load_ptr(src) \
+        ((void *)(ptr_int_t)dr_atomic_load64((volatile int64 *)(src)))
+#    define atomic_store_ptr(dest, val) \
+        dr_atomic_store64((volatile int64 *)(dest), (int64)(ptr_int_t)(val))
+#    define LF_INDEX_HASH_MULT 0x9e3779b97f4a7c15ULL
+#else
+#    define atomic_load_ptr(src) \
+        ((void *)(ptr_int_t)dr_atomic_load32((volatile int *)(src)))
+#    define atomic_store_ptr(dest, val) \
+        dr_atomic_store32((volatile int *)(dest), (int)(ptr_int_t)(val))
+#    define LF_INDEX_HASH_MULT 0x9e3779b9U
+#endif
+
+#define LF_INDEX_TOMBSTONE ((app_pc)(ptr_int_t)-1)
+
+typedef struct _lf_index_slot_t {
+    app_pc key; /* NULL if empty, LF_INDEX_TOMBSTONE if removed */
+    void *value;
+} lf_index_slot_t;
+
+typedef struct _lf_index_array_t {
+    uint bits;
+    uint capacity;
+    /* Non-empty slots, including tombstones.  Writer-only. */
+    uint used;
+    /* Slots holding a live key.  Writer-only. */
+    uint live;
+    lf_index_slot_t *slots;
+    struct _lf_index_array_t *retired_next;
+} lf_index_array_t;
+
+typedef struct _lf_index_t {
+    lf_index_array_t *cur;
+    lf_index_array_t *retired;
+} lf_index_t;
+
+static lf_index_array_t *
+lf_index_array_create(uint bits)
+{
+    uint capacity = 1U << bits;
+    lf_index_array_t *arr = (lf_index_array_t *)dr_global_alloc(
+        sizeof(*arr) + capacity * sizeof(lf_index_slot_t));
+    arr->bits = bits;
+    arr->capacity = capacity;
+    arr->used = 0;
+    arr->live = 0;
+    arr->slots = (lf_index_slot_t *)(arr + 1);
+    arr->retired_next = NULL;
+    memset(arr->slots, 0, capacity * sizeof(lf_index_slot_t));
+    return arr;
+}
+
+static void
+lf_index_array_free(lf_index_array_t *arr)
+{
+    dr_global_free(arr, sizeof(*arr) + arr->capacity * sizeof(lf_index_slot_t));
+}
+
+static inline uint
+lf_index_hash(lf_index_array_t *arr, app_pc key)
+{
+    return (uint)(((ptr_uint_t)key * LF_INDEX_HASH_MULT) >>
+                  (sizeof(ptr_uint_t) * 8 - arr->bits));
+}
+
+static void
+lf_index_init(lf_index_t *index, uint bits)
+{
+    index->cur = lf_index_array_create(bits);
+    index->retired = NULL;
+}
+
+static void
+lf_index_delete(lf_index_t *index)
+{
+    while (index->retired != NULL) {
+        lf_index_array_t *next = index->retired->retired_next;
+        lf_index_array_free(index->retired);
+        index->retired = next;
+    }
+    lf_index_array_free(index->cur);
+    index->cur = NULL;
+}
+
+/* Safe to call with no lock held.  Returns NULL if key is not present. */
+static void *
+lf_index_lookup(lf_index_t *index, app_pc key)
+{
+    lf_index_array_t *arr = (lf_index_array_t *)atomic_load_ptr(&index->cur);
+    uint mask = arr->capacity - 1;
+    uint i;
+    /* The writer keeps at least a quarter of the slots empty so this terminates. */
+    for (i = lf_index_hash(arr, key);; i = (i + 1) & mask) {
+        app_pc cur = (app_pc)atomic_load_ptr(&arr->slots[i].key);
+        if (cur == key)
+            return atomic_load_ptr(&arr->slots[i].value);
+        if (cur == NULL)
+            return NULL;
+    }
+}
+
+/* Caller must hold the lock protecting the mirrored table.  Returns the slot
+ * holding key, or NULL with *empty set to the empty slot ending its chain.
+ */
+static lf_index_slot_t *
+lf_index_find_slot(lf_index_array_t *arr, app_pc key, lf_index_slot_t **empty)
+{
+    uint mask = arr->capacity - 1;
+    uint i;
+    for (i = lf_index_hash(arr, key);; i = (i + 1) & mask) {
+        if (arr->slots[i].key == key)
+            return &arr->slots[i];
+        if (arr->slots[i].key == NULL) {
+            if (empty != NULL)
+                *empty = &arr->slots[i];
+            return NULL;
+        }
+    }
+}
+
+/* Caller must hold the lock protecting the mirrored table. */
+static void
+lf_index_rebuild(lf_index_t *index)
+{
+    lf_index_array_t *old = index->cur;
+    uint bits = old->bits;
+    uint i;
+    /* Grow when live keys would fill more than half the new array; otherwise
+     * this rebuild is just reclaiming tombstones.
+     */
+    while ((old->live + 1) * 2 > (1U << bits))
+        bits++;
+    lf_index_array_t *arr = lf_index_array_create(bits);
+    for (i = 0; i < old->capacity; i++) {
+        lf_index_slot_t *empty = NULL;
+        app_pc key = old->slots[i].key;
+        if (key == NULL || key == LF_INDEX_TOMBSTONE)
+            continue;
+        lf_index_find_slot(arr, key, &empty);
+        empty->value = old->slots[i].value;
+        empty->key = key;
+        arr->used++;
+        arr->live++;
+    }
+    NOTIFY(2, "%s: %u live of %u slots => %u slots\n", __FUNCTION__, old->live,
+           old->capacity, arr->capacity);
+    /* Readers still searching old are unaffected: it is never written again. */
+    atomic_store_ptr(&index->cur, arr);
+    old->retired_next = index->retired;
+    index->retired = old;
+}
+
+/* Adds key or replaces its value.  Caller must hold the lock protecting the
+ * mirrored table.
+ */
+static void
+lf_index_set(lf_index_t *index, app_pc key, void *value)
+{
+    lf_index_slot_t *slot, *empty = NULL;
+    ASSERT(key != NULL && key != LF_INDEX_TOMBSTONE && value != NULL, "invalid key");
+    slot = lf_index_find_slot(index->cur, key, &empty);
+    if (slot != NULL) {
+        atomic_store_ptr(&slot->value, value);
+        return;
+    }
+    if ((index->cur->used + 1) * 4 > index->cur->capacity * 3) {
+        lf_index_rebuild(index);
+        lf_index_find_slot(index->cur, key, &empty);
+    }
+    /* Publish the value before the key so a reader matching the key sees it. */
+    atomic_store_ptr(&empty->value, value);
+    atomic_store_ptr(&empty->key, key);
+    index->cur->used++;
+    index->cur->live++;
+}
+
+static void
+lf_index_remove_slot(lf_index_array_t *arr, lf_index_slot_t *slot)
+{
+    /* A reader that already matched the key now sees NULL, i.e., not present. */
+    atomic_store_ptr(&slot->value, NULL);
+    atomic_store_ptr(&slot->key, LF_INDEX_TOMBSTONE);
+    arr->live--;
+}
+
+/* Caller must hold the lock protecting the mirrored table. */
+static void
+lf_index_remove(lf_index_t *index, app_pc key)
+{
+    lf_index_slot_t *slot = lf_index_find_slot(index->cur, key, NULL);
+    if (slot != NULL)
+        lf_index_remove_slot(index->cur, slot);
+}
+
+/* Removes all keys in [start, end).  Caller must hold the lock protecting the
+ * mirrored table.
+ */
+static void
+lf_index_remove_range(lf_index_t *index, app_pc start, app_pc end)
+{
+    lf_index_array_t *arr = index->cur;
+    uint i;
+    for (i = 0; i < arr->capacity; i++) {
+        app_pc key = arr->slots[i].key;
+        if (key != NULL && key != LF_INDEX_TOMBSTONE && key >= start && key < end)
+            lf_index_remove_slot(arr, &arr->slots[i]);
+    }
+}
+
 /***************************************************************************
  * REQUEST TRACKING
  */
@@ -181,6 +417,8 @@ typedef struct _wrap_entry_t {
 #define WRAP_TABLE_HASH_BITS 6
 /* i#1689: we store the decorated (LSB=1) pc (passed from client) in the table */
 static hashtable_t wrap_table;
+/* Lock-free mirror of wrap_table's keys, written under wrap_lock */
+static lf_index_t wrap_index;
 /* We need recursive locking on the table to support drwrap_unwrap
  * being called from a post event so we use this lock instead of
  * hashtable_lock(&wrap_table)
@@ -285,6 +523,10 @@ fast_safe_read(void *base, size_t size, void *out_buf)
 /* i#1689: we store the aligned (LSB=0) pc here */
 static hashtable_t post_call_table;
 static void *post_call_rwlock;
+/* Lock-free mirror of post_call_table's keys, written under the post_call_rwlock
+ * write lock.  Lets the common lookups skip post_call_rwlock entirely.
+ */
+static lf_index_t post_call_index;
 
 typedef struct _post_call_entry_t {
     /* PR 454616: we need two flags in the post_call_table: one that
@@ -346,6 +588,7 @@ post_call_entry_add(app_pc postcall, bool external)
         post_call_entry_free(e);
         return NULL;
     }
+    lf_index_set(&post_call_index, postcall, e);
     if (!external && post_call_notify_list != NULL) {
         post_call_notify_t *cb = post_call_notify_list;
         while (cb != NULL) {
@@ -381,11 +624,7 @@ post_call_consistent(app_pc postcall, post_call_entry_t *e)
 static bool
 post_call_lookup(app_pc pc)
 {
-    bool res = false;
-    dr_rwlock_read_lock(post_call_rwlock);
-    res = (hashtable_lookup(&post_call_table, (void *)pc) != NULL);
-    dr_rwlock_read_unlock(post_call_rwlock);
-    return res;
+    return lf_index_lookup(&post_call_index, pc) != NULL;
 }
 #endif
 
@@ -395,6 +634,11 @@ post_call_lookup_for_instru(app_pc pc)
 {
     bool res = false;
     post_call_entry_t *e;
+    /* Nearly every instruction is not a post-call site: answer that without
+     * touching post_call_rwlock.
+     */
+    if (lf_index_lookup(&post_call_index, pc) == NULL)
+        return false;
     dr_rwlock_read_lock(post_call_rwlock);
     e = (post_call_entry_t *)hashtable_lookup(&post_call_table, (void *)pc);
     if (e != NULL) {
@@ -408,6 +652,7 @@ post_call_lookup_for_instru(app_pc pc)
             /* might not be found now if racily removed: but that's fine */
             NOTIFY(2, "%s: removing %p\n", __FUNCTION__, pc);
             hashtable_remove(&post_call_table, (void *)pc);
+            lf_index_remove(&post_call_index, pc);
             /* invalidate cache */
             for (i = 0; i < POSTCALL_CACHE_SIZE; i++) {
                 if (pc == postcall_cache[i])
@@ -933,6 +1178,18 @@ drwrap_event_exception(void *drcontext, dr_exception_t *excpt);
 static void
 drwrap_replace_init(void);
 
+static void
+drwrap_flush_func(app_pc func);
+
+static bool
+drwrap_inline_init(void);
+
+static void
+drwrap_inline_exit(void);
+
+static void
+drwrap_inline_thread_init(void *drcontext);
+
 /***************************************************************************
  * INIT
  */
@@ -989,10 +1246,14 @@ drwrap_init(void)
                       false /*!str_dup*/, false /*!synch*/, post_call_entry_free, NULL,
                       NULL);
     post_call_rwlock = dr_rwlock_create();
+    lf_index_init(&wrap_index, WRAP_TABLE_HASH_BITS);
+    lf_index_init(&post_call_index, POST_CALL_TABLE_HASH_BITS);
     /* This lock may have been set up by drwrap_set_global_flags() (in this thread). */
     if (wrap_lock == NULL)
         wrap_lock = dr_recurlock_create();
     drmgr_register_module_unload_event(drwrap_event_module_unload);
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags) && !drwrap_inline_init())
+        return false;
 
     tls_idx = drmgr_register_tls_field();
     if (tls_idx == -1)
@@ -1071,6 +1332,10 @@ drwrap_exit(void)
     hashtable_delete(&replace_native_table);
     hashtable_delete(&wrap_table);
     hashtable_delete(&post_call_table);
+    lf_index_delete(&wrap_index);
+    lf_index_delete(&post_call_index);
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags))
+        drwrap_inline_exit();
     dr_rwlock_destroy(post_call_rwlock);
     dr_recurlock_destroy(wrap_lock);
     wrap_lock = NULL; /* For early drwrap_set_global_flags() after re-attach. */
@@ -1091,6 +1356,8 @@ drwrap_thread_init(void *drcontext)
     memset(pt, 0, sizeof(*pt));
     pt->wrap_level = -1;
     drmgr_set_tls_field(drcontext, tls_idx, (void *)pt);
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags))
+        drwrap_inline_thread_init(drcontext);
 }
 
 static void
@@ -1140,9 +1407,10 @@ drwrap_set_global_flags(drwrap_global_flags_t flags)
     }
     dr_recurlock_lock(wrap_lock);
     if (dr_atomic_load32(&drwrap_init_count) > 0 &&
-        /* After drwrap_init() was called, control inversion cannot be changed. */
-        TEST(DRWRAP_INVERT_CONTROL, flags) &&
-        !TEST(DRWRAP_INVERT_CONTROL, global_flags)) {
+        /* After drwrap_init() was called, control inversion and inline handler
+         * support cannot be changed.
+         */
+        TESTANY(DRWRAP_INVERT_CONTROL | DRWRAP_INLINE_HANDLERS, flags & ~global_flags)) {
         dr_recurlock_unlock(wrap_lock);
         return false;
     }
@@ -1776,6 +2044,649 @@ drwrap_replace_native_fini(void *drcontext)
     app_retaddr = 0;
 }
 
+/***************************************************************************
+ * INLINE WRAPPING
+ */
+
+/* drwrap_wrap_inline() requests trade the generality of the clean-call path for
+ * speed: the client's handlers are emitted straight into the code cache around
+ * drreg-reserved scratch registers.  Post-call sites are found the same two ways as
+ * for regular wraps: from direct calls seen at block creation, and from return
+ * addresses observed on entry to the callee.  The latter check is inlined as a
+ * per-function direct-mapped cache of return addresses already known to be sites,
+ * so only the first entry from each new call site leaves the code cache.
+ *
+ * A thread stores the id of the inline-wrapped function it most recently entered
+ * in a raw TLS slot, and a post-call site only runs a function's post handler if
+ * that slot holds its id.  With one slot per thread, post handlers do not nest.
+ *
+ * Requests and site nodes are only freed at exit, so unlike wrap_index and
+ * post_call_index, payloads found through these indices can be dereferenced
+ * without holding inline_lock.
+ */
+
+#define INLINE_RESERVED_REGS (DRWRAP_INLINE_SCRATCH_REGS + 1)
+
+#define INLINE_RETADDR_CACHE_BITS 6
+#define INLINE_RETADDR_CACHE_SIZE (1 << INLINE_RETADDR_CACHE_BITS)
+/* Drop the low bits that are constant due to instruction alignment. */
+#ifdef X86
+#    define INLINE_RETADDR_SHIFT 0
+#elif defined(ARM)
+#    define INLINE_RETADDR_SHIFT 1
+#else
+#    define INLINE_RETADDR_SHIFT 2
+#endif
+
+#ifdef X86
+#    define INLINE_RETVAL_REG DR_REG_XAX
+#    define INLINE_RETVAL_HIGH_REG DR_REG_XDX
+#elif defined(ARM)
+#    define INLINE_RETVAL_REG DR_REG_R0
+#    define INLINE_RETVAL_HIGH_REG DR_REG_R1
+#elif defined(AARCH64)
+#    define INLINE_RETVAL_REG DR_REG_X0
+#    define INLINE_RETVAL_HIGH_REG DR_REG_X1
+#else
+#    define INLINE_RETVAL_REG DR_REG_A0
+#    define INLINE_RETVAL_HIGH_REG DR_REG_A1
+#endif
+
+/* Raw TLS slots: the id of the active inline wrap, and the handlers' scratch slot. */
+#define INLINE_TLS_SLOT_ACTIVE 0
+#define INLINE_TLS_SLOT_SCRATCH 1
+#define INLINE_TLS_SLOT_COUNT 2
+#define INLINE_TLS_OFFS(slot) (inline_tls_offs + (slot) * sizeof(void *))
+
+typedef struct _inline_wrap_t {
+    app_pc func; /* decorated, as passed by the client */
+    drwrap_inline_insert_cb_t pre_insert;
+    drwrap_inline_insert_cb_t post_insert;
+    void *user_data;
+    drwrap_wrap_flags_t flags;
+    drwrap_callconv_t callconv;
+    /* Written under inline_lock; read at block creation. */
+    bool enabled;
+    /* Stored in the active TLS slot.  Never 0. */
+    ptr_uint_t id;
+    /* Return addresses as seen by the callee (LSB=1 for Thumb callers), indexed by
+     * drwrap_inline_cache_idx(), that are known post-call sites.  Read by inlined
+     * code and written racily by drwrap_inline_learn_retaddr().
+     */
+    app_pc retaddr_cache[INLINE_RETADDR_CACHE_SIZE];
+    struct _inline_wrap_t *next_all;
+} inline_wrap_t;
+
+typedef struct _inline_site_t {
+    inline_wrap_t *iw;
+    /* Whether code built at the site is known to include this node. */
+    bool instrumented;
+    /* The next request sharing this site.  Immutable once published. */
+    struct _inline_site_t *next;
+    struct _inline_site_t *next_all;
+} inline_site_t;
+
+/* The following are written under inline_lock. */
+static void *inline_lock;
+/* Keyed by the decorated function pc. */
+static lf_index_t inline_wrap_index;
+/* Keyed by the aligned (LSB=0) post-call site pc, holding a list of nodes. */
+static lf_index_t inline_site_index;
+static inline_wrap_t *inline_wrap_list;
+static inline_site_t *inline_site_list;
+static ptr_uint_t inline_next_id;
+
+static reg_id_t inline_tls_seg;
+static uint inline_tls_offs;
+
+static bool
+drwrap_inline_init(void)
+{
+    drreg_options_t ops = { sizeof(ops), INLINE_RESERVED_REGS + 1 /*aflags*/, false };
+    if (drreg_init(&ops) != DRREG_SUCCESS)
+        return false;
+    if (!dr_raw_tls_calloc(&inline_tls_seg, &inline_tls_offs, INLINE_TLS_SLOT_COUNT, 0))
+        return false;
+    inline_lock = dr_mutex_create();
+    lf_index_init(&inline_wrap_index, WRAP_TABLE_HASH_BITS);
+    lf_index_init(&inline_site_index, POST_CALL_TABLE_HASH_BITS);
+    return true;
+}
+
+static void
+drwrap_inline_exit(void)
+{
+    while (inline_wrap_list != NULL) {
+        inline_wrap_t *tmp = inline_wrap_list->next_all;
+        dr_global_free(inline_wrap_list, sizeof(*inline_wrap_list));
+        inline_wrap_list = tmp;
+    }
+    while (inline_site_list != NULL) {
+        inline_site_t *tmp = inline_site_list->next_all;
+        dr_global_free(inline_site_list, sizeof(*inline_site_list));
+        inline_site_list = tmp;
+    }
+    inline_next_id = 0;
+    lf_index_delete(&inline_wrap_index);
+    lf_index_delete(&inline_site_index);
+    dr_mutex_destroy(inline_lock);
+    inline_lock = NULL;
+    if (!dr_raw_tls_cfree(inline_tls_offs, INLINE_TLS_SLOT_COUNT))
+        ASSERT(false, "failed to free raw TLS slots");
+    drreg_exit();
+}
+
+static void
+drwrap_inline_thread_init(void *drcontext)
+{
+    /* Raw TLS is not guaranteed to be zeroed on every platform. */
+    byte *base = dr_get_dr_segment_base(inline_tls_seg);
+    memset(base + INLINE_TLS_OFFS(0), 0, INLINE_TLS_SLOT_COUNT * sizeof(void *));
+}
+
+static void
+drwrap_inline_module_unload(const module_data_t *info)
+{
+    inline_wrap_t *iw;
+    int i;
+    dr_mutex_lock(inline_lock);
+    lf_index_remove_range(&inline_site_index, info->start, info->end);
+    for (iw = inline_wrap_list; iw != NULL; iw = iw->next_all) {
+        for (i = 0; i < INLINE_RETADDR_CACHE_SIZE; i++) {
+            if (iw->retaddr_cache[i] >= info->start && iw->retaddr_cache[i] < info->end)
+                atomic_store_ptr(&iw->retaddr_cache[i], NULL);
+        }
+    }
+    dr_mutex_unlock(inline_lock);
+}
+
+#ifndef RISCV64 /* TODO i#3544: Port inline wrapping to RISC-V. */
+/* Sets *regs to the registers holding the leading arguments under callconv and
+ * returns how many there are.  The rest start *stack_offs slots above the stack
+ * pointer on entry.
+ */
+static uint
+drwrap_inline_arg_regs(drwrap_callconv_t callconv, const reg_id_t **regs,
+                       uint *stack_offs)
+{
+#    if defined(ARM)
+    static const reg_id_t arm_regs[] = { DR_REG_R0, DR_REG_R1, DR_REG_R2, DR_REG_R3 };
+#    elif defined(AARCH64)
+    static const reg_id_t aarch64_regs[] = { DR_REG_X0, DR_REG_X1, DR_REG_X2,
+                                             DR_REG_X3, DR_REG_X4, DR_REG_X5,
+                                             DR_REG_X6, DR_REG_X7 };
+#    else
+#        ifdef X64
+    static const reg_id_t amd64_regs[] = { DR_REG_RDI, DR_REG_RSI, DR_REG_RDX,
+                                           DR_REG_RCX, DR_REG_R8,  DR_REG_R9 };
+    static const reg_id_t ms_x64_regs[] = { DR_REG_RCX, DR_REG_RDX, DR_REG_R8,
+                                            DR_REG_R9 };
+#        endif
+    static const reg_id_t fastcall_regs[] = { DR_REG_XCX, DR_REG_XDX };
+#    endif
+    *regs = NULL;
+    *stack_offs = 0;
+    switch (callconv) {
+#    if defined(ARM)
+    case DRWRAP_CALLCONV_ARM: *regs = arm_regs; return BUFFER_SIZE_ELEMENTS(arm_regs);
+#    elif defined(AARCH64)
+    case DRWRAP_CALLCONV_AARCH64:
+        *regs = aarch64_regs;
+        return BUFFER_SIZE_ELEMENTS(aarch64_regs);
+#    else
+#        ifdef X64
+    case DRWRAP_CALLCONV_AMD64:
+        *regs = amd64_regs;
+        *stack_offs = 1 /*retaddr*/;
+        return BUFFER_SIZE_ELEMENTS(amd64_regs);
+    case DRWRAP_CALLCONV_MICROSOFT_X64:
+        *regs = ms_x64_regs;
+        *stack_offs = 1 /*retaddr*/ + 4 /*reserved*/;
+        return BUFFER_SIZE_ELEMENTS(ms_x64_regs);
+#        endif
+    case DRWRAP_CALLCONV_CDECL: *stack_offs = 1 /*retaddr*/; return 0;
+    case DRWRAP_CALLCONV_FASTCALL:
+        *regs = fastcall_regs;
+        *stack_offs = 1 /*retaddr*/;
+        return BUFFER_SIZE_ELEMENTS(fastcall_regs);
+    case DRWRAP_CALLCONV_THISCALL:
+        *regs = fastcall_regs;
+        *stack_offs = 1 /*retaddr*/;
+        return 1;
+#    endif
+    default: ASSERT(false, "unknown or unsupported calling convention"); return 0;
+    }
+}
+
+static inline uint
+drwrap_inline_cache_idx(app_pc retaddr)
+{
+    return (uint)(((ptr_uint_t)retaddr >> INLINE_RETADDR_SHIFT) &
+                  (INLINE_RETADDR_CACHE_SIZE - 1));
+}
+
+/* Returns the node recording site as a post-call site of iw, adding it if
+ * necessary.  Caller must hold inline_lock.
+ */
+static inline_site_t *
+drwrap_inline_add_site(inline_wrap_t *iw, app_pc site)
+{
+    inline_site_t *head = (inline_site_t *)lf_index_lookup(&inline_site_index, site);
+    inline_site_t *s;
+    ASSERT(dr_mutex_self_owns(inline_lock), "must hold inline_lock");
+    for (s = head; s != NULL; s = s->next) {
+        if (s->iw == iw)
+            return s;
+    }
+    s = (inline_site_t *)dr_global_alloc(sizeof(*s));
+    s->iw = iw;
+    s->instrumented = false;
+    s->next = head;
+    s->next_all = inline_site_list;
+    inline_site_list = s;
+    lf_index_set(&inline_site_index, site, s);
+    NOTIFY(2, "%s: " PFX " is a post-call site for " PFX "\n", __FUNCTION__, site,
+           iw->func);
+    return s;
+}
+
+/* Called via clean call from the entry of an inline-wrapped function whose return
+ * address missed in the request's cache.
+ */
+static void
+drwrap_inline_learn_retaddr(inline_wrap_t *iw, app_pc retaddr)
+{
+    void *drcontext = dr_get_current_drcontext();
+    app_pc site = dr_app_pc_as_load_target(DR_ISA_ARM_THUMB, retaddr);
+    inline_site_t *s;
+    bool flush;
+    dr_mutex_lock(inline_lock);
+    s = drwrap_inline_add_site(iw, site);
+    /* Blocks built from now on see the site, so existing code is the only concern.
+     * As in drwrap_mark_retaddr_for_instru() we assume we only care about fragments
+     * starting at the site.
+     */
+    /* XXX: we're assuming void* tag == pc */
+    flush = !s->instrumented && dr_fragment_exists_at(drcontext, (void *)site);
+    s->instrumented = true;
+    dr_mutex_unlock(inline_lock);
+    if (flush) {
+        /* Unlike dr_flush_region(), this lets the current fragment run to completion,
+         * so we can return to the cache rather than redirecting to the function entry
+         * and re-executing the pre handler.
+         */
+        dr_atomic_add_stat_return_sum(&drwrap_stats.flush_count, 1);
+        NOTIFY(3, "%s: flushing " PFX "\n", __FUNCTION__, site);
+        if (!dr_unlink_flush_region(site, 1))
+            ASSERT(false, "inline post-call flush failed");
+    }
+    atomic_store_ptr(&iw->retaddr_cache[drwrap_inline_cache_idx(retaddr)], retaddr);
+}
+
+/* Reserves INLINE_RESERVED_REGS registers from allowed into reg. */
+static bool
+drwrap_inline_reserve(void *drcontext, instrlist_t *ilist, instr_t *where,
+                      drvector_t *allowed, reg_id_t reg[INLINE_RESERVED_REGS])
+{
+    int i;
+    for (i = 0; i < INLINE_RESERVED_REGS; i++) {
+        if (drreg_reserve_register(drcontext, ilist, where, allowed, &reg[i]) !=
+            DRREG_SUCCESS) {
+            ASSERT(false, "failed to reserve inline wrap scratch register");
+            while (--i >= 0)
+                drreg_unreserve_register(drcontext, ilist, where, reg[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Unreserves the arithmetic flags, if reserved, and reg. */
+static void
+drwrap_inline_unreserve(void *drcontext, instrlist_t *ilist, instr_t *where,
+                        reg_id_t reg[INLINE_RESERVED_REGS], bool aflags)
+{
+    int i;
+    if (aflags && drreg_unreserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS)
+        ASSERT(false, "failed to unreserve aflags");
+    for (i = INLINE_RESERVED_REGS - 1; i >= 0; i--) {
+        if (drreg_unreserve_register(drcontext, ilist, where, reg[i]) != DRREG_SUCCESS)
+            ASSERT(false, "failed to unreserve inline wrap scratch register");
+    }
+}
+
+static void
+drwrap_inline_info_init(void *drcontext, drwrap_inline_info_t *info, inline_wrap_t *iw,
+                        reg_id_t reg[INLINE_RESERVED_REGS])
+{
+    int i;
+    info->func = iw->func;
+    info->user_data = iw->user_data;
+    for (i = 0; i < DRWRAP_INLINE_MAX_ARGS; i++)
+        info->arg[i] = opnd_create_null();
+    info->retval = opnd_create_null();
+    info->scratch_slot = dr_raw_tls_opnd(drcontext, inline_tls_seg,
+                                         INLINE_TLS_OFFS(INLINE_TLS_SLOT_SCRATCH));
+    for (i = 0; i < DRWRAP_INLINE_SCRATCH_REGS; i++)
+        info->scratch_reg[i] = reg[i];
+}
+
+/* Inserts the inline equivalent of drwrap_ensure_postcall(): the return address
+ * is looked up in iw's cache, calling out to record the site on a miss.
+ */
+static void
+drwrap_inline_insert_retaddr_check(void *drcontext, instrlist_t *ilist, instr_t *where,
+                                   inline_wrap_t *iw, reg_id_t reg[INLINE_RESERVED_REGS])
+{
+    instr_t *skip = INSTR_CREATE_label(drcontext);
+    reg_id_t reg_ra = reg[0], reg_idx = reg[1], reg_ptr = reg[2];
+#    ifdef X86
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_load(drcontext, opnd_create_reg(reg_ra),
+                                               OPND_CREATE_MEMPTR(DR_REG_XSP, 0)));
+#    else
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_move(drcontext, opnd_create_reg(reg_ra),
+                                               opnd_create_reg(DR_REG_LR)));
+#    endif
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_move(drcontext, opnd_create_reg(reg_idx), opnd_create_reg(reg_ra)));
+#    if INLINE_RETADDR_SHIFT > 0
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_slr_s(drcontext, opnd_create_reg(reg_idx),
+                                                OPND_CREATE_INT8(INLINE_RETADDR_SHIFT)));
+#    endif
+#    ifndef X86
+    /* Logical immediates are restricted on ARM and AArch64, so use a register. */
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_load_int(drcontext, opnd_create_reg(reg_ptr),
+                              OPND_CREATE_INT32(INLINE_RETADDR_CACHE_SIZE - 1)));
+#    endif
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_and_s(drcontext, opnd_create_reg(reg_idx),
+                           IF_X86_ELSE(OPND_CREATE_INT32(INLINE_RETADDR_CACHE_SIZE - 1),
+                                       opnd_create_reg(reg_ptr))));
+    instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)iw->retaddr_cache,
+                                     opnd_create_reg(reg_ptr), ilist, where, NULL, NULL);
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_add_sll(drcontext, opnd_create_reg(reg_ptr),
+                                                  opnd_create_reg(reg_ptr),
+                                                  opnd_create_reg(reg_idx),
+                                                  IF_X64_ELSE(3, 2)));
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_load(drcontext, opnd_create_reg(reg_idx),
+                                               OPND_CREATE_MEMPTR(reg_ptr, 0)));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_idx), opnd_create_reg(reg_ra)));
+    instrlist_meta_preinsert(
+        ilist, where,
+        XINST_CREATE_jump_cond(drcontext, DR_PRED_EQ, opnd_create_instr(skip)));
+    dr_insert_clean_call(drcontext, ilist, where, (void *)drwrap_inline_learn_retaddr,
+                         false /*!fpstate*/, 2, OPND_CREATE_INTPTR((ptr_int_t)iw),
+                         opnd_create_reg(reg_ra));
+    instrlist_meta_preinsert(ilist, where, skip);
+}
+
+/* Inserts iw's pre handler at the entry to iw->func. */
+static void
+drwrap_inline_insert_pre(void *drcontext, instrlist_t *ilist, instr_t *where,
+                         inline_wrap_t *iw)
+{
+    drwrap_inline_info_t info;
+    reg_id_t reg[INLINE_RESERVED_REGS];
+    reg_id_t swap = DR_REG_NULL;
+    drvector_t allowed;
+    const reg_id_t *arg_regs;
+    uint num_arg_regs, stack_offs, i;
+    bool ok;
+
+    /* Keep the argument registers (and the link register) holding their app
+     * values so the handler and the retaddr check can read them in place.
+     */
+    num_arg_regs = drwrap_inline_arg_regs(iw->callconv, &arg_regs, &stack_offs);
+    drreg_init_and_fill_vector(&allowed, true);
+    for (i = 0; i < num_arg_regs; i++)
+        drreg_set_vector_entry(&allowed, arg_regs[i], false);
+#    ifdef AARCHXX
+    drreg_set_vector_entry(&allowed, DR_REG_LR, false);
+#    endif
+    ok = drwrap_inline_reserve(drcontext, ilist, where, &allowed, reg);
+    drvector_delete(&allowed);
+    if (!ok)
+        return;
+    /* Another component's lazily-restored register may still hold a tool value. */
+    for (i = 0; i < num_arg_regs; i++) {
+        drreg_restore_app_values(drcontext, ilist, where, opnd_create_reg(arg_regs[i]),
+                                 &swap);
+    }
+#    ifdef AARCHXX
+    drreg_restore_app_values(drcontext, ilist, where, opnd_create_reg(DR_REG_LR), &swap);
+#    endif
+    ASSERT(swap == DR_REG_NULL, "stolen register is never an argument");
+    if (drreg_reserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS) {
+        ASSERT(false, "failed to reserve aflags");
+        drwrap_inline_unreserve(drcontext, ilist, where, reg, false);
+        return;
+    }
+
+    if (iw->pre_insert != NULL) {
+        drwrap_inline_info_init(drcontext, &info, iw, reg);
+        for (i = 0; i < DRWRAP_INLINE_MAX_ARGS; i++) {
+            if (i < num_arg_regs)
+                info.arg[i] = opnd_create_reg(arg_regs[i]);
+            else {
+                info.arg[i] = OPND_CREATE_MEMPTR(
+                    DR_REG_XSP, (stack_offs + i - num_arg_regs) * sizeof(reg_t));
+            }
+        }
+        iw->pre_insert(drcontext, ilist, where, &info);
+    }
+    if (iw->post_insert != NULL) {
+        instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)iw->id,
+                                         opnd_create_reg(reg[0]), ilist, where, NULL,
+                                         NULL);
+        dr_insert_write_raw_tls(drcontext, ilist, where, inline_tls_seg,
+                                INLINE_TLS_OFFS(INLINE_TLS_SLOT_ACTIVE), reg[0]);
+        if (!TEST(DRWRAP_NO_DYNAMIC_RETADDRS, iw->flags))
+            drwrap_inline_insert_retaddr_check(drcontext, ilist, where, iw, reg);
+    }
+    drwrap_inline_unreserve(drcontext, ilist, where, reg, true);
+}
+
+/* Inserts the post handler of each request in sites whose function was the last one
+ * entered, if any.  For cleanup_only, the active id is cleared without invoking the
+ * handler.
+ */
+static void
+drwrap_inline_insert_post(void *drcontext, instrlist_t *ilist, instr_t *where,
+                          inline_site_t *sites, bool cleanup_only)
+{
+    drwrap_inline_info_t info;
+    reg_id_t reg[INLINE_RESERVED_REGS];
+    reg_id_t reg_active, reg_retval;
+    drvector_t allowed;
+    drreg_status_t res;
+    instr_t *done;
+    inline_site_t *s;
+    bool ok;
+
+    drreg_init_and_fill_vector(&allowed, true);
+    drreg_set_vector_entry(&allowed, INLINE_RETVAL_REG, false);
+    drreg_set_vector_entry(&allowed, INLINE_RETVAL_HIGH_REG, false);
+    ok = drwrap_inline_reserve(drcontext, ilist, where, &allowed, reg);
+    drvector_delete(&allowed);
+    if (!ok)
+        return;
+    reg_active = reg[1];
+    reg_retval = reg[DRWRAP_INLINE_SCRATCH_REGS];
+    /* Copy the return value before drreg can use its register for the flags.  The
+     * register is dead after a function with no return value, which is fine.
+     */
+    res = drreg_get_app_value(drcontext, ilist, where, INLINE_RETVAL_REG, reg_retval);
+    if ((res != DRREG_SUCCESS && res != DRREG_ERROR_NO_APP_VALUE) ||
+        drreg_reserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS) {
+        ASSERT(false, "failed to set up inline post-call scratch state");
+        drwrap_inline_unreserve(drcontext, ilist, where, reg, false);
+        return;
+    }
+
+    done = INSTR_CREATE_label(drcontext);
+    dr_insert_read_raw_tls(drcontext, ilist, where, inline_tls_seg,
+                           INLINE_TLS_OFFS(INLINE_TLS_SLOT_ACTIVE), reg_active);
+    for (s = sites; s != NULL; s = s->next) {
+        instr_t *next = INSTR_CREATE_label(drcontext);
+        s->instrumented = true;
+        instrlist_insert_mov_immed_ptrsz(drcontext, (ptr_int_t)s->iw->id,
+                                         opnd_create_reg(reg[0]), ilist, where, NULL,
+                                         NULL);
+        instrlist_meta_preinsert(ilist, where,
+                                 XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_active),
+                                                  opnd_create_reg(reg[0])));
+        instrlist_meta_preinsert(
+            ilist, where,
+            XINST_CREATE_jump_cond(drcontext, DR_PRED_NE, opnd_create_instr(next)));
+        instrlist_meta_preinsert(ilist, where,
+                                 XINST_CREATE_load_int(drcontext, opnd_create_reg(reg[0]),
+                                                       OPND_CREATE_INT32(0)));
+        dr_insert_write_raw_tls(drcontext, ilist, where, inline_tls_seg,
+                                INLINE_TLS_OFFS(INLINE_TLS_SLOT_ACTIVE), reg[0]);
+        if (!cleanup_only && s->iw->post_insert != NULL) {
+            drwrap_inline_info_init(drcontext, &info, s->iw, reg);
+            info.retval = opnd_create_reg(reg_retval);
+            s->iw->post_insert(drcontext, ilist, where, &info);
+        }
+        instrlist_meta_preinsert(ilist, where,
+                                 XINST_CREATE_jump(drcontext, opnd_create_instr(done)));
+        instrlist_meta_preinsert(ilist, where, next);
+    }
+    instrlist_meta_preinsert(ilist, where, done);
+    drwrap_inline_unreserve(drcontext, ilist, where, reg, true);
+}
+#endif /* !RISCV64 */
+
+/* Inserts inline wrapping instrumentation for inst at where. */
+static void
+drwrap_inline_insert(void *drcontext, instrlist_t *ilist, instr_t *inst, instr_t *where,
+                     app_pc pc, bool cleanup_only)
+{
+#ifndef RISCV64
+    inline_site_t *sites =
+        (inline_site_t *)lf_index_lookup(&inline_site_index, instr_get_app_pc(inst));
+    inline_wrap_t *iw;
+    /* A return lands before anything at the site executes, so its post handlers go
+     * first.
+     */
+    if (sites != NULL)
+        drwrap_inline_insert_post(drcontext, ilist, where, sites, cleanup_only);
+    iw = (inline_wrap_t *)lf_index_lookup(&inline_wrap_index, pc);
+    if (iw != NULL && iw->enabled && !cleanup_only)
+        drwrap_inline_insert_pre(drcontext, ilist, where, iw);
+    if (instr_is_call(inst) && instr_is_app(inst) && opnd_is_pc(instr_get_target(inst))) {
+        app_pc target = dr_app_pc_as_jump_target(instr_get_isa_mode(inst),
+                                                 opnd_get_pc(instr_get_target(inst)));
+        iw = (inline_wrap_t *)lf_index_lookup(&inline_wrap_index, target);
+        if (iw != NULL && iw->post_insert != NULL) {
+            dr_mutex_lock(inline_lock);
+            drwrap_inline_add_site(iw, instr_get_app_pc(inst) +
+                                       instr_length(drcontext, inst));
+            dr_mutex_unlock(inline_lock);
+        }
+    }
+#endif
+}
+
+DR_EXPORT
+bool
+drwrap_wrap_inline(app_pc func, drwrap_inline_insert_cb_t pre_insert,
+                   drwrap_inline_insert_cb_t post_insert,
+                   void (*pre_func_cb)(void *wrapcxt, DR_PARAM_INOUT void **user_data),
+                   void (*post_func_cb)(void *wrapcxt, void *user_data), void *user_data,
+                   uint flags)
+{
+    inline_wrap_t *iw;
+    bool flush;
+
+    if (func == NULL)
+        return false;
+    if (!TEST(DRWRAP_INLINE_HANDLERS, global_flags) || IF_RISCV64_ELSE(true, false) ||
+        TESTANY(DRWRAP_UNWIND_ON_EXCEPTION | DRWRAP_REPLACE_RETADDR, flags) ||
+        (pre_insert == NULL && post_insert == NULL)) {
+        NOTIFY(2, "%s: using the clean-call path for " PFX "\n", __FUNCTION__, func);
+        return drwrap_wrap_ex(func, pre_func_cb, post_func_cb, user_data, flags);
+    }
+
+    dr_mutex_lock(inline_lock);
+    iw = (inline_wrap_t *)lf_index_lookup(&inline_wrap_index, func);
+    if (iw != NULL) {
+        if (iw->pre_insert != pre_insert || iw->post_insert != post_insert) {
+            dr_mutex_unlock(inline_lock);
+            return false;
+        }
+        /* Re-enabling requires re-instrumenting the entry. */
+        flush = !iw->enabled;
+    } else {
+        iw = (inline_wrap_t *)dr_global_alloc(sizeof(*iw));
+        memset(iw, 0, sizeof(*iw));
+        iw->func = func;
+        iw->pre_insert = pre_insert;
+        iw->post_insert = post_insert;
+        iw->id = ++inline_next_id;
+        iw->next_all = inline_wrap_list;
+        inline_wrap_list = iw;
+        flush = true;
+    }
+    iw->user_data = user_data;
+    iw->flags = EXCLUDE_CALLCONV(flags);
+    iw->callconv = EXTRACT_CALLCONV(flags);
+    if (iw->callconv == 0)
+        iw->callconv = DRWRAP_CALLCONV_DEFAULT;
+    iw->enabled = true;
+    /* Publish only once initialized. */
+    lf_index_set(&inline_wrap_index, func, iw);
+    /* XXX: we're assuming void* tag == pc */
+    flush = flush && dr_fragment_exists_at(dr_get_current_drcontext(), func);
+    dr_mutex_unlock(inline_lock);
+    if (flush)
+        drwrap_flush_func(func);
+    return true;
+}
+
+DR_EXPORT
+bool
+drwrap_unwrap_inline(app_pc func, drwrap_inline_insert_cb_t pre_insert,
+                     drwrap_inline_insert_cb_t post_insert,
+                     void (*pre_func_cb)(void *wrapcxt, DR_PARAM_OUT void **user_data),
+                     void (*post_func_cb)(void *wrapcxt, void *user_data))
+{
+    inline_wrap_t *iw;
+    bool found = false;
+
+    if (func == NULL)
+        return false;
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags)) {
+        dr_mutex_lock(inline_lock);
+        iw = (inline_wrap_t *)lf_index_lookup(&inline_wrap_index, func);
+        if (iw != NULL && iw->enabled && iw->pre_insert == pre_insert &&
+            iw->post_insert == post_insert) {
+            /* Post-call sites keep their code: the active id is no longer set
+             * for this request once the entry is flushed.
+             */
+            iw->enabled = false;
+            found = true;
+        }
+        dr_mutex_unlock(inline_lock);
+        if (found) {
+            drwrap_flush_func(func);
+            return true;
+        }
+    }
+    return drwrap_unwrap(func, pre_func_cb, post_func_cb);
+}
+
 /***************************************************************************
  * FUNCTION WRAPPING
  */
@@ -1953,6 +2864,12 @@ drwrap_ensure_postcall(void *drcontext, per_thread_t *pt, wrap_entry_t *wrap,
         if (retaddr == postcall_cache[i])
             return;
     }
+    /* The cache is small and shared, so with many threads and call sites it
+     * misses often.  Known sites are then found in the index rather than by
+     * taking the write lock below.
+     */
+    if (lf_index_lookup(&post_call_index, retaddr) != NULL)
+        return;
 
     /* to write to the cache we need a write lock */
     dr_rwlock_write_lock(post_call_rwlock);
@@ -2281,11 +3198,13 @@ drwrap_after_callee_func(void *drcontext, per_thread_t *pt, dr_mcontext_t *mc, i
                                  * let's flush it
                                  */
                                 drvector_append(&toflush, (void *)wrap->func);
+                                lf_index_remove(&wrap_index, wrap->func);
                                 hashtable_remove(&wrap_table, (void *)wrap->func);
                                 wrap = NULL; /* don't double-free */
                             } else {
                                 hashtable_add_replace(&wrap_table, (void *)wrap->func,
                                                       (void *)next);
+                                lf_index_set(&wrap_index, wrap->func, next);
                             }
                         } else
                             prev->next = next;
@@ -2451,9 +3370,16 @@ drwrap_event_bb_insert_where(void *drcontext, void *tag, instrlist_t *bb, instr_
          * call instruction, and additionally record the actual retaddr when in the
          * callee. By doing both we minimize flushes from the return point having already
          * been reached before the callee hook can mark it.
+         * The index lets us skip wrap_lock for the vast majority of instructions,
+         * which are not wrapped.
          */
-        dr_recurlock_lock(wrap_lock);
-        wrap = hashtable_lookup(&wrap_table, (void *)pc);
+        bool locked = false;
+        wrap = NULL;
+        if (lf_index_lookup(&wrap_index, pc) != NULL) {
+            dr_recurlock_lock(wrap_lock);
+            locked = true;
+            wrap = hashtable_lookup(&wrap_table, (void *)pc);
+        }
         if (wrap != NULL) {
             void *arg1 = TEST(DRWRAP_NO_FRILLS, global_flags) ? (void *)wrap : (void *)pc;
             /* i#690: do not bother saving registers that should be scratch at
@@ -2474,9 +3400,13 @@ drwrap_event_bb_insert_where(void *drcontext, void *tag, instrlist_t *bb, instr_
                 opnd_create_reg(DR_REG_XSP) _IF_AARCHXX_OR_RISCV64(
                     opnd_create_reg(IF_AARCHXX_ELSE(DR_REG_LR, DR_REG_RA))));
         }
-        dr_recurlock_unlock(wrap_lock);
+        if (locked)
+            dr_recurlock_unlock(wrap_lock);
     }
 
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags))
+        drwrap_inline_insert(drcontext, bb, inst, where, pc, cleanup_only);
+
     if (post_call_lookup_for_instru(instr_get_app_pc(inst) /*normalized*/)) {
         drwrap_insert_post_call(drcontext, bb, where, pc, cleanup_only);
     }
@@ -2501,11 +3431,14 @@ drwrap_event_bb_insert_where(void *drcontext, void *tag, instrlist_t *bb, instr_
     if (instr_is_call(inst) && instr_is_app(inst) && opnd_is_pc(instr_get_target(inst))) {
         app_pc target = dr_app_pc_as_jump_target(instr_get_isa_mode(inst),
                                                  opnd_get_pc(instr_get_target(inst)));
-        dr_recurlock_lock(wrap_lock);
-        wrap = hashtable_lookup(&wrap_table, (void *)target);
-        bool add_post = wrap != NULL && wrap->post_cb != NULL &&
-            !TEST(DRWRAP_REPLACE_RETADDR, wrap->flags);
-        dr_recurlock_unlock(wrap_lock);
+        bool add_post = false;
+        if (lf_index_lookup(&wrap_index, target) != NULL) {
+            dr_recurlock_lock(wrap_lock);
+            wrap = hashtable_lookup(&wrap_table, (void *)target);
+            add_post = wrap != NULL && wrap->post_cb != NULL &&
+                !TEST(DRWRAP_REPLACE_RETADDR, wrap->flags);
+            dr_recurlock_unlock(wrap_lock);
+        }
         if (add_post) {
             /* Add the pc-as-load-target (so *not* "pc"). */
             dr_rwlock_write_lock(post_call_rwlock);
@@ -2537,12 +3470,15 @@ drwrap_event_module_unload(void *drcontext, const module_data_t *info)
     NOTIFY(2, "%s: removing %p..%p\n", __FUNCTION__, info->start, info->end);
     dr_rwlock_write_lock(post_call_rwlock);
     hashtable_remove_range(&post_call_table, (void *)info->start, (void *)info->end);
+    lf_index_remove_range(&post_call_index, info->start, info->end);
     /* Invalidate cache. */
     for (int i = 0; i < POSTCALL_CACHE_SIZE; i++) {
         if (postcall_cache[i] >= info->start && postcall_cache[i] < info->end)
             postcall_cache[i] = NULL;
     }
     dr_rwlock_write_unlock(post_call_rwlock);
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags))
+        drwrap_inline_module_unload(info);
 
     /* XXX: It's arguable whether we should remove from replace_table,
      * replace_native_table, and wrap_table: we could expect the client to un-replace
@@ -2686,9 +3622,11 @@ drwrap_wrap_ex(app_pc func,
         }
         wrap_new->next = wrap_cur;
         hashtable_add_replace(&wrap_table, (void *)func, (void *)wrap_new);
+        lf_index_set(&wrap_index, func, wrap_new);
     } else {
         wrap_new->next = NULL;
         hashtable_add(&wrap_table, (void *)func, (void *)wrap_new);
+        lf_index_set(&wrap_index, func, wrap_new);
         /* XXX: we're assuming void* tag == pc */
         if (dr_fragment_exists_at(dr_get_current_drcontext(), func)) {
             dr_atomic_add_stat_return_sum(&drwrap_stats.flush_count, 1);
@@ -2750,6 +3688,8 @@ drwrap_is_wrapped(app_pc func,
 
     if (func == NULL || (pre_func_cb == NULL && post_func_cb == NULL))
         return false;
+    if (lf_index_lookup(&wrap_index, func) == NULL)
+        return false;
 
     dr_recurlock_lock(wrap_lock);
     wrap = hashtable_lookup(&wrap_table, (void *)func);
@@ -2768,13 +3708,12 @@ DR_EXPORT
 bool
 drwrap_is_post_wrap(app_pc pc)
 {
-    bool res = false;
     if (pc == NULL)
         return false;
-    dr_rwlock_read_lock(post_call_rwlock);
-    res = (hashtable_lookup(&post_call_table, (void *)pc) != NULL);
-    dr_rwlock_read_unlock(post_call_rwlock);
-    return res;
+    if (TEST(DRWRAP_INLINE_HANDLERS, global_flags) &&
+        lf_index_lookup(&inline_site_index, pc) != NULL)
+        return true;
+    return lf_index_lookup(&post_call_index, pc) != NULL;
 }
 
 DR_EXPORT
@@ -838,6 +838,13 @@ typedef enum {
      * use that requires drwrap_replace().
      */
     DRWRAP_INVERT_CONTROL = 0x10,
+    /**
+     * This flag must only be set before calling drwrap_init().  If set, drwrap
+     * initializes the drreg extension and allocates raw thread-local storage slots so
+     * that drwrap_wrap_inline() can emit its handlers directly into the code cache.
+     * Without this flag, drwrap_wrap_inline() always uses its clean-call fallback.
+     */
+    DRWRAP_INLINE_HANDLERS = 0x20,
 } drwrap_global_flags_t;
 
 DR_EXPORT
@@ -869,6 +876,125 @@ DR_EXPORT
 bool
 drwrap_is_post_wrap(app_pc pc);
 
+/***************************************************************************
+ * INLINE WRAPPING
+ */
+
+/** The number of arguments whose locations are provided in #drwrap_inline_info_t. */
+#define DRWRAP_INLINE_MAX_ARGS 6
+
+/** The number of scratch registers provided in #drwrap_inline_info_t. */
+#define DRWRAP_INLINE_SCRATCH_REGS 2
+
+/**
+ * Describes the state available to an inline handler registered with
+ * drwrap_wrap_inline().
+ */
+typedef struct _drwrap_inline_info_t {
+    /** The wrapped function, as passed to drwrap_wrap_inline(). */
+    app_pc func;
+    /** The \p user_data passed to drwrap_wrap_inline(). */
+    void *user_data;
+    /**
+     * For a pre-function handler, the location of each of the first
+     * #DRWRAP_INLINE_MAX_ARGS arguments according to the calling convention
+     * passed to drwrap_wrap_inline(): either an application register holding its
+     * application value, which must not be written, or a stack-pointer-relative
+     * memory operand.  For a post-function handler, each entry is a null operand.
+     */
+    opnd_t arg[DRWRAP_INLINE_MAX_ARGS];
+    /**
+     * For a post-function handler, a scratch register holding a copy of the
+     * function's pointer-sized integer return value.  For a pre-function handler,
+     * a null operand.
+     */
+    opnd_t retval;
+    /**
+     * A pointer-sized thread-local memory slot which the handlers may use as they
+     * wish, such as to pass a value from the pre-function handler to the
+     * post-function handler.  The slot is shared by all inline wraps.  On ARM and
+     * AArch64 it can only be accessed via a load or store instruction.
+     */
+    opnd_t scratch_slot;
+    /**
+     * Registers which the handler may clobber.  The arithmetic flags may be
+     * clobbered as well.
+     */
+    reg_id_t scratch_reg[DRWRAP_INLINE_SCRATCH_REGS];
+} drwrap_inline_info_t;
+
+/**
+ * An inline handler registered with drwrap_wrap_inline().  It is invoked during
+ * drmgr's insertion phase and should insert meta instructions prior to \p where
+ * in \p ilist.  The inserted code must not reserve further registers through drreg,
+ * must not change the stack pointer, and must fall through to \p where.
+ */
+typedef void (*drwrap_inline_insert_cb_t)(void *drcontext, instrlist_t *ilist,
+                                          instr_t *where,
+                                          const drwrap_inline_info_t *info);
+
+DR_EXPORT
+/**
+ * Wraps the function \p func with handlers that are emitted inline into the code
+ * cache, avoiding the clean calls and full machine context switches of
+ * drwrap_wrap_ex().  This is intended for small, frequently-called functions whose
+ * instrumentation only needs the arguments and return value, such as recording
+ * them into a trace buffer.
+ *
+ * \p pre_insert is invoked when instrumenting the first instruction of \p func,
+ * and \p post_insert when instrumenting each return point of \p func, to insert
+ * code that runs at those points.  Either may be NULL.  The code inserted by
+ * \p post_insert only runs when returning from \p func: if another inline-wrapped
+ * function with a post-function handler is entered before \p func returns, the
+ * post-function code for \p func is skipped.  Inline post-function handlers thus
+ * do not nest, and are not invoked when \p func exits without returning, such as
+ * via longjmp or an exception.
+ *
+ * The inline path requires #DRWRAP_INLINE_HANDLERS.  If that flag was not set, if
+ * \p flags contain #DRWRAP_UNWIND_ON_EXCEPTION or #DRWRAP_REPLACE_RETADDR, if \p
+ * pre_insert and \p post_insert are both NULL, or on RISC-V, this routine instead
+ * calls drwrap_wrap_ex() with \p pre_func_cb, \p post_func_cb, \p user_data, and
+ * \p flags, and fails if those callbacks are both NULL; otherwise those callbacks
+ * are not used.  Clients needing the machine context, argument modification,
+ * drwrap_skip_call(), or unwinding should use drwrap_wrap_ex() directly.
+ *
+ * Only one inline wrap request per function is supported.  A second request for
+ * the same \p func fails unless it passes the same \p pre_insert and \p
+ * post_insert, in which case it re-enables a prior request.  Just like
+ * drwrap_wrap_ex(), wrapping should occur prior to the execution of \p func.
+ *
+ * This routine may call dr_unlink_flush_region(), which means that it
+ * cannot be called while any locks are held that could block a thread
+ * processing a registered event callback or cache callout.
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_wrap_inline(app_pc func, drwrap_inline_insert_cb_t pre_insert,
+                   drwrap_inline_insert_cb_t post_insert,
+                   void (*pre_func_cb)(void *wrapcxt, DR_PARAM_INOUT void **user_data),
+                   void (*post_func_cb)(void *wrapcxt, void *user_data),
+                   void *user_data, uint flags);
+
+DR_EXPORT
+/**
+ * Removes a request made by drwrap_wrap_inline() with the same parameters.  If
+ * the request fell back to drwrap_wrap_ex(), this calls drwrap_unwrap() with \p
+ * pre_func_cb and \p post_func_cb.  Post-function code already emitted for
+ * calls in progress may still run.
+ *
+ * This routine may call dr_unlink_flush_region(), which means that it
+ * cannot be called while any locks are held that could block a thread
+ * processing a registered event callback or cache callout.
+ *
+ * \return whether successful.
+ */
+bool
+drwrap_unwrap_inline(app_pc func, drwrap_inline_insert_cb_t pre_insert,
+                     drwrap_inline_insert_cb_t post_insert,
+                     void (*pre_func_cb)(void *wrapcxt, DR_PARAM_OUT void **user_data),
+                     void (*post_func_cb)(void *wrapcxt, void *user_data));
+
 /** An integer sized for support by dr_atomic_addX_return_sum(). */
 typedef ptr_int_t atomic_int_t;
 
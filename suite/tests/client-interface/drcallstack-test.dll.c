@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2013-2021 Google, Inc.  All rights reserved.
+ * Copyright (c) 2013-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -73,17 +73,32 @@ wrap_pre(void *wrapcxt, DR_PARAM_OUT void **user_data)
         sizeof(frame),
     };
     int count = 0;
+#define MAX_FRAMES 64
+    app_pc pcs[MAX_FRAMES];
     print_qualified_function_name(drwrap_get_func(wrapcxt));
     do {
         res = drcallstack_next_frame(walk, &frame);
         if (res != DRCALLSTACK_SUCCESS)
             break;
         print_qualified_function_name(frame.pc);
+        if (count < MAX_FRAMES)
+            pcs[count] = frame.pc;
         ++count;
     } while (res == DRCALLSTACK_SUCCESS);
     DR_ASSERT(res == DRCALLSTACK_NO_MORE_FRAMES);
     res = drcallstack_cleanup_walk(walk);
     DR_ASSERT(res == DRCALLSTACK_SUCCESS);
+
+    /* A capture should find the same frames, whether from the shadow stack
+     * (validated against libunwind) or from libunwind.
+     */
+    drcallstack_sample_frame_t frames[MAX_FRAMES];
+    size_t num_frames = MAX_FRAMES;
+    res = drcallstack_capture(mc, frames, &num_frames);
+    DR_ASSERT(res == DRCALLSTACK_SUCCESS);
+    DR_ASSERT(num_frames > 0);
+    for (int i = 0; i < count && i < (int)num_frames; i++)
+        DR_ASSERT(frames[i].pc == pcs[i]);
 }
 
 static void
@@ -106,6 +121,10 @@ dr_init(client_id_t id)
     drcallstack_options_t ops = {
         sizeof(ops),
     };
+    ops.flags = DRCALLSTACK_CACHE_UNWIND_INFO;
+#if defined(X86) || defined(AARCH64)
+    ops.flags |= DRCALLSTACK_SHADOW_STACK | DRCALLSTACK_SHADOW_VALIDATE;
+#endif
     if (!drwrap_init() || drcallstack_init(&ops) != DRCALLSTACK_SUCCESS ||
         drsym_init(0) != DRSYM_SUCCESS)
         DR_ASSERT(false);
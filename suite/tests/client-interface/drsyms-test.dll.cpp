@@ -1,5 +1,5 @@
 /* **********************************************************
- * Copyright (c) 2011-2023 Google, Inc.  All rights reserved.
+ * Copyright (c) 2011-2025 Google, Inc.  All rights reserved.
  * **********************************************************/
 
 /*
@@ -560,6 +560,78 @@ test_line_iteration(const module_data_t *dll_data)
         dr_fprintf(STDERR, "found tools.h\n");
 }
 
+#ifdef UNIX
+#    define MAX_INDEXED_LINES 64
+
+typedef struct {
+    size_t addrs[MAX_INDEXED_LINES];
+    int count;
+} line_addrs_t;
+
+static bool
+collect_line_addr_cb(drsym_line_info_t *info, void *data)
+{
+    line_addrs_t *lines = (line_addrs_t *)data;
+    if (info->file == NULL)
+        return true;
+    /* Also probe just past each line start for a nonzero line_offs. */
+    lines->addrs[lines->count++] = info->line_addr;
+    lines->addrs[lines->count++] = info->line_addr + 1;
+    return lines->count < MAX_INDEXED_LINES;
+}
+
+/* Checks that line lookups through the sorted line index match the results of
+ * searching the DWARF line tables.
+ */
+static void
+test_line_index(const char *dll_path)
+{
+    static line_addrs_t lines;
+    static char file[MAX_INDEXED_LINES][MAXIMUM_PATH];
+    static drsym_info_t expect[MAX_INDEXED_LINES];
+    static drsym_error_t expect_res[MAX_INDEXED_LINES];
+    char name[MAX_FUNC_LEN];
+    char index_file[MAXIMUM_PATH];
+    drsym_info_t info;
+    drsym_error_t res;
+    int i;
+
+    lines.count = 0;
+    res = drsym_enumerate_lines(dll_path, collect_line_addr_cb, &lines);
+    ASSERT(res == DRSYM_SUCCESS && lines.count > 0);
+    for (i = 0; i < lines.count; i++) {
+        expect[i].struct_size = sizeof(expect[i]);
+        expect[i].name = name;
+        expect[i].name_size = BUFFER_SIZE_ELEMENTS(name);
+        expect[i].file = file[i];
+        expect[i].file_size = BUFFER_SIZE_ELEMENTS(file[i]);
+        expect_res[i] = drsym_lookup_address(dll_path, lines.addrs[i], &expect[i],
+                                             DRSYM_DEFAULT_FLAGS);
+    }
+    drsym_free_resources(dll_path);
+
+    res = drsym_enable_line_index(true, NULL);
+    ASSERT(res == DRSYM_SUCCESS);
+    for (i = 0; i < lines.count; i++) {
+        info.struct_size = sizeof(info);
+        info.name = name;
+        info.name_size = BUFFER_SIZE_ELEMENTS(name);
+        info.file = index_file;
+        info.file_size = BUFFER_SIZE_ELEMENTS(index_file);
+        res = drsym_lookup_address(dll_path, lines.addrs[i], &info, DRSYM_DEFAULT_FLAGS);
+        ASSERT(res == expect_res[i]);
+        if (res != DRSYM_SUCCESS)
+            continue;
+        ASSERT(info.line == expect[i].line);
+        ASSERT(info.line_offs == expect[i].line_offs);
+        ASSERT(strcmp(info.file, expect[i].file) == 0);
+    }
+    res = drsym_enable_line_index(false, NULL);
+    ASSERT(res == DRSYM_SUCCESS);
+    drsym_free_resources(dll_path);
+}
+#endif
+
 /* Lookup symbols in the appdll and wrap them. */
 static void
 lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
@@ -631,6 +703,9 @@ lookup_dll_syms(void *dc, const module_data_t *dll_data, bool loaded)
     check_enumerate_dll_syms(dll_path);
 
     test_line_iteration(dll_data);
+#ifdef UNIX
+    test_line_index(dll_path);
+#endif
 
     drsym_free_resources(dll_path);
 }
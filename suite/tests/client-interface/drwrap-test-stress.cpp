@@ -0,0 +1,280 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of VMware, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Stress test and benchmark for drwrap with many threads calling wrapped
+ * functions.  One function is only ever called directly, so its post-call site
+ * is recorded when the call is instrumented; the other is only called through
+ * a pointer, so its post-call site is found from the return address at runtime.
+ *
+ * With no arguments this runs a fixed configuration as a test.  Pass
+ * "<threads> <calls_per_thread>" to use it as a benchmark: the wall-clock time
+ * of the threads' loops is then printed.
+ *
+ * When built with TEST_INLINE_HANDLERS the functions are wrapped with
+ * drwrap_wrap_inline().  Its handlers call out to check the arguments, the return
+ * value, and the scratch slot, so that variant's timing includes those clean calls.
+ */
+
+/* XXX: We undef this b/c it's easier than getting rid of from CMake with the
+ * global cflags config where all the other tests want this set.
+ */
+#undef DR_REG_ENUM_COMPATIBILITY
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdlib.h>
+#include "configure.h"
+#include "dr_api.h"
+#include "drwrap.h"
+#include "tools.h"
+#include "thread.h"
+
+#define DEFAULT_THREADS 16
+#define DEFAULT_CALLS_PER_THREAD 20000
+#define MAX_THREADS 1024
+
+static int num_threads = DEFAULT_THREADS;
+static int calls_per_thread = DEFAULT_CALLS_PER_THREAD;
+static std::atomic<int64> pre_count;
+static std::atomic<int64> post_count;
+
+extern "C" { /* Make it easy to get the name across platforms. */
+EXPORT void *NOINLINE
+wrapped_alloc(size_t size)
+{
+    static char buf[64];
+    /* Avoid the calls getting optimized away. */
+    return size < sizeof(buf) ? buf : nullptr;
+}
+
+EXPORT void NOINLINE
+wrapped_free(void *ptr)
+{
+    if (ptr == nullptr)
+        print("That's weird.\n");
+}
+}
+
+/* Called through a pointer so there is no direct call to the function. */
+static void (*volatile free_func)(void *) = wrapped_free;
+
+THREAD_FUNC_RETURN_TYPE
+thread_func(void *arg)
+{
+    for (int i = 0; i < calls_per_thread; ++i) {
+        void *ptr = wrapped_alloc(i % 32);
+        (*free_func)(ptr);
+    }
+    return THREAD_FUNC_RETURN_ZERO;
+}
+
+#ifdef TEST_INLINE_HANDLERS
+static void
+inline_pre_alloc(ptr_uint_t size)
+{
+    if (size >= 32)
+        dr_fprintf(STDERR, "wrong alloc argument %d\n", (int)size);
+    pre_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+inline_post_alloc(void *retval)
+{
+    if (retval == nullptr)
+        dr_fprintf(STDERR, "wrong alloc return value\n");
+    post_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+inline_pre_free(void *ptr, void *last_alloc)
+{
+    if (ptr != last_alloc)
+        dr_fprintf(STDERR, "free argument does not match the scratch slot\n");
+    pre_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+inline_post_free()
+{
+    post_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+insert_load_arg(void *drcontext, instrlist_t *ilist, instr_t *where, reg_id_t dst,
+                opnd_t arg)
+{
+    if (opnd_is_reg(arg)) {
+        instrlist_meta_preinsert(
+            ilist, where, XINST_CREATE_move(drcontext, opnd_create_reg(dst), arg));
+    } else {
+        instrlist_meta_preinsert(
+            ilist, where, XINST_CREATE_load(drcontext, opnd_create_reg(dst), arg));
+    }
+}
+
+static void
+insert_pre_alloc(void *drcontext, instrlist_t *ilist, instr_t *where,
+                 const drwrap_inline_info_t *info)
+{
+    insert_load_arg(drcontext, ilist, where, info->scratch_reg[0], info->arg[0]);
+    dr_insert_clean_call(drcontext, ilist, where, (void *)inline_pre_alloc, false, 1,
+                         opnd_create_reg(info->scratch_reg[0]));
+}
+
+static void
+insert_post_alloc(void *drcontext, instrlist_t *ilist, instr_t *where,
+                  const drwrap_inline_info_t *info)
+{
+    /* Pass the result to the pre handler of the free that follows in this thread. */
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_store(drcontext, info->scratch_slot,
+                                                info->retval));
+    dr_insert_clean_call(drcontext, ilist, where, (void *)inline_post_alloc, false, 1,
+                         info->retval);
+}
+
+static void
+insert_pre_free(void *drcontext, instrlist_t *ilist, instr_t *where,
+                const drwrap_inline_info_t *info)
+{
+    insert_load_arg(drcontext, ilist, where, info->scratch_reg[0], info->arg[0]);
+    instrlist_meta_preinsert(ilist, where,
+                             XINST_CREATE_load(drcontext,
+                                               opnd_create_reg(info->scratch_reg[1]),
+                                               info->scratch_slot));
+    dr_insert_clean_call(drcontext, ilist, where, (void *)inline_pre_free, false, 2,
+                         opnd_create_reg(info->scratch_reg[0]),
+                         opnd_create_reg(info->scratch_reg[1]));
+}
+
+static void
+insert_post_free(void *drcontext, instrlist_t *ilist, instr_t *where,
+                 const drwrap_inline_info_t *info)
+{
+    dr_insert_clean_call(drcontext, ilist, where, (void *)inline_post_free, false, 0);
+}
+#else
+static void
+wrap_pre(void *wrapcxt, DR_PARAM_OUT void **user_data)
+{
+    pre_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+wrap_post(void *wrapcxt, void *user_data)
+{
+    post_count.fetch_add(1, std::memory_order_relaxed);
+}
+#endif
+
+static void
+event_exit(void)
+{
+    int64 expect = 2 * (int64)num_threads * calls_per_thread;
+    if (pre_count.load() != expect || post_count.load() != expect) {
+        dr_fprintf(STDERR, "count mismatch: pre=%lld post=%lld expected=%lld\n",
+                   (long long)pre_count.load(), (long long)post_count.load(),
+                   (long long)expect);
+    }
+    drwrap_exit();
+    dr_fprintf(STDERR, "client done\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    std::cerr << "in dr_client_main\n";
+    dr_register_exit_event(event_exit);
+#ifdef TEST_INLINE_HANDLERS
+    drwrap_set_global_flags(DRWRAP_INLINE_HANDLERS);
+#endif
+    drwrap_init();
+
+    module_data_t *module = dr_get_main_module();
+    app_pc pc = (app_pc)dr_get_proc_address(module->handle, "wrapped_alloc");
+#ifdef TEST_INLINE_HANDLERS
+    bool ok = drwrap_wrap_inline(pc, insert_pre_alloc, insert_post_alloc, nullptr,
+                                 nullptr, nullptr, 0);
+    assert(ok);
+    pc = (app_pc)dr_get_proc_address(module->handle, "wrapped_free");
+    ok = drwrap_wrap_inline(pc, insert_pre_free, insert_post_free, nullptr, nullptr,
+                            nullptr, 0);
+    assert(ok);
+#else
+    bool ok = drwrap_wrap(pc, wrap_pre, wrap_post);
+    assert(ok);
+    assert(drwrap_is_wrapped(pc, wrap_pre, wrap_post));
+    pc = (app_pc)dr_get_proc_address(module->handle, "wrapped_free");
+    ok = drwrap_wrap(pc, wrap_pre, wrap_post);
+    assert(ok);
+#endif
+    dr_free_module_data(module);
+}
+
+int
+main(int argc, const char *argv[])
+{
+    bool benchmark = false;
+    if (argc == 3) {
+        num_threads = atoi(argv[1]);
+        calls_per_thread = atoi(argv[2]);
+        benchmark = true;
+        if (num_threads <= 0 || num_threads > MAX_THREADS || calls_per_thread <= 0) {
+            std::cerr << "usage: " << argv[0] << " [<threads> <calls_per_thread>]\n";
+            return 1;
+        }
+    }
+    if (!my_setenv("DYNAMORIO_OPTIONS", "-stderr_mask 0xc -client_lib ';;'"))
+        std::cerr << "failed to set env var!\n";
+
+    static thread_t threads[MAX_THREADS];
+    dr_app_setup_and_start();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_threads; ++i)
+        threads[i] = create_thread(thread_func, nullptr);
+    for (int i = 0; i < num_threads; ++i)
+        join_thread(threads[i]);
+    auto end = std::chrono::steady_clock::now();
+    dr_app_stop_and_cleanup();
+
+    if (benchmark) {
+        std::cerr << num_threads << " threads x " << calls_per_thread
+                  << " wrapped call pairs: "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                         .count()
+                  << " ms\n";
+    }
+    print("app done\n");
+    return 0;
+}
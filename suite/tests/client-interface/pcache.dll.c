@@ -32,6 +32,7 @@
 
 #include "dr_api.h"
 #include "hashtable.h"
+#include <string.h>
 
 #include "client_tools.h" /* For ASSERT; DR_ASSERT raises a message box. */
 
@@ -39,6 +40,9 @@ static byte *mybase;
 static uint bb_execs;
 static uint resurrect_success;
 static bool verbose;
+/* With -app_only we only count pcaches of the application module. */
+static bool app_only;
+static app_pc app_start, app_end;
 
 /* test hashtable persistence via a table that contains one entry per
  * pcache written or loaded.  key is start, payload is size.
@@ -163,7 +167,8 @@ event_resurrect_ro(void *drcontext, void *perscxt, byte **map DR_PARAM_OUT)
         }
     }
 
-    resurrect_success++;
+    if (!app_only || (start >= app_start && start < app_end))
+        resurrect_success++;
     return true;
 }
 
@@ -224,6 +229,13 @@ void
 dr_init(client_id_t id)
 {
     mybase = dr_get_client_base(id);
+    app_only = strcmp(dr_get_options(id), "-app_only") == 0;
+    if (app_only) {
+        module_data_t *exe = dr_get_main_module();
+        app_start = exe->start;
+        app_end = exe->end;
+        dr_free_module_data(exe);
+    }
     dr_fprintf(STDERR, "thank you for testing the client interface\n");
     dr_register_exit_event(event_exit);
     dr_register_bb_event(event_bb);
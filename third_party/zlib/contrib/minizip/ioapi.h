@@ -0,0 +1,8 @@
+/* Local build shim standing in for zlib's contrib/minizip (not the real minizip). */
+#ifndef _ZLIBIOAPI64_H
+#define _ZLIBIOAPI64_H
+#include <stdint.h>
+#include "zlib.h"
+typedef uint64_t ZPOS64_T;
+typedef struct zlib_filefunc64_def_s zlib_filefunc64_def;
+#endif
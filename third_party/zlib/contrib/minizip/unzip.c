@@ -0,0 +1,344 @@
+/* Local build shim standing in for zlib's contrib/minizip (not the real minizip).
+ * Reads non-zip64 archives with stored or deflated members.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unzip.h"
+
+typedef struct {
+    ZPOS64_T cd_pos; /* absolute offset of the central directory entry */
+    uLong method, crc, flag, dosdate;
+    ZPOS64_T csize, usize, local_off;
+    char *name;
+    uLong name_len;
+    char *extra;
+    uLong extra_len;
+    char *comment;
+    uLong comment_len;
+} entry_t;
+
+typedef struct {
+    FILE *f;
+    entry_t *entries;
+    long num;
+    long cur; /* -1 if none */
+    /* Open member state. */
+    int open;
+    z_stream zs;
+    unsigned char inbuf[16384];
+    ZPOS64_T crem; /* compressed bytes left in file */
+    ZPOS64_T urem; /* uncompressed bytes left */
+    uLong crc;
+} unz_t;
+
+static uLong
+rd16(const unsigned char *p)
+{
+    return (uLong)p[0] | ((uLong)p[1] << 8);
+}
+
+static uLong
+rd32(const unsigned char *p)
+{
+    return rd16(p) | (rd16(p + 2) << 16);
+}
+
+unzFile
+unzOpen64(const void *path)
+{
+    return unzOpen((const char *)path);
+}
+
+unzFile
+unzOpen(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *tail;
+    long size, tail_size, i, eocd = -1;
+    unz_t *u;
+    ZPOS64_T cd_off, pos;
+    long num;
+    if (f == NULL)
+        return NULL;
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 22) {
+        fclose(f);
+        return NULL;
+    }
+    tail_size = size < 65557 ? size : 65557;
+    tail = (unsigned char *)malloc(tail_size);
+    fseek(f, size - tail_size, SEEK_SET);
+    if (fread(tail, 1, tail_size, f) != (size_t)tail_size) {
+        free(tail);
+        fclose(f);
+        return NULL;
+    }
+    for (i = tail_size - 22; i >= 0; i--) {
+        if (rd32(tail + i) == 0x06054b50) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        free(tail);
+        fclose(f);
+        return NULL;
+    }
+    num = (long)rd16(tail + eocd + 10);
+    cd_off = rd32(tail + eocd + 16);
+    free(tail);
+    u = (unz_t *)calloc(1, sizeof(*u));
+    u->f = f;
+    u->num = num;
+    u->cur = -1;
+    u->entries = (entry_t *)calloc(num > 0 ? num : 1, sizeof(entry_t));
+    pos = cd_off;
+    for (i = 0; i < num; i++) {
+        unsigned char h[46];
+        entry_t *e = &u->entries[i];
+        fseek(f, (long)pos, SEEK_SET);
+        if (fread(h, 1, 46, f) != 46 || rd32(h) != 0x02014b50) {
+            unzClose(u);
+            return NULL;
+        }
+        e->cd_pos = pos;
+        e->flag = rd16(h + 8);
+        e->method = rd16(h + 10);
+        e->dosdate = rd32(h + 12);
+        e->crc = rd32(h + 16);
+        e->csize = rd32(h + 20);
+        e->usize = rd32(h + 24);
+        e->name_len = rd16(h + 28);
+        e->extra_len = rd16(h + 30);
+        e->comment_len = rd16(h + 32);
+        e->local_off = rd32(h + 42);
+        e->name = (char *)calloc(1, e->name_len + 1);
+        e->extra = (char *)calloc(1, e->extra_len + 1);
+        e->comment = (char *)calloc(1, e->comment_len + 1);
+        if (fread(e->name, 1, e->name_len, f) != e->name_len ||
+            fread(e->extra, 1, e->extra_len, f) != e->extra_len ||
+            fread(e->comment, 1, e->comment_len, f) != e->comment_len) {
+            unzClose(u);
+            return NULL;
+        }
+        pos += 46 + e->name_len + e->extra_len + e->comment_len;
+    }
+    return u;
+}
+
+int
+unzClose(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    long i;
+    if (u == NULL)
+        return UNZ_PARAMERROR;
+    if (u->open)
+        unzCloseCurrentFile(file);
+    for (i = 0; i < u->num; i++) {
+        free(u->entries[i].name);
+        free(u->entries[i].extra);
+        free(u->entries[i].comment);
+    }
+    free(u->entries);
+    fclose(u->f);
+    free(u);
+    return UNZ_OK;
+}
+
+int
+unzGoToFirstFile(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    if (u == NULL)
+        return UNZ_PARAMERROR;
+    if (u->num == 0) {
+        u->cur = -1;
+        return UNZ_END_OF_LIST_OF_FILE;
+    }
+    u->cur = 0;
+    return UNZ_OK;
+}
+
+int
+unzGoToNextFile(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    if (u == NULL)
+        return UNZ_PARAMERROR;
+    if (u->cur < 0 || u->cur + 1 >= u->num)
+        return UNZ_END_OF_LIST_OF_FILE;
+    u->cur++;
+    return UNZ_OK;
+}
+
+int
+unzLocateFile(unzFile file, const char *name, int case_sensitive)
+{
+    unz_t *u = (unz_t *)file;
+    long i;
+    if (u == NULL || name == NULL)
+        return UNZ_PARAMERROR;
+    for (i = 0; i < u->num; i++) {
+        if ((case_sensitive == 1 ? strcmp(u->entries[i].name, name)
+                                 : strcasecmp(u->entries[i].name, name)) == 0) {
+            u->cur = i;
+            return UNZ_OK;
+        }
+    }
+    return UNZ_END_OF_LIST_OF_FILE;
+}
+
+static void
+copy_out(char *dst, uLong dst_size, const char *src, uLong src_len)
+{
+    uLong n;
+    if (dst == NULL || dst_size == 0)
+        return;
+    n = src_len < dst_size ? src_len : dst_size;
+    memcpy(dst, src, n);
+    if (src_len < dst_size)
+        dst[src_len] = '\0';
+}
+
+int
+unzGetCurrentFileInfo64(unzFile file, unz_file_info64 *info, char *name, uLong name_size,
+                        void *extra, uLong extra_size, char *comment, uLong comment_size)
+{
+    unz_t *u = (unz_t *)file;
+    entry_t *e;
+    if (u == NULL || u->cur < 0)
+        return UNZ_PARAMERROR;
+    e = &u->entries[u->cur];
+    if (info != NULL) {
+        memset(info, 0, sizeof(*info));
+        info->flag = e->flag;
+        info->compression_method = e->method;
+        info->dosDate = e->dosdate;
+        info->crc = e->crc;
+        info->compressed_size = e->csize;
+        info->uncompressed_size = e->usize;
+        info->size_filename = e->name_len;
+        info->size_file_extra = e->extra_len;
+        info->size_file_comment = e->comment_len;
+    }
+    copy_out(name, name_size, e->name, e->name_len);
+    if (extra != NULL && extra_size > 0)
+        memcpy(extra, e->extra, e->extra_len < extra_size ? e->extra_len : extra_size);
+    copy_out(comment, comment_size, e->comment, e->comment_len);
+    return UNZ_OK;
+}
+
+int
+unzOpenCurrentFile(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    unsigned char h[30];
+    entry_t *e;
+    if (u == NULL || u->cur < 0)
+        return UNZ_PARAMERROR;
+    if (u->open)
+        unzCloseCurrentFile(file);
+    e = &u->entries[u->cur];
+    if (e->method != 0 && e->method != Z_DEFLATED)
+        return UNZ_BADZIPFILE;
+    if (fseek(u->f, (long)e->local_off, SEEK_SET) != 0 || fread(h, 1, 30, u->f) != 30 ||
+        rd32(h) != 0x04034b50)
+        return UNZ_BADZIPFILE;
+    if (fseek(u->f, (long)(rd16(h + 26) + rd16(h + 28)), SEEK_CUR) != 0)
+        return UNZ_ERRNO;
+    memset(&u->zs, 0, sizeof(u->zs));
+    if (e->method == Z_DEFLATED && inflateInit2(&u->zs, -MAX_WBITS) != Z_OK)
+        return UNZ_INTERNALERROR;
+    u->crem = e->csize;
+    u->urem = e->usize;
+    u->crc = crc32(0L, Z_NULL, 0);
+    u->open = 1;
+    return UNZ_OK;
+}
+
+int
+unzReadCurrentFile(unzFile file, voidp buf, unsigned len)
+{
+    unz_t *u = (unz_t *)file;
+    entry_t *e;
+    unsigned done = 0;
+    if (u == NULL || !u->open)
+        return UNZ_PARAMERROR;
+    e = &u->entries[u->cur];
+    if (len > u->urem)
+        len = (unsigned)u->urem;
+    if (len == 0)
+        return 0;
+    if (e->method == 0) {
+        size_t n = fread(buf, 1, len, u->f);
+        if (n != len)
+            return UNZ_ERRNO;
+        done = len;
+        u->crem -= len;
+    } else {
+        u->zs.next_out = (Bytef *)buf;
+        u->zs.avail_out = len;
+        while (u->zs.avail_out > 0) {
+            int res;
+            if (u->zs.avail_in == 0 && u->crem > 0) {
+                size_t want = u->crem < sizeof(u->inbuf) ? (size_t)u->crem
+                                                         : sizeof(u->inbuf);
+                if (fread(u->inbuf, 1, want, u->f) != want)
+                    return UNZ_ERRNO;
+                u->crem -= want;
+                u->zs.next_in = u->inbuf;
+                u->zs.avail_in = (uInt)want;
+            }
+            res = inflate(&u->zs, Z_SYNC_FLUSH);
+            if (res == Z_STREAM_END)
+                break;
+            if (res != Z_OK)
+                return res == Z_DATA_ERROR ? Z_DATA_ERROR : UNZ_INTERNALERROR;
+        }
+        done = len - u->zs.avail_out;
+    }
+    u->urem -= done;
+    u->crc = crc32(u->crc, (const Bytef *)buf, done);
+    return (int)done;
+}
+
+int
+unzCloseCurrentFile(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    int res = UNZ_OK;
+    if (u == NULL || !u->open)
+        return UNZ_PARAMERROR;
+    if (u->urem == 0 && u->crc != u->entries[u->cur].crc)
+        res = UNZ_CRCERROR;
+    if (u->entries[u->cur].method == Z_DEFLATED)
+        inflateEnd(&u->zs);
+    u->open = 0;
+    return res;
+}
+
+ZPOS64_T
+unzGetOffset64(unzFile file)
+{
+    unz_t *u = (unz_t *)file;
+    if (u == NULL || u->cur < 0)
+        return 0;
+    return u->entries[u->cur].cd_pos;
+}
+
+int
+unzSetOffset64(unzFile file, ZPOS64_T pos)
+{
+    unz_t *u = (unz_t *)file;
+    long i;
+    if (u == NULL)
+        return UNZ_PARAMERROR;
+    for (i = 0; i < u->num; i++) {
+        if (u->entries[i].cd_pos == pos) {
+            u->cur = i;
+            return UNZ_OK;
+        }
+    }
+    return UNZ_BADZIPFILE;
+}
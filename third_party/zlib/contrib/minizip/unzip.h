@@ -0,0 +1,55 @@
+/* Local build shim standing in for zlib's contrib/minizip (not the real minizip). */
+#ifndef _unz64_H
+#define _unz64_H
+#include "ioapi.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef void *unzFile;
+#define UNZ_OK (0)
+#define UNZ_END_OF_LIST_OF_FILE (-100)
+#define UNZ_ERRNO (Z_ERRNO)
+#define UNZ_EOF (0)
+#define UNZ_PARAMERROR (-102)
+#define UNZ_BADZIPFILE (-103)
+#define UNZ_INTERNALERROR (-104)
+#define UNZ_CRCERROR (-105)
+typedef struct tm_unz_s {
+    int tm_sec, tm_min, tm_hour, tm_mday, tm_mon, tm_year;
+} tm_unz;
+typedef struct unz_file_info64_s {
+    uLong version;
+    uLong version_needed;
+    uLong flag;
+    uLong compression_method;
+    uLong dosDate;
+    uLong crc;
+    ZPOS64_T compressed_size;
+    ZPOS64_T uncompressed_size;
+    uLong size_filename;
+    uLong size_file_extra;
+    uLong size_file_comment;
+    uLong disk_num_start;
+    uLong internal_fa;
+    uLong external_fa;
+    tm_unz tmu_date;
+} unz_file_info64;
+unzFile unzOpen(const char *path);
+unzFile unzOpen64(const void *path);
+int unzClose(unzFile file);
+int unzGoToFirstFile(unzFile file);
+int unzGoToNextFile(unzFile file);
+int unzLocateFile(unzFile file, const char *szFileName, int iCaseSensitivity);
+int unzGetCurrentFileInfo64(unzFile file, unz_file_info64 *pfile_info,
+                            char *szFileName, uLong fileNameBufferSize, void *extraField,
+                            uLong extraFieldBufferSize, char *szComment,
+                            uLong commentBufferSize);
+int unzOpenCurrentFile(unzFile file);
+int unzReadCurrentFile(unzFile file, voidp buf, unsigned len);
+int unzCloseCurrentFile(unzFile file);
+ZPOS64_T unzGetOffset64(unzFile file);
+int unzSetOffset64(unzFile file, ZPOS64_T pos);
+#ifdef __cplusplus
+}
+#endif
+#endif
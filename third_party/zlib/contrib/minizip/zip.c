@@ -0,0 +1,228 @@
+/* Local build shim standing in for zlib's contrib/minizip (not the real minizip).
+ * Writes non-zip64 archives with stored or deflated members.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zip.h"
+
+typedef struct {
+    char *name;
+    char *comment;
+    uLong method, crc;
+    ZPOS64_T csize, usize, local_off;
+} zentry_t;
+
+typedef struct {
+    FILE *f;
+    zentry_t *entries;
+    long num, cap;
+    int open;
+    z_stream zs;
+    unsigned char outbuf[16384];
+} zip_t;
+
+static void
+wr16(unsigned char *p, uLong v)
+{
+    p[0] = (unsigned char)(v & 0xff);
+    p[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+static void
+wr32(unsigned char *p, uLong v)
+{
+    wr16(p, v & 0xffff);
+    wr16(p + 2, (v >> 16) & 0xffff);
+}
+
+zipFile
+zipOpen(const char *pathname, int append)
+{
+    return zipOpen2_64(pathname, append, NULL, NULL);
+}
+
+zipFile
+zipOpen2_64(const void *pathname, int append, const char **globalcomment,
+            zlib_filefunc64_def *funcs)
+{
+    zip_t *z;
+    FILE *f;
+    if (append != APPEND_STATUS_CREATE)
+        return NULL;
+    f = fopen((const char *)pathname, "wb");
+    if (f == NULL)
+        return NULL;
+    z = (zip_t *)calloc(1, sizeof(*z));
+    z->f = f;
+    return z;
+}
+
+static int
+write_local_header(zip_t *z, zentry_t *e)
+{
+    unsigned char h[30];
+    size_t name_len = strlen(e->name);
+    memset(h, 0, sizeof(h));
+    wr32(h, 0x04034b50);
+    wr16(h + 4, 20);
+    wr16(h + 8, e->method);
+    wr32(h + 14, e->crc);
+    wr32(h + 18, (uLong)e->csize);
+    wr32(h + 22, (uLong)e->usize);
+    wr16(h + 26, (uLong)name_len);
+    if (fwrite(h, 1, 30, z->f) != 30 || fwrite(e->name, 1, name_len, z->f) != name_len)
+        return ZIP_ERRNO;
+    return ZIP_OK;
+}
+
+int
+zipOpenNewFileInZip(zipFile file, const char *filename, const zip_fileinfo *zipfi,
+                    const void *extrafield_local, uInt size_extrafield_local,
+                    const void *extrafield_global, uInt size_extrafield_global,
+                    const char *comment, int method, int level)
+{
+    zip_t *z = (zip_t *)file;
+    zentry_t *e;
+    if (z == NULL || (method != 0 && method != Z_DEFLATED))
+        return ZIP_PARAMERROR;
+    if (z->open)
+        zipCloseFileInZip(file);
+    if (z->num == z->cap) {
+        z->cap = z->cap == 0 ? 16 : z->cap * 2;
+        z->entries = (zentry_t *)realloc(z->entries, z->cap * sizeof(zentry_t));
+    }
+    e = &z->entries[z->num++];
+    memset(e, 0, sizeof(*e));
+    e->name = strdup(filename);
+    e->comment = strdup(comment == NULL ? "" : comment);
+    e->method = (uLong)method;
+    e->crc = crc32(0L, Z_NULL, 0);
+    e->local_off = (ZPOS64_T)ftell(z->f);
+    if (write_local_header(z, e) != ZIP_OK)
+        return ZIP_ERRNO;
+    memset(&z->zs, 0, sizeof(z->zs));
+    if (method == Z_DEFLATED &&
+        deflateInit2(&z->zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) !=
+            Z_OK)
+        return ZIP_INTERNALERROR;
+    z->open = 1;
+    return ZIP_OK;
+}
+
+static int
+deflate_out(zip_t *z, zentry_t *e, int flush)
+{
+    int res;
+    do {
+        size_t have;
+        z->zs.next_out = z->outbuf;
+        z->zs.avail_out = sizeof(z->outbuf);
+        res = deflate(&z->zs, flush);
+        if (res == Z_STREAM_ERROR)
+            return ZIP_INTERNALERROR;
+        have = sizeof(z->outbuf) - z->zs.avail_out;
+        if (have > 0 && fwrite(z->outbuf, 1, have, z->f) != have)
+            return ZIP_ERRNO;
+        e->csize += have;
+    } while (z->zs.avail_out == 0 || (flush == Z_FINISH && res != Z_STREAM_END));
+    return ZIP_OK;
+}
+
+int
+zipWriteInFileInZip(zipFile file, const void *buf, unsigned len)
+{
+    zip_t *z = (zip_t *)file;
+    zentry_t *e;
+    if (z == NULL || !z->open)
+        return ZIP_PARAMERROR;
+    e = &z->entries[z->num - 1];
+    e->crc = crc32(e->crc, (const Bytef *)buf, len);
+    e->usize += len;
+    if (e->method == 0) {
+        if (len > 0 && fwrite(buf, 1, len, z->f) != len)
+            return ZIP_ERRNO;
+        e->csize += len;
+        return ZIP_OK;
+    }
+    z->zs.next_in = (Bytef *)buf;
+    z->zs.avail_in = len;
+    return deflate_out(z, e, Z_NO_FLUSH);
+}
+
+int
+zipCloseFileInZip(zipFile file)
+{
+    zip_t *z = (zip_t *)file;
+    zentry_t *e;
+    long end;
+    int res = ZIP_OK;
+    if (z == NULL || !z->open)
+        return ZIP_PARAMERROR;
+    e = &z->entries[z->num - 1];
+    if (e->method == Z_DEFLATED) {
+        z->zs.next_in = NULL;
+        z->zs.avail_in = 0;
+        res = deflate_out(z, e, Z_FINISH);
+        deflateEnd(&z->zs);
+    }
+    z->open = 0;
+    if (res != ZIP_OK)
+        return res;
+    /* Patch the local header now that sizes and crc are known. */
+    end = ftell(z->f);
+    if (fseek(z->f, (long)e->local_off, SEEK_SET) != 0 || write_local_header(z, e) != ZIP_OK ||
+        fseek(z->f, end, SEEK_SET) != 0)
+        return ZIP_ERRNO;
+    return ZIP_OK;
+}
+
+int
+zipClose(zipFile file, const char *global_comment)
+{
+    zip_t *z = (zip_t *)file;
+    long cd_start, cd_end, i;
+    unsigned char eocd[22];
+    int res = ZIP_OK;
+    if (z == NULL)
+        return ZIP_PARAMERROR;
+    if (z->open)
+        res = zipCloseFileInZip(file);
+    cd_start = ftell(z->f);
+    for (i = 0; i < z->num; i++) {
+        zentry_t *e = &z->entries[i];
+        unsigned char h[46];
+        size_t name_len = strlen(e->name), comment_len = strlen(e->comment);
+        memset(h, 0, sizeof(h));
+        wr32(h, 0x02014b50);
+        wr16(h + 4, 20);
+        wr16(h + 6, 20);
+        wr16(h + 10, e->method);
+        wr32(h + 16, e->crc);
+        wr32(h + 20, (uLong)e->csize);
+        wr32(h + 24, (uLong)e->usize);
+        wr16(h + 28, (uLong)name_len);
+        wr16(h + 32, (uLong)comment_len);
+        wr32(h + 42, (uLong)e->local_off);
+        if (fwrite(h, 1, 46, z->f) != 46 ||
+            fwrite(e->name, 1, name_len, z->f) != name_len ||
+            fwrite(e->comment, 1, comment_len, z->f) != comment_len)
+            res = ZIP_ERRNO;
+        free(e->name);
+        free(e->comment);
+    }
+    cd_end = ftell(z->f);
+    memset(eocd, 0, sizeof(eocd));
+    wr32(eocd, 0x06054b50);
+    wr16(eocd + 8, (uLong)z->num);
+    wr16(eocd + 10, (uLong)z->num);
+    wr32(eocd + 12, (uLong)(cd_end - cd_start));
+    wr32(eocd + 16, (uLong)cd_start);
+    if (fwrite(eocd, 1, sizeof(eocd), z->f) != sizeof(eocd))
+        res = ZIP_ERRNO;
+    if (fclose(z->f) != 0)
+        res = ZIP_ERRNO;
+    free(z->entries);
+    free(z);
+    return res;
+}
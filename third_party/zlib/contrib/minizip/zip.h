@@ -0,0 +1,40 @@
+/* Local build shim standing in for zlib's contrib/minizip (not the real minizip). */
+#ifndef _zip12_H
+#define _zip12_H
+#include "ioapi.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef void *zipFile;
+#define ZIP_OK (0)
+#define ZIP_EOF (0)
+#define ZIP_ERRNO (Z_ERRNO)
+#define ZIP_PARAMERROR (-102)
+#define ZIP_BADZIPFILE (-103)
+#define ZIP_INTERNALERROR (-104)
+#define APPEND_STATUS_CREATE (0)
+#define APPEND_STATUS_CREATEAFTER (1)
+#define APPEND_STATUS_ADDINZIP (2)
+typedef struct {
+    int tm_sec, tm_min, tm_hour, tm_mday, tm_mon, tm_year;
+} tm_zip;
+typedef struct {
+    tm_zip tmz_date;
+    uLong dosDate;
+    uLong internal_fa;
+    uLong external_fa;
+} zip_fileinfo;
+zipFile zipOpen2_64(const void *pathname, int append, const char **globalcomment,
+                    zlib_filefunc64_def *pzlib_filefunc_def);
+zipFile zipOpen(const char *pathname, int append);
+int zipOpenNewFileInZip(zipFile file, const char *filename, const zip_fileinfo *zipfi,
+                        const void *extrafield_local, uInt size_extrafield_local,
+                        const void *extrafield_global, uInt size_extrafield_global,
+                        const char *comment, int method, int level);
+int zipWriteInFileInZip(zipFile file, const void *buf, unsigned len);
+int zipCloseFileInZip(zipFile file);
+int zipClose(zipFile file, const char *global_comment);
+#ifdef __cplusplus
+}
+#endif
+#endif